@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <optional>
@@ -7,7 +8,9 @@
 #include <vector>
 
 #include "./messages.h"
-#include "util.h"
+#include "protocol/profiler.h"
+#include "protocol/util.h"
+#include "protocol/wire.h"
 #include "esp_log.h"
 
 
@@ -15,10 +18,6 @@ namespace comm {
 
 
 class BinarySerializer {
-    static constexpr uint8_t COMMAND_MOVE = 1;
-    static constexpr uint8_t COMMAND_CLAW = 2;
-    static constexpr uint8_t COMMAND_ARM = 3;
-
 public:
     static std::optional<Command> deserializeCommand(std::span<const uint8_t> data) {
         if (data.empty()) {
@@ -28,39 +27,251 @@ public:
         size_t offset = 1;
         const uint8_t commandType = data[0];
 
-        if (commandType == COMMAND_MOVE) {
+        if (commandType == wire::COMMAND_MOVE) {
             Command command;
             command.type = CommandType::Move;
-            if (!readLe(data, offset, command.leftSpeed)) {
+            if (!wire::read<wire::COMMAND_MOVE_FIELDS>(data, offset, command.leftSpeed, command.rightSpeed) ||
+                offset != data.size()) {
                 return std::nullopt;
             }
-            if (!readLe(data, offset, command.rightSpeed)) {
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_CLAW) {
+            Command command;
+            command.type = CommandType::Claw;
+            if (!wire::read<wire::COMMAND_CLAW_FIELDS>(data, offset, command.clawPwm) || offset != data.size()) {
                 return std::nullopt;
             }
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_ARM) {
             if (offset != data.size()) {
                 return std::nullopt;
             }
+            Command command;
+            command.type = CommandType::Arm;
             return command;
         }
 
-        if (commandType == COMMAND_CLAW) {
-            int16_t rawPwm = 0;
-            if (!readLe(data, offset, rawPwm) || offset != data.size()) {
+        if (commandType == wire::COMMAND_LIDAR_FILTER) {
+            uint8_t flags = 0;
+            uint16_t minDistanceMm = 0;
+            uint16_t maxDistanceMm = 0;
+            uint8_t minQuality = 0;
+            if (!wire::read<wire::COMMAND_LIDAR_FILTER_FIELDS>(data, offset, flags, minDistanceMm, maxDistanceMm, minQuality) ||
+                offset != data.size()) {
                 return std::nullopt;
             }
 
+            auto toQ2 = [](uint16_t mm) {
+                return static_cast<uint16_t>(std::min<uint32_t>(mm * 4u, UINT16_MAX));
+            };
+
             Command command;
-            command.type = CommandType::Claw;
-            command.clawPwm = rawPwm;
+            command.type = CommandType::LidarFilter;
+            command.lidarFilter = {
+                .dropInvalid = (flags & wire::LIDAR_FILTER_DROP_INVALID) != 0,
+                .minDistanceQ2 = toQ2(minDistanceMm),
+                .maxDistanceQ2 = maxDistanceMm == 0 ? static_cast<uint16_t>(UINT16_MAX) : toQ2(maxDistanceMm),
+                .minQuality = minQuality,
+            };
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_BEAR_TEMPLATE) {
+            uint8_t flags = 0;
+            uint16_t covarianceRatio = 0;
+            BearTemplate bearTemplate;
+            if (!wire::read<wire::COMMAND_BEAR_TEMPLATE_FIELDS>(
+                    data,
+                    offset,
+                    flags,
+                    bearTemplate.jumpMm,
+                    bearTemplate.maxGapQ6,
+                    bearTemplate.minPoints,
+                    bearTemplate.widthMm,
+                    bearTemplate.widthToleranceMm,
+                    bearTemplate.minRangeMm,
+                    bearTemplate.maxRangeMm,
+                    covarianceRatio) ||
+                offset != data.size()) {
+                return std::nullopt;
+            }
+            bearTemplate.enabled = (flags & wire::BEAR_TEMPLATE_ENABLED) != 0;
+            bearTemplate.minCovarianceRatio = covarianceRatio / 10000.0f;
+
+            Command command;
+            command.type = CommandType::BearTemplate;
+            command.bearTemplate = bearTemplate;
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_FIELD_UPLOAD_BEGIN) {
+            Command command;
+            command.type = CommandType::FieldUploadBegin;
+            if (!wire::read<wire::COMMAND_FIELD_UPLOAD_BEGIN_FIELDS>(data, offset, command.uploadValue) || offset != data.size()) {
+                return std::nullopt;
+            }
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_FIELD_UPLOAD_DATA) {
+            Command command;
+            command.type = CommandType::FieldUploadData;
+            if (!wire::read<wire::COMMAND_FIELD_UPLOAD_DATA_FIELDS>(data, offset, command.uploadValue)) {
+                return std::nullopt;
+            }
+            command.uploadData.assign(data.begin() + offset, data.end());
             return command;
         }
 
-        if (commandType == COMMAND_ARM) {
+        if (commandType == wire::COMMAND_FIELD_UPLOAD_END) {
+            Command command;
+            command.type = CommandType::FieldUploadEnd;
+            if (!wire::read<wire::COMMAND_FIELD_UPLOAD_END_FIELDS>(data, offset, command.uploadValue) || offset != data.size()) {
+                return std::nullopt;
+            }
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_SCORE_PARTICLES) {
+            Command command;
+            command.type = CommandType::ScoreParticles;
+            uint16_t count = 0;
+            if (!wire::read<wire::COMMAND_SCORE_PARTICLES_FIELDS>(data, offset, command.particleSequence, count) ||
+                offset + count * wire::layoutSize(wire::PARTICLE_FIELDS) != data.size()) {
+                return std::nullopt;
+            }
+
+            command.particles.resize(count);
+            for (auto& particle : command.particles) {
+                wire::read<wire::PARTICLE_FIELDS>(data, offset, particle.xMm, particle.yMm, particle.theta);
+            }
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_RECORDER_DUMP) {
             if (offset != data.size()) {
                 return std::nullopt;
             }
             Command command;
-            command.type = CommandType::Arm;
+            command.type = CommandType::RecorderDump;
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_LIDAR_MOTOR) {
+            Command command;
+            command.type = CommandType::LidarMotor;
+            if (!wire::read<wire::COMMAND_LIDAR_MOTOR_FIELDS>(data, offset, command.lidarTargetRpm) || offset != data.size()) {
+                return std::nullopt;
+            }
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_TELEMETRY_CONFIG) {
+            Command command;
+            command.type = CommandType::TelemetryConfig;
+            if (!wire::read<wire::COMMAND_TELEMETRY_CONFIG_FIELDS>(data, offset, command.telemetry.periodMs, command.telemetry.maxPoints) ||
+                offset != data.size()) {
+                return std::nullopt;
+            }
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_PROFILE_DUMP) {
+            uint8_t flags = 0;
+            if (!wire::read<wire::COMMAND_PROFILE_DUMP_FIELDS>(data, offset, flags) || offset != data.size()) {
+                return std::nullopt;
+            }
+            Command command;
+            command.type = CommandType::ProfileDump;
+            command.profileReset = (flags & wire::PROFILE_DUMP_RESET) != 0;
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_LIDAR_OUTPUT) {
+            uint8_t flags = 0;
+            Command command;
+            command.type = CommandType::LidarOutput;
+            auto& mount = command.lidarOutput.mount;
+            if (!wire::read<wire::COMMAND_LIDAR_OUTPUT_FIELDS>(data, offset, flags, mount.xMm, mount.yMm, mount.theta) ||
+                offset != data.size()) {
+                return std::nullopt;
+            }
+            command.lidarOutput.cartesian = (flags & wire::LIDAR_OUTPUT_CARTESIAN) != 0;
+            command.lidarOutput.motionCompensation = (flags & wire::LIDAR_OUTPUT_MOTION_COMPENSATION) != 0;
+            command.lidarOutput.raw = (flags & wire::LIDAR_OUTPUT_RAW) != 0;
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_MOTOR_TRACE) {
+            uint8_t flags = 0;
+            Command command;
+            command.type = CommandType::MotorTrace;
+            auto& trace = command.motorTrace;
+            if (!wire::read<wire::COMMAND_MOTOR_TRACE_FIELDS>(
+                    data, offset, flags, trace.periodUs, trace.postTrigger, trace.stallSpeed, trace.stallSamples) ||
+                offset != data.size()) {
+                return std::nullopt;
+            }
+            trace.captureNow = (flags & wire::MOTOR_TRACE_CAPTURE_NOW) != 0;
+            trace.stallTrigger = (flags & wire::MOTOR_TRACE_STALL_TRIGGER) != 0;
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_COLLISION_GUARD) {
+            uint8_t flags = 0;
+            Command command;
+            command.type = CommandType::CollisionGuard;
+            auto& guard = command.collisionGuard;
+            if (!wire::read<wire::COMMAND_COLLISION_GUARD_FIELDS>(
+                    data, offset, flags, guard.lookaheadMs, guard.minPoints, guard.clearMs, guard.vertexCount) ||
+                guard.vertexCount > CollisionGuardConfig::MAX_VERTICES ||
+                offset + guard.vertexCount * wire::layoutSize(wire::VERTEX_FIELDS) != data.size()) {
+                return std::nullopt;
+            }
+            for (size_t i = 0; i < guard.vertexCount; ++i) {
+                wire::read<wire::VERTEX_FIELDS>(data, offset, guard.vertices[i].x, guard.vertices[i].y);
+            }
+            guard.enabled = (flags & wire::COLLISION_GUARD_ENABLED) != 0;
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_GRASP) {
+            uint8_t action = 0;
+            Command command;
+            command.type = CommandType::Grasp;
+            auto& grasp = command.grasp;
+            if (!wire::read<wire::COMMAND_GRASP_FIELDS>(
+                    data, offset, action, grasp.closeDuty, grasp.rampMs, grasp.timeoutMs, grasp.stallMa, grasp.stallMs, grasp.holdDuty) ||
+                action > static_cast<uint8_t>(GraspAction::Open) ||
+                offset != data.size()) {
+                return std::nullopt;
+            }
+            grasp.action = static_cast<GraspAction>(action);
+            return command;
+        }
+
+        if (commandType == wire::COMMAND_SUBSCRIBE) {
+            Command command;
+            command.type = CommandType::Subscribe;
+            uint8_t count = 0;
+            if (!wire::read<wire::COMMAND_SUBSCRIBE_FIELDS>(data, offset, count) ||
+                offset + count * wire::layoutSize(wire::SUBSCRIPTION_FIELDS) != data.size()) {
+                return std::nullopt;
+            }
+
+            command.subscriptions.resize(count);
+            for (auto& subscription : command.subscriptions) {
+                uint8_t stream = 0;
+                wire::read<wire::SUBSCRIPTION_FIELDS>(data, offset, stream, subscription.periodMs);
+                if (stream >= wire::STREAM_COUNT) {
+                    return std::nullopt;
+                }
+                subscription.stream = static_cast<TelemetryStream>(stream);
+            }
             return command;
         }
 
@@ -68,18 +279,205 @@ public:
     }
 
     static std::vector<uint8_t> serializeMeasurements(const Measurements& measurements) {
+        PROFILE_SCOPE("serialize_measurements");
+        const wire::MeasurementsFields fields = {
+            .timestamp = measurements.timestamp,
+            .cartesian = measurements.cartesian,
+            .motionCompensated = measurements.motionCompensated,
+            .leftTicks = measurements.encoders.leftTicks,
+            .rightTicks = measurements.encoders.rightTicks,
+            .filteredInvalid = measurements.lidarFiltered.invalid,
+            .filteredOutOfRange = measurements.lidarFiltered.outOfRange,
+            .filteredLowQuality = measurements.lidarFiltered.lowQuality,
+            .lidarRpm = measurements.lidarRpm,
+            .batchBacklog = measurements.lidarBatch.backlog,
+            .batchSourceBacklog = measurements.lidarBatch.sourceBacklog,
+            .batchAgeUs = measurements.lidarBatch.ageUs,
+            .batchDropped = measurements.lidarBatch.dropped,
+            .commandsCoalesced = measurements.commandLanes.coalesced,
+            .commandsPreempted = measurements.commandLanes.preempted,
+            .commandsDropped = measurements.commandLanes.dropped,
+        };
+
+        std::vector<uint8_t> payload;
+        if (measurements.cartesian) {
+            wire::encodeMeasurementsXY(fields, measurements.lidarXY, payload);
+        }
+        else {
+            wire::encodeMeasurements(fields, measurements.lidar, payload);
+        }
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeBearCandidates(const BearCandidates& candidates) {
         std::vector<uint8_t> payload;
-        payload.reserve(8 + 2 + measurements.lidar.size() * (2 + 2) + (4 + 4));
+        payload.reserve(1 + wire::layoutSize(wire::MESSAGE_BEAR_CANDIDATES_FIELDS) +
+            candidates.candidates.size() * wire::layoutSize(wire::BEAR_CANDIDATE_FIELDS));
 
-        appendLe<int64_t>(payload, measurements.timestamp);
-        appendLe<uint16_t>(payload, measurements.lidar.size());
-        for (const auto& measurement : measurements.lidar) {
-            appendLe<uint16_t>(payload, measurement.angleQ6);
-            appendLe<uint16_t>(payload, measurement.distanceQ2);
+        appendLe<uint8_t>(payload, wire::MESSAGE_BEAR_CANDIDATES);
+        wire::append<wire::MESSAGE_BEAR_CANDIDATES_FIELDS>(payload, candidates.timestamp, candidates.candidates.size());
+        for (const auto& candidate : candidates.candidates) {
+            wire::append<wire::BEAR_CANDIDATE_FIELDS>(
+                payload, candidate.angleQ6, candidate.distanceQ2, candidate.widthMm, candidate.points, candidate.score);
         }
 
-        appendLe<int32_t>(payload, measurements.encoders.leftTicks);
-        appendLe<int32_t>(payload, measurements.encoders.rightTicks);
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeParticleScores(const ParticleScores& scores) {
+        std::vector<uint8_t> payload;
+        payload.reserve(1 + wire::layoutSize(wire::MESSAGE_PARTICLE_SCORES_FIELDS) +
+            scores.costs.size() * wire::layoutSize(wire::PARTICLE_COST_FIELDS));
+
+        appendLe<uint8_t>(payload, wire::MESSAGE_PARTICLE_SCORES);
+        wire::append<wire::MESSAGE_PARTICLE_SCORES_FIELDS>(payload, scores.sequence, scores.scanTimestamp, scores.points, scores.costs.size());
+        for (uint32_t cost : scores.costs) {
+            wire::append<wire::PARTICLE_COST_FIELDS>(payload, cost);
+        }
+
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeFieldUploadResult(const FieldUploadResult& result) {
+        std::vector<uint8_t> payload;
+        appendLe<uint8_t>(payload, wire::MESSAGE_FIELD_UPLOAD_RESULT);
+        wire::append<wire::MESSAGE_FIELD_UPLOAD_RESULT_FIELDS>(payload, result.ok);
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeRecorderChunk(const RecorderChunk& chunk) {
+        std::vector<uint8_t> payload;
+        payload.reserve(1 + wire::layoutSize(wire::MESSAGE_RECORDER_CHUNK_FIELDS) + chunk.data.size());
+
+        appendLe<uint8_t>(payload, wire::MESSAGE_RECORDER_CHUNK);
+        wire::append<wire::MESSAGE_RECORDER_CHUNK_FIELDS>(payload, chunk.offset, chunk.total);
+        payload.insert(payload.end(), chunk.data.begin(), chunk.data.end());
+
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeLidarStartup(const LidarStartup::Report& report) {
+        std::vector<uint8_t> payload;
+        payload.reserve(1 + wire::layoutSize(wire::MESSAGE_LIDAR_STARTUP_FIELDS));
+
+        const auto& phaseUs = report.phaseUs;
+        appendLe<uint8_t>(payload, wire::MESSAGE_LIDAR_STARTUP);
+        wire::append<wire::MESSAGE_LIDAR_STARTUP_FIELDS>(
+            payload,
+            report.ok,
+            report.attempts,
+            report.health,
+            report.info.model,
+            report.info.firmwareMajor,
+            report.info.firmwareMinor,
+            report.info.hardware,
+            phaseUs[0],
+            phaseUs[1],
+            phaseUs[2],
+            phaseUs[3],
+            phaseUs[4]);
+
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeScanMatch(const ScanMatch& match) {
+        std::vector<uint8_t> payload;
+        payload.reserve(1 + wire::layoutSize(wire::MESSAGE_SCAN_MATCH_FIELDS));
+
+        const auto& result = match.result;
+        appendLe<uint8_t>(payload, wire::MESSAGE_SCAN_MATCH);
+        wire::append<wire::MESSAGE_SCAN_MATCH_FIELDS>(
+            payload,
+            match.timestamp,
+            result.delta.xMm,
+            result.delta.yMm,
+            result.delta.theta,
+            result.quality,
+            result.iterations,
+            result.matched,
+            match.durationUs);
+
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeGuardEvent(const GuardEvent& event) {
+        std::vector<uint8_t> payload;
+        payload.reserve(1 + wire::layoutSize(wire::MESSAGE_GUARD_EVENT_FIELDS));
+
+        appendLe<uint8_t>(payload, wire::MESSAGE_GUARD_EVENT);
+        wire::append<wire::MESSAGE_GUARD_EVENT_FIELDS>(
+            payload,
+            event.timestamp,
+            event.blocked,
+            event.points,
+            event.nearest.x,
+            event.nearest.y,
+            event.leftSpeed,
+            event.rightSpeed,
+            event.reactionUs);
+
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeGraspEvent(const GraspEvent& event) {
+        std::vector<uint8_t> payload;
+        payload.reserve(1 + wire::layoutSize(wire::MESSAGE_GRASP_FIELDS));
+
+        appendLe<uint8_t>(payload, wire::MESSAGE_GRASP);
+        wire::append<wire::MESSAGE_GRASP_FIELDS>(
+            payload,
+            event.timestamp,
+            event.action,
+            event.result,
+            event.durationMs,
+            event.stallMs[0],
+            event.stallMs[1],
+            event.peakMa[0],
+            event.peakMa[1]);
+
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeLidarRaw(const LidarRawBatch& batch) {
+        std::vector<uint8_t> payload;
+        payload.reserve(1 + wire::layoutSize(wire::MESSAGE_LIDAR_RAW_FIELDS) + batch.packets.size() * LidarPassthrough::BYTES_PER_PACKET);
+
+        appendLe<uint8_t>(payload, wire::MESSAGE_LIDAR_RAW);
+        wire::append<wire::MESSAGE_LIDAR_RAW_FIELDS>(payload, batch.timestamp, batch.dropped, batch.checksumErrors, batch.packets.size());
+        for (const auto& packet : batch.packets) {
+            const uint32_t ageUs = std::min<int64_t>(batch.timestamp - packet.arrivalUs, UINT32_MAX);
+            wire::append<wire::LIDAR_RAW_PACKET_FIELDS>(payload, ageUs, packet.sequence);
+            payload.insert(payload.end(), packet.bytes.begin(), packet.bytes.end());
+        }
+
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeLocalGrid(const LocalGridUpdate& update) {
+        std::vector<uint8_t> payload;
+        payload.reserve(1 + wire::layoutSize(wire::MESSAGE_LOCAL_GRID_FIELDS) + update.tiles.size());
+
+        appendLe<uint8_t>(payload, wire::MESSAGE_LOCAL_GRID);
+        wire::append<wire::MESSAGE_LOCAL_GRID_FIELDS>(
+            payload, update.timestamp, update.xMm, update.yMm, update.theta, update.originTileX, update.originTileY, update.tileCount);
+        payload.insert(payload.end(), update.tiles.begin(), update.tiles.end());
+
+        return payload;
+    }
+
+    static std::vector<uint8_t> serializeMotorTraceChunk(const MotorTraceChunk& chunk) {
+        std::vector<uint8_t> payload;
+        payload.reserve(1 + wire::layoutSize(wire::MESSAGE_MOTOR_TRACE_FIELDS) +
+            chunk.samples.size() * 2 * wire::layoutSize(wire::MOTOR_SAMPLE_FIELDS));
+
+        appendLe<uint8_t>(payload, wire::MESSAGE_MOTOR_TRACE);
+        wire::append<wire::MESSAGE_MOTOR_TRACE_FIELDS>(
+            payload, chunk.reason, chunk.periodUs, chunk.total, chunk.trigger, chunk.offset, chunk.samples.size());
+        for (const auto& sample : chunk.samples) {
+            for (const auto& motor : sample.motors) {
+                wire::append<wire::MOTOR_SAMPLE_FIELDS>(payload, motor.setpoint, motor.speed, motor.position);
+            }
+        }
 
         return payload;
     }
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "./messages.h"
+
+
+namespace comm {
+
+
+/**
+ * Hands every command that changes control loop state from the receive
+ * task to the control loop, which applies it between two iterations, so
+ * nothing the loop reads is written concurrently and a burst of setpoints
+ * cannot delay the loop. Motion setpoints are latest-wins: only the newest
+ * is applied at the next tick. Actions (claw, grasp, arm, configuration,
+ * stream subscriptions, lidar motor, motor trace) are applied in order. A
+ * stop, a move with both speeds zero, discards older setpoints and is
+ * applied before everything else.
+ */
+class CommandLanes {
+public:
+    static constexpr size_t MAX_ACTIONS = 16;
+
+private:
+    std::mutex _mutex;
+    std::optional<Command> _stop;
+    std::optional<Command> _motion;
+    std::vector<Command> _actions;
+    // only touched by `drain`, swapped with `_actions` to apply them outside the lock
+    std::vector<Command> _draining;
+    CommandLaneStats _stats;
+
+    static bool isStop(const Command& command) {
+        return command.type == CommandType::Move && command.leftSpeed == 0 && command.rightSpeed == 0;
+    }
+
+    static void saturatingIncrement(uint16_t& counter) {
+        counter += counter < UINT16_MAX;
+    }
+
+public:
+    CommandLanes() {
+        _actions.reserve(MAX_ACTIONS);
+        _draining.reserve(MAX_ACTIONS);
+    }
+
+    CommandLanes(CommandLanes const&) = delete;
+
+    /**
+     * Commands that go through the lanes. Everything else is handled on
+     * arrival and only touches state with its own synchronization: the
+     * field upload and particle scoring, the recorder dump, the profiler.
+     */
+    static bool accepts(const Command& command) {
+        switch (command.type) {
+            case CommandType::Move:
+            case CommandType::Claw:
+            case CommandType::Grasp:
+            case CommandType::Arm:
+            case CommandType::CollisionGuard:
+            case CommandType::Subscribe:
+            case CommandType::LidarFilter:
+            case CommandType::BearTemplate:
+            case CommandType::TelemetryConfig:
+            case CommandType::MotorTrace:
+            case CommandType::LidarOutput:
+            case CommandType::LidarMotor:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void push(const Command& command) {
+        std::lock_guard lock(_mutex);
+        if (isStop(command)) {
+            if (_motion) {
+                saturatingIncrement(_stats.preempted);
+                _motion.reset();
+            }
+            if (_stop) {
+                saturatingIncrement(_stats.coalesced);
+            }
+            _stop = command;
+        }
+        else if (command.type == CommandType::Move) {
+            if (_motion) {
+                saturatingIncrement(_stats.coalesced);
+            }
+            _motion = command;
+        }
+        else if (_actions.size() < MAX_ACTIONS) {
+            _actions.push_back(command);
+        }
+        else {
+            saturatingIncrement(_stats.dropped);
+        }
+    }
+
+    /**
+     * Calls `apply(command)` for everything pending: the stop first, then
+     * the actions in arrival order, then the newest motion setpoint.
+     */
+    template <typename Apply>
+    void drain(Apply&& apply) {
+        std::optional<Command> stop;
+        std::optional<Command> motion;
+        _draining.clear();
+        {
+            std::lock_guard lock(_mutex);
+            std::swap(stop, _stop);
+            std::swap(motion, _motion);
+            std::swap(_draining, _actions);
+        }
+
+        if (stop) {
+            apply(*stop);
+        }
+        for (const auto& action : _draining) {
+            apply(action);
+        }
+        if (motion) {
+            apply(*motion);
+        }
+    }
+
+    // counters since the previous call
+    CommandLaneStats takeStats() {
+        std::lock_guard lock(_mutex);
+        return std::exchange(_stats, {});
+    }
+};
+
+
+} // namespace comm
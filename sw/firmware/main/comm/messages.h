@@ -1,8 +1,22 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 #include <vector>
 #include "../driver/rpLidar.h"
+#include "../driver/clawGrasp.h"
+#include "../driver/lidarFilter.h"
+#include "../driver/lidarStartup.h"
+#include "../driver/motorTrace.h"
+#include "../lidar/clustering.h"
+#include "../lidar/collisionGuard.h"
+#include "../lidar/lidarBatcher.h"
+#include "../lidar/lidarPassthrough.h"
+#include "../lidar/localGrid.h"
+#include "../lidar/pointTransform.h"
+#include "../localization/likelihoodField.h"
+#include "../localization/scanMatcher.h"
+#include "./telemetry_streams.h"
 
 
 namespace comm {
@@ -12,6 +26,21 @@ enum class CommandType {
     Move,
     Claw,
     Arm,
+    LidarFilter,
+    BearTemplate,
+    FieldUploadBegin,
+    FieldUploadData,
+    FieldUploadEnd,
+    ScoreParticles,
+    RecorderDump,
+    LidarMotor,
+    TelemetryConfig,
+    ProfileDump,
+    LidarOutput,
+    MotorTrace,
+    CollisionGuard,
+    Subscribe,
+    Grasp,
 };
 
 
@@ -20,6 +49,23 @@ struct Command {
     int16_t leftSpeed = 0;
     int16_t rightSpeed = 0;
     int16_t clawPwm = 0;
+    GraspConfig grasp;
+    LidarFilterConfig lidarFilter;
+    // 0 = open loop
+    uint16_t lidarTargetRpm = 0;
+    LidarBatchConfig telemetry;
+    LidarOutputConfig lidarOutput;
+    MotorTraceConfig motorTrace;
+    CollisionGuardConfig collisionGuard;
+    std::vector<StreamSubscription> subscriptions;
+    // ProfileDump: clear the histograms after sending them
+    bool profileReset = false;
+    BearTemplate bearTemplate;
+    // FieldUpload*: total size for Begin, chunk offset for Data, CRC-16 for End
+    uint32_t uploadValue = 0;
+    std::vector<uint8_t> uploadData;
+    uint16_t particleSequence = 0;
+    std::vector<ParticlePose> particles;
 };
 
 
@@ -32,10 +78,67 @@ struct EncodersMeasurement {
 };
 
 
+struct CommandLaneStats {
+    // motion setpoints replaced by a newer one before they were applied
+    uint16_t coalesced = 0;
+    // motion setpoints discarded because a later stop overtook them
+    uint16_t preempted = 0;
+    // actions refused because their queue was full
+    uint16_t dropped = 0;
+};
+
+
 struct Measurements {
     int64_t timestamp = 0;
     std::vector<LidarMeasurement> lidar;
+    // robot-frame points, sent instead of `lidar` when `cartesian` is set
+    bool cartesian = false;
+    bool motionCompensated = false;
+    std::vector<ScanPointMm> lidarXY;
     EncodersMeasurement encoders;
+    LidarFilterStats lidarFiltered;
+    // measured lidar revolution rate, 0 = unknown
+    uint16_t lidarRpm = 0;
+    LidarBatchStats lidarBatch;
+    CommandLaneStats commandLanes;
+};
+
+
+struct ParticleScores {
+    uint16_t sequence = 0;
+    int64_t scanTimestamp = 0;
+    // scan points each cost is summed over, 0 if no likelihood field is loaded
+    uint16_t points = 0;
+    std::vector<uint32_t> costs;
+};
+
+
+struct FieldUploadResult {
+    bool ok = false;
+};
+
+
+// part of a flight recorder dump
+struct RecorderChunk {
+    uint32_t offset = 0;
+    uint32_t total = 0;
+    std::span<const uint8_t> data;
+};
+
+
+// alignment of the latest lidar revolution to the previous one
+struct ScanMatch {
+    // time the revolution was processed
+    int64_t timestamp = 0;
+    ScanMatchResult result;
+    // time the matcher took
+    uint32_t durationUs = 0;
+};
+
+
+struct BearCandidates {
+    int64_t timestamp = 0;
+    std::vector<BearCandidate> candidates;
 };
 
 
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "protocol/util.h"
+#include "protocol/wire.h"
+
+
+namespace comm {
+
+
+enum class TelemetryStream : uint8_t {
+    // the lidar measurements frame, paced by the lidar batcher
+    Measurements = wire::STREAM_MEASUREMENTS,
+    Encoders = wire::STREAM_ENCODERS,
+    LidarMotor = wire::STREAM_LIDAR_MOTOR,
+    CollisionGuard = wire::STREAM_COLLISION_GUARD,
+    Link = wire::STREAM_LINK,
+    // tiles of the local occupancy grid, sent by `LocalGrid`
+    LocalGrid = wire::STREAM_LOCAL_GRID,
+};
+
+
+struct StreamSubscription {
+    TelemetryStream stream = TelemetryStream::Encoders;
+    // wire::STREAM_OFF, wire::STREAM_ON_CHANGE or a period
+    uint16_t periodMs = wire::STREAM_OFF;
+};
+
+
+// current values of the streams sent in stream frames
+struct StreamSample {
+    int32_t leftTicks = 0;
+    int32_t rightTicks = 0;
+    uint16_t lidarRpm = 0;
+    uint16_t lidarTargetRpm = 0;
+    int8_t guardBlocked = 0;
+    // setpoints applied after the collision guard, mm/s
+    int16_t guardLeftSpeed = 0;
+    int16_t guardRightSpeed = 0;
+    uint16_t txFree = 0;
+    uint32_t txDropped = 0;
+};
+
+
+/**
+ * Schedules the small telemetry streams the host subscribed to, each at
+ * its own period or whenever its value changes, and packs the due ones
+ * into one stream frame. When the TX buffer is short the lower stream IDs
+ * go first and the others stay due. The lidar measurements frame and the
+ * local grid tiles are messages of their own, sent by the lidar batcher
+ * and the local grid.
+ */
+class TelemetryStreams {
+public:
+    static constexpr size_t COUNT = wire::STREAM_COUNT;
+    static constexpr size_t MAX_RECORD_SIZE = std::max({
+        wire::layoutSize(wire::STREAM_ENCODERS_FIELDS),
+        wire::layoutSize(wire::STREAM_LIDAR_MOTOR_FIELDS),
+        wire::layoutSize(wire::STREAM_COLLISION_GUARD_FIELDS),
+        wire::layoutSize(wire::STREAM_LINK_FIELDS),
+    });
+    // type, timestamp and mask, framing included
+    static constexpr size_t FRAME_OVERHEAD = 1 + wire::layoutSize(wire::MESSAGE_STREAMS_FIELDS) + 16;
+
+private:
+    struct Stream {
+        uint16_t periodMs = wire::STREAM_OFF;
+        int64_t lastUs = 0;
+        bool sent = false;
+        std::array<uint8_t, MAX_RECORD_SIZE> last {};
+    };
+
+    std::array<Stream, COUNT> _streams;
+    std::array<std::array<uint8_t, MAX_RECORD_SIZE>, COUNT> _records {};
+    std::array<size_t, COUNT> _sizes {};
+    std::vector<uint8_t> _record;
+
+    size_t encode(size_t stream, const StreamSample& sample, std::array<uint8_t, MAX_RECORD_SIZE>& out) {
+        std::vector<uint8_t>& record = _record;
+        record.clear();
+        switch (static_cast<TelemetryStream>(stream)) {
+            case TelemetryStream::Encoders:
+                wire::append<wire::STREAM_ENCODERS_FIELDS>(record, sample.leftTicks, sample.rightTicks);
+                break;
+            case TelemetryStream::LidarMotor:
+                wire::append<wire::STREAM_LIDAR_MOTOR_FIELDS>(record, sample.lidarRpm, sample.lidarTargetRpm);
+                break;
+            case TelemetryStream::CollisionGuard:
+                wire::append<wire::STREAM_COLLISION_GUARD_FIELDS>(record, sample.guardBlocked, sample.guardLeftSpeed, sample.guardRightSpeed);
+                break;
+            case TelemetryStream::Link:
+                wire::append<wire::STREAM_LINK_FIELDS>(record, sample.txFree, sample.txDropped);
+                break;
+            default:
+                break;
+        }
+        std::copy(record.begin(), record.end(), out.begin());
+        return record.size();
+    }
+
+    bool due(size_t stream, int64_t nowUs) const {
+        const Stream& state = _streams[stream];
+        if (state.periodMs == wire::STREAM_OFF) {
+            return false;
+        }
+        if (!state.sent) {
+            return true;
+        }
+        if (state.periodMs == wire::STREAM_ON_CHANGE) {
+            return std::memcmp(state.last.data(), _records[stream].data(), _sizes[stream]) != 0;
+        }
+        return nowUs - state.lastUs >= int64_t(state.periodMs) * 1000;
+    }
+
+public:
+    TelemetryStreams() {
+        _record.reserve(MAX_RECORD_SIZE);
+    }
+
+    void subscribe(TelemetryStream stream, uint16_t periodMs) {
+        const auto index = static_cast<size_t>(stream);
+        if (stream == TelemetryStream::Measurements || stream == TelemetryStream::LocalGrid || index >= COUNT) {
+            return;
+        }
+        _streams[index] = Stream { .periodMs = periodMs };
+    }
+
+    // earliest time a periodic stream becomes due, INT64_MAX if none is subscribed
+    int64_t nextDueUs() const {
+        int64_t next = INT64_MAX;
+        for (const Stream& state : _streams) {
+            if (state.periodMs != wire::STREAM_OFF && state.periodMs != wire::STREAM_ON_CHANGE) {
+                next = std::min(next, state.sent ? state.lastUs + int64_t(state.periodMs) * 1000 : 0);
+            }
+        }
+        return next;
+    }
+
+    /**
+     * Writes a stream frame with the due streams that fit into
+     * `txFreeBytes` to `payload`. Returns false, leaving `payload` alone,
+     * if there is nothing to send.
+     */
+    bool take(int64_t nowUs, size_t txFreeBytes, const StreamSample& sample, std::vector<uint8_t>& payload) {
+        if (txFreeBytes <= FRAME_OVERHEAD) {
+            return false;
+        }
+        // COBS adds one byte per 254
+        size_t budget = (txFreeBytes - FRAME_OVERHEAD) * 254 / 255;
+
+        uint8_t mask = 0;
+        for (size_t stream = 0; stream < COUNT; ++stream) {
+            if (_streams[stream].periodMs == wire::STREAM_OFF) {
+                continue;
+            }
+            _sizes[stream] = encode(stream, sample, _records[stream]);
+            if (due(stream, nowUs) && _sizes[stream] <= budget) {
+                budget -= _sizes[stream];
+                mask |= 1 << stream;
+            }
+        }
+        if (mask == 0) {
+            return false;
+        }
+
+        payload.clear();
+        appendLe<uint8_t>(payload, wire::MESSAGE_STREAMS);
+        wire::append<wire::MESSAGE_STREAMS_FIELDS>(payload, nowUs, mask);
+        for (size_t stream = 0; stream < COUNT; ++stream) {
+            if ((mask & (1 << stream)) == 0) {
+                continue;
+            }
+            payload.insert(payload.end(), _records[stream].begin(), _records[stream].begin() + _sizes[stream]);
+            Stream& state = _streams[stream];
+            state.sent = true;
+            state.lastUs = nowUs;
+            state.last = _records[stream];
+        }
+        return true;
+    }
+};
+
+
+} // namespace comm
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "driver/uart.h"
+#include "driver/usb_serial_jtag.h"
+#include "esp_timer.h"
+
+#include "protocol/binlog.h"
+#include "protocol/transport.h"
+
+
+// host link used when nothing else is asked for, 1 selects USB Serial/JTAG
+#ifndef HOST_LINK_USB_SERIAL_JTAG
+#define HOST_LINK_USB_SERIAL_JTAG 0
+#endif
+
+#if HOST_LINK_USB_SERIAL_JTAG && (defined(CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG) || defined(CONFIG_ESP_CONSOLE_SECONDARY_USB_SERIAL_JTAG))
+#error "the console would write into the USB Serial/JTAG host link, build with sdkconfig.defaults.usb_host_link"
+#endif
+
+
+namespace comm {
+
+
+inline TickType_t toTicks(uint32_t timeoutMs) {
+    return timeoutMs == ByteStream::WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+}
+
+
+class UartStream: public ByteStream {
+    uart_port_t _uart;
+
+public:
+    UartStream(uart_port_t uart, int baudRate, int rxBufferSize, int txBufferSize):
+        _uart(uart)
+    {
+        uart_config_t config = {
+            .baud_rate = baudRate,
+            .data_bits = UART_DATA_8_BITS,
+            .parity = UART_PARITY_DISABLE,
+            .stop_bits = UART_STOP_BITS_1,
+            .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+            .rx_flow_ctrl_thresh = 0,
+            .source_clk = UART_SCLK_APB,
+        };
+
+        uart_param_config(_uart, &config);
+        uart_driver_install(_uart, rxBufferSize, txBufferSize, 0, nullptr, 0);
+    }
+
+    size_t read(std::span<uint8_t> buffer, uint32_t timeoutMs) override {
+        if (buffer.empty() || uart_read_bytes(_uart, buffer.data(), 1, toTicks(timeoutMs)) != 1) {
+            return 0;
+        }
+
+        // take whatever else is already buffered
+        size_t available = 0;
+        uart_get_buffered_data_len(_uart, &available);
+        const size_t extra = std::min(available, buffer.size() - 1);
+        const int read = extra > 0 ? uart_read_bytes(_uart, buffer.data() + 1, extra, 0) : 0;
+        return 1 + std::max(read, 0);
+    }
+
+    size_t write(std::span<const uint8_t> data) override {
+        const int written = uart_write_bytes(_uart, reinterpret_cast<const char*>(data.data()), data.size());
+        return std::max(written, 0);
+    }
+
+    size_t txFree() override {
+        size_t free = 0;
+        uart_get_tx_buffer_free_size(_uart, &free);
+        return free;
+    }
+};
+
+
+/**
+ * The native USB Serial/JTAG peripheral. USB full speed runs well above
+ * the UART and the baud rate set by the host is ignored. The console
+ * has to be elsewhere: builds with this link move it to UART0
+ * (sdkconfig.defaults.usb_host_link).
+ *
+ * The driver has no fill level query, so `txFree` is an estimate: bytes
+ * written minus what drained since at a rate learned from the writes. A
+ * write that had to wait or was refused shows the buffer full, the
+ * estimate restarts from there and the rate is halved; a write that went
+ * through at once raises it by an eighth. A host that stops reading costs
+ * one write timeout per `MIN_DRAIN_BYTES_PER_MS` worth of frame.
+ */
+class UsbSerialJtagStream: public ByteStream {
+    // a frame that does not fit by then is dropped, e.g. while no host is attached
+    static constexpr TickType_t WRITE_TIMEOUT = pdMS_TO_TICKS(10);
+    // a write that took this long waited for room
+    static constexpr int64_t WRITE_WAITED_US = 500;
+    // USB full speed bulk tops out near 1 MB/s
+    static constexpr uint32_t MIN_DRAIN_BYTES_PER_MS = 8;
+    static constexpr uint32_t MAX_DRAIN_BYTES_PER_MS = 1024;
+
+    size_t _txBufferSize;
+    std::mutex _mutex;
+    uint32_t _drainBytesPerMs = 256;
+    // estimated bytes in the driver's TX buffer at `_pendingAtUs`
+    size_t _pending = 0;
+    int64_t _pendingAtUs = 0;
+
+    size_t pendingAt(int64_t nowUs) {
+        const auto drained = static_cast<size_t>(std::max<int64_t>(nowUs - _pendingAtUs, 0) * _drainBytesPerMs / 1000);
+        // keep the remainder of a partly drained byte for the next call
+        if (drained > 0 || _pending == 0) {
+            _pending = drained >= _pending ? 0 : _pending - drained;
+            _pendingAtUs = nowUs;
+        }
+        return _pending;
+    }
+
+public:
+    UsbSerialJtagStream(uint32_t rxBufferSize, uint32_t txBufferSize):
+        _txBufferSize(txBufferSize)
+    {
+        usb_serial_jtag_driver_config_t config = {
+            .tx_buffer_size = txBufferSize,
+            .rx_buffer_size = rxBufferSize,
+        };
+        usb_serial_jtag_driver_install(&config);
+    }
+
+    size_t read(std::span<uint8_t> buffer, uint32_t timeoutMs) override {
+        // returns as soon as anything arrived, with all of it that fits
+        const int read = usb_serial_jtag_read_bytes(buffer.data(), buffer.size(), toTicks(timeoutMs));
+        return std::max(read, 0);
+    }
+
+    size_t write(std::span<const uint8_t> data) override {
+        const int64_t began = esp_timer_get_time();
+        const int written = usb_serial_jtag_write_bytes(data.data(), data.size(), WRITE_TIMEOUT);
+        const int64_t now = esp_timer_get_time();
+
+        std::lock_guard lock(_mutex);
+        if (written < static_cast<int>(data.size()) || now - began >= WRITE_WAITED_US) {
+            _drainBytesPerMs = std::max(_drainBytesPerMs / 2, MIN_DRAIN_BYTES_PER_MS);
+            _pending = _txBufferSize;
+            _pendingAtUs = now;
+        }
+        else {
+            _drainBytesPerMs = std::min(_drainBytesPerMs + _drainBytesPerMs / 8, MAX_DRAIN_BYTES_PER_MS);
+            _pending = std::min(pendingAt(now) + data.size(), _txBufferSize);
+        }
+        return std::max(written, 0);
+    }
+
+    size_t txFree() override {
+        if (!usb_serial_jtag_is_connected()) {
+            return 0;
+        }
+        std::lock_guard lock(_mutex);
+        return _txBufferSize - pendingAt(esp_timer_get_time());
+    }
+};
+
+
+enum class HostLink {
+    Uart,
+    UsbSerialJtag,
+};
+
+inline constexpr HostLink DEFAULT_HOST_LINK = HOST_LINK_USB_SERIAL_JTAG ? HostLink::UsbSerialJtag : HostLink::Uart;
+
+
+inline std::unique_ptr<ByteStream> makeHostStream(HostLink link) {
+    if (link == HostLink::UsbSerialJtag) {
+        BINLOG_I("Host link: USB Serial/JTAG");
+        return std::make_unique<UsbSerialJtagStream>(4096, 10240);
+    }
+    BINLOG_I("Host link: UART0 921600 baud");
+    return std::make_unique<UartStream>(UART_NUM_0, 921600, 10240, 10240);
+}
+
+
+/**
+ * Runs `transport.receive()` forever on a task of its own, the receive
+ * callback is called from there.
+ */
+inline void startReceiveTask(FramedTransport& transport) {
+    xTaskCreatePinnedToCore(
+        [](void* arg) {
+            auto& transport = *static_cast<FramedTransport*>(arg);
+            while (true) {
+                transport.receive();
+            }
+        },
+        "transport_rx", 4096, &transport, tskIDLE_PRIORITY + 1, nullptr, 1
+    );
+}
+
+
+} // namespace comm
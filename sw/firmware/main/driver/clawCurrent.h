@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_adc/adc_oneshot.h"
+#include "esp_err.h"
+
+
+/**
+ * Current through the two claw motors, left first, in mA. A source that
+ * cannot measure returns false, the grasp then relies on its timeout.
+ */
+class ClawCurrentSense {
+public:
+    virtual ~ClawCurrentSense() = default;
+
+    virtual bool read(std::array<uint16_t, 2>& milliamps) = 0;
+};
+
+
+// no current sense wired, grasps end at `ClawGrasp::BLIND_TIMEOUT_MS`
+class NoClawCurrentSense: public ClawCurrentSense {
+public:
+    bool read(std::array<uint16_t, 2>&) override {
+        return false;
+    }
+};
+
+
+// returns whatever was set last, for host tests and bench setups without the motors
+class FixedClawCurrentSense: public ClawCurrentSense {
+public:
+    std::array<uint16_t, 2> milliamps {};
+
+    bool read(std::array<uint16_t, 2>& out) override {
+        out = milliamps;
+        return true;
+    }
+};
+
+
+/**
+ * Current sense amplifiers of the claw drivers on two ADC1 channels, read
+ * one shot at a time. The reading is not calibrated, which is plenty for
+ * telling a stalled motor from a running one.
+ */
+class AdcClawCurrentSense: public ClawCurrentSense {
+    adc_oneshot_unit_handle_t _unit = nullptr;
+    std::array<adc_channel_t, 2> _channels;
+    uint16_t _mvPerAmp;
+
+    // full scale at 12 dB attenuation
+    static constexpr int FULL_SCALE_MV = 3100;
+    static constexpr int FULL_SCALE_RAW = 4095;
+
+public:
+    AdcClawCurrentSense(adc_channel_t left, adc_channel_t right, uint16_t mvPerAmp):
+        _channels { left, right },
+        _mvPerAmp(mvPerAmp)
+    {
+        adc_oneshot_unit_init_cfg_t unitConfig = {
+            .unit_id = ADC_UNIT_1,
+            .clk_src = ADC_RTC_CLK_SRC_DEFAULT,
+            .ulp_mode = ADC_ULP_MODE_DISABLE,
+        };
+        if (adc_oneshot_new_unit(&unitConfig, &_unit) != ESP_OK) {
+            _unit = nullptr;
+            return;
+        }
+
+        adc_oneshot_chan_cfg_t channelConfig = {
+            .atten = ADC_ATTEN_DB_12,
+            .bitwidth = ADC_BITWIDTH_12,
+        };
+        for (adc_channel_t channel : _channels) {
+            adc_oneshot_config_channel(_unit, channel, &channelConfig);
+        }
+    }
+
+    AdcClawCurrentSense(AdcClawCurrentSense const&) = delete;
+
+    ~AdcClawCurrentSense() override {
+        if (_unit != nullptr) {
+            adc_oneshot_del_unit(_unit);
+        }
+    }
+
+    bool read(std::array<uint16_t, 2>& milliamps) override {
+        if (_unit == nullptr) {
+            return false;
+        }
+        for (size_t i = 0; i < _channels.size(); ++i) {
+            int raw = 0;
+            if (adc_oneshot_read(_unit, _channels[i], &raw) != ESP_OK) {
+                return false;
+            }
+            const int millivolts = raw * FULL_SCALE_MV / FULL_SCALE_RAW;
+            milliamps[i] = static_cast<uint16_t>(millivolts * 1000 / _mvPerAmp);
+        }
+        return true;
+    }
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "./claws.h"
+#include "./clawCurrent.h"
+
+
+enum class GraspAction : uint8_t {
+    // stops the claws and ends any sequence
+    Stop = 0,
+    Close = 1,
+    Open = 2,
+};
+
+
+enum class GraspResult : uint8_t {
+    // every claw stalled: closed on the object, or fully open
+    Stalled = 1,
+    TimedOut = 2,
+    // replaced by another grasp or claw command
+    Aborted = 3,
+};
+
+
+struct GraspConfig {
+    GraspAction action = GraspAction::Close;
+    // duty that closes the claws, its sign picks the direction as for the claw command
+    int16_t closeDuty = -800;
+    // the duty rises from 0 to `closeDuty` over this time
+    uint16_t rampMs = 150;
+    // closing or opening ends here at the latest
+    uint16_t timeoutMs = 1500;
+    // current above which a claw counts as stalled
+    uint16_t stallMa = 600;
+    // time the current has to stay above `stallMa`, longer than the inrush at start
+    uint16_t stallMs = 40;
+    // duty a closed claw is held with, same sign as `closeDuty`
+    int16_t holdDuty = -300;
+};
+
+
+struct GraspEvent {
+    int64_t timestamp = 0;
+    GraspAction action = GraspAction::Close;
+    GraspResult result = GraspResult::Stalled;
+    // from the command to the end of the sequence
+    uint16_t durationMs = 0;
+    // from the command to each claw stalling, left first, UINT16_MAX if it did not
+    std::array<uint16_t, 2> stallMs {};
+    // highest current of each claw, 0 without current sense
+    std::array<uint16_t, 2> peakMa {};
+};
+
+
+/**
+ * Closes or opens both claws with one command, so the host does not time
+ * a grasp across the link. Closing ramps the duty up and watches each
+ * motor's current: a claw that stalls on the object drops to the hold
+ * duty while the other keeps closing, and once both have stalled (or at
+ * the timeout) the claws are held closed. Opening runs at full close duty
+ * reversed until both stall at their end stops or the timeout, then stops.
+ * Without a current reading nothing stalls, so both end at
+ * `BLIND_TIMEOUT_MS` at the latest instead of pushing into the object or
+ * the end stops for the whole timeout. Called from the control loop,
+ * `update` needs to run every millisecond or so while `moving()`.
+ */
+class ClawGrasp {
+    enum class Phase {
+        Idle,
+        Closing,
+        Holding,
+        Opening,
+    };
+
+    Claws& _claws;
+    ClawCurrentSense& _current;
+    GraspConfig _config;
+    Phase _phase = Phase::Idle;
+    int64_t _startUs = 0;
+    std::array<bool, 2> _stalled {};
+    // since when the current is above the stall threshold, -1 while it is not
+    std::array<int64_t, 2> _aboveSinceUs {};
+    // last set on the claws, none after a reset
+    std::array<int16_t, 2> _duties {};
+    GraspEvent _event;
+
+    static constexpr std::array<int16_t, 2> NO_DUTIES = { INT16_MIN, INT16_MIN };
+
+    void drive(int16_t left, int16_t right) {
+        if (left != _duties[0] || right != _duties[1]) {
+            _duties = { left, right };
+            _claws.setPower(left, right);
+        }
+    }
+
+    void finish(GraspResult result, int64_t nowUs) {
+        _event.timestamp = nowUs;
+        _event.action = _phase == Phase::Opening ? GraspAction::Open : GraspAction::Close;
+        _event.result = result;
+        _event.durationMs = static_cast<uint16_t>(std::min<int64_t>((nowUs - _startUs) / 1000, UINT16_MAX));
+    }
+
+    // false without a current reading
+    bool senseStalls(int64_t nowUs) {
+        std::array<uint16_t, 2> milliamps {};
+        if (!_current.read(milliamps)) {
+            return false;
+        }
+        for (size_t i = 0; i < 2; ++i) {
+            _event.peakMa[i] = std::max(_event.peakMa[i], milliamps[i]);
+            if (_stalled[i]) {
+                continue;
+            }
+            if (milliamps[i] < _config.stallMa) {
+                _aboveSinceUs[i] = -1;
+                continue;
+            }
+            if (_aboveSinceUs[i] < 0) {
+                _aboveSinceUs[i] = nowUs;
+            }
+            if (nowUs - _aboveSinceUs[i] >= int64_t(_config.stallMs) * 1000) {
+                _stalled[i] = true;
+                _event.stallMs[i] = static_cast<uint16_t>(std::min<int64_t>((nowUs - _startUs) / 1000, UINT16_MAX - 1));
+            }
+        }
+        return true;
+    }
+
+public:
+    // the claws travel end to end in 0.4 s at full duty, a little longer at the default close duty
+    static constexpr uint16_t BLIND_TIMEOUT_MS = 700;
+
+    ClawGrasp(Claws& claws, ClawCurrentSense& current):
+        _claws(claws),
+        _current(current)
+    {}
+
+    ClawGrasp(ClawGrasp const&) = delete;
+
+    // closing or opening, the claws are not just holding or idle
+    bool moving() const {
+        return _phase == Phase::Closing || _phase == Phase::Opening;
+    }
+
+    const GraspEvent& event() const {
+        return _event;
+    }
+
+    /**
+     * Ends a running sequence without touching the claws, before another
+     * command drives them. Returns true if one was closing or opening, its
+     * end is in `event()`.
+     */
+    bool cancel(int64_t nowUs) {
+        const bool wasMoving = moving();
+        if (wasMoving) {
+            finish(GraspResult::Aborted, nowUs);
+        }
+        _phase = Phase::Idle;
+        _duties = NO_DUTIES;
+        return wasMoving;
+    }
+
+    void start(const GraspConfig& config, int64_t nowUs) {
+        _config = config;
+        _startUs = nowUs;
+        _stalled = {};
+        _aboveSinceUs = { -1, -1 };
+        _event = GraspEvent { .stallMs = { UINT16_MAX, UINT16_MAX } };
+        _duties = NO_DUTIES;
+        switch (config.action) {
+            case GraspAction::Close:
+                _phase = Phase::Closing;
+                break;
+            case GraspAction::Open:
+                _phase = Phase::Opening;
+                break;
+            case GraspAction::Stop:
+                _phase = Phase::Idle;
+                _claws.stop();
+                break;
+        }
+    }
+
+    // sets the claw duties for `nowUs`, returns true when the sequence ended, see `event()`
+    bool update(int64_t nowUs) {
+        if (!moving()) {
+            return false;
+        }
+        const bool sensed = senseStalls(nowUs);
+
+        const int64_t elapsedUs = nowUs - _startUs;
+        const uint16_t timeoutMs = sensed ? _config.timeoutMs : std::min(_config.timeoutMs, BLIND_TIMEOUT_MS);
+        const bool timedOut = elapsedUs >= int64_t(timeoutMs) * 1000;
+        const bool allStalled = _stalled[0] && _stalled[1];
+
+        if (_phase == Phase::Opening) {
+            if (allStalled || timedOut) {
+                finish(allStalled ? GraspResult::Stalled : GraspResult::TimedOut, nowUs);
+                _phase = Phase::Idle;
+                drive(0, 0);
+                return true;
+            }
+            drive(_stalled[0] ? 0 : -_config.closeDuty, _stalled[1] ? 0 : -_config.closeDuty);
+            return false;
+        }
+
+        if (allStalled || timedOut) {
+            finish(allStalled ? GraspResult::Stalled : GraspResult::TimedOut, nowUs);
+            _phase = Phase::Holding;
+            drive(_config.holdDuty, _config.holdDuty);
+            return true;
+        }
+        const int64_t rampUs = int64_t(_config.rampMs) * 1000;
+        const auto ramp = static_cast<int16_t>(rampUs > elapsedUs ? _config.closeDuty * elapsedUs / rampUs : _config.closeDuty);
+        drive(_stalled[0] ? _config.holdDuty : ramp, _stalled[1] ? _config.holdDuty : ramp);
+        return false;
+    }
+};
@@ -123,6 +123,12 @@ public:
         }
     }
 
+    // each claw on its own, a positive power moves it as `setPower` does
+    void setPower(int left, int right) {
+        _left.setPower(left);
+        _right.setPower(-right);
+    }
+
     int getPos() {
         return 0;
     }
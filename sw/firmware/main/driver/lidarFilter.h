@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+#include "rpLidar.h"
+
+
+struct LidarFilterConfig {
+    bool dropInvalid = true;
+    uint16_t minDistanceQ2 = 0;
+    uint16_t maxDistanceQ2 = UINT16_MAX;
+    // only applied to measurements that carry a quality (standard scan)
+    uint8_t minQuality = 0;
+};
+
+
+struct LidarFilterStats {
+    uint16_t invalid = 0;
+    uint16_t outOfRange = 0;
+    uint16_t lowQuality = 0;
+};
+
+
+/**
+ * Drops lidar samples that are not worth sending to the host and counts
+ * what was dropped. A distance of 0 means the sensor got no return.
+ */
+class LidarFilter {
+    LidarFilterConfig _config;
+    LidarFilterStats _stats;
+
+public:
+    LidarFilter() = default;
+    explicit LidarFilter(LidarFilterConfig config): _config(config) {}
+
+    void setConfig(LidarFilterConfig config) {
+        _config = config;
+    }
+
+    const LidarFilterConfig& config() const {
+        return _config;
+    }
+
+    bool accept(const Measurement& measurement) {
+        if (measurement.distanceQ2 == 0) {
+            if (_config.dropInvalid) {
+                _stats.invalid++;
+                return false;
+            }
+            return true;
+        }
+
+        if (measurement.distanceQ2 < _config.minDistanceQ2 || measurement.distanceQ2 > _config.maxDistanceQ2) {
+            _stats.outOfRange++;
+            return false;
+        }
+
+        if (measurement.quality != Measurement::QUALITY_UNKNOWN && measurement.quality < _config.minQuality) {
+            _stats.lowQuality++;
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Returns the counts accumulated since the previous call and starts over.
+     */
+    LidarFilterStats takeStats() {
+        auto stats = _stats;
+        _stats = {};
+        return stats;
+    }
+};
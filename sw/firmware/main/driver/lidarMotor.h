@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "driver/gpio.h"
+#include "driver/mcpwm_prelude.h"
+
+#include "protocol/binlog.h"
+
+
+/**
+ * PWM drive of the lidar motor. All eight LEDC channels are taken by the
+ * drive motors and the claws, so this uses an MCPWM generator instead.
+ */
+class LidarMotor {
+    static constexpr uint32_t RESOLUTION_HZ = 10'000'000;
+    // 25 kHz, the frequency recommended for the RPLidar motor input
+    static constexpr uint32_t PERIOD_TICKS = 400;
+
+    mcpwm_timer_handle_t _timer = nullptr;
+    mcpwm_oper_handle_t _operator = nullptr;
+    mcpwm_cmpr_handle_t _comparator = nullptr;
+    mcpwm_gen_handle_t _generator = nullptr;
+    float _duty = 0;
+
+public:
+    LidarMotor(gpio_num_t pin, int group = 0) {
+        mcpwm_timer_config_t timerConfig = {
+            .group_id = group,
+            .clk_src = MCPWM_TIMER_CLK_SRC_DEFAULT,
+            .resolution_hz = RESOLUTION_HZ,
+            .count_mode = MCPWM_TIMER_COUNT_MODE_UP,
+            .period_ticks = PERIOD_TICKS,
+            .intr_priority = 0,
+            .flags = {},
+        };
+        mcpwm_operator_config_t operatorConfig = {
+            .group_id = group,
+            .intr_priority = 0,
+            .flags = {},
+        };
+        mcpwm_comparator_config_t comparatorConfig = {
+            .intr_priority = 0,
+            .flags = {},
+        };
+        comparatorConfig.flags.update_cmp_on_tez = true;
+        mcpwm_generator_config_t generatorConfig = {
+            .gen_gpio_num = pin,
+            .flags = {},
+        };
+
+        if (mcpwm_new_timer(&timerConfig, &_timer) != ESP_OK ||
+            mcpwm_new_operator(&operatorConfig, &_operator) != ESP_OK ||
+            mcpwm_operator_connect_timer(_operator, _timer) != ESP_OK ||
+            mcpwm_new_comparator(_operator, &comparatorConfig, &_comparator) != ESP_OK ||
+            mcpwm_new_generator(_operator, &generatorConfig, &_generator) != ESP_OK) {
+            BINLOG_W("Failed to set up MCPWM for the lidar motor");
+            return;
+        }
+
+        mcpwm_comparator_set_compare_value(_comparator, 0);
+        mcpwm_generator_set_action_on_timer_event(_generator,
+            MCPWM_GEN_TIMER_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_EMPTY, MCPWM_GEN_ACTION_HIGH));
+        mcpwm_generator_set_action_on_compare_event(_generator,
+            MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, _comparator, MCPWM_GEN_ACTION_LOW));
+
+        mcpwm_timer_enable(_timer);
+        mcpwm_timer_start_stop(_timer, MCPWM_TIMER_START_NO_STOP);
+    }
+
+    LidarMotor(LidarMotor const&) = delete;
+    LidarMotor(LidarMotor&& other):
+        _timer(other._timer),
+        _operator(other._operator),
+        _comparator(other._comparator),
+        _generator(other._generator),
+        _duty(other._duty)
+    {
+        other._timer = nullptr;
+        other._operator = nullptr;
+        other._comparator = nullptr;
+        other._generator = nullptr;
+    }
+
+    // 0 = stopped, 1 = full speed
+    void setDuty(float duty) {
+        _duty = std::clamp(duty, 0.0f, 1.0f);
+        if (_comparator) {
+            mcpwm_comparator_set_compare_value(_comparator, static_cast<uint32_t>(_duty * PERIOD_TICKS));
+        }
+    }
+
+    float duty() const {
+        return _duty;
+    }
+};
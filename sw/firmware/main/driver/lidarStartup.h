@@ -0,0 +1,237 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "esp_timer.h"
+
+#include "protocol/binlog.h"
+#include "rpLidar.h"
+
+
+/**
+ * Brings the lidar from any state into express scanning without sleeping:
+ * stop, reset (until the boot banner goes quiet), health check, device
+ * info, express scan start. Every phase moves on as soon as the expected
+ * response arrives. Driven by poll() from the task that reads the lidar.
+ */
+class LidarStartup {
+public:
+    enum class Phase : uint8_t {
+        Idle,
+        Stop,
+        Reset,
+        Health,
+        Info,
+        Scan,
+        Running,
+        Failed,
+    };
+
+    static constexpr uint8_t HEALTH_UNKNOWN = 0xFF;
+    static constexpr uint8_t HEALTH_ERROR = 2;
+
+    struct Report {
+        bool ok = false;
+        uint8_t attempts = 0;
+        uint8_t health = HEALTH_UNKNOWN;
+        LidarInfo info;
+        // duration of the last attempt's phases, Stop to Scan
+        std::array<uint32_t, 5> phaseUs {};
+    };
+
+private:
+    static constexpr uint8_t MAX_ATTEMPTS = 3;
+    // the lidar ignores commands for at least 1 ms after a stop
+    static constexpr int64_t STOP_DELAY_US = 2'000;
+    static constexpr int64_t BANNER_QUIET_US = 15'000;
+    static constexpr int64_t RESET_TIMEOUT_US = 1'500'000;
+    static constexpr int64_t RESPONSE_TIMEOUT_US = 200'000;
+    static constexpr size_t HEALTH_SIZE = 3;
+    static constexpr uint8_t EXPRESS_SCAN_TYPE = 0x82;
+    // express scan in legacy mode
+    static constexpr std::array<uint8_t, 5> EXPRESS_SCAN_PAYLOAD = { 0, 0, 0, 0, 0 };
+
+    RpLidar& _lidar;
+    std::atomic<Phase> _phase = Phase::Idle;
+    int64_t _phaseStartUs = 0;
+    int64_t _lastByteUs = 0;
+    std::vector<uint8_t> _response;
+    Report _report;
+
+    void enter(Phase phase, int64_t now) {
+        const auto previous = _phase.load();
+        if (previous >= Phase::Stop && previous <= Phase::Scan) {
+            _report.phaseUs[static_cast<size_t>(previous) - static_cast<size_t>(Phase::Stop)] = now - _phaseStartUs;
+        }
+
+        _phase = phase;
+        _phaseStartUs = now;
+        _response.clear();
+
+        switch (phase) {
+            case Phase::Stop:
+                _lidar.sendRequest(RpLidar::CMD_STOP);
+                break;
+            case Phase::Reset:
+                _lidar.flushInput();
+                _lidar.sendRequest(RpLidar::CMD_RESET);
+                break;
+            case Phase::Health:
+                _lidar.sendRequest(RpLidar::CMD_GET_HEALTH);
+                break;
+            case Phase::Info:
+                _lidar.sendRequest(RpLidar::CMD_GET_INFO);
+                break;
+            case Phase::Scan:
+                _lidar.resetExpress();
+                _lidar.sendRequest(RpLidar::CMD_EXPRESS_SCAN, EXPRESS_SCAN_PAYLOAD);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void retry(int64_t now, const char* reason) {
+        BINLOG_W("Attempt %u failed in phase %u: %s", _report.attempts, static_cast<unsigned>(_phase.load()), reason);
+        if (_report.attempts >= MAX_ATTEMPTS) {
+            enter(Phase::Failed, now);
+            return;
+        }
+        _report.attempts++;
+        enter(Phase::Stop, now);
+    }
+
+    // data of a complete response of `size` bytes, empty while it has not arrived yet
+    std::span<const uint8_t> response(size_t size) {
+        const auto found = ResponseDescriptor::find(_response);
+        if (!found || _response.size() < found->second + size) {
+            return {};
+        }
+        return std::span<const uint8_t>(_response).subspan(found->second, size);
+    }
+
+public:
+    explicit LidarStartup(RpLidar& lidar):
+        _lidar(lidar)
+    {
+        _response.reserve(512);
+    }
+
+    void begin() {
+        _report = Report{};
+        _report.attempts = 1;
+        _lidar.motorOn();
+        enter(Phase::Stop, esp_timer_get_time());
+    }
+
+    Phase phase() const {
+        return _phase;
+    }
+
+    bool running() const {
+        return _phase == Phase::Running;
+    }
+
+    bool failed() const {
+        return _phase == Phase::Failed;
+    }
+
+    // begun and not finished, `poll()` has work to do
+    bool inProgress() const {
+        return _phase != Phase::Idle && !running() && !failed();
+    }
+
+    const Report& report() const {
+        return _report;
+    }
+
+    /**
+     * Advances the bring-up. Returns true once, when it has just finished,
+     * either running or failed.
+     */
+    bool poll() {
+        const Phase phase = _phase;
+        if (phase == Phase::Idle || phase == Phase::Running || phase == Phase::Failed) {
+            return false;
+        }
+
+        const int64_t now = esp_timer_get_time();
+        if (phase != Phase::Stop && _lidar.readAvailable(_response, _response.capacity() - _response.size()) > 0) {
+            _lastByteUs = now;
+        }
+        const int64_t elapsed = now - _phaseStartUs;
+
+        switch (phase) {
+            case Phase::Stop:
+                if (elapsed >= STOP_DELAY_US) {
+                    enter(Phase::Reset, now);
+                }
+                break;
+            case Phase::Reset:
+                // models without a banner are given the full timeout
+                if ((!_response.empty() && now - _lastByteUs >= BANNER_QUIET_US) || elapsed >= RESET_TIMEOUT_US) {
+                    enter(Phase::Health, now);
+                }
+                else if (_response.size() == _response.capacity()) {
+                    _response.clear();
+                }
+                break;
+            case Phase::Health: {
+                const auto data = response(HEALTH_SIZE);
+                if (!data.empty()) {
+                    _report.health = data[0];
+                    if (_report.health == HEALTH_ERROR) {
+                        // a reset clears the error state
+                        retry(now, "health error");
+                    }
+                    else {
+                        enter(Phase::Info, now);
+                    }
+                }
+                else if (elapsed >= RESPONSE_TIMEOUT_US) {
+                    retry(now, "no health response");
+                }
+                break;
+            }
+            case Phase::Info: {
+                const auto data = response(LidarInfo::SIZE);
+                if (!data.empty()) {
+                    _report.info = LidarInfo::parse(data);
+                    enter(Phase::Scan, now);
+                }
+                else if (elapsed >= RESPONSE_TIMEOUT_US) {
+                    retry(now, "no info response");
+                }
+                break;
+            }
+            case Phase::Scan: {
+                const auto found = ResponseDescriptor::find(_response);
+                if (found && found->first.type == EXPRESS_SCAN_TYPE) {
+                    // the first packets may have been read with the descriptor
+                    _lidar.unread(std::span<const uint8_t>(_response).subspan(found->second));
+                    enter(Phase::Running, now);
+                }
+                else if (elapsed >= RESPONSE_TIMEOUT_US) {
+                    retry(now, "express scan not started");
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        const Phase result = _phase;
+        if (result == Phase::Running || result == Phase::Failed) {
+            _report.ok = result == Phase::Running;
+            BINLOG_I("Lidar %s after %u attempt(s): stop=%lu reset=%lu health=%lu info=%lu scan=%lu us",
+                _report.ok ? "running" : "failed", _report.attempts,
+                _report.phaseUs[0], _report.phaseUs[1], _report.phaseUs[2], _report.phaseUs[3], _report.phaseUs[4]);
+            return true;
+        }
+        return false;
+    }
+};
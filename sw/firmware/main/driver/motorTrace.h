@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <vector>
+
+#include <dcmotor.h>
+
+#include "esp_timer.h"
+
+#include "protocol/binlog.h"
+
+
+struct MotorTraceConfig {
+    // record now, without waiting for a trigger
+    bool captureNow = false;
+    // record when a motor stalls
+    bool stallTrigger = false;
+    uint16_t periodUs = 1000;
+    // samples kept after the trigger, the rest of the buffer holds the time before it
+    uint16_t postTrigger = 768;
+    // ticks/s, a driven motor slower than this counts as stalled
+    uint16_t stallSpeed = 50;
+    // consecutive stalled samples that trigger the capture
+    uint16_t stallSamples = 50;
+};
+
+
+enum class MotorTraceReason : uint8_t {
+    Command = 1,
+    Stall = 2,
+};
+
+
+struct MotorTraceSample {
+    struct Motor {
+        // given to `DCMotor::setSpeed`, ticks/s
+        int16_t setpoint;
+        // from the encoder over the sample period, ticks/s
+        int16_t speed;
+        int32_t position;
+    };
+
+    std::array<Motor, 2> motors;
+};
+
+
+// part of a capture, oldest samples first
+struct MotorTraceChunk {
+    MotorTraceReason reason = MotorTraceReason::Command;
+    uint16_t periodUs = 0;
+    // samples in the whole capture
+    uint16_t total = 0;
+    // index of the sample that triggered the capture
+    uint16_t trigger = 0;
+    // index of the first sample of this chunk
+    uint16_t offset = 0;
+    std::span<const MotorTraceSample> samples;
+};
+
+
+/**
+ * Records the speed regulation of both drive motors into a preallocated
+ * RAM ring, from an esp_timer at a fixed period, so tuning `RegParams`
+ * does not need any logging in the loop. The ring runs continuously once
+ * started; a trigger (command or stall) keeps `postTrigger` more samples
+ * and freezes it until the capture is sent.
+ *
+ * The regulator's integral and PWM output are internal to the DCMotor
+ * component, so a sample holds what is visible from outside: setpoint,
+ * measured speed and position.
+ */
+class MotorTrace {
+public:
+    static constexpr size_t CAPACITY = 1024;
+    static constexpr uint16_t MIN_PERIOD_US = 200;
+    // samples per message
+    static constexpr size_t CHUNK_SAMPLES = 32;
+
+    enum class State : uint8_t {
+        Idle,
+        // ring running, waiting for a trigger
+        Armed,
+        // recording the samples after the trigger
+        Triggered,
+        // frozen, being sent
+        Ready,
+    };
+
+private:
+    std::array<DCMotor*, 2> _motors;
+    std::array<std::atomic<int16_t>, 2> _setpoints {};
+    std::vector<MotorTraceSample> _ring;
+    std::array<MotorTraceSample, CHUNK_SAMPLES> _chunk;
+    esp_timer_handle_t _timer = nullptr;
+
+    MotorTraceConfig _config;
+    std::atomic<State> _state = State::Idle;
+    std::atomic<bool> _captureRequested = false;
+    MotorTraceReason _reason = MotorTraceReason::Command;
+
+    // written by the timer only until the capture is Ready
+    size_t _head = 0;
+    size_t _recorded = 0;
+    size_t _remaining = 0;
+    size_t _triggerIndex = 0;
+    std::array<int32_t, 2> _lastPositions {};
+    std::array<uint16_t, 2> _stalled {};
+
+    // read by the sender only once the capture is Ready
+    size_t _sent = 0;
+
+    void freeze() {
+        _sent = 0;
+        _state = State::Ready;
+        esp_timer_stop(_timer);
+    }
+
+    void trigger(MotorTraceReason reason) {
+        _reason = reason;
+        // ring position of the sample just written
+        _triggerIndex = (_head + CAPACITY - 1) % CAPACITY;
+        _remaining = std::min<size_t>(_config.postTrigger, CAPACITY - 1);
+        if (_remaining == 0) {
+            freeze();
+            return;
+        }
+        _state = State::Triggered;
+    }
+
+    bool stalled(size_t motor, const MotorTraceSample::Motor& sample) {
+        const bool slow = sample.setpoint != 0 && std::abs(sample.speed) < _config.stallSpeed;
+        _stalled[motor] = slow ? std::min<uint16_t>(_stalled[motor] + 1, UINT16_MAX) : 0;
+        return _stalled[motor] >= _config.stallSamples;
+    }
+
+    void tick() {
+        const State state = _state;
+        if (state != State::Armed && state != State::Triggered) {
+            return;
+        }
+
+        MotorTraceSample sample;
+        bool stall = false;
+        for (size_t i = 0; i < _motors.size(); ++i) {
+            const auto position = static_cast<int32_t>(_motors[i]->getPosition());
+            const int64_t speed = int64_t(position - _lastPositions[i]) * 1'000'000 / _config.periodUs;
+            _lastPositions[i] = position;
+            sample.motors[i] = {
+                .setpoint = _setpoints[i].load(std::memory_order_relaxed),
+                .speed = static_cast<int16_t>(std::clamp<int64_t>(speed, INT16_MIN, INT16_MAX)),
+                .position = position,
+            };
+            stall |= _config.stallTrigger && stalled(i, sample.motors[i]);
+        }
+
+        _ring[_head] = sample;
+        _head = (_head + 1) % CAPACITY;
+        _recorded++;
+
+        if (state == State::Armed) {
+            if (_captureRequested.exchange(false)) {
+                trigger(MotorTraceReason::Command);
+            }
+            else if (stall) {
+                trigger(MotorTraceReason::Stall);
+            }
+        }
+        else if (--_remaining == 0) {
+            freeze();
+        }
+    }
+
+public:
+    MotorTrace(DCMotor& left, DCMotor& right):
+        _motors { &left, &right },
+        _ring(CAPACITY)
+    {
+        const esp_timer_create_args_t args = {
+            .callback = [](void* arg) {
+                static_cast<MotorTrace*>(arg)->tick();
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "motor_trace",
+            .skip_unhandled_events = true,
+        };
+        esp_timer_create(&args, &_timer);
+    }
+
+    MotorTrace(MotorTrace const&) = delete;
+
+    ~MotorTrace() {
+        esp_timer_stop(_timer);
+        esp_timer_delete(_timer);
+    }
+
+    // setpoint given to the motor, ticks/s
+    void setSetpoint(size_t motor, int setpoint) {
+        _setpoints[motor].store(std::clamp(setpoint, INT16_MIN, INT16_MAX), std::memory_order_relaxed);
+    }
+
+    /**
+     * Starts a capture, dropping any not yet sent. A config without a
+     * trigger only stops the trace.
+     */
+    void start(MotorTraceConfig config) {
+        esp_timer_stop(_timer);
+        _state = State::Idle;
+
+        if (!config.captureNow && !config.stallTrigger) {
+            return;
+        }
+        config.periodUs = std::max(config.periodUs, MIN_PERIOD_US);
+        config.stallSamples = std::max<uint16_t>(config.stallSamples, 1);
+        _config = config;
+
+        _head = 0;
+        _recorded = 0;
+        _stalled = {};
+        for (size_t i = 0; i < _motors.size(); ++i) {
+            _lastPositions[i] = static_cast<int32_t>(_motors[i]->getPosition());
+        }
+        _captureRequested = config.captureNow;
+        _state = State::Armed;
+        esp_timer_start_periodic(_timer, config.periodUs);
+        BINLOG_I("Motor trace armed, period=%uus now=%d stall=%d", config.periodUs, config.captureNow, config.stallTrigger);
+    }
+
+    State state() const {
+        return _state;
+    }
+
+    bool ready() const {
+        return _state == State::Ready;
+    }
+
+    /**
+     * Calls `emit(chunk)` with the next part of a Ready capture, oldest
+     * samples first. Returns false once everything has been sent.
+     */
+    template <typename Emit>
+    bool sendChunk(Emit&& emit) {
+        if (_state != State::Ready) {
+            return false;
+        }
+
+        const size_t total = std::min(_recorded, CAPACITY);
+        const size_t oldest = (_head + CAPACITY - total) % CAPACITY;
+        const size_t count = std::min(CHUNK_SAMPLES, total - _sent);
+        for (size_t i = 0; i < count; ++i) {
+            _chunk[i] = _ring[(oldest + _sent + i) % CAPACITY];
+        }
+
+        emit(MotorTraceChunk {
+            .reason = _reason,
+            .periodUs = _config.periodUs,
+            .total = static_cast<uint16_t>(total),
+            .trigger = static_cast<uint16_t>((_triggerIndex + CAPACITY - oldest) % CAPACITY),
+            .offset = static_cast<uint16_t>(_sent),
+            .samples = std::span<const MotorTraceSample>(_chunk.data(), count),
+        });
+
+        _sent += count;
+        if (_sent >= total) {
+            _state = State::Idle;
+            return false;
+        }
+        return true;
+    }
+};
@@ -1,25 +1,37 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <functional>
 #include <optional>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include <freertos/task.h>
 
 #include "driver/gpio.h"
-#include "driver/ledc.h"
 #include "driver/uart.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 
-#define PWM_CONTROL 0
+#include "protocol/profiler.h"
+#include "lidarMotor.h"
+
+#define PWM_CONTROL 1
 
 
 struct Measurement {
+    // express scans do not report quality
+    static constexpr uint8_t QUALITY_UNKNOWN = 0xFF;
+
     uint16_t distanceQ2;
     uint16_t angleQ6;
+    uint8_t quality = QUALITY_UNKNOWN;
 };
 
 
@@ -42,34 +54,152 @@ struct ExpressCabin {
 struct ParsedExpressPacket {
     uint16_t startAngleQ6;
     std::array<ExpressCabin, 16> cabins;
+    uint32_t sequence;
+};
+
+
+// express scan packet as read from the UART, sync bytes included
+struct ExpressPacket {
+    static constexpr size_t SIZE = 84;
+
+    std::array<uint8_t, SIZE> bytes;
+    int64_t arrivalUs;
+    // counts the packets read, a gap means one was dropped or not decoded
+    uint32_t sequence;
+
+    uint16_t startAngleQ6() const {
+        return bytes[2] | ((bytes[3] & 0x7F) << 8);
+    }
+
+    // the sync bytes carry the XOR of everything after them, low nibble first
+    bool checksumValid() const {
+        uint8_t checksum = 0;
+        for (size_t i = 2; i < SIZE; ++i) {
+            checksum ^= bytes[i];
+        }
+        return checksum == ((bytes[0] & 0x0F) | ((bytes[1] & 0x0F) << 4));
+    }
+
+    ParsedExpressPacket parse() const {
+        ParsedExpressPacket packet;
+        packet.startAngleQ6 = startAngleQ6();
+        packet.sequence = sequence;
+        for (size_t i = 0; i < packet.cabins.size(); ++i) {
+            packet.cabins[i] = ExpressCabin::parse(std::span<const uint8_t>(bytes.data() + 4 + i * 5, 5));
+        }
+        return packet;
+    }
+};
+
+
+// header the lidar sends before the data of a request: A5 5A, length and mode, data type
+struct ResponseDescriptor {
+    static constexpr size_t SIZE = 7;
+
+    uint32_t length;
+    uint8_t mode;
+    uint8_t type;
+
+    /**
+     * Finds the first descriptor in `data`. Returns it together with the
+     * offset of the data that follows it.
+     */
+    static std::optional<std::pair<ResponseDescriptor, size_t>> find(std::span<const uint8_t> data) {
+        for (size_t i = 0; i + SIZE <= data.size(); ++i) {
+            if (data[i] != 0xA5 || data[i + 1] != 0x5A) {
+                continue;
+            }
+            const uint32_t header = data[i + 2] | (static_cast<uint32_t>(data[i + 3]) << 8)
+                | (static_cast<uint32_t>(data[i + 4]) << 16) | (static_cast<uint32_t>(data[i + 5]) << 24);
+            return std::pair{ ResponseDescriptor{ header & 0x3FFFFFFF, static_cast<uint8_t>(header >> 30), data[i + 6] }, i + SIZE };
+        }
+        return std::nullopt;
+    }
+};
+
+
+struct LidarInfo {
+    uint8_t model = 0;
+    uint8_t firmwareMajor = 0;
+    uint8_t firmwareMinor = 0;
+    uint8_t hardware = 0;
+    std::array<uint8_t, 16> serial {};
+
+    static constexpr size_t SIZE = 20;
+
+    static LidarInfo parse(std::span<const uint8_t> data) {
+        LidarInfo info;
+        info.model = data[0];
+        info.firmwareMinor = data[1];
+        info.firmwareMajor = data[2];
+        info.hardware = data[3];
+        std::copy(data.begin() + 4, data.begin() + 4 + info.serial.size(), info.serial.begin());
+        return info;
+    }
 };
 
 
 class RpLidar {
+public:
+    using PacketHook = std::function<void(std::span<const uint8_t>)>;
+
+private:
     uart_port_t _uart;
-    ledc_channel_t _motorChannel;
+    QueueHandle_t _events = nullptr;
     gpio_num_t _motorPin;
+#if PWM_CONTROL
+    LidarMotor _motor;
+#endif
+    float _motorDuty = 1.0f;
     std::optional<ParsedExpressPacket> _expressPrevPacket;
+    PacketHook _packetHook;
+    std::optional<uint16_t> _lastStartAngleQ6;
+    int64_t _lastWrapUs = 0;
+    uint16_t _checksumErrors = 0;
+    uint32_t _packetSequence = 0;
+    std::optional<uint32_t> _revolutionPeriodUs;
+    // bytes read together with a response descriptor and handed back, they precede the UART buffer
+    std::vector<uint8_t> _unread;
 
     static constexpr int BAUD_RATE = 115200;
     static constexpr int RX_BUFFER_SIZE = 10240;
     static constexpr int TX_BUFFER_SIZE = 0;
-    static constexpr int EXPRESS_PACKET_SIZE = 84;
+    static constexpr int EVENT_QUEUE_SIZE = 16;
+    static constexpr int EXPRESS_PACKET_SIZE = ExpressPacket::SIZE;
     static constexpr int CABINS_PER_PACKET = 16;
     static constexpr uint16_t FULL_CIRCLE_Q6 = 360 * 64;
 
+    // handed back bytes first, then the UART buffer, without waiting
+    size_t readInput(uint8_t* out, size_t size) {
+        const size_t fromUnread = std::min(size, _unread.size());
+        std::copy_n(_unread.begin(), fromUnread, out);
+        _unread.erase(_unread.begin(), _unread.begin() + fromUnread);
+        if (fromUnread == size) {
+            return size;
+        }
+        const int read = uart_read_bytes(_uart, out + fromUnread, size - fromUnread, 0);
+        return fromUnread + std::max(read, 0);
+    }
+
 public:
+    static constexpr uint8_t CMD_STOP = 0x25;
+    static constexpr uint8_t CMD_RESET = 0x40;
+    static constexpr uint8_t CMD_SCAN = 0x20;
+    static constexpr uint8_t CMD_EXPRESS_SCAN = 0x82;
+    static constexpr uint8_t CMD_GET_INFO = 0x50;
+    static constexpr uint8_t CMD_GET_HEALTH = 0x52;
+
     RpLidar(
         uart_port_t uartUnit,
         gpio_num_t tx,
         gpio_num_t rx,
-        gpio_num_t motorPin,
-        ledc_channel_t motorChannel,
-        ledc_timer_t motorTimer
+        gpio_num_t motorPin
     ):
         _uart(uartUnit),
-        _motorChannel(motorChannel),
         _motorPin(motorPin)
+#if PWM_CONTROL
+        , _motor(motorPin)
+#endif
     {
         uart_config_t config {
             .baud_rate = BAUD_RATE,
@@ -82,21 +212,11 @@ public:
         };
         uart_param_config(_uart, &config);
         uart_set_pin(_uart, tx, rx, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-        uart_driver_install(_uart, RX_BUFFER_SIZE, TX_BUFFER_SIZE, 0, nullptr, 0);
+        uart_driver_install(_uart, RX_BUFFER_SIZE, TX_BUFFER_SIZE, EVENT_QUEUE_SIZE, &_events, 0);
+        // a data event for every express packet instead of every 120 bytes
+        uart_set_rx_full_threshold(_uart, EXPRESS_PACKET_SIZE);
 
-#if PWM_CONTROL
-        ledc_channel_config_t channelConfig = {
-            .gpio_num = _motorPin,
-            .speed_mode = LEDC_LOW_SPEED_MODE,
-            .channel = _motorChannel,
-            .intr_type = LEDC_INTR_DISABLE,
-            .timer_sel = motorTimer,
-            .duty = 0,
-            .hpoint = 0,
-            .flags = {},
-        };
-        ledc_channel_config(&channelConfig);
-#else
+#if !PWM_CONTROL
         gpio_set_direction(_motorPin, GPIO_MODE_OUTPUT);
         gpio_set_level(_motorPin, 0);
 #endif
@@ -105,20 +225,134 @@ public:
     RpLidar(RpLidar const&) = delete;
     RpLidar(RpLidar&& other):
         _uart(other._uart),
-        _motorChannel(other._motorChannel),
+        _events(other._events),
         _motorPin(other._motorPin),
-        _expressPrevPacket(std::move(other._expressPrevPacket))
+#if PWM_CONTROL
+        _motor(std::move(other._motor)),
+#endif
+        _motorDuty(other._motorDuty),
+        _expressPrevPacket(std::move(other._expressPrevPacket)),
+        _packetHook(std::move(other._packetHook)),
+        _unread(std::move(other._unread))
     {
         other._uart = UART_NUM_MAX;
     }
 
-    void start() {
+    uart_port_t uart() const {
+        return _uart;
+    }
+
+    // events of the UART driver, data received among them
+    QueueHandle_t eventQueue() const {
+        return _events;
+    }
+
+    /**
+     * Called with every raw express scan packet (sync bytes included) as it
+     * is read, from the task that polls the lidar.
+     */
+    void setPacketHook(PacketHook hook) {
+        _packetHook = std::move(hook);
+    }
+
+    void motorOn() {
 #if PWM_CONTROL
-        ledc_set_duty(LEDC_LOW_SPEED_MODE, _motorChannel, 1024);
-        ledc_update_duty(LEDC_LOW_SPEED_MODE, _motorChannel);
+        _motor.setDuty(_motorDuty);
 #else
         gpio_set_level(_motorPin, 1);
 #endif
+    }
+
+    /**
+     * Sends a request, with the payload size and checksum if it has a payload.
+     * Does not wait for the response.
+     */
+    void sendRequest(uint8_t command, std::span<const uint8_t> payload = {}) {
+        std::vector<uint8_t> request{ 0xA5, command };
+        if (!payload.empty()) {
+            request.push_back(payload.size());
+            request.insert(request.end(), payload.begin(), payload.end());
+            uint8_t checksum = 0;
+            for (uint8_t byte : request) {
+                checksum ^= byte;
+            }
+            request.push_back(checksum);
+        }
+        uart_write_bytes(_uart, request.data(), request.size());
+    }
+
+    // appends whatever the lidar has sent so far, up to `max` bytes, without waiting
+    size_t readAvailable(std::vector<uint8_t>& out, size_t max = 256) {
+        size_t available = 0;
+        uart_get_buffered_data_len(_uart, &available);
+        available = std::min(available, max);
+        if (available == 0) {
+            return 0;
+        }
+
+        const size_t offset = out.size();
+        out.resize(offset + available);
+        const int read = uart_read_bytes(_uart, out.data() + offset, available, 0);
+        out.resize(offset + std::max(read, 0));
+        return std::max(read, 0);
+    }
+
+    void flushInput() {
+        _unread.clear();
+        uart_flush_input(_uart);
+    }
+
+    /**
+     * Hands back bytes that arrived after a response descriptor, like the
+     * first express packets after the scan descriptor. The packet reader
+     * takes them before anything still in the UART buffer.
+     */
+    void unread(std::span<const uint8_t> data) {
+        _unread.insert(_unread.begin(), data.begin(), data.end());
+    }
+
+    size_t bufferedBytes() {
+        size_t available = 0;
+        uart_get_buffered_data_len(_uart, &available);
+        return _unread.size() + available;
+    }
+
+    // forgets the previous express packet, the next one starts a new stream
+    void resetExpress() {
+        _expressPrevPacket.reset();
+        _lastStartAngleQ6.reset();
+        _lastWrapUs = 0;
+    }
+
+    // express packets dropped for a wrong checksum since the previous call
+    uint16_t takeChecksumErrors() {
+        return std::exchange(_checksumErrors, 0);
+    }
+
+    /**
+     * Sets the motor speed used while scanning, 0 to 1. Without
+     * PWM_CONTROL the motor is only switched on and off.
+     */
+    void setMotorDuty(float duty) {
+        _motorDuty = duty;
+#if PWM_CONTROL
+        if (_motor.duty() > 0) {
+            _motor.setDuty(duty);
+        }
+#endif
+    }
+
+    /**
+     * Time of the last complete revolution, measured between start angle
+     * wraps of express packets. Empty if no revolution completed since the
+     * previous call.
+     */
+    std::optional<uint32_t> takeRevolutionPeriod() {
+        return std::exchange(_revolutionPeriodUs, std::nullopt);
+    }
+
+    void start() {
+        motorOn();
 
         std::array<uint8_t, 2> startStop{{0xA5, 0x25}};
         uart_write_bytes(_uart, startStop.data(), startStop.size());
@@ -142,8 +376,7 @@ public:
         uart_write_bytes(_uart, stop.data(), stop.size());
 
 #if PWM_CONTROL
-        ledc_set_duty(LEDC_LOW_SPEED_MODE, _motorChannel, 0);
-        ledc_update_duty(LEDC_LOW_SPEED_MODE, _motorChannel);
+        _motor.setDuty(0);
 #else
         gpio_set_level(_motorPin, 0);
 #endif
@@ -151,15 +384,11 @@ public:
         vTaskDelay(pdMS_TO_TICKS(50));
     }
 
+    // blocking bring-up for bench tests, the firmware uses LidarStartup
     void startExpress() {
-        _expressPrevPacket.reset();
+        resetExpress();
 
-#if PWM_CONTROL
-        ledc_set_duty(LEDC_LOW_SPEED_MODE, _motorChannel, 1024);
-        ledc_update_duty(LEDC_LOW_SPEED_MODE, _motorChannel);
-#else
-        gpio_set_level(_motorPin, 1);
-#endif
+        motorOn();
 
         std::array<uint8_t, 2> stopCmd{{0xA5, 0x25}};
         uart_write_bytes(_uart, stopCmd.data(), stopCmd.size());
@@ -179,18 +408,28 @@ public:
     }
 
     std::optional<std::vector<Measurement>> getMeasurementsExpress() {
-        auto packet = expressReadPacket();
+        auto packet = readExpressPacket();
         if (!packet) {
             return std::nullopt;
         }
+        return decodeExpress(*packet);
+    }
 
-        if (!_expressPrevPacket) {
+    /**
+     * Measurements of the packet before `packet`, whose angles are
+     * interpolated up to the start angle of `packet`. Empty unless the
+     * packet read just before it was decoded too.
+     */
+    std::optional<std::vector<Measurement>> decodeExpress(const ExpressPacket& raw) {
+        auto packet = raw.parse();
+
+        if (!_expressPrevPacket || _expressPrevPacket->sequence + 1 != packet.sequence) {
             _expressPrevPacket = std::move(packet);
             return std::nullopt;
         }
 
         auto prevAngleQ6 = _expressPrevPacket->startAngleQ6;
-        auto curAngleQ6 = packet->startAngleQ6;
+        auto curAngleQ6 = packet.startAngleQ6;
 
         uint16_t angleDiff;
         if (curAngleQ6 >= prevAngleQ6) {
@@ -199,6 +438,7 @@ public:
             angleDiff = FULL_CIRCLE_Q6 + curAngleQ6 - prevAngleQ6;
         }
 
+        PROFILE_SCOPE("lidar_decode_cabins");
         std::vector<Measurement> result;
         result.reserve(CABINS_PER_PACKET * 2);
 
@@ -215,8 +455,8 @@ public:
             while (angle2 < 0) angle2 += FULL_CIRCLE_Q6;
             while (angle2 >= FULL_CIRCLE_Q6) angle2 -= FULL_CIRCLE_Q6;
 
-            result.push_back({static_cast<uint16_t>(cabin.distance1 * 4), static_cast<uint16_t>(angle1)});
-            result.push_back({static_cast<uint16_t>(cabin.distance2 * 4), static_cast<uint16_t>(angle2)});
+            result.push_back({static_cast<uint16_t>(cabin.distance1 * 4), static_cast<uint16_t>(angle1), Measurement::QUALITY_UNKNOWN});
+            result.push_back({static_cast<uint16_t>(cabin.distance2 * 4), static_cast<uint16_t>(angle2), Measurement::QUALITY_UNKNOWN});
         }
 
         _expressPrevPacket = std::move(packet);
@@ -234,7 +474,7 @@ public:
                 uart_get_buffered_data_len(_uart, &available);
                 continue;
             }
-            // uint8_t quality = data >> 2;
+            uint8_t quality = data >> 2;
 
             uart_read_bytes(_uart, &data, 1, 0);
             if ((data & 0x01) == 0) {
@@ -251,6 +491,7 @@ public:
 
             measurement.angleQ6 = angleQ6;
             measurement.distanceQ2 = distanceQ2;
+            measurement.quality = quality;
 
             return std::array{ measurement };
         }
@@ -259,98 +500,90 @@ public:
     }
 
     std::string getInfo() {
-        // flush uart buffer
-        uint8_t flushB = 0;
-        while (uart_read_bytes(_uart, &flushB, 1, 0) == 1) {}
-
-        std::array<uint8_t, 2> req{{0xA5, 0x50}};
-        uart_write_bytes(_uart, req.data(), req.size());
-
-        vTaskDelay(pdMS_TO_TICKS(50));
-
-        // search for descriptor sync in the response stream
-        uint8_t desc[7] = {};
-        TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(200);
-        int descIdx = 0;
-        while (descIdx < 7 && xTaskGetTickCount() < deadline) {
-            if (uart_read_bytes(_uart, desc + descIdx, 1, pdMS_TO_TICKS(10)) == 1) {
-                if (descIdx == 0 && desc[0] != 0xA5) continue;
-                if (descIdx == 1 && desc[1] != 0x5A) { descIdx = 0; continue; }
-                descIdx++;
+        flushInput();
+        sendRequest(CMD_GET_INFO);
+
+        std::vector<uint8_t> response;
+        const TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(200);
+        std::optional<std::pair<ResponseDescriptor, size_t>> found;
+        while (xTaskGetTickCount() < deadline) {
+            readAvailable(response);
+            found = ResponseDescriptor::find(response);
+            if (found && (found->first.length != LidarInfo::SIZE || response.size() >= found->second + LidarInfo::SIZE)) {
+                break;
             }
+            vTaskDelay(1);
         }
 
-        if (descIdx < 7) {
+        if (!found) {
             return "Error: no response descriptor";
         }
-
-        uint32_t descHeader = desc[2] | (static_cast<uint32_t>(desc[3]) << 8)
-                            | (static_cast<uint32_t>(desc[4]) << 16) | (static_cast<uint32_t>(desc[5]) << 24);
-        uint32_t dataLen = descHeader & 0x3FFFFFFF;
-
-        if (dataLen != 20) {
+        if (found->first.length != LidarInfo::SIZE) {
             return "Error: unexpected info length";
         }
-
-        uint8_t info[20] = {};
-        for (int i = 0; i < 20; i++) {
-            if (uart_read_bytes(_uart, info + i, 1, pdMS_TO_TICKS(50)) != 1) {
-                return "Error: incomplete info response";
-            }
+        if (response.size() < found->second + LidarInfo::SIZE) {
+            return "Error: incomplete info response";
         }
 
-        uint8_t model = info[0];
-        uint8_t fwMinor = info[1];
-        uint8_t fwMajor = info[2];
-        uint8_t hw = info[3];
+        const auto info = LidarInfo::parse(std::span<const uint8_t>(response).subspan(found->second));
 
         char serialStr[33] = {};
         for (int i = 0; i < 16; i++) {
-            snprintf(serialStr + i * 2, 3, "%02X", info[4 + i]);
+            snprintf(serialStr + i * 2, 3, "%02X", info.serial[i]);
         }
 
         char result[128] = {};
         snprintf(result, sizeof(result),
             "Model: %u, Firmware: %u.%u, Hardware: %u, Serial: %s",
-            model, fwMajor, fwMinor, hw, serialStr);
+            info.model, info.firmwareMajor, info.firmwareMinor, info.hardware, serialStr);
         return std::string(result);
     }
 
-    std::optional<ParsedExpressPacket> expressReadPacket() {
-        size_t available = 0;
-        uart_get_buffered_data_len(_uart, &available);
+    /**
+     * Reads the next express packet, only checking its sync bytes and
+     * checksum. Also tracks the revolution period from the start angles.
+     */
+    std::optional<ExpressPacket> readExpressPacket() {
+        PROFILE_SCOPE("lidar_read_packet");
+        size_t available = bufferedBytes();
 
         while (available >= EXPRESS_PACKET_SIZE) {
-            uint8_t sync1 = 0;
-            uart_read_bytes(_uart, &sync1, 1, 0);
-            if ((sync1 >> 4) != 0xA) {
-                uart_get_buffered_data_len(_uart, &available);
+            ExpressPacket packet;
+            readInput(&packet.bytes[0], 1);
+            if ((packet.bytes[0] >> 4) != 0xA) {
+                available = bufferedBytes();
                 continue;
             }
 
-            uint8_t sync2 = 0;
-            uart_read_bytes(_uart, &sync2, 1, 0);
-            if ((sync2 >> 4) != 0x5) {
-                uart_get_buffered_data_len(_uart, &available);
+            readInput(&packet.bytes[1], 1);
+            if ((packet.bytes[1] >> 4) != 0x5) {
+                available = bufferedBytes();
                 continue;
             }
 
-            // ignored
-            // uint8_t checksum = ((sync1 & 0x0F) << 4) | (sync2 & 0x0F);
+            // the rest was already buffered when the sync bytes were
+            readInput(packet.bytes.data() + 2, EXPRESS_PACKET_SIZE - 2);
+            packet.arrivalUs = esp_timer_get_time();
 
-            std::array<uint8_t, EXPRESS_PACKET_SIZE - 2> rest{};
-            for (int i = 0; i < EXPRESS_PACKET_SIZE - 2; ++i) {
-                while (uart_read_bytes(_uart, &rest[i], 1, pdMS_TO_TICKS(1)) != 1) {}
+            if (_packetHook) {
+                _packetHook(packet.bytes);
             }
 
-            uint16_t startAngleQ6 = rest[0] | ((rest[1] & 0x7F) << 8);
-
-            ParsedExpressPacket packet;
-            packet.startAngleQ6 = startAngleQ6;
+            packet.sequence = _packetSequence++;
+            if (!packet.checksumValid()) {
+                _checksumErrors += _checksumErrors < UINT16_MAX;
+                available = bufferedBytes();
+                continue;
+            }
 
-            for (int i = 0; i < CABINS_PER_PACKET; ++i) {
-                packet.cabins[i] = ExpressCabin::parse(std::span<const uint8_t>(rest.data() + 2 + i * 5, 5));
+            const uint16_t startAngleQ6 = packet.startAngleQ6();
+            if (_lastStartAngleQ6 && startAngleQ6 < *_lastStartAngleQ6) {
+                if (_lastWrapUs != 0) {
+                    _revolutionPeriodUs = packet.arrivalUs - _lastWrapUs;
+                }
+                _lastWrapUs = packet.arrivalUs;
             }
+            _lastStartAngleQ6 = startAngleQ6;
 
             return packet;
         }
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "protocol/profiler.h"
+#include "../driver/rpLidar.h"
+
+
+/**
+ * What a bear looks like to the lidar: a short foreground segment whose
+ * visible width is close to the bear diameter and which is not a straight line.
+ */
+struct BearTemplate {
+    bool enabled = true;
+    // range difference between neighbouring points that splits a segment
+    uint16_t jumpMm = 60;
+    // angular gap between neighbouring points that splits a segment
+    uint16_t maxGapQ6 = 3 * 64;
+    uint8_t minPoints = 3;
+    uint16_t widthMm = 100;
+    uint16_t widthToleranceMm = 50;
+    uint16_t minRangeMm = 100;
+    uint16_t maxRangeMm = 3000;
+    // minor/major axis ratio of the point covariance, rejects flat segments
+    float minCovarianceRatio = 0.01f;
+};
+
+
+struct BearCandidate {
+    // centroid of the segment points, sensor frame, same units as Measurement
+    uint16_t angleQ6;
+    uint16_t distanceQ2;
+    uint16_t widthMm;
+    uint8_t points;
+    // 255 = width matches the template exactly, 0 = at the tolerance limit
+    uint8_t score;
+};
+
+
+/**
+ * Splits a revolution into segments at range discontinuities and keeps
+ * the ones that match a BearTemplate. Pure computation, no hardware access.
+ */
+class ScanClusterer {
+    static constexpr uint16_t FULL_CIRCLE_Q6 = 360 * 64;
+    static constexpr float Q6_TO_RAD = static_cast<float>(M_PI) / (180.0f * 64.0f);
+
+    struct Point {
+        float x;
+        float y;
+        float range;
+        uint16_t angleQ6;
+    };
+
+    BearTemplate _template;
+    std::vector<Point> _points;
+
+    bool isBreak(size_t i, size_t j) const {
+        const auto& a = _points[i];
+        const auto& b = _points[j];
+        const uint16_t gap = (b.angleQ6 + FULL_CIRCLE_Q6 - a.angleQ6) % FULL_CIRCLE_Q6;
+        return gap > _template.maxGapQ6 || std::fabs(a.range - b.range) > _template.jumpMm;
+    }
+
+    // a neighbour just across a range jump that is closer to the sensor occludes the segment
+    bool isOccludedBy(size_t edge, size_t neighbour) const {
+        const auto& a = _points[edge];
+        const auto& b = _points[neighbour];
+        const uint16_t gap = (b.angleQ6 + FULL_CIRCLE_Q6 - a.angleQ6) % FULL_CIRCLE_Q6;
+        const uint16_t gapBack = (a.angleQ6 + FULL_CIRCLE_Q6 - b.angleQ6) % FULL_CIRCLE_Q6;
+        return std::min(gap, gapBack) <= _template.maxGapQ6 && b.range < a.range;
+    }
+
+    static float covarianceRatio(float sxx, float sxy, float syy) {
+        const float trace = sxx + syy;
+        const float root = std::sqrt(std::max(0.0f, (sxx - syy) * (sxx - syy) + 4.0f * sxy * sxy));
+        const float major = (trace + root) / 2.0f;
+        const float minor = (trace - root) / 2.0f;
+        return major > 1e-6f ? minor / major : 0.0f;
+    }
+
+    void evaluate(size_t start, size_t count, std::vector<BearCandidate>& out) const {
+        const size_t n = _points.size();
+        if (count < _template.minPoints || count >= n) {
+            return;
+        }
+
+        const size_t last = (start + count - 1) % n;
+        if (isOccludedBy(start, (start + n - 1) % n) || isOccludedBy(last, (last + 1) % n)) {
+            return;
+        }
+
+        const float width = std::hypot(_points[last].x - _points[start].x, _points[last].y - _points[start].y);
+        const float widthError = std::fabs(width - _template.widthMm);
+        if (widthError > _template.widthToleranceMm) {
+            return;
+        }
+
+        float sumX = 0;
+        float sumY = 0;
+        for (size_t k = 0; k < count; ++k) {
+            const auto& p = _points[(start + k) % n];
+            sumX += p.x;
+            sumY += p.y;
+        }
+        const float meanX = sumX / count;
+        const float meanY = sumY / count;
+
+        const float range = std::hypot(meanX, meanY);
+        if (range < _template.minRangeMm || range > _template.maxRangeMm) {
+            return;
+        }
+
+        float sxx = 0;
+        float sxy = 0;
+        float syy = 0;
+        for (size_t k = 0; k < count; ++k) {
+            const auto& p = _points[(start + k) % n];
+            const float dx = p.x - meanX;
+            const float dy = p.y - meanY;
+            sxx += dx * dx;
+            sxy += dx * dy;
+            syy += dy * dy;
+        }
+        if (count >= 3 && covarianceRatio(sxx, sxy, syy) <= _template.minCovarianceRatio) {
+            return;
+        }
+
+        float angle = std::atan2(meanY, meanX) / Q6_TO_RAD;
+        if (angle < 0) {
+            angle += FULL_CIRCLE_Q6;
+        }
+
+        const float tolerance = std::max<float>(_template.widthToleranceMm, 1.0f);
+        out.push_back({
+            .angleQ6 = static_cast<uint16_t>(static_cast<uint32_t>(angle) % FULL_CIRCLE_Q6),
+            .distanceQ2 = static_cast<uint16_t>(std::min(range * 4.0f, 65535.0f)),
+            .widthMm = static_cast<uint16_t>(width),
+            .points = static_cast<uint8_t>(std::min<size_t>(count, UINT8_MAX)),
+            .score = static_cast<uint8_t>(255.0f * (1.0f - widthError / tolerance)),
+        });
+    }
+
+public:
+    static constexpr size_t MAX_CANDIDATES = 8;
+
+    explicit ScanClusterer(size_t maxPoints = 2048) {
+        _points.reserve(maxPoints);
+    }
+
+    void setTemplate(const BearTemplate& bearTemplate) {
+        _template = bearTemplate;
+    }
+
+    const BearTemplate& bearTemplate() const {
+        return _template;
+    }
+
+    /**
+     * Fills `out` with at most MAX_CANDIDATES best scoring candidates of one
+     * revolution. Measurements must be ordered by angle, as the lidar sends them.
+     */
+    void detect(std::span<const Measurement> scan, std::vector<BearCandidate>& out) {
+        out.clear();
+        if (!_template.enabled) {
+            return;
+        }
+        PROFILE_SCOPE("bear_clustering");
+
+        _points.clear();
+        for (const auto& measurement : scan) {
+            if (measurement.distanceQ2 == 0 || _points.size() == _points.capacity()) {
+                continue;
+            }
+            const float range = measurement.distanceQ2 / 4.0f;
+            const float angle = measurement.angleQ6 * Q6_TO_RAD;
+            _points.push_back({ range * std::cos(angle), range * std::sin(angle), range, measurement.angleQ6 });
+        }
+
+        const size_t n = _points.size();
+        if (n < 2) {
+            return;
+        }
+
+        // start right after a break so that a segment crossing 0 degrees stays whole
+        size_t start = n;
+        for (size_t i = 0; i < n; ++i) {
+            if (isBreak(i, (i + 1) % n)) {
+                start = (i + 1) % n;
+                break;
+            }
+        }
+        if (start == n) {
+            return;
+        }
+
+        size_t segmentStart = start;
+        size_t segmentCount = 0;
+        for (size_t k = 0; k < n; ++k) {
+            const size_t i = (start + k) % n;
+            segmentCount++;
+            if (isBreak(i, (i + 1) % n)) {
+                evaluate(segmentStart, segmentCount, out);
+                segmentStart = (i + 1) % n;
+                segmentCount = 0;
+            }
+        }
+
+        std::sort(out.begin(), out.end(), [](const BearCandidate& a, const BearCandidate& b) {
+            return a.score > b.score;
+        });
+        if (out.size() > MAX_CANDIDATES) {
+            out.resize(MAX_CANDIDATES);
+        }
+    }
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <tuple>
+#include <utility>
+
+#include "protocol/profiler.h"
+#include "../driver/rpLidar.h"
+#include "../localization/likelihoodField.h"
+#include "pointTransform.h"
+
+
+struct CollisionGuardConfig {
+    static constexpr size_t MAX_VERTICES = 8;
+
+    bool enabled = false;
+    // the keep-out polygon reaches this far ahead of the robot at the commanded speed
+    uint16_t lookaheadMs = 500;
+    // points inside the polygon in one packet that count as an obstacle
+    uint8_t minPoints = 3;
+    // time without an obstacle before the block is released, longer than a revolution
+    uint16_t clearMs = 200;
+    // convex keep-out polygon at standstill, robot frame in mm, either winding
+    std::array<ScanPointMm, MAX_VERTICES> vertices {};
+    uint8_t vertexCount = 0;
+};
+
+
+struct GuardEvent {
+    int64_t timestamp = 0;
+    // direction of travel that is blocked: 1 forward, -1 backward, 0 released
+    int8_t blocked = 0;
+    // points inside the polygon in the packet that caused the event
+    uint8_t points = 0;
+    // intruding point closest to the robot
+    ScanPointMm nearest {};
+    // commanded wheel speeds at the time, mm/s
+    int16_t leftSpeed = 0;
+    int16_t rightSpeed = 0;
+    // from reading the packet to the motors being set
+    uint32_t reactionUs = 0;
+};
+
+
+/**
+ * Stops the robot driving into an obstacle without waiting for the host.
+ * Every lidar packet is checked against a keep-out polygon that is
+ * stretched ahead of the robot in the direction of travel, by the distance
+ * the commanded speed covers in `lookaheadMs`. While an obstacle is inside,
+ * motion in that direction is removed from the setpoints and turning on
+ * the spot stays possible. The polygon keeps the reach it had when the
+ * block began until the block is released, so slowing down cannot shrink
+ * it off the obstacle; the release keeps only the turning part of the
+ * setpoints, driving on takes a new command. A blocked robot that is
+ * commanded the other way is guarded in that direction too, at the reach
+ * of its speed, and an obstacle there moves the block to it.
+ */
+class CollisionGuard {
+    CollisionGuardConfig _config;
+    int16_t _leftSpeed = 0;
+    int16_t _rightSpeed = 0;
+    int8_t _blocked = 0;
+    // reach of the polygon when the block began, kept while blocked
+    int32_t _blockedReachMm = 0;
+    int64_t _lastIntrusionUs = 0;
+    GuardEvent _event;
+
+    struct Intrusion {
+        uint8_t points = 0;
+        // closest to the robot
+        ScanPointMm nearest {};
+    };
+
+    int16_t forwardSpeed() const {
+        return static_cast<int16_t>((_leftSpeed + _rightSpeed) / 2);
+    }
+
+    std::pair<int16_t, int16_t> turnOnly() const {
+        const auto turn = static_cast<int16_t>((_leftSpeed - _rightSpeed) / 2);
+        return { turn, static_cast<int16_t>(-turn) };
+    }
+
+    // the polygon with the vertices on the side of `direction` moved out by `reachMm`
+    static bool inside(const CollisionGuardConfig& config, ScanPointMm point, int direction, int32_t reachMm) {
+        auto stretchedX = [&](const ScanPointMm& vertex) {
+            return vertex.x * direction > 0 ? vertex.x + reachMm * direction : int32_t(vertex.x);
+        };
+
+        int sign = 0;
+        for (size_t i = 0; i < config.vertexCount; ++i) {
+            const ScanPointMm& a = config.vertices[i];
+            const ScanPointMm& b = config.vertices[(i + 1) % config.vertexCount];
+            const int32_t ax = stretchedX(a);
+            const int32_t bx = stretchedX(b);
+            const int64_t cross = int64_t(bx - ax) * (point.y - a.y) - int64_t(b.y - a.y) * (point.x - ax);
+            if (cross == 0) {
+                continue;
+            }
+            const int side = cross > 0 ? 1 : -1;
+            if (sign != 0 && side != sign) {
+                return false;
+            }
+            sign = side;
+        }
+        return true;
+    }
+
+    int32_t reachOf(int16_t speed) const {
+        return std::abs(speed) * _config.lookaheadMs / 1000;
+    }
+
+    // points of the packet inside the polygon stretched towards `direction`
+    Intrusion intrusion(std::span<const Measurement> packet, const PointTransform& transform, int direction, int32_t reachMm) const {
+        Intrusion found;
+        int32_t nearestDistance = INT32_MAX;
+        for (const auto& measurement : packet) {
+            if (measurement.distanceQ2 == 0) {
+                continue;
+            }
+            const ScanPointMm point = transform.toRobot(measurement);
+            if (point.x * direction <= 0 || !inside(_config, point, direction, reachMm)) {
+                continue;
+            }
+            found.points += found.points < UINT8_MAX;
+            const int32_t distance = std::abs(point.x) + std::abs(point.y);
+            if (distance < nearestDistance) {
+                nearestDistance = distance;
+                found.nearest = point;
+            }
+        }
+        return found;
+    }
+
+public:
+    void setConfig(const CollisionGuardConfig& config) {
+        _config = config;
+        _config.vertexCount = std::min<uint8_t>(_config.vertexCount, CollisionGuardConfig::MAX_VERTICES);
+        _config.minPoints = std::max<uint8_t>(_config.minPoints, 1);
+        if (!_config.enabled || _config.vertexCount < 3) {
+            _config.enabled = false;
+            // disabling releases the block like clearing does
+            if (forwardSpeed() * _blocked > 0) {
+                std::tie(_leftSpeed, _rightSpeed) = turnOnly();
+            }
+            _blocked = 0;
+        }
+    }
+
+    const CollisionGuardConfig& config() const {
+        return _config;
+    }
+
+    // wheel speeds the host asked for, mm/s
+    void setCommand(int16_t leftSpeed, int16_t rightSpeed) {
+        _leftSpeed = leftSpeed;
+        _rightSpeed = rightSpeed;
+    }
+
+    int8_t blocked() const {
+        return _blocked;
+    }
+
+    /**
+     * The commanded wheel speeds without any motion towards a blocked
+     * direction, only their turning part is kept.
+     */
+    std::pair<int16_t, int16_t> limit() const {
+        if (_blocked == 0 || forwardSpeed() * _blocked <= 0) {
+            return { _leftSpeed, _rightSpeed };
+        }
+        return turnOnly();
+    }
+
+    /**
+     * Checks one lidar packet. Returns true if the blocked direction
+     * changed; `event()` then describes why and the setpoints have to be
+     * applied again through `limit()`.
+     */
+    bool check(std::span<const Measurement> packet, const PointTransform& transform, int64_t nowUs) {
+        if (!_config.enabled) {
+            return false;
+        }
+        PROFILE_SCOPE("collision_guard");
+
+        // keep watching a blocked direction even when the host stopped asking for it
+        const int16_t speed = forwardSpeed();
+        const int commanded = (speed > 0) - (speed < 0);
+        int direction = _blocked != 0 ? _blocked : commanded;
+        if (direction == 0) {
+            return false;
+        }
+        int32_t reachMm = _blocked != 0 ? _blockedReachMm : reachOf(speed);
+        Intrusion found = intrusion(packet, transform, direction, reachMm);
+
+        // limit() lets a move away from the blocked direction through, it is guarded on its own
+        if (_blocked != 0 && commanded == -_blocked) {
+            const Intrusion ahead = intrusion(packet, transform, commanded, reachOf(speed));
+            if (ahead.points >= _config.minPoints) {
+                found = ahead;
+                direction = commanded;
+                reachMm = reachOf(speed);
+            }
+        }
+
+        const int8_t previous = _blocked;
+        if (found.points >= _config.minPoints) {
+            _blocked = static_cast<int8_t>(direction);
+            _blockedReachMm = reachMm;
+            _lastIntrusionUs = nowUs;
+        }
+        else if (_blocked != 0 && nowUs - _lastIntrusionUs >= int64_t(_config.clearMs) * 1000) {
+            _blocked = 0;
+        }
+        if (_blocked == previous) {
+            return false;
+        }
+
+        _event = {
+            .timestamp = nowUs,
+            .blocked = _blocked,
+            .points = found.points,
+            .nearest = found.nearest,
+            .leftSpeed = _leftSpeed,
+            .rightSpeed = _rightSpeed,
+        };
+        // the move that was blocked is stale by now
+        if (_blocked == 0 && forwardSpeed() * previous > 0) {
+            std::tie(_leftSpeed, _rightSpeed) = turnOnly();
+        }
+        return true;
+    }
+
+    GuardEvent& event() {
+        return _event;
+    }
+};
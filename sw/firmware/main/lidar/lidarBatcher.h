@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../driver/rpLidar.h"
+
+
+struct LidarBatchConfig {
+    // a frame is sent at least this often, with or without lidar points
+    uint16_t periodMs = 30;
+    // points per frame, a frame is sent early once this many are waiting
+    uint16_t maxPoints = 96;
+};
+
+
+struct LidarBatchStats {
+    // points left waiting after the frame was taken
+    uint16_t backlog = 0;
+    // bytes not yet read from the lidar UART
+    uint16_t sourceBacklog = 0;
+    // time the oldest point of the frame spent waiting
+    uint32_t ageUs = 0;
+    // points discarded because the backlog was full, since the previous frame
+    uint16_t dropped = 0;
+};
+
+
+/**
+ * Queue between the lidar and the telemetry frames. The lidar is always
+ * drained into it; frames are cut from it by time or by size, so that a
+ * faster input shortens the frame period instead of growing the backlog,
+ * and a frame never carries more points than the TX buffer has room for.
+ * When the link cannot keep up, the oldest points are dropped, which keeps
+ * their age bounded.
+ */
+class LidarBatcher {
+public:
+    static constexpr size_t MAX_PENDING = 1024;
+    // worst case size of a measurements frame without lidar points, framing included
+    static constexpr size_t FRAME_OVERHEAD = 64;
+    static constexpr size_t BYTES_PER_POINT = 4;
+    static constexpr uint16_t MAX_POINTS_LIMIT = 480;
+
+private:
+    struct Pending {
+        Measurement measurement;
+        int64_t arrivalUs;
+    };
+
+    LidarBatchConfig _config;
+    std::vector<Pending> _pending;
+    size_t _head = 0;
+    size_t _size = 0;
+    uint16_t _dropped = 0;
+
+    size_t pointsFitting(size_t txFreeBytes) const {
+        if (txFreeBytes <= FRAME_OVERHEAD) {
+            return 0;
+        }
+        // COBS adds one byte per 254
+        return (txFreeBytes - FRAME_OVERHEAD) * 254 / 255 / BYTES_PER_POINT;
+    }
+
+public:
+    LidarBatcher():
+        _pending(MAX_PENDING)
+    {}
+
+    void setConfig(LidarBatchConfig config) {
+        config.periodMs = std::max<uint16_t>(config.periodMs, 1);
+        config.maxPoints = std::clamp<uint16_t>(config.maxPoints, 1, MAX_POINTS_LIMIT);
+        _config = config;
+    }
+
+    const LidarBatchConfig& config() const {
+        return _config;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    void push(int64_t now, const Measurement& measurement) {
+        if (_size == MAX_PENDING) {
+            _head = (_head + 1) % MAX_PENDING;
+            _size--;
+            _dropped++;
+        }
+        _pending[(_head + _size) % MAX_PENDING] = { measurement, now };
+        _size++;
+    }
+
+    bool due(int64_t now, int64_t lastFrameUs, size_t txFreeBytes) const {
+        if (now - lastFrameUs >= _config.periodMs * 1000) {
+            return true;
+        }
+        return _size >= _config.maxPoints && pointsFitting(txFreeBytes) >= _config.maxPoints;
+    }
+
+    /**
+     * Takes the oldest points for one frame, as many as fit into the TX
+     * buffer, and calls `emit(measurement)` for each of them.
+     */
+    template <typename Emit>
+    LidarBatchStats take(int64_t now, size_t txFreeBytes, Emit&& emit) {
+        const size_t count = std::min({ _size, static_cast<size_t>(_config.maxPoints), pointsFitting(txFreeBytes) });
+
+        LidarBatchStats stats;
+        if (count > 0) {
+            stats.ageUs = static_cast<uint32_t>(std::min<int64_t>(now - _pending[_head].arrivalUs, UINT32_MAX));
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            emit(_pending[_head].measurement);
+            _head = (_head + 1) % MAX_PENDING;
+        }
+        _size -= count;
+
+        stats.backlog = _size;
+        stats.dropped = _dropped;
+        _dropped = 0;
+        return stats;
+    }
+
+    void clear() {
+        _head = 0;
+        _size = 0;
+    }
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "../driver/rpLidar.h"
+#include "protocol/wire.h"
+
+
+// consecutive raw packets for one message, oldest first
+struct LidarRawBatch {
+    int64_t timestamp = 0;
+    // packets discarded because the queue was full, since the previous batch
+    uint16_t dropped = 0;
+    // packets the lidar sent with a wrong checksum, since the previous batch
+    uint16_t checksumErrors = 0;
+    std::span<const ExpressPacket> packets;
+};
+
+
+/**
+ * Queue of undecoded express packets for the raw lidar output. Packets
+ * are only checked for framing and checksum by `RpLidar` and forwarded
+ * as they are, the host decodes them in bulk. A message is sent once it
+ * is full or its oldest packet has waited a frame period; when the link
+ * cannot keep up, the oldest packets are dropped.
+ */
+class LidarPassthrough {
+public:
+    static constexpr size_t MAX_PENDING = 64;
+    static constexpr size_t PACKETS_PER_MESSAGE = 12;
+    // header of a raw message, framing included
+    static constexpr size_t MESSAGE_OVERHEAD = 32;
+    // arrival age, sequence and the packet itself
+    static constexpr size_t BYTES_PER_PACKET = comm::wire::layoutSize(comm::wire::LIDAR_RAW_PACKET_FIELDS) + ExpressPacket::SIZE;
+    static_assert(ExpressPacket::SIZE == comm::wire::LIDAR_RAW_PACKET_SIZE);
+
+private:
+    std::vector<ExpressPacket> _pending;
+    std::vector<ExpressPacket> _batch;
+    size_t _head = 0;
+    size_t _size = 0;
+    uint16_t _dropped = 0;
+    uint16_t _checksumErrors = 0;
+
+    static size_t packetsFitting(size_t txFreeBytes) {
+        if (txFreeBytes <= MESSAGE_OVERHEAD) {
+            return 0;
+        }
+        // COBS adds one byte per 254
+        return (txFreeBytes - MESSAGE_OVERHEAD) * 254 / 255 / BYTES_PER_PACKET;
+    }
+
+public:
+    LidarPassthrough():
+        _pending(MAX_PENDING)
+    {
+        _batch.reserve(PACKETS_PER_MESSAGE);
+    }
+
+    // reported with the next batch
+    void countChecksumErrors(uint16_t errors) {
+        _checksumErrors = static_cast<uint16_t>(std::min<uint32_t>(_checksumErrors + errors, UINT16_MAX));
+    }
+
+    void clear() {
+        _head = 0;
+        _size = 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    void push(const ExpressPacket& packet) {
+        if (_size == MAX_PENDING) {
+            _head = (_head + 1) % MAX_PENDING;
+            _size--;
+            _dropped += _dropped < UINT16_MAX;
+        }
+        _pending[(_head + _size) % MAX_PENDING] = packet;
+        _size++;
+    }
+
+    // a message is full, or its oldest packet has waited `periodMs`
+    bool due(int64_t nowUs, uint16_t periodMs) const {
+        if (_size == 0) {
+            return false;
+        }
+        return _size >= PACKETS_PER_MESSAGE || nowUs - _pending[_head].arrivalUs >= int64_t(periodMs) * 1000;
+    }
+
+    /**
+     * Calls `emit(batch)` with as many of the oldest packets as fit into
+     * `txFreeBytes`, at most one message. Returns false if none fit.
+     */
+    template <typename Emit>
+    bool take(int64_t nowUs, size_t txFreeBytes, Emit&& emit) {
+        const size_t count = std::min({ _size, PACKETS_PER_MESSAGE, packetsFitting(txFreeBytes) });
+        if (count == 0) {
+            return false;
+        }
+
+        _batch.clear();
+        for (size_t i = 0; i < count; ++i) {
+            _batch.push_back(_pending[(_head + i) % MAX_PENDING]);
+        }
+        _head = (_head + count) % MAX_PENDING;
+        _size -= count;
+
+        emit(LidarRawBatch {
+            .timestamp = nowUs,
+            .dropped = std::exchange(_dropped, 0),
+            .checksumErrors = std::exchange(_checksumErrors, 0),
+            .packets = _batch,
+        });
+        return true;
+    }
+};
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "protocol/profiler.h"
+#include "protocol/wire.h"
+#include "../driver/rpLidar.h"
+#include "../localization/scanMatcher.h"
+#include "pointTransform.h"
+
+
+// tiles of the local grid that changed, RLE encoded, see `LocalGrid::take`
+struct LocalGridUpdate {
+    int64_t timestamp = 0;
+    // robot pose in the grid frame, which is the odometry frame since the grid was reset
+    int32_t xMm = 0;
+    int32_t yMm = 0;
+    // 32768 = pi
+    int16_t theta = 0;
+    // grid frame tile of the window's lowest x and y, tiles outside the window are forgotten
+    int16_t originTileX = 0;
+    int16_t originTileY = 0;
+    uint8_t tileCount = 0;
+    std::span<const uint8_t> tiles;
+};
+
+
+/**
+ * Occupancy grid of the area around the robot, 2 m x 2 m in 2 cm cells,
+ * updated from every decoded lidar packet. Cells hold log-odds, raised at
+ * a ray's end and lowered along the way with integer (Bresenham) ray
+ * walks. The grid keeps the odometry frame of its last reset and scrolls
+ * by whole tiles as the robot moves, so the robot stays in the middle
+ * tile; cells are stored in a ring, scrolling only clears the tiles that
+ * come into view. Only tiles with a changed cell are sent.
+ */
+class LocalGrid {
+public:
+    static constexpr int32_t CELL_MM = 20;
+    static constexpr int32_t TILE_CELLS = comm::wire::LOCAL_GRID_TILE_CELLS;
+    static constexpr int32_t TILES = 10;
+    static constexpr int32_t CELLS = TILE_CELLS * TILES;
+    static constexpr size_t TILE_COUNT = TILES * TILES;
+    static constexpr size_t CELLS_PER_TILE = TILE_CELLS * TILE_CELLS;
+
+    // log-odds in 1/16 nat, p = 1 / (1 + exp(-value / 16))
+    static constexpr int8_t HIT = 14;
+    static constexpr int8_t MISS = -4;
+    static constexpr int8_t LIMIT = 64;
+
+    // header of a local grid message, framing included
+    static constexpr size_t MESSAGE_OVERHEAD = 1 + comm::wire::layoutSize(comm::wire::MESSAGE_LOCAL_GRID_FIELDS) + 16;
+    // tile coordinates, run count and runs of (length, value)
+    static constexpr size_t MAX_TILE_SIZE = 2 + 2 + 1 + 2 * CELLS_PER_TILE;
+    // largest message `take` builds, the transport drops longer payloads
+    static constexpr size_t MAX_MESSAGE_SIZE = 2048;
+    static constexpr size_t MAX_TILES_SIZE = MAX_MESSAGE_SIZE - MESSAGE_OVERHEAD;
+
+private:
+    // tile after tile, cells in rows within a tile; on the heap, the grid lives on the app_main stack
+    std::vector<int8_t> _cells;
+    std::bitset<TILE_COUNT> _dirty;
+    // reserved when the stream is first switched on
+    std::vector<uint8_t> _encoded;
+    size_t _cursor = 0;
+    uint16_t _periodMs = comm::wire::STREAM_OFF;
+    int64_t _lastSentUs = 0;
+
+    // grid frame pose, position in 1/256 mm
+    int32_t _xQ8 = 0;
+    int32_t _yQ8 = 0;
+    uint32_t _heading = 0;
+    int32_t _originTileX = -TILES / 2;
+    int32_t _originTileY = -TILES / 2;
+
+    static int32_t floorDiv(int32_t value, int32_t divisor) {
+        const int32_t quotient = value / divisor;
+        return quotient * divisor > value ? quotient - 1 : quotient;
+    }
+
+    static int32_t wrap(int32_t value, int32_t size) {
+        return value - floorDiv(value, size) * size;
+    }
+
+    static int32_t cellOf(int32_t q8) {
+        return floorDiv(q8, CELL_MM << 8);
+    }
+
+    static size_t slotOf(int32_t tileX, int32_t tileY) {
+        return size_t(wrap(tileY, TILES) * TILES + wrap(tileX, TILES));
+    }
+
+    bool inWindow(int32_t cellX, int32_t cellY) const {
+        const int32_t x = cellX - _originTileX * TILE_CELLS;
+        const int32_t y = cellY - _originTileY * TILE_CELLS;
+        return x >= 0 && x < CELLS && y >= 0 && y < CELLS;
+    }
+
+    void update(int32_t cellX, int32_t cellY, int8_t delta) {
+        const size_t slot = slotOf(floorDiv(cellX, TILE_CELLS), floorDiv(cellY, TILE_CELLS));
+        int8_t& cell = _cells[slot * CELLS_PER_TILE + wrap(cellY, TILE_CELLS) * TILE_CELLS + wrap(cellX, TILE_CELLS)];
+        const auto value = static_cast<int8_t>(std::clamp(cell + delta, -LIMIT, int(LIMIT)));
+        if (value != cell) {
+            cell = value;
+            _dirty.set(slot);
+        }
+    }
+
+    // lowers the cells from (x0, y0) to (x1, y1) and raises the last one, as far as they are in the window
+    void ray(int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+        const int32_t dx = std::abs(x1 - x0);
+        const int32_t dy = -std::abs(y1 - y0);
+        const int32_t stepX = x0 < x1 ? 1 : -1;
+        const int32_t stepY = y0 < y1 ? 1 : -1;
+        int32_t error = dx + dy;
+        while (inWindow(x0, y0)) {
+            if (x0 == x1 && y0 == y1) {
+                update(x0, y0, HIT);
+                return;
+            }
+            update(x0, y0, MISS);
+            const int32_t doubled = 2 * error;
+            if (doubled >= dy) {
+                error += dy;
+                x0 += stepX;
+            }
+            if (doubled <= dx) {
+                error += dx;
+                y0 += stepY;
+            }
+        }
+    }
+
+    // robot-frame millimetres to the grid frame, in 1/256 mm
+    std::pair<int32_t, int32_t> toGridQ8(ScanPointMm point, int32_t c, int32_t s) const {
+        return {
+            _xQ8 + static_cast<int32_t>((int64_t(point.x) * c - int64_t(point.y) * s) >> 22),
+            _yQ8 + static_cast<int32_t>((int64_t(point.x) * s + int64_t(point.y) * c) >> 22),
+        };
+    }
+
+    void scroll() {
+        const int32_t originX = floorDiv(cellOf(_xQ8), TILE_CELLS) - TILES / 2;
+        const int32_t originY = floorDiv(cellOf(_yQ8), TILE_CELLS) - TILES / 2;
+        if (originX == _originTileX && originY == _originTileY) {
+            return;
+        }
+        // a ring slot that comes into view held a tile that left it, it is sent empty
+        for (int32_t tileY = originY; tileY < originY + TILES; ++tileY) {
+            for (int32_t tileX = originX; tileX < originX + TILES; ++tileX) {
+                if (tileX >= _originTileX && tileX < _originTileX + TILES && tileY >= _originTileY && tileY < _originTileY + TILES) {
+                    continue;
+                }
+                const size_t slot = slotOf(tileX, tileY);
+                std::fill_n(_cells.begin() + slot * CELLS_PER_TILE, CELLS_PER_TILE, 0);
+                _dirty.set(slot);
+            }
+        }
+        _originTileX = originX;
+        _originTileY = originY;
+    }
+
+    void encodeTile(size_t slot) {
+        const int32_t tileX = _originTileX + wrap(int32_t(slot % TILES) - _originTileX, TILES);
+        const int32_t tileY = _originTileY + wrap(int32_t(slot / TILES) - _originTileY, TILES);
+        // the run count is the last field, filled in below
+        comm::wire::append<comm::wire::LOCAL_GRID_TILE_FIELDS>(_encoded, tileX, tileY, 0);
+        const size_t countAt = _encoded.size() - 1;
+
+        const int8_t* cells = &_cells[slot * CELLS_PER_TILE];
+        uint8_t runs = 0;
+        for (size_t i = 0; i < CELLS_PER_TILE;) {
+            size_t length = 1;
+            while (i + length < CELLS_PER_TILE && cells[i + length] == cells[i]) {
+                length++;
+            }
+            comm::wire::append<comm::wire::LOCAL_GRID_RUN_FIELDS>(_encoded, length, cells[i]);
+            runs++;
+            i += length;
+        }
+        _encoded[countAt] = runs;
+    }
+
+public:
+    LocalGrid() : _cells(TILE_COUNT * CELLS_PER_TILE, 0) {}
+
+    LocalGrid(LocalGrid const&) = delete;
+
+    // empties the grid and makes the current robot pose its origin
+    void reset() {
+        std::fill(_cells.begin(), _cells.end(), 0);
+        _dirty.reset();
+        _xQ8 = 0;
+        _yQ8 = 0;
+        _heading = 0;
+        _originTileX = -TILES / 2;
+        _originTileY = -TILES / 2;
+    }
+
+    // wire::STREAM_OFF, wire::STREAM_ON_CHANGE or a period, switching it on resets the grid
+    void setPeriod(uint16_t periodMs) {
+        if (_periodMs == comm::wire::STREAM_OFF && periodMs != comm::wire::STREAM_OFF) {
+            _encoded.reserve(MAX_TILES_SIZE);
+            reset();
+        }
+        _periodMs = periodMs;
+    }
+
+    bool enabled() const {
+        return _periodMs != comm::wire::STREAM_OFF;
+    }
+
+    // `delta` is the odometry since the previous call, in the robot frame at its start
+    void move(PoseDelta delta) {
+        const int32_t c = fixedTrig::cosQ30(_heading);
+        const int32_t s = fixedTrig::sinQ30(_heading);
+        const auto [x, y] = toGridQ8({ delta.xMm, delta.yMm }, c, s);
+        _xQ8 = x;
+        _yQ8 = y;
+        _heading += fixedTrig::fromTheta(delta.theta);
+        scroll();
+    }
+
+    // casts a ray from the lidar to every point of one packet
+    void integrate(std::span<const Measurement> measurements, const PointTransform& transform) {
+        PROFILE_SCOPE("local_grid");
+        const int32_t c = fixedTrig::cosQ30(_heading);
+        const int32_t s = fixedTrig::sinQ30(_heading);
+        const auto [lidarX, lidarY] = toGridQ8({ transform.mount().xMm, transform.mount().yMm }, c, s);
+        const int32_t fromX = cellOf(lidarX);
+        const int32_t fromY = cellOf(lidarY);
+
+        for (const auto& measurement : measurements) {
+            if (measurement.distanceQ2 == 0) {
+                continue;
+            }
+            const auto [x, y] = toGridQ8(transform.toRobot(measurement), c, s);
+            ray(fromX, fromY, cellOf(x), cellOf(y));
+        }
+    }
+
+    // a tile changed and the period has passed since the previous message
+    bool due(int64_t nowUs) const {
+        if (!enabled() || _dirty.none()) {
+            return false;
+        }
+        return _periodMs == comm::wire::STREAM_ON_CHANGE || nowUs - _lastSentUs >= int64_t(_periodMs) * 1000;
+    }
+
+    // when `due` turns true without a new packet, INT64_MAX if nothing is waiting
+    int64_t nextDueUs() const {
+        if (!enabled() || _dirty.none() || _periodMs == comm::wire::STREAM_ON_CHANGE) {
+            return INT64_MAX;
+        }
+        return _lastSentUs + int64_t(_periodMs) * 1000;
+    }
+
+    /**
+     * Calls `emit(update)` with as many changed tiles as fit into
+     * `txFreeBytes` and into `MAX_MESSAGE_SIZE`, continuing after the
+     * last tile sent so a busy link cannot starve a part of the grid.
+     * Returns false if none fit.
+     */
+    template <typename Emit>
+    bool take(int64_t nowUs, size_t txFreeBytes, Emit&& emit) {
+        if (txFreeBytes <= MESSAGE_OVERHEAD) {
+            return false;
+        }
+        // COBS adds one byte per 254
+        const size_t budget = std::min((txFreeBytes - MESSAGE_OVERHEAD) * 254 / 255, MAX_TILES_SIZE);
+
+        _encoded.clear();
+        uint8_t count = 0;
+        for (size_t i = 0; i < TILE_COUNT; ++i) {
+            const size_t slot = (_cursor + i) % TILE_COUNT;
+            if (!_dirty.test(slot)) {
+                continue;
+            }
+            const size_t before = _encoded.size();
+            encodeTile(slot);
+            if (_encoded.size() > budget) {
+                _encoded.resize(before);
+                break;
+            }
+            _dirty.reset(slot);
+            _cursor = (slot + 1) % TILE_COUNT;
+            count++;
+        }
+        if (count == 0) {
+            return false;
+        }
+
+        _lastSentUs = nowUs;
+        emit(LocalGridUpdate {
+            .timestamp = nowUs,
+            .xMm = _xQ8 / 256,
+            .yMm = _yQ8 / 256,
+            .theta = static_cast<int16_t>(_heading >> 16),
+            .originTileX = static_cast<int16_t>(_originTileX),
+            .originTileY = static_cast<int16_t>(_originTileY),
+            .tileCount = count,
+            .tiles = _encoded,
+        });
+        return true;
+    }
+};
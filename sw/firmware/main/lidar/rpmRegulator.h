@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+
+/**
+ * PI regulator of the lidar revolution rate. Fed once per revolution with
+ * the measured period, returns the motor duty for the next one.
+ * A target of 0 disables regulation and keeps the open-loop duty.
+ */
+class RpmRegulator {
+public:
+    static constexpr float OPEN_LOOP_DUTY = 1.0f;
+    static constexpr float MIN_DUTY = 0.3f;
+    static constexpr float MAX_DUTY = 1.0f;
+
+private:
+    // duty per RPM of error, and per RPM * second
+    static constexpr float KP = 0.001f;
+    static constexpr float KI = 0.004f;
+    // periods outside of this are glitches (missed wrap, stalled motor)
+    static constexpr uint32_t MIN_PERIOD_US = 20'000;
+    static constexpr uint32_t MAX_PERIOD_US = 1'000'000;
+
+    uint16_t _targetRpm = 0;
+    float _duty = OPEN_LOOP_DUTY;
+    float _integral = OPEN_LOOP_DUTY;
+    float _measuredRpm = 0;
+
+public:
+    void setTarget(uint16_t rpm) {
+        if (rpm != 0 && _targetRpm == 0) {
+            // continue from the current duty instead of jumping
+            _integral = _duty;
+        }
+        _targetRpm = rpm;
+        if (rpm == 0) {
+            _duty = OPEN_LOOP_DUTY;
+        }
+    }
+
+    uint16_t target() const {
+        return _targetRpm;
+    }
+
+    float duty() const {
+        return _duty;
+    }
+
+    float measuredRpm() const {
+        return _measuredRpm;
+    }
+
+    float update(uint32_t periodUs) {
+        if (periodUs < MIN_PERIOD_US || periodUs > MAX_PERIOD_US) {
+            return _duty;
+        }
+
+        _measuredRpm = 60e6f / periodUs;
+        if (_targetRpm == 0) {
+            return _duty;
+        }
+
+        const float error = _targetRpm - _measuredRpm;
+        const float dt = periodUs / 1e6f;
+        _integral = std::clamp(_integral + KI * error * dt, MIN_DUTY, MAX_DUTY);
+        _duty = std::clamp(_integral + KP * error, MIN_DUTY, MAX_DUTY);
+        return _duty;
+    }
+};
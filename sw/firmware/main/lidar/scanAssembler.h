@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "../driver/rpLidar.h"
+
+
+/**
+ * Collects lidar measurements into whole revolutions. A revolution ends
+ * when the angle wraps, i.e. drops by more than half a circle.
+ */
+class ScanAssembler {
+    static constexpr uint16_t FULL_CIRCLE_Q6 = 360 * 64;
+
+    std::vector<Measurement> _current;
+    std::vector<Measurement> _complete;
+    size_t _maxPoints;
+    uint16_t _lastAngleQ6 = 0;
+    uint32_t _revolutions = 0;
+
+public:
+    explicit ScanAssembler(size_t maxPoints = 2048):
+        _maxPoints(maxPoints)
+    {
+        _current.reserve(maxPoints);
+        _complete.reserve(maxPoints);
+    }
+
+    /**
+     * Returns true if `measurement` started a new revolution; the finished
+     * one is then available through `scan()` until the next wrap.
+     */
+    bool push(const Measurement& measurement) {
+        const bool wrapped = !_current.empty() && measurement.angleQ6 + FULL_CIRCLE_Q6 / 2 < _lastAngleQ6;
+        _lastAngleQ6 = measurement.angleQ6;
+
+        if (wrapped) {
+            std::swap(_current, _complete);
+            _current.clear();
+            _revolutions++;
+        }
+
+        if (_current.size() < _maxPoints) {
+            _current.push_back(measurement);
+        }
+
+        return wrapped;
+    }
+
+    void reset() {
+        _current.clear();
+        _complete.clear();
+        _lastAngleQ6 = 0;
+    }
+
+    std::span<const Measurement> scan() const {
+        return _complete;
+    }
+
+    uint32_t revolutions() const {
+        return _revolutions;
+    }
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "protocol/util.h"
+
+
+/**
+ * Lidar likelihood field as a raster of per-cell costs, where
+ * cost = -ln(likelihood / max likelihood) * costScale, clipped to 255.
+ * Summing costs over the points of a scan gives a log-weight for a pose.
+ *
+ * Cells are stored in square tiles (row-major tiles of row-major cells)
+ * so that points from one particle, which land close to each other,
+ * mostly hit the same few cache lines.
+ *
+ * File layout (little endian), generated by map/raster.py:
+ *  - magic "LKF1"
+ *  - width, height: uint16 (cells)
+ *  - tileShift: uint8 (tile side = 1 << tileShift cells)
+ *  - costScale: uint8 (cost units per nat)
+ *  - defaultCost: uint8 (outside the raster)
+ *  - reserved: uint8
+ *  - cellUm: uint32 (cell side in micrometers)
+ *  - offsetXUm, offsetYUm: int32 (world position of cell 0,0)
+ *  - cells: tilesX * tilesY * tileSide^2 bytes
+ */
+class LikelihoodField {
+public:
+    static constexpr size_t HEADER_SIZE = 24;
+    // the file stays in internal RAM as loaded (no PSRAM on this board), this leaves room
+    // for the task stacks, the lidar buffers and the local grid next to it
+    static constexpr size_t MAX_FILE_SIZE = 128 * 1024;
+
+private:
+    static constexpr uint8_t MAGIC[4] = { 'L', 'K', 'F', '1' };
+
+    // the whole file, cells start at HEADER_SIZE
+    std::vector<uint8_t> _data;
+    const uint8_t* _cells = nullptr;
+    uint16_t _width = 0;
+    uint16_t _height = 0;
+    uint8_t _tileShift = 4;
+    uint8_t _costScale = 1;
+    uint8_t _defaultCost = 255;
+    uint32_t _cellUm = 10000;
+    uint16_t _tilesX = 0;
+    int32_t _offsetXMm = 0;
+    int32_t _offsetYMm = 0;
+    // mm -> cell index as a Q16 multiplier, avoids a division per point
+    uint32_t _cellsPerMmQ16 = 0;
+
+public:
+    LikelihoodField() = default;
+    // _cells points into _data
+    LikelihoodField(LikelihoodField const&) = delete;
+
+    /**
+     * Takes over a whole field file without copying it, so a field only ever
+     * occupies its file size in RAM. Leaves the field unloaded if the file is
+     * invalid.
+     */
+    bool load(std::vector<uint8_t>&& data) {
+        unload();
+        if (data.size() < HEADER_SIZE || data.size() > MAX_FILE_SIZE
+            || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+            return false;
+        }
+
+        size_t offset = sizeof(MAGIC);
+        uint8_t reserved = 0;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        uint8_t tileShift = 0;
+        uint8_t costScale = 0;
+        uint8_t defaultCost = 0;
+        uint32_t cellUm = 0;
+        int32_t offsetXUm = 0;
+        int32_t offsetYUm = 0;
+        comm::readLe(data, offset, width);
+        comm::readLe(data, offset, height);
+        comm::readLe(data, offset, tileShift);
+        comm::readLe(data, offset, costScale);
+        comm::readLe(data, offset, defaultCost);
+        comm::readLe(data, offset, reserved);
+        comm::readLe(data, offset, cellUm);
+        comm::readLe(data, offset, offsetXUm);
+        comm::readLe(data, offset, offsetYUm);
+
+        if (tileShift > 7 || cellUm < 1000 || costScale == 0) {
+            return false;
+        }
+
+        const size_t tileSide = size_t(1) << tileShift;
+        const size_t tilesX = (width + tileSide - 1) / tileSide;
+        const size_t tilesY = (height + tileSide - 1) / tileSide;
+        const size_t cellCount = tilesX * tilesY * tileSide * tileSide;
+        if (cellCount == 0 || data.size() != HEADER_SIZE + cellCount) {
+            return false;
+        }
+
+        _data = std::move(data);
+        _cells = _data.data() + HEADER_SIZE;
+        _width = width;
+        _height = height;
+        _tileShift = tileShift;
+        _costScale = costScale;
+        _defaultCost = defaultCost;
+        _cellUm = cellUm;
+        _tilesX = tilesX;
+        _offsetXMm = offsetXUm / 1000;
+        _offsetYMm = offsetYUm / 1000;
+        _cellsPerMmQ16 = static_cast<uint32_t>((1000ull << 16) / cellUm);
+        return true;
+    }
+
+    void unload() {
+        std::vector<uint8_t>().swap(_data);
+        _cells = nullptr;
+    }
+
+    // the file the field was loaded from, empty if none
+    std::span<const uint8_t> file() const {
+        return _data;
+    }
+
+    bool loaded() const {
+        return _cells != nullptr;
+    }
+
+    uint8_t costScale() const {
+        return _costScale;
+    }
+
+    uint8_t costAt(int32_t xMm, int32_t yMm) const {
+        const int32_t relX = xMm - _offsetXMm;
+        const int32_t relY = yMm - _offsetYMm;
+        if (relX < 0 || relY < 0) {
+            return _defaultCost;
+        }
+
+        const uint32_t cx = (static_cast<uint32_t>(relX) * _cellsPerMmQ16) >> 16;
+        const uint32_t cy = (static_cast<uint32_t>(relY) * _cellsPerMmQ16) >> 16;
+        if (cx >= _width || cy >= _height) {
+            return _defaultCost;
+        }
+
+        const uint32_t mask = (1u << _tileShift) - 1;
+        const uint32_t tile = (cy >> _tileShift) * _tilesX + (cx >> _tileShift);
+        const uint32_t index = (tile << (2 * _tileShift)) | ((cy & mask) << _tileShift) | (cx & mask);
+        return _cells[index];
+    }
+};
+
+
+struct ParticlePose {
+    int16_t xMm;
+    int16_t yMm;
+    // 32768 = pi
+    int16_t theta;
+};
+
+
+// lidar point in the robot frame
+struct ScanPointMm {
+    int16_t x;
+    int16_t y;
+};
+
+
+/**
+ * Writes the summed likelihood-field cost of `points` seen from each
+ * particle pose into `costs`. The transform runs in Q14 fixed point.
+ */
+inline void scoreParticles(
+    const LikelihoodField& field,
+    std::span<const ScanPointMm> points,
+    std::span<const ParticlePose> particles,
+    std::span<uint32_t> costs
+) {
+    const size_t count = std::min(particles.size(), costs.size());
+    for (size_t i = 0; i < count; ++i) {
+        const auto& particle = particles[i];
+        const float theta = particle.theta * static_cast<float>(M_PI / 32768.0);
+        const int32_t c = static_cast<int32_t>(std::lround(std::cos(theta) * 16384.0f));
+        const int32_t s = static_cast<int32_t>(std::lround(std::sin(theta) * 16384.0f));
+
+        uint32_t cost = 0;
+        for (const auto& point : points) {
+            const int32_t x = particle.xMm + ((c * point.x - s * point.y) >> 14);
+            const int32_t y = particle.yMm + ((s * point.x + c * point.y) >> 14);
+            cost += field.costAt(x, y);
+        }
+        costs[i] = cost;
+    }
+}
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "protocol/binlog.h"
+#include "protocol/crc.h"
+#include "../comm/messages.h"
+#include "../driver/rpLidar.h"
+#include "../storage/storage.h"
+#include "likelihoodField.h"
+
+
+/**
+ * Scores host-supplied particle poses against the latest lidar revolution
+ * using a likelihood field stored on the storage partition. Scoring runs
+ * in its own low-priority task; results are delivered through a callback.
+ *
+ * An upload is received into RAM and becomes the field in place; the worker
+ * task writes it to the storage partition afterwards, so the receive task
+ * never waits for flash. The previous field is released when an upload
+ * begins, only one field is ever held in memory.
+ */
+class ParticleScoringService {
+public:
+    using ResultCallback = std::function<void(const comm::ParticleScores&)>;
+
+    static constexpr size_t MAX_PARTICLES = 340;
+    static constexpr size_t MAX_POINTS = 2048;
+
+private:
+    static constexpr const char* FIELD_PATH = "/storage/lkfield.bin";
+    static constexpr const char* UPLOAD_PATH = "/storage/lkfield.tmp";
+    static constexpr float Q6_TO_RAD = static_cast<float>(M_PI) / (180.0f * 64.0f);
+
+    int16_t _mountXMm;
+    int16_t _mountYMm;
+
+    LikelihoodField _field;
+    ResultCallback _callback;
+    TaskHandle_t _task = nullptr;
+
+    // guards _field, held for a whole batch so the field is not swapped mid-scoring
+    std::mutex _fieldMutex;
+    std::mutex _mutex;
+    std::vector<ScanPointMm> _scan;
+    int64_t _scanTimestamp = 0;
+    uint16_t _pendingSequence = 0;
+    std::vector<ParticlePose> _pending;
+    bool _hasPending = false;
+
+    // flash access left to the worker, guarded by _mutex
+    enum class StorageJob : uint8_t {
+        None,
+        // write the uploaded field to FIELD_PATH
+        Save,
+        // an upload failed after the previous field was released
+        Reload,
+    };
+    StorageJob _storageJob = StorageJob::None;
+
+    // only touched by the receive task
+    std::vector<uint8_t> _upload;
+    bool _uploading = false;
+    uint32_t _uploadSize = 0;
+    uint16_t _uploadCrc = 0xFFFF;
+
+    bool loadField() {
+        FILE* file = fopen(FIELD_PATH, "rb");
+        if (!file) {
+            return false;
+        }
+
+        fseek(file, 0, SEEK_END);
+        const long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        std::lock_guard lock(_fieldMutex);
+        _field.unload();
+        std::vector<uint8_t> data;
+        bool read = size > 0 && static_cast<size_t>(size) <= LikelihoodField::MAX_FILE_SIZE;
+        if (read) {
+            data.resize(size);
+            read = fread(data.data(), 1, data.size(), file) == data.size();
+        }
+        fclose(file);
+
+        if (!read || !_field.load(std::move(data))) {
+            BINLOG_W("Invalid likelihood field file, size=%ld", size);
+            return false;
+        }
+        return true;
+    }
+
+    bool saveField() {
+        std::lock_guard lock(_fieldMutex);
+        if (!_field.loaded() || !storage::mount()) {
+            return false;
+        }
+
+        FILE* file = fopen(UPLOAD_PATH, "wb");
+        if (!file) {
+            return false;
+        }
+        const auto data = _field.file();
+        const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+        if (fclose(file) != 0 || !written) {
+            remove(UPLOAD_PATH);
+            return false;
+        }
+
+        remove(FIELD_PATH);
+        return rename(UPLOAD_PATH, FIELD_PATH) == 0;
+    }
+
+    void runStorageJob(StorageJob job) {
+        if (job == StorageJob::Save && !saveField()) {
+            BINLOG_W("Likelihood field could not be saved, it is lost on reboot");
+        }
+        else if (job == StorageJob::Reload && storage::mount() && loadField()) {
+            BINLOG_I("Previous likelihood field reloaded");
+        }
+    }
+
+    void requestStorageJob(StorageJob job) {
+        {
+            std::lock_guard lock(_mutex);
+            _storageJob = job;
+        }
+        if (_task) {
+            xTaskNotifyGive(_task);
+        }
+    }
+
+    void workerLoop() {
+        std::vector<ParticlePose> particles;
+        particles.reserve(MAX_PARTICLES);
+        std::vector<ScanPointMm> scan;
+        scan.reserve(MAX_POINTS);
+        comm::ParticleScores scores;
+        scores.costs.reserve(MAX_PARTICLES);
+
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+            StorageJob job = StorageJob::None;
+            bool hasBatch = false;
+            {
+                std::lock_guard lock(_mutex);
+                std::swap(job, _storageJob);
+                if (_hasPending) {
+                    particles.swap(_pending);
+                    scan.assign(_scan.begin(), _scan.end());
+                    scores.sequence = _pendingSequence;
+                    scores.scanTimestamp = _scanTimestamp;
+                    _hasPending = false;
+                    hasBatch = true;
+                }
+            }
+
+            runStorageJob(job);
+            if (!hasBatch) {
+                continue;
+            }
+
+            scores.points = scan.size();
+            scores.costs.resize(particles.size());
+            {
+                std::lock_guard lock(_fieldMutex);
+                if (_field.loaded()) {
+                    scoreParticles(_field, scan, particles, scores.costs);
+                }
+                else {
+                    std::fill(scores.costs.begin(), scores.costs.end(), 0);
+                    scores.points = 0;
+                }
+            }
+
+            if (_callback) {
+                _callback(scores);
+            }
+        }
+    }
+
+public:
+    ParticleScoringService(int16_t mountXMm, int16_t mountYMm):
+        _mountXMm(mountXMm),
+        _mountYMm(mountYMm)
+    {
+        _scan.reserve(MAX_POINTS);
+        _pending.reserve(MAX_PARTICLES);
+    }
+
+    ParticleScoringService(ParticleScoringService const&) = delete;
+
+    void begin(ResultCallback callback) {
+        _callback = std::move(callback);
+
+        if (storage::mount() && loadField()) {
+            BINLOG_I("Likelihood field loaded");
+        }
+
+        xTaskCreatePinnedToCore(
+            [](void* arg) {
+                static_cast<ParticleScoringService*>(arg)->workerLoop();
+            },
+            "pf_scoring", 4096, this, tskIDLE_PRIORITY + 1, &_task, 0
+        );
+    }
+
+    bool fieldLoaded() {
+        std::lock_guard lock(_fieldMutex);
+        return _field.loaded();
+    }
+
+    /**
+     * Replaces the scan used for scoring. Points are converted to the robot
+     * frame once here, so scoring only needs a rotation and a translation.
+     */
+    void setScan(int64_t timestamp, std::span<const Measurement> scan) {
+        std::lock_guard lock(_mutex);
+        _scan.clear();
+        for (const auto& measurement : scan) {
+            if (measurement.distanceQ2 == 0 || _scan.size() == MAX_POINTS) {
+                continue;
+            }
+            // the lidar angle grows clockwise, the robot frame is counter-clockwise
+            const float angle = -measurement.angleQ6 * Q6_TO_RAD;
+            const float range = measurement.distanceQ2 / 4.0f;
+            _scan.push_back({
+                static_cast<int16_t>(std::lround(range * std::cos(angle)) + _mountXMm),
+                static_cast<int16_t>(std::lround(range * std::sin(angle)) + _mountYMm),
+            });
+        }
+        _scanTimestamp = timestamp;
+    }
+
+    /**
+     * Queues a batch for scoring. A batch that has not been picked up by the
+     * worker yet is replaced, the host only cares about the newest one.
+     */
+    void submit(uint16_t sequence, std::span<const ParticlePose> particles) {
+        {
+            std::lock_guard lock(_mutex);
+            const size_t count = std::min(particles.size(), MAX_PARTICLES);
+            _pending.assign(particles.begin(), particles.begin() + count);
+            _pendingSequence = sequence;
+            _hasPending = true;
+        }
+        if (_task) {
+            xTaskNotifyGive(_task);
+        }
+    }
+
+    /**
+     * Releases the current field and reserves RAM for the upload, so the
+     * upload never exists next to a loaded field. Batches are not scored
+     * until the upload finishes.
+     */
+    bool beginUpload(uint32_t size) {
+        _uploading = false;
+        std::vector<uint8_t>().swap(_upload);
+        if (size < LikelihoodField::HEADER_SIZE || size > LikelihoodField::MAX_FILE_SIZE) {
+            return false;
+        }
+
+        {
+            std::lock_guard lock(_fieldMutex);
+            _field.unload();
+        }
+        _upload.reserve(size);
+        _uploading = true;
+        _uploadSize = size;
+        _uploadCrc = 0xFFFF;
+        return true;
+    }
+
+    // chunks must arrive in order, `offset` only guards against lost ones
+    bool writeUpload(uint32_t offset, std::span<const uint8_t> data) {
+        if (!_uploading || offset != _upload.size() || offset + data.size() > _uploadSize) {
+            return false;
+        }
+
+        _upload.insert(_upload.end(), data.begin(), data.end());
+        _uploadCrc = comm::crc16(data, _uploadCrc);
+        return true;
+    }
+
+    bool finishUpload(uint16_t crc) {
+        if (!_uploading) {
+            return false;
+        }
+        _uploading = false;
+
+        bool loaded = false;
+        if (_upload.size() != _uploadSize || crc != _uploadCrc) {
+            BINLOG_W("Likelihood field upload rejected, written=%u size=%lu", _upload.size(), _uploadSize);
+        }
+        else {
+            std::lock_guard lock(_fieldMutex);
+            loaded = _field.load(std::move(_upload));
+        }
+        std::vector<uint8_t>().swap(_upload);
+
+        requestStorageJob(loaded ? StorageJob::Save : StorageJob::Reload);
+        return loaded;
+    }
+};
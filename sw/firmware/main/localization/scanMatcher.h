@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "protocol/profiler.h"
+#include "../driver/rpLidar.h"
+#include "likelihoodField.h"
+
+
+// relative pose, robot frame: where the robot is now, seen from where it was
+struct PoseDelta {
+    int16_t xMm = 0;
+    int16_t yMm = 0;
+    // 32768 = pi
+    int16_t theta = 0;
+};
+
+
+struct ScanMatchResult {
+    PoseDelta delta;
+    // share of the scan points that ended up on a reference line, 255 = all
+    uint8_t quality = 0;
+    uint8_t iterations = 0;
+    uint16_t matched = 0;
+};
+
+
+/**
+ * Aligns each lidar revolution to the previous one with point-to-line ICP.
+ * Correspondences are found by bearing: reference points are bucketed by
+ * the angle they are seen at from the lidar, so a scan point only needs to
+ * be compared with the few references in its own and neighbouring buckets.
+ *
+ * The per-point work runs in integer arithmetic (Q14 rotations, integer
+ * bearings); only the 3x3 system solved once per iteration uses floats.
+ * Iterations and points are bounded, so the cost per revolution is too.
+ * Pure computation, no hardware access.
+ */
+class ScanMatcher {
+public:
+    static constexpr size_t MAX_POINTS = 360;
+    static constexpr uint8_t MAX_ITERATIONS = 12;
+
+private:
+    // 512 buckets of 0.7 degrees
+    static constexpr int BIN_SHIFT = 9;
+    static constexpr int BINS = 1 << BIN_SHIFT;
+    static constexpr int SEARCH_BINS = 3;
+    // points closer than this hit the robot itself
+    static constexpr int32_t MIN_RANGE_MM = 150;
+    // a reference point needs both neighbours this close to define a line
+    static constexpr int32_t MAX_NEIGHBOUR_GAP_MM = 150;
+    // correspondence gate, shrinks from the first to the last iteration
+    static constexpr int32_t MAX_DISTANCE_MM = 300;
+    static constexpr int32_t MIN_DISTANCE_MM = 60;
+    static constexpr int32_t INLIER_MM = 30;
+    static constexpr uint16_t MIN_MATCHED = 40;
+    static constexpr float CONVERGED_MM = 0.5f;
+    static constexpr float CONVERGED_RAD = 0.0005f;
+    static constexpr float Q6_TO_RAD = static_cast<float>(M_PI) / (180.0f * 64.0f);
+    static constexpr float THETA_TO_RAD = static_cast<float>(M_PI) / 32768.0f;
+
+    struct RefPoint {
+        int16_t x;
+        int16_t y;
+        // unit normal of the local line, Q14; (0, 0) if there is none
+        int16_t nx;
+        int16_t ny;
+    };
+
+    int16_t _mountXMm;
+    int16_t _mountYMm;
+    std::vector<ScanPointMm> _points;
+    std::vector<ScanPointMm> _previous;
+    std::vector<RefPoint> _reference;
+    std::vector<uint16_t> _bins;
+    // _reference[_binStart[b] .. _binStart[b + 1]) are the points of bucket b; on the heap
+    // with _binFill, the matcher lives on the app_main stack
+    std::vector<uint16_t> _binStart;
+    std::vector<uint16_t> _binFill;
+
+    /**
+     * Bearing of (x, y) with 65536 = full circle, counter-clockwise from +x.
+     * atan(z) ~ z * (pi/4 + 0.273 * (1 - z)) on the first octant, error below 0.25 degrees.
+     */
+    static uint16_t bearing(int32_t x, int32_t y) {
+        const int32_t ax = std::abs(x);
+        const int32_t ay = std::abs(y);
+        if (ax == 0 && ay == 0) {
+            return 0;
+        }
+
+        const bool steep = ay > ax;
+        const int32_t z = steep ? (ax << 15) / ay : (ay << 15) / ax;
+        int32_t angle = (z * (8192 + ((2847 * (32768 - z)) >> 15))) >> 15;
+        if (steep) {
+            angle = 16384 - angle;
+        }
+        if (x < 0) {
+            angle = 32768 - angle;
+        }
+        if (y < 0) {
+            angle = 65536 - angle;
+        }
+        return static_cast<uint16_t>(angle);
+    }
+
+    int bin(int32_t x, int32_t y) const {
+        return bearing(x - _mountXMm, y - _mountYMm) >> (16 - BIN_SHIFT);
+    }
+
+    // buckets the previous scan by bearing and fits a line through every point's neighbours
+    void buildReference() {
+        std::fill(_binStart.begin(), _binStart.end(), 0);
+        _bins.resize(_previous.size());
+        for (size_t i = 0; i < _previous.size(); ++i) {
+            _bins[i] = bin(_previous[i].x, _previous[i].y);
+            _binStart[_bins[i] + 1]++;
+        }
+        for (int b = 0; b < BINS; ++b) {
+            _binStart[b + 1] += _binStart[b];
+        }
+
+        _reference.resize(_previous.size());
+        std::copy(_binStart.begin(), _binStart.end() - 1, _binFill.begin());
+        for (size_t i = 0; i < _previous.size(); ++i) {
+            _reference[_binFill[_bins[i]]++] = { _previous[i].x, _previous[i].y, 0, 0 };
+        }
+
+        const size_t n = _reference.size();
+        auto near = [](const RefPoint& a, const RefPoint& b) {
+            return std::abs(a.x - b.x) + std::abs(a.y - b.y) <= MAX_NEIGHBOUR_GAP_MM;
+        };
+        for (size_t i = 0; i < n && n >= 3; ++i) {
+            const auto& prev = _reference[(i + n - 1) % n];
+            const auto& next = _reference[(i + 1) % n];
+            auto& point = _reference[i];
+            if (!near(prev, point) || !near(point, next)) {
+                continue;
+            }
+            const float dx = next.x - prev.x;
+            const float dy = next.y - prev.y;
+            const float length = std::sqrt(dx * dx + dy * dy);
+            if (length < 1.0f) {
+                continue;
+            }
+            point.nx = static_cast<int16_t>(std::lround(-dy / length * 16384.0f));
+            point.ny = static_cast<int16_t>(std::lround(dx / length * 16384.0f));
+        }
+    }
+
+    // the reference point with a line closest to (x, y) within `maxDistance`, or nullptr
+    const RefPoint* nearest(int32_t x, int32_t y, int32_t maxDistance) const {
+        const int center = bin(x, y);
+        const RefPoint* best = nullptr;
+        int32_t bestDistance2 = maxDistance * maxDistance;
+        for (int offset = -SEARCH_BINS; offset <= SEARCH_BINS; ++offset) {
+            const int b = (center + offset) & (BINS - 1);
+            for (uint16_t i = _binStart[b]; i < _binStart[b + 1]; ++i) {
+                const auto& ref = _reference[i];
+                if (ref.nx == 0 && ref.ny == 0) {
+                    continue;
+                }
+                const int32_t dx = x - ref.x;
+                const int32_t dy = y - ref.y;
+                const int32_t distance2 = dx * dx + dy * dy;
+                if (distance2 < bestDistance2) {
+                    bestDistance2 = distance2;
+                    best = &ref;
+                }
+            }
+        }
+        return best;
+    }
+
+    // solves the symmetric system a * x = b, false if it is badly conditioned
+    static bool solve(const std::array<float, 6>& a, const std::array<float, 3>& b, std::array<float, 3>& x) {
+        // a = [a0 a1 a2; a1 a3 a4; a2 a4 a5]
+        const float c0 = a[3] * a[5] - a[4] * a[4];
+        const float c1 = a[2] * a[4] - a[1] * a[5];
+        const float c2 = a[1] * a[4] - a[2] * a[3];
+        const float det = a[0] * c0 + a[1] * c1 + a[2] * c2;
+        // relative to the diagonal, so a corridor (one direction unobserved) is rejected too
+        if (!(det > 1e-3f * a[0] * a[3] * a[5])) {
+            return false;
+        }
+        const float c4 = a[0] * a[5] - a[2] * a[2];
+        const float c5 = a[1] * a[2] - a[0] * a[4];
+        const float c8 = a[0] * a[3] - a[1] * a[1];
+        x[0] = (c0 * b[0] + c1 * b[1] + c2 * b[2]) / det;
+        x[1] = (c1 * b[0] + c4 * b[1] + c5 * b[2]) / det;
+        x[2] = (c2 * b[0] + c5 * b[1] + c8 * b[2]) / det;
+        return true;
+    }
+
+public:
+    ScanMatcher(int16_t mountXMm, int16_t mountYMm):
+        _mountXMm(mountXMm),
+        _mountYMm(mountYMm),
+        _binStart(BINS + 1),
+        _binFill(BINS)
+    {
+        _points.reserve(MAX_POINTS);
+        _previous.reserve(MAX_POINTS);
+        _reference.reserve(MAX_POINTS);
+        _bins.reserve(MAX_POINTS);
+    }
+
+    // forgets the previous scan, the next one only becomes the reference
+    void reset() {
+        _previous.clear();
+    }
+
+    /**
+     * Matches `scan` against the previous revolution, starting from `prior`
+     * (usually wheel odometry). Returns nothing for the first scan and when
+     * the match is not constrained well enough, e.g. in an empty room or a
+     * featureless corridor. Either way `scan` becomes the next reference.
+     */
+    std::optional<ScanMatchResult> match(std::span<const Measurement> scan, PoseDelta prior) {
+        PROFILE_SCOPE("scan_match");
+        size_t valid = 0;
+        for (const auto& measurement : scan) {
+            valid += measurement.distanceQ2 >= MIN_RANGE_MM * 4;
+        }
+        const size_t stride = std::max<size_t>(1, (valid + MAX_POINTS - 1) / MAX_POINTS);
+
+        _points.clear();
+        size_t index = 0;
+        for (const auto& measurement : scan) {
+            if (measurement.distanceQ2 < MIN_RANGE_MM * 4 || index++ % stride != 0) {
+                continue;
+            }
+            // the lidar angle grows clockwise, the robot frame is counter-clockwise
+            const float angle = -measurement.angleQ6 * Q6_TO_RAD;
+            const float range = measurement.distanceQ2 / 4.0f;
+            _points.push_back({
+                static_cast<int16_t>(std::lround(range * std::cos(angle)) + _mountXMm),
+                static_cast<int16_t>(std::lround(range * std::sin(angle)) + _mountYMm),
+            });
+        }
+
+        const bool hasReference = _previous.size() >= MIN_MATCHED;
+        if (hasReference) {
+            buildReference();
+        }
+        std::swap(_points, _previous);
+        if (!hasReference) {
+            return std::nullopt;
+        }
+        const auto& points = _previous;
+
+        float x = prior.xMm;
+        float y = prior.yMm;
+        float theta = prior.theta * THETA_TO_RAD;
+        ScanMatchResult result;
+
+        for (uint8_t iteration = 0; iteration < MAX_ITERATIONS; ++iteration) {
+            const int32_t maxDistance = std::max(MIN_DISTANCE_MM, MAX_DISTANCE_MM - iteration * 40);
+            const int32_t c = std::lround(std::cos(theta) * 16384.0f);
+            const int32_t s = std::lround(std::sin(theta) * 16384.0f);
+            const int32_t tx = std::lround(x);
+            const int32_t ty = std::lround(y);
+
+            // normal equations of the residuals n . (p - q); J = (nx, ny, n . perp(p)) with
+            // nx, ny in Q14 and the rotation column in mm
+            int64_t axx = 0, axy = 0, axt = 0, ayy = 0, ayt = 0, att = 0;
+            int64_t bx = 0, by = 0, bt = 0;
+            uint16_t matched = 0;
+            uint16_t inliers = 0;
+
+            for (const auto& point : points) {
+                const int32_t px = tx + ((c * point.x - s * point.y) >> 14);
+                const int32_t py = ty + ((s * point.x + c * point.y) >> 14);
+                const RefPoint* ref = nearest(px, py, maxDistance);
+                if (!ref) {
+                    continue;
+                }
+
+                const int32_t error = (ref->nx * (px - ref->x) + ref->ny * (py - ref->y)) >> 14;
+                const int32_t jt = (ref->ny * px - ref->nx * py) >> 14;
+                axx += ref->nx * ref->nx;
+                axy += ref->nx * ref->ny;
+                axt += ref->nx * jt;
+                ayy += ref->ny * ref->ny;
+                ayt += ref->ny * jt;
+                att += static_cast<int64_t>(jt) * jt;
+                bx += ref->nx * error;
+                by += ref->ny * error;
+                bt += static_cast<int64_t>(jt) * error;
+                matched++;
+                inliers += std::abs(error) <= INLIER_MM;
+            }
+
+            result.iterations = iteration + 1;
+            result.matched = matched;
+            result.quality = points.empty() ? 0 : static_cast<uint8_t>(inliers * 255u / points.size());
+            if (matched < MIN_MATCHED) {
+                return std::nullopt;
+            }
+
+            // back to floats, translation in mm and rotation in rad; the rotation column is
+            // scaled to metres so all three unknowns are of similar magnitude
+            constexpr float Q14 = 16384.0f;
+            constexpr float Q28 = Q14 * Q14;
+            const std::array<float, 6> a = {
+                axx / Q28, axy / Q28, axt / Q14 / 1000.0f,
+                ayy / Q28, ayt / Q14 / 1000.0f,
+                att / 1e6f,
+            };
+            const std::array<float, 3> b = { bx / Q14, by / Q14, bt / 1000.0f };
+            std::array<float, 3> step {};
+            if (!solve(a, b, step)) {
+                return std::nullopt;
+            }
+            const float dx = -step[0];
+            const float dy = -step[1];
+            const float dtheta = -step[2] / 1000.0f;
+
+            // compose the correction on the left: p' = R(dtheta) * p + d
+            const float cd = std::cos(dtheta);
+            const float sd = std::sin(dtheta);
+            const float nx = cd * x - sd * y + dx;
+            const float ny = sd * x + cd * y + dy;
+            x = nx;
+            y = ny;
+            theta += dtheta;
+
+            if (std::fabs(dx) < CONVERGED_MM && std::fabs(dy) < CONVERGED_MM && std::fabs(dtheta) < CONVERGED_RAD) {
+                break;
+            }
+        }
+
+        const float wrapped = std::remainder(theta, 2.0f * static_cast<float>(M_PI));
+        result.delta = {
+            static_cast<int16_t>(std::clamp<long>(std::lround(x), INT16_MIN, INT16_MAX)),
+            static_cast<int16_t>(std::clamp<long>(std::lround(y), INT16_MIN, INT16_MAX)),
+            static_cast<int16_t>(std::clamp<long>(std::lround(wrapped / THETA_TO_RAD), INT16_MIN, INT16_MAX)),
+        };
+        return result;
+    }
+};
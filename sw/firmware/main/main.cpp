@@ -2,23 +2,59 @@
 #include <freertos/task.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <span>
 
 #include "driver/ledc.h"
-#include "esp_log.h"
 #include "esp_timer.h"
 
 #include "./comm/binary_serializer.h"
-#include "./comm/uart_transport.h"
+#include "./comm/command_lanes.h"
+#include "./comm/telemetry_streams.h"
+#include "./comm/transport.h"
+#include "./driver/clawCurrent.h"
+#include "./driver/clawGrasp.h"
+#include "./driver/lidarFilter.h"
+#include "./driver/lidarStartup.h"
+#include "./driver/motorTrace.h"
+#include "./lidar/clustering.h"
+#include "./lidar/collisionGuard.h"
+#include "./lidar/lidarBatcher.h"
+#include "./lidar/lidarPassthrough.h"
+#include "./lidar/localGrid.h"
+#include "./lidar/pointTransform.h"
+#include "./lidar/rpmRegulator.h"
+#include "./lidar/scanAssembler.h"
+#include "./localization/particleScoring.h"
+#include "./localization/scanMatcher.h"
+#include "./runtime/freeRtosExecutor.h"
+#include "./runtime/uartEvents.h"
+#include "./storage/flightRecorder.h"
+#include "protocol/binlog.h"
+#include "protocol/coro.h"
 #include "robot.h"
 #include "test.h"
 
-constexpr const char* LOG_TAG = "robot_cmd";
 
+// lidar position in the robot frame
+constexpr int16_t LIDAR_MOUNT_X_MM = -50;
+constexpr int16_t LIDAR_MOUNT_Y_MM = 0;
 
-constexpr auto REPORT_PERIOD_MS = 30;
-constexpr auto MAX_LIDAR_MEASUREMENTS = 96;
+constexpr float TICKS_PER_METER = 496.0f / (0.0387f * M_PI);
+constexpr float WHEEL_BASE_MM = 249.0f;
+
+// room for a full log ring
+constexpr size_t LOG_FLUSH_MIN_TX_FREE = binlog::SLOTS * (4 + 4 + 1 + 1 + binlog::ARGS_SIZE);
+// room for a motor trace chunk besides a measurements frame
+constexpr size_t MOTOR_TRACE_MIN_TX_FREE = 2 * MotorTrace::CHUNK_SAMPLES * sizeof(MotorTraceSample);
+
+static_assert(LocalGrid::MAX_MESSAGE_SIZE <= comm::FramedTransport::MAX_PAYLOAD_SIZE);
+
+// longest sleep of the control loop, for the log ring, which does not wake it
+constexpr int64_t CONTROL_IDLE_MAX_US = 10'000;
+// sleep while the lidar bring-up has deadlines of its own or a motor trace waits for TX room
+constexpr int64_t CONTROL_POLL_US = 1'000;
 
 
 constexpr RegParams reg = {
@@ -54,9 +90,7 @@ auto lily = []() {
             UART_NUM_1,
             GPIO_NUM_21,
             GPIO_NUM_47,
-            GPIO_NUM_14,
-            LEDC_CHANNEL_4,
-            LEDC_TIMER_0
+            GPIO_NUM_14
         )
     );
 }();
@@ -66,101 +100,495 @@ extern "C" void app_main() {
     // test::robot(lily);
     // return;
 
-    comm::UartTransport transport(UART_NUM_0, 921600, 10240, 10240);
+    comm::FramedTransport transport(comm::makeHostStream(comm::DEFAULT_HOST_LINK));
+
+    FreeRtosExecutor executor;
+    // lidar bytes or a command for the control loop arrived
+    coro::Signal controlWakeup(executor);
+    UartEventBridge lidarEvents(lily.lidar().eventQueue(), controlWakeup, "lidar_events");
 
     bool armed = false;
+    std::atomic<bool> lidarStartRequested = false;
+    LidarStartup lidarStartup(lily.lidar());
+    LidarFilter lidarFilter;
+    ScanAssembler scanAssembler;
+    ScanClusterer scanClusterer;
+    RpmRegulator rpmRegulator;
+    LidarBatcher lidarBatcher;
+    LidarPassthrough lidarPassthrough;
+    LidarOutputConfig lidarOutput = { .mount = { .xMm = LIDAR_MOUNT_X_MM, .yMm = LIDAR_MOUNT_Y_MM } };
+    PointTransform pointTransform;
+    pointTransform.setMount(lidarOutput.mount);
+    ParticleScoringService particleScoring(LIDAR_MOUNT_X_MM, LIDAR_MOUNT_Y_MM);
+    ScanMatcher scanMatcher(LIDAR_MOUNT_X_MM, LIDAR_MOUNT_Y_MM);
+    storage::FlightRecorder recorder;
+    comm::CommandLanes commandLanes;
+    MotorTrace motorTrace(lily.motorLeft(), lily.motorRight());
+    CollisionGuard collisionGuard;
+    // the claw drivers' current sense is not wired to the ESP32 on this board, grasps end at
+    // ClawGrasp::BLIND_TIMEOUT_MS; AdcClawCurrentSense takes its ADC1 channels once it is
+    NoClawCurrentSense clawCurrent;
+    ClawGrasp clawGrasp(lily.claws(), clawCurrent);
+    comm::TelemetryStreams telemetryStreams;
+    LocalGrid localGrid;
+    // encoders at the last local grid update
+    comm::EncodersMeasurement gridEncoders;
+    // measurement frames can be unsubscribed, the batcher keeps feeding the scan matcher
+    bool measurementsEnabled = true;
 
-    transport.setReceiveCallback([&](std::span<const uint8_t> payload) {
-        auto command = comm::BinarySerializer::deserializeCommand(payload);
-        if (!command) {
-            ESP_LOGW(LOG_TAG, "Failed to parse command payload, size=%u", payload.size());
-            return;
+    particleScoring.begin([&](const comm::ParticleScores& scores) {
+        auto payload = comm::BinarySerializer::serializeParticleScores(scores);
+        transport.send(std::span<const uint8_t>(payload));
+    });
+
+    recorder.begin([&](uint32_t offset, uint32_t total, std::span<const uint8_t> data) {
+        auto payload = comm::BinarySerializer::serializeRecorderChunk({ .offset = offset, .total = total, .data = data });
+        transport.send(std::span<const uint8_t>(payload));
+    });
+
+    lily.lidar().setPacketHook([&](std::span<const uint8_t> packet) {
+        recorder.record(storage::RecordType::LidarPacket, packet);
+    });
+
+    // wheel speeds in mm/s
+    auto driveMotors = [&](int16_t leftSpeed, int16_t rightSpeed) {
+        int cmdTicksLeft  = static_cast<int>(leftSpeed  * TICKS_PER_METER / 1000.0f);
+        int cmdTicksRight = static_cast<int>(rightSpeed * TICKS_PER_METER / 1000.0f);
+        lily.motorLeft().setSpeed(cmdTicksLeft);
+        lily.motorRight().setSpeed(cmdTicksRight);
+        motorTrace.setSetpoint(0, cmdTicksLeft);
+        motorTrace.setSetpoint(1, cmdTicksRight);
+
+        if (cmdTicksLeft == 0) {
+            lily.motorLeft().stop(false);
+        }
+        else {
+            lily.motorLeft().moveInfinite();
         }
 
-        switch (command->type) {
+        if (cmdTicksRight == 0) {
+            lily.motorRight().stop(false);
+        }
+        else {
+            lily.motorRight().moveInfinite();
+        }
+    };
+
+    // everything that changes control loop state, applied by the control loop between iterations
+    auto applyLaneCommand = [&](const comm::Command& command) {
+        switch (command.type) {
             case comm::CommandType::Move: {
                 if (!armed) {
-                    ESP_LOGW(LOG_TAG, "Move command ignored: robot not armed");
+                    BINLOG_W("Move command ignored: robot not armed");
                     break;
                 }
-                static constexpr float TICKS_PER_METER = 496.0f / (0.0387f * M_PI);
-                int cmdTicksLeft  = static_cast<int>(command->leftSpeed  * TICKS_PER_METER / 1000.0f);
-                int cmdTicksRight = static_cast<int>(command->rightSpeed * TICKS_PER_METER / 1000.0f);
-                lily.motorLeft().setSpeed(cmdTicksLeft);
-                lily.motorRight().setSpeed(cmdTicksRight);
-
-                if (cmdTicksLeft == 0) {
-                    lily.motorLeft().stop(false);
-                }
-                else {
-                    lily.motorLeft().moveInfinite();
-                }
-
-                if (cmdTicksRight == 0) {
-                    lily.motorRight().stop(false);
-                }
-                else {
-                    lily.motorRight().moveInfinite();
-                }
+                collisionGuard.setCommand(command.leftSpeed, command.rightSpeed);
+                const auto [leftSpeed, rightSpeed] = collisionGuard.limit();
+                driveMotors(leftSpeed, rightSpeed);
                 break;
             }
             case comm::CommandType::Claw:
                 if (!armed) {
-                    ESP_LOGW(LOG_TAG, "Claw command ignored: robot not armed");
+                    BINLOG_W("Claw command ignored: robot not armed");
                     break;
                 }
-                lily.claws().setPower(command->clawPwm);
+                if (clawGrasp.cancel(esp_timer_get_time())) {
+                    auto graspPayload = comm::BinarySerializer::serializeGraspEvent(clawGrasp.event());
+                    transport.send(std::span<const uint8_t>(graspPayload));
+                }
+                lily.claws().setPower(command.clawPwm);
+                break;
+            case comm::CommandType::Grasp:
+                if (!armed) {
+                    BINLOG_W("Grasp command ignored: robot not armed");
+                    break;
+                }
+                if (clawGrasp.cancel(esp_timer_get_time())) {
+                    auto graspPayload = comm::BinarySerializer::serializeGraspEvent(clawGrasp.event());
+                    transport.send(std::span<const uint8_t>(graspPayload));
+                }
+                clawGrasp.start(command.grasp, esp_timer_get_time());
                 break;
             case comm::CommandType::Arm:
                 if (!armed) {
-                    ESP_LOGD(LOG_TAG, "Arm command received: enabling telemetry stream");
+                    BINLOG_D("Arm command received: enabling telemetry stream");
+                    // the control loop runs on the app_main stack, CONFIG_ESP_MAIN_TASK_STACK_SIZE is sized from this
+                    BINLOG_I("Main task stack: %u bytes never used", static_cast<unsigned>(uxTaskGetStackHighWaterMark(nullptr)));
                     armed = true;
-                    lily.lidar().startExpress();
+                    lidarStartRequested = true;
+                }
+                else if (lidarStartup.failed()) {
+                    lidarStartRequested = true;
+                }
+                break;
+            case comm::CommandType::CollisionGuard:
+                collisionGuard.setConfig(command.collisionGuard);
+                if (armed) {
+                    const auto [leftSpeed, rightSpeed] = collisionGuard.limit();
+                    driveMotors(leftSpeed, rightSpeed);
+                }
+                break;
+            case comm::CommandType::Subscribe:
+                for (const auto& subscription : command.subscriptions) {
+                    if (subscription.stream == comm::TelemetryStream::LocalGrid) {
+                        if (!localGrid.enabled()) {
+                            gridEncoders = {
+                                .leftTicks = static_cast<int32_t>(lily.motorLeft().getPosition()),
+                                .rightTicks = static_cast<int32_t>(lily.motorRight().getPosition()),
+                            };
+                        }
+                        localGrid.setPeriod(subscription.periodMs);
+                        continue;
+                    }
+                    if (subscription.stream != comm::TelemetryStream::Measurements) {
+                        telemetryStreams.subscribe(subscription.stream, subscription.periodMs);
+                        continue;
+                    }
+                    measurementsEnabled = subscription.periodMs != comm::wire::STREAM_OFF;
+                    if (measurementsEnabled && subscription.periodMs != comm::wire::STREAM_ON_CHANGE) {
+                        lidarBatcher.setConfig({ .periodMs = subscription.periodMs, .maxPoints = lidarBatcher.config().maxPoints });
+                    }
+                }
+                break;
+            case comm::CommandType::LidarFilter:
+                lidarFilter.setConfig(command.lidarFilter);
+                break;
+            case comm::CommandType::BearTemplate:
+                scanClusterer.setTemplate(command.bearTemplate);
+                break;
+            case comm::CommandType::TelemetryConfig:
+                lidarBatcher.setConfig(command.telemetry);
+                break;
+            case comm::CommandType::MotorTrace:
+                motorTrace.start(command.motorTrace);
+                break;
+            case comm::CommandType::LidarOutput:
+                lidarOutput = command.lidarOutput;
+                pointTransform.setMount(lidarOutput.mount);
+                break;
+            case comm::CommandType::LidarMotor:
+                rpmRegulator.setTarget(command.lidarTargetRpm);
+                lily.lidar().setMotorDuty(rpmRegulator.duty());
+                break;
+            default:
+                break;
+        }
+    };
+
+    transport.setReceiveCallback([&](std::span<const uint8_t> payload) {
+        PROFILE_SCOPE("command_callback");
+        recorder.record(storage::RecordType::Command, payload);
+
+        auto command = comm::BinarySerializer::deserializeCommand(payload);
+        if (!command) {
+            BINLOG_W("Failed to parse command payload, size=%u", payload.size());
+            return;
+        }
+
+        if (comm::CommandLanes::accepts(*command)) {
+            commandLanes.push(*command);
+            controlWakeup.set();
+            return;
+        }
+
+        switch (command->type) {
+            case comm::CommandType::FieldUploadBegin:
+                if (!particleScoring.beginUpload(command->uploadValue)) {
+                    BINLOG_W("Likelihood field upload refused, size=%lu", command->uploadValue);
+                }
+                break;
+            case comm::CommandType::FieldUploadData:
+                if (!particleScoring.writeUpload(command->uploadValue, command->uploadData)) {
+                    BINLOG_W("Likelihood field chunk rejected, offset=%lu", command->uploadValue);
+                }
+                break;
+            case comm::CommandType::FieldUploadEnd: {
+                comm::FieldUploadResult result = { .ok = particleScoring.finishUpload(command->uploadValue) };
+                auto payload = comm::BinarySerializer::serializeFieldUploadResult(result);
+                transport.send(std::span<const uint8_t>(payload));
+                break;
+            }
+            case comm::CommandType::ScoreParticles:
+                particleScoring.submit(command->particleSequence, command->particles);
+                break;
+            case comm::CommandType::RecorderDump:
+                recorder.requestDump();
+                break;
+            case comm::CommandType::ProfileDump:
+                profiling::Profiler::instance().serialize([&](std::span<const uint8_t> profilePayload) {
+                    transport.send(profilePayload);
+                });
+                if (command->profileReset) {
+                    profiling::Profiler::instance().reset();
                 }
                 break;
             default:
-                ESP_LOGW(LOG_TAG, "Unhandled command type=%d", static_cast<int>(command->type));
+                BINLOG_W("Unhandled command type=%d", static_cast<int>(command->type));
                 break;
         }
     });
+    comm::startReceiveTask(transport);
 
     int64_t lastMeasurementUs = 0;
+    bool scanComplete = false;
 
     comm::Measurements measurements;
-    measurements.lidar.reserve(96);
+    measurements.lidar.reserve(LidarBatcher::MAX_POINTS_LIMIT);
+    measurements.lidarXY.reserve(LidarBatcher::MAX_POINTS_LIMIT);
 
-    while (true) {
-        if (armed) {
-            measurements.lidar.clear();
-            measurements.timestamp = esp_timer_get_time();
+    comm::BearCandidates bearCandidates;
+    bearCandidates.candidates.reserve(ScanClusterer::MAX_CANDIDATES);
 
-            while (lastMeasurementUs + REPORT_PERIOD_MS * 1000 > esp_timer_get_time() && measurements.lidar.size() < MAX_LIDAR_MEASUREMENTS) {
-                auto lidarMeasurements = lily.lidar().getMeasurementsExpress();
+    std::vector<uint8_t> encoderRecord;
+    encoderRecord.reserve(4 + 4);
 
-                if (!lidarMeasurements.has_value()) {
-                    vTaskDelay(pdMS_TO_TICKS(1));
-                    continue;
+    comm::StreamSample streamSample;
+    std::vector<uint8_t> streamPayload;
+    streamPayload.reserve(comm::TelemetryStreams::FRAME_OVERHEAD + comm::TelemetryStreams::COUNT * comm::TelemetryStreams::MAX_RECORD_SIZE);
+
+    comm::ScanMatch scanMatch;
+    comm::EncodersMeasurement scanEncoders;
+    comm::EncodersMeasurement frameEncoders;
+
+    // wheel odometry between two encoder readings
+    auto odometryDelta = [&](const comm::EncodersMeasurement& from, const comm::EncodersMeasurement& to) {
+        const float left = (to.leftTicks - from.leftTicks) * 1000.0f / TICKS_PER_METER;
+        const float right = (to.rightTicks - from.rightTicks) * 1000.0f / TICKS_PER_METER;
+        const float theta = (right - left) / WHEEL_BASE_MM;
+        const float distance = (left + right) / 2.0f;
+        return PoseDelta {
+            .xMm = static_cast<int16_t>(std::lround(distance * std::cos(theta / 2.0f))),
+            .yMm = static_cast<int16_t>(std::lround(distance * std::sin(theta / 2.0f))),
+            .theta = static_cast<int16_t>(std::lround(std::remainder(theta, 2.0f * static_cast<float>(M_PI)) * 32768.0f / static_cast<float>(M_PI))),
+        };
+    };
+
+    auto controlLoop = [&]() -> coro::Task {
+        while (true) {
+            commandLanes.drain(applyLaneCommand);
+
+            if (clawGrasp.update(esp_timer_get_time())) {
+                auto graspPayload = comm::BinarySerializer::serializeGraspEvent(clawGrasp.event());
+                transport.send(std::span<const uint8_t>(graspPayload));
+            }
+
+            // log records wait in their ring until the host has armed the robot
+            if (armed && binlog::Log::instance().pending() && transport.txFree() >= LOG_FLUSH_MIN_TX_FREE) {
+                binlog::Log::instance().serialize([&](std::span<const uint8_t> logPayload) {
+                    transport.send(logPayload);
+                });
+            }
+
+            // one part of a finished motor trace per iteration, so it cannot hold up the loop
+            if (motorTrace.ready() && transport.txFree() >= MOTOR_TRACE_MIN_TX_FREE) {
+                motorTrace.sendChunk([&](const MotorTraceChunk& chunk) {
+                    auto tracePayload = comm::BinarySerializer::serializeMotorTraceChunk(chunk);
+                    transport.send(std::span<const uint8_t>(tracePayload));
+                });
+            }
+
+            if (armed) {
+                if (lidarStartRequested.exchange(false)) {
+                    lidarBatcher.clear();
+                    lidarPassthrough.clear();
+                    scanMatcher.reset();
+                    lidarStartup.begin();
                 }
 
-                for (const auto& measurement : *lidarMeasurements) {
-                    measurements.lidar.push_back(comm::LidarMeasurement {
-                        .distanceQ2 = measurement.distanceQ2,
-                        .angleQ6 = measurement.angleQ6
+                if (!lidarStartup.running() && lidarStartup.poll()) {
+                    auto startupPayload = comm::BinarySerializer::serializeLidarStartup(lidarStartup.report());
+                    transport.send(std::span<const uint8_t>(startupPayload));
+                    if (lidarStartup.failed()) {
+                        recorder.trigger();
+                    }
+                }
+
+                // drain everything the lidar has sent, leftovers in its UART buffer only get older
+                bool drained = false;
+                while (lidarStartup.running()) {
+                    auto packet = lily.lidar().readExpressPacket();
+                    if (!packet.has_value()) {
+                        break;
+                    }
+                    drained = true;
+
+                    if (auto period = lily.lidar().takeRevolutionPeriod()) {
+                        lily.lidar().setMotorDuty(rpmRegulator.update(*period));
+                    }
+
+                    // raw packets are only decoded while the collision guard or the local grid needs the points
+                    if (lidarOutput.raw) {
+                        lidarPassthrough.push(*packet);
+                        if (!collisionGuard.config().enabled && !localGrid.enabled()) {
+                            continue;
+                        }
+                    }
+
+                    auto lidarMeasurements = lily.lidar().decodeExpress(*packet);
+                    if (!lidarMeasurements.has_value()) {
+                        continue;
+                    }
+
+                    // a release keeps only the turning part, the blocked move is not resumed
+                    if (collisionGuard.check(*lidarMeasurements, pointTransform, packet->arrivalUs)) {
+                        const auto [leftSpeed, rightSpeed] = collisionGuard.limit();
+                        driveMotors(leftSpeed, rightSpeed);
+                        auto& event = collisionGuard.event();
+                        event.reactionUs = esp_timer_get_time() - packet->arrivalUs;
+                        auto eventPayload = comm::BinarySerializer::serializeGuardEvent(event);
+                        transport.send(std::span<const uint8_t>(eventPayload));
+                    }
+
+                    if (localGrid.enabled()) {
+                        const comm::EncodersMeasurement encoders = {
+                            .leftTicks = static_cast<int32_t>(lily.motorLeft().getPosition()),
+                            .rightTicks = static_cast<int32_t>(lily.motorRight().getPosition()),
+                        };
+                        localGrid.move(odometryDelta(gridEncoders, encoders));
+                        gridEncoders = encoders;
+                        localGrid.integrate(*lidarMeasurements, pointTransform);
+                    }
+                    if (lidarOutput.raw) {
+                        continue;
+                    }
+
+                    const int64_t now = esp_timer_get_time();
+                    for (const auto& measurement : *lidarMeasurements) {
+                        if (!lidarFilter.accept(measurement)) {
+                            continue;
+                        }
+                        scanComplete |= scanAssembler.push(measurement);
+                        lidarBatcher.push(now, measurement);
+                    }
+                }
+                const uint16_t checksumErrors = lily.lidar().takeChecksumErrors();
+                if (lidarOutput.raw) {
+                    lidarPassthrough.countChecksumErrors(checksumErrors);
+                }
+
+                if (lidarPassthrough.due(esp_timer_get_time(), lidarBatcher.config().periodMs)) {
+                    lidarPassthrough.take(esp_timer_get_time(), transport.txFree(), [&](const LidarRawBatch& batch) {
+                        auto rawPayload = comm::BinarySerializer::serializeLidarRaw(batch);
+                        transport.send(std::span<const uint8_t>(rawPayload));
                     });
                 }
-            }
 
-            measurements.encoders = {
-                .leftTicks = static_cast<int32_t>(lily.motorLeft().getPosition()),
-                .rightTicks = static_cast<int32_t>(lily.motorRight().getPosition()),
-            };
+                // the light streams go before the measurement frame, they are a few bytes each
+                const auto [guardLeftSpeed, guardRightSpeed] = collisionGuard.limit();
+                streamSample = {
+                    .leftTicks = static_cast<int32_t>(lily.motorLeft().getPosition()),
+                    .rightTicks = static_cast<int32_t>(lily.motorRight().getPosition()),
+                    .lidarRpm = static_cast<uint16_t>(std::lround(rpmRegulator.measuredRpm())),
+                    .lidarTargetRpm = rpmRegulator.target(),
+                    .guardBlocked = collisionGuard.blocked(),
+                    .guardLeftSpeed = guardLeftSpeed,
+                    .guardRightSpeed = guardRightSpeed,
+                    .txFree = static_cast<uint16_t>(std::min<size_t>(transport.txFree(), UINT16_MAX)),
+                    .txDropped = transport.txDropped(),
+                };
+                if (telemetryStreams.take(esp_timer_get_time(), transport.txFree(), streamSample, streamPayload)) {
+                    transport.send(std::span<const uint8_t>(streamPayload));
+                }
+
+                if (localGrid.due(esp_timer_get_time())) {
+                    localGrid.take(esp_timer_get_time(), transport.txFree(), [&](const LocalGridUpdate& update) {
+                        auto gridPayload = comm::BinarySerializer::serializeLocalGrid(update);
+                        transport.send(std::span<const uint8_t>(gridPayload));
+                    });
+                }
+
+                const int64_t now = esp_timer_get_time();
+                const size_t txFree = transport.txFree();
+                if (lidarBatcher.due(now, lastMeasurementUs, txFree)) {
+                    measurements.timestamp = now;
+                    measurements.lidar.clear();
+                    measurements.lidarBatch = lidarBatcher.take(now, txFree, [&](const Measurement& measurement) {
+                        measurements.lidar.push_back(comm::LidarMeasurement {
+                            .distanceQ2 = measurement.distanceQ2,
+                            .angleQ6 = measurement.angleQ6
+                        });
+                    });
+                    measurements.lidarBatch.sourceBacklog = std::min<size_t>(lily.lidar().bufferedBytes(), UINT16_MAX);
+
+                    measurements.encoders = {
+                        .leftTicks = static_cast<int32_t>(lily.motorLeft().getPosition()),
+                        .rightTicks = static_cast<int32_t>(lily.motorRight().getPosition()),
+                    };
+
+                    // the batch holds the points since the previous frame, so does this motion
+                    measurements.cartesian = lidarOutput.cartesian;
+                    measurements.motionCompensated = lidarOutput.cartesian && lidarOutput.motionCompensation;
+                    if (measurements.cartesian) {
+                        measurements.lidarXY.clear();
+                        const PoseDelta motion = measurements.motionCompensated ? odometryDelta(frameEncoders, measurements.encoders) : PoseDelta {};
+                        pointTransform.transform(measurements.lidar, motion, measurements.lidarXY);
+                    }
+                    frameEncoders = measurements.encoders;
+
+                    measurements.lidarFiltered = lidarFilter.takeStats();
+                    measurements.lidarRpm = static_cast<uint16_t>(std::lround(rpmRegulator.measuredRpm()));
+                    measurements.commandLanes = commandLanes.takeStats();
+
+                    encoderRecord.clear();
+                    comm::appendLe<int32_t>(encoderRecord, measurements.encoders.leftTicks);
+                    comm::appendLe<int32_t>(encoderRecord, measurements.encoders.rightTicks);
+                    recorder.record(storage::RecordType::Encoders, encoderRecord);
 
-            auto payload = comm::BinarySerializer::serializeMeasurements(measurements);
-            transport.send(std::span<const uint8_t>(payload));
+                    if (measurementsEnabled) {
+                        auto payload = comm::BinarySerializer::serializeMeasurements(measurements);
+                        transport.send(std::span<const uint8_t>(payload));
+                    }
 
-            lastMeasurementUs = measurements.timestamp;
+                    if (scanComplete && scanClusterer.bearTemplate().enabled) {
+                        bearCandidates.timestamp = measurements.timestamp;
+                        scanClusterer.detect(scanAssembler.scan(), bearCandidates.candidates);
+                        auto candidatesPayload = comm::BinarySerializer::serializeBearCandidates(bearCandidates);
+                        transport.send(std::span<const uint8_t>(candidatesPayload));
+                    }
+
+                    if (scanComplete) {
+                        particleScoring.setScan(measurements.timestamp, scanAssembler.scan());
+
+                        const int64_t matchStart = esp_timer_get_time();
+                        const auto match = scanMatcher.match(scanAssembler.scan(), odometryDelta(scanEncoders, measurements.encoders));
+                        scanEncoders = measurements.encoders;
+                        if (match) {
+                            scanMatch.timestamp = measurements.timestamp;
+                            scanMatch.result = *match;
+                            scanMatch.durationUs = esp_timer_get_time() - matchStart;
+                            auto matchPayload = comm::BinarySerializer::serializeScanMatch(scanMatch);
+                            transport.send(std::span<const uint8_t>(matchPayload));
+                        }
+                    }
+
+                    scanComplete = false;
+                    lastMeasurementUs = now;
+                    continue;
+                }
+
+                if (drained) {
+                    continue;
+                }
+            }
+
+            // sleeps until lidar bytes, a command, the next frame or a stream period
+            const int64_t nowUs = executor.nowUs();
+            int64_t deadlineUs = nowUs + CONTROL_IDLE_MAX_US;
+            if (armed && lidarStartup.running()) {
+                deadlineUs = std::min<int64_t>(deadlineUs, lastMeasurementUs + lidarBatcher.config().periodMs * 1000);
+            }
+            if (armed) {
+                // a stream that is due but did not fit is retried at the poll interval
+                deadlineUs = std::min(deadlineUs, std::max(telemetryStreams.nextDueUs(), nowUs + CONTROL_POLL_US));
+                deadlineUs = std::min(deadlineUs, std::max(localGrid.nextDueUs(), nowUs + CONTROL_POLL_US));
+            }
+            if (lidarStartup.inProgress() || motorTrace.ready() || clawGrasp.moving()) {
+                deadlineUs = std::min(deadlineUs, nowUs + CONTROL_POLL_US);
+            }
+            co_await controlWakeup.wait(deadlineUs);
         }
+    };
 
-        vTaskDelay(1);
-    }
+    executor.spawn(controlLoop());
+    executor.run();
 }
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "esp_timer.h"
+
+#include "protocol/coro.h"
+
+
+/**
+ * Runs coroutines on the task that constructs it. While every coroutine
+ * waits, the task blocks on its notification until the earliest deadline;
+ * `wake()` from another task gives the notification.
+ */
+class FreeRtosExecutor: public coro::Executor {
+    TaskHandle_t _task;
+
+protected:
+    void idle(int64_t deadlineUs) override {
+        TickType_t ticks = portMAX_DELAY;
+        if (deadlineUs != coro::NO_DEADLINE) {
+            const int64_t waitUs = deadlineUs - esp_timer_get_time();
+            if (waitUs <= 0) {
+                return;
+            }
+            // rounded up, waking before the deadline would only spin
+            constexpr int64_t TICK_US = portTICK_PERIOD_MS * 1000;
+            ticks = static_cast<TickType_t>((waitUs + TICK_US - 1) / TICK_US);
+        }
+        ulTaskNotifyTake(pdTRUE, ticks);
+    }
+
+public:
+    FreeRtosExecutor():
+        _task(xTaskGetCurrentTaskHandle())
+    {}
+
+    int64_t nowUs() override {
+        return esp_timer_get_time();
+    }
+
+    void wake() override {
+        xTaskNotifyGive(_task);
+    }
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include "driver/uart.h"
+
+#include "protocol/coro.h"
+
+
+/**
+ * Sets a `coro::Signal` for every event of an ESP-IDF UART driver, from a
+ * small task blocked on the driver's event queue, so a coroutine can wait
+ * for received bytes instead of polling the driver.
+ */
+class UartEventBridge {
+    QueueHandle_t _events;
+    coro::Signal& _signal;
+
+public:
+    UartEventBridge(QueueHandle_t events, coro::Signal& signal, const char* name):
+        _events(events),
+        _signal(signal)
+    {
+        xTaskCreate(
+            [](void* arg) {
+                auto& bridge = *static_cast<UartEventBridge*>(arg);
+                uart_event_t event;
+                while (true) {
+                    if (xQueueReceive(bridge._events, &event, portMAX_DELAY) == pdTRUE) {
+                        bridge._signal.set();
+                    }
+                }
+            },
+            name, 2048, this, tskIDLE_PRIORITY + 2, nullptr
+        );
+    }
+
+    UartEventBridge(const UartEventBridge&) = delete;
+};
+
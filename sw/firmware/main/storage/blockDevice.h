@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include <unistd.h>
+
+
+namespace storage {
+
+
+/**
+ * Fixed-size byte-addressed storage written in whole blocks.
+ * Keeps the flight recorder independent of the filesystem, so it can be
+ * exercised on the host against RamBlockDevice.
+ */
+class BlockDevice {
+public:
+    virtual ~BlockDevice() = default;
+
+    virtual size_t size() const = 0;
+    virtual bool read(size_t offset, std::span<uint8_t> out) = 0;
+    virtual bool write(size_t offset, std::span<const uint8_t> data) = 0;
+    virtual bool flush() {
+        return true;
+    }
+};
+
+
+/**
+ * A file preallocated to its full size on open, so that later writes
+ * only overwrite existing clusters and never grow the FAT chains.
+ */
+class FileBlockDevice : public BlockDevice {
+    FILE* _file = nullptr;
+    size_t _size = 0;
+
+public:
+    FileBlockDevice() = default;
+    FileBlockDevice(FileBlockDevice const&) = delete;
+
+    ~FileBlockDevice() override {
+        close();
+    }
+
+    bool open(const char* path, size_t size) {
+        close();
+
+        _file = fopen(path, "r+b");
+        if (!_file) {
+            _file = fopen(path, "w+b");
+        }
+        if (!_file) {
+            return false;
+        }
+
+        fseek(_file, 0, SEEK_END);
+        const long existing = ftell(_file);
+        if (existing < static_cast<long>(size)) {
+            std::vector<uint8_t> fill(4096, 0xFF);
+            for (size_t offset = std::max<long>(existing, 0); offset < size; offset += fill.size()) {
+                const size_t chunk = std::min(fill.size(), size - offset);
+                if (fwrite(fill.data(), 1, chunk, _file) != chunk) {
+                    close();
+                    return false;
+                }
+            }
+            fflush(_file);
+        }
+
+        _size = size;
+        return true;
+    }
+
+    void close() {
+        if (_file) {
+            fclose(_file);
+            _file = nullptr;
+        }
+        _size = 0;
+    }
+
+    size_t size() const override {
+        return _size;
+    }
+
+    bool read(size_t offset, std::span<uint8_t> out) override {
+        if (!_file || offset + out.size() > _size || fseek(_file, offset, SEEK_SET) != 0) {
+            return false;
+        }
+        return fread(out.data(), 1, out.size(), _file) == out.size();
+    }
+
+    bool write(size_t offset, std::span<const uint8_t> data) override {
+        if (!_file || offset + data.size() > _size || fseek(_file, offset, SEEK_SET) != 0) {
+            return false;
+        }
+        return fwrite(data.data(), 1, data.size(), _file) == data.size();
+    }
+
+    bool flush() override {
+        return _file && fflush(_file) == 0 && fsync(fileno(_file)) == 0;
+    }
+};
+
+
+/**
+ * In-memory fake with the erase semantics of NOR flash accounted for:
+ * counts bytes written and how many times each erase sector was rewritten.
+ */
+class RamBlockDevice : public BlockDevice {
+    std::vector<uint8_t> _data;
+    std::vector<uint32_t> _sectorWrites;
+    size_t _sectorSize;
+    uint64_t _bytesWritten = 0;
+    uint32_t _writes = 0;
+
+public:
+    RamBlockDevice(size_t size, size_t sectorSize = 4096):
+        _data(size, 0xFF),
+        _sectorWrites((size + sectorSize - 1) / sectorSize, 0),
+        _sectorSize(sectorSize)
+    {}
+
+    size_t size() const override {
+        return _data.size();
+    }
+
+    bool read(size_t offset, std::span<uint8_t> out) override {
+        if (offset + out.size() > _data.size()) {
+            return false;
+        }
+        std::memcpy(out.data(), _data.data() + offset, out.size());
+        return true;
+    }
+
+    bool write(size_t offset, std::span<const uint8_t> data) override {
+        if (offset + data.size() > _data.size()) {
+            return false;
+        }
+        std::memcpy(_data.data() + offset, data.data(), data.size());
+        if (!data.empty()) {
+            for (size_t sector = offset / _sectorSize; sector <= (offset + data.size() - 1) / _sectorSize; ++sector) {
+                _sectorWrites[sector]++;
+            }
+        }
+        _bytesWritten += data.size();
+        _writes++;
+        return true;
+    }
+
+    uint64_t bytesWritten() const {
+        return _bytesWritten;
+    }
+
+    uint32_t writes() const {
+        return _writes;
+    }
+
+    // erase count of each sector, the highest one bounds the flash lifetime
+    std::span<const uint32_t> sectorWrites() const {
+        return _sectorWrites;
+    }
+
+    uint32_t maxSectorWrites() const {
+        return _sectorWrites.empty() ? 0 : *std::max_element(_sectorWrites.begin(), _sectorWrites.end());
+    }
+};
+
+
+} // namespace storage
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "protocol/crc.h"
+#include "protocol/util.h"
+#include "blockDevice.h"
+
+
+namespace storage {
+
+
+enum class RecordType : uint8_t {
+    LidarPacket = 1, // raw express scan packet
+    Encoders = 2, // left, right ticks: int32
+    Command = 3, // command payload as received
+};
+
+
+struct FlightLogStats {
+    uint32_t records = 0;
+    uint32_t dropped = 0;
+    uint32_t blocksWritten = 0;
+    uint32_t writeErrors = 0;
+};
+
+
+/**
+ * Ring of fixed-size blocks on a BlockDevice. Records are appended to RAM
+ * staging blocks under a short lock and a full block is written out in one
+ * aligned write by writePending(), which is meant to run in its own task.
+ * When the staging blocks are all waiting for the writer, new records are
+ * dropped rather than waited for.
+ *
+ * Block layout (little endian):
+ *  - magic "FLR1", sequence: uint32
+ *  - used: uint16 (bytes including this header)
+ *  - crc: uint16 (CRC-16/CCITT-FALSE of the records)
+ *  - records: type uint8, size uint16 (header included), timestamp uint32 (us, wraps), payload
+ * Records never cross a block, the rest of a block is 0xFF.
+ */
+class FlightLog {
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+    static constexpr uint32_t BLOCK_MAGIC = 0x31524C46;
+    static constexpr size_t BLOCK_HEADER_SIZE = 12;
+    static constexpr size_t RECORD_HEADER_SIZE = 7;
+    static constexpr size_t MAX_RECORD_SIZE = BLOCK_SIZE - BLOCK_HEADER_SIZE - RECORD_HEADER_SIZE;
+    static constexpr size_t STAGING_BLOCKS = 6;
+
+private:
+    BlockDevice& _device;
+    size_t _blockCount;
+
+    std::mutex _mutex;
+    std::vector<uint8_t> _staging;
+    std::array<uint16_t, STAGING_BLOCKS> _used {};
+    size_t _active = 0;
+    size_t _sealed = 0;
+    size_t _fill = BLOCK_HEADER_SIZE;
+    FlightLogStats _stats;
+
+    // owned by the writer
+    uint32_t _sequence = 0;
+    size_t _nextBlock = 0;
+
+    uint8_t* stagingBlock(size_t index) {
+        return _staging.data() + index * BLOCK_SIZE;
+    }
+
+    bool sealLocked() {
+        if (_fill == BLOCK_HEADER_SIZE) {
+            return true;
+        }
+        if (_sealed + 1 == STAGING_BLOCKS) {
+            return false;
+        }
+        _used[_active] = _fill;
+        _sealed++;
+        _active = (_active + 1) % STAGING_BLOCKS;
+        _fill = BLOCK_HEADER_SIZE;
+        return true;
+    }
+
+    bool readValidBlock(size_t block, std::span<uint8_t> out) {
+        if (!_device.read(block * BLOCK_SIZE, out)) {
+            return false;
+        }
+
+        const std::span<const uint8_t> data(out);
+        size_t offset = 0;
+        uint32_t magic = 0;
+        uint32_t sequence = 0;
+        uint16_t used = 0;
+        uint16_t crc = 0;
+        comm::readLe(data, offset, magic);
+        comm::readLe(data, offset, sequence);
+        comm::readLe(data, offset, used);
+        comm::readLe(data, offset, crc);
+        return magic == BLOCK_MAGIC && used >= BLOCK_HEADER_SIZE && used <= BLOCK_SIZE
+            && crc == comm::crc16(data.subspan(BLOCK_HEADER_SIZE, used - BLOCK_HEADER_SIZE));
+    }
+
+    // continues after the newest block already on the device
+    void recover() {
+        std::array<uint8_t, BLOCK_HEADER_SIZE> header;
+        bool found = false;
+        for (size_t block = 0; block < _blockCount; ++block) {
+            if (!_device.read(block * BLOCK_SIZE, header)) {
+                continue;
+            }
+            size_t offset = 0;
+            uint32_t magic = 0;
+            uint32_t sequence = 0;
+            comm::readLe(std::span<const uint8_t>(header), offset, magic);
+            comm::readLe(std::span<const uint8_t>(header), offset, sequence);
+            if (magic == BLOCK_MAGIC && (!found || sequence >= _sequence)) {
+                found = true;
+                _sequence = sequence;
+                _nextBlock = (block + 1) % _blockCount;
+            }
+        }
+        if (found) {
+            _sequence++;
+        }
+    }
+
+public:
+    explicit FlightLog(BlockDevice& device):
+        _device(device),
+        _blockCount(device.size() / BLOCK_SIZE),
+        _staging(STAGING_BLOCKS * BLOCK_SIZE, 0xFF)
+    {
+        recover();
+    }
+
+    FlightLog(FlightLog const&) = delete;
+
+    size_t blockCount() const {
+        return _blockCount;
+    }
+
+    FlightLogStats stats() {
+        std::lock_guard lock(_mutex);
+        return _stats;
+    }
+
+    /**
+     * Appends a record. Never waits for the writer: returns false and counts
+     * the record as dropped when no staging block has room for it.
+     */
+    bool record(RecordType type, uint32_t timestampUs, std::span<const uint8_t> payload) {
+        const size_t size = RECORD_HEADER_SIZE + payload.size();
+
+        std::lock_guard lock(_mutex);
+        if (payload.size() > MAX_RECORD_SIZE || _blockCount == 0
+            || (_fill + size > BLOCK_SIZE && !sealLocked())) {
+            _stats.dropped++;
+            return false;
+        }
+
+        uint8_t* out = stagingBlock(_active) + _fill;
+        out[0] = static_cast<uint8_t>(type);
+        out[1] = size & 0xFF;
+        out[2] = size >> 8;
+        for (int i = 0; i < 4; ++i) {
+            out[3 + i] = (timestampUs >> (8 * i)) & 0xFF;
+        }
+        std::memcpy(out + RECORD_HEADER_SIZE, payload.data(), payload.size());
+
+        _fill += size;
+        _stats.records++;
+        return true;
+    }
+
+    // hands the partially filled block to the writer, so that a quiet log still reaches flash
+    void sealActive() {
+        std::lock_guard lock(_mutex);
+        sealLocked();
+    }
+
+    /**
+     * Writes the oldest staged block to the device, returns false if there
+     * was none. Must only be called from one task.
+     */
+    bool writePending() {
+        size_t index = 0;
+        uint16_t used = 0;
+        {
+            std::lock_guard lock(_mutex);
+            if (_sealed == 0) {
+                return false;
+            }
+            index = (_active + STAGING_BLOCKS - _sealed) % STAGING_BLOCKS;
+            used = _used[index];
+        }
+
+        uint8_t* block = stagingBlock(index);
+        std::memset(block + used, 0xFF, BLOCK_SIZE - used);
+
+        std::vector<uint8_t> header;
+        header.reserve(BLOCK_HEADER_SIZE);
+        comm::appendLe<uint32_t>(header, BLOCK_MAGIC);
+        comm::appendLe<uint32_t>(header, _sequence);
+        comm::appendLe<uint16_t>(header, used);
+        comm::appendLe<uint16_t>(header, comm::crc16(std::span<const uint8_t>(block + BLOCK_HEADER_SIZE, used - BLOCK_HEADER_SIZE)));
+        std::memcpy(block, header.data(), header.size());
+
+        const bool ok = _device.write(_nextBlock * BLOCK_SIZE, std::span<const uint8_t>(block, BLOCK_SIZE));
+        _sequence++;
+        _nextBlock = (_nextBlock + 1) % _blockCount;
+
+        std::lock_guard lock(_mutex);
+        _sealed--;
+        if (ok) {
+            _stats.blocksWritten++;
+        }
+        else {
+            _stats.writeErrors++;
+        }
+        return true;
+    }
+
+    size_t validBlocks() {
+        std::vector<uint8_t> block(BLOCK_SIZE);
+        size_t count = 0;
+        for (size_t i = 0; i < _blockCount; ++i) {
+            count += readValidBlock(i, block);
+        }
+        return count;
+    }
+
+    /**
+     * Calls `onBlock(span)` for every valid block on the device, oldest first.
+     * Must run in the writer task.
+     */
+    template <typename OnBlock>
+    void forEachBlock(OnBlock&& onBlock) {
+        std::vector<uint8_t> block(BLOCK_SIZE);
+        for (size_t i = 0; i < _blockCount; ++i) {
+            if (readValidBlock((_nextBlock + i) % _blockCount, block)) {
+                onBlock(std::span<const uint8_t>(block));
+            }
+        }
+    }
+};
+
+
+} // namespace storage
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "esp_timer.h"
+
+#include "protocol/binlog.h"
+#include "blockDevice.h"
+#include "flightLog.h"
+#include "storage.h"
+
+
+namespace storage {
+
+
+/**
+ * Records raw lidar packets, encoder samples and received commands to a
+ * ring file on the storage partition, so a reset, brownout or panic keeps
+ * everything up to the last flush. Recording only copies into RAM; a
+ * low-priority task writes each block to flash once it is full and seals
+ * a partly filled one every `FLUSH_PERIOD_US`, one 4 KiB block at a time,
+ * which keeps the cache stalls of flash writes short and the wear spread
+ * over the whole file. Dumps run in the same task.
+ */
+class FlightRecorder {
+public:
+    // offset of `data` in the dump and the size of the whole dump
+    using DumpCallback = std::function<void(uint32_t offset, uint32_t total, std::span<const uint8_t> data)>;
+
+    static constexpr size_t DUMP_CHUNK_SIZE = 1024;
+
+private:
+    static constexpr const char* PATH = "/storage/flight.log";
+    // about 16 s of lidar packets at 4000 samples/s, commands and encoder samples
+    static constexpr size_t FILE_SIZE = 48 * FlightLog::BLOCK_SIZE;
+    static constexpr int64_t FLUSH_PERIOD_US = 1000 * 1000;
+    // a trigger flushes early, at most this often, each one can cost a partly filled block
+    static constexpr int64_t TRIGGER_MIN_INTERVAL_US = 1000 * 1000;
+    // roughly the time the link needs for one chunk at 921600 baud
+    static constexpr TickType_t DUMP_CHUNK_DELAY = pdMS_TO_TICKS(12);
+
+    FileBlockDevice _device;
+    std::optional<FlightLog> _log;
+    DumpCallback _dumpCallback;
+    TaskHandle_t _task = nullptr;
+    std::atomic<bool> _dumpRequested = false;
+    std::atomic<bool> _flushRequested = false;
+    // only touched by the caller of `trigger`
+    int64_t _lastTriggerUs = -TRIGGER_MIN_INTERVAL_US;
+    int64_t _writeUs = 0;
+
+    void dump() {
+        const uint32_t total = _log->validBlocks() * FlightLog::BLOCK_SIZE;
+        uint32_t offset = 0;
+
+        _log->forEachBlock([&](std::span<const uint8_t> block) {
+            for (size_t i = 0; i < block.size() && offset < total; i += DUMP_CHUNK_SIZE) {
+                _dumpCallback(offset, total, block.subspan(i, DUMP_CHUNK_SIZE));
+                offset += DUMP_CHUNK_SIZE;
+                vTaskDelay(DUMP_CHUNK_DELAY);
+            }
+        });
+
+        if (total == 0) {
+            _dumpCallback(0, 0, {});
+        }
+
+        const auto stats = _log->stats();
+        BINLOG_I("Dumped %lu bytes, records=%lu dropped=%lu blocks=%lu errors=%lu write=%lldus",
+            total, stats.records, stats.dropped, stats.blocksWritten, stats.writeErrors, _writeUs);
+    }
+
+    void writerLoop() {
+        int64_t lastFlushUs = esp_timer_get_time();
+
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20));
+
+            const bool dumpRequested = _dumpRequested.exchange(false);
+            const int64_t now = esp_timer_get_time();
+            const bool flush = _flushRequested.exchange(false) || dumpRequested || now - lastFlushUs >= FLUSH_PERIOD_US;
+            if (flush) {
+                _log->sealActive();
+            }
+
+            const int64_t start = esp_timer_get_time();
+            bool wrote = false;
+            while (_log->writePending()) {
+                wrote = true;
+            }
+            if (flush) {
+                if (wrote) {
+                    _device.flush();
+                }
+                lastFlushUs = now;
+            }
+            _writeUs += esp_timer_get_time() - start;
+
+            if (dumpRequested && _dumpCallback) {
+                dump();
+            }
+        }
+    }
+
+public:
+    FlightRecorder() = default;
+    FlightRecorder(FlightRecorder const&) = delete;
+
+    void begin(DumpCallback dumpCallback) {
+        _dumpCallback = std::move(dumpCallback);
+
+        if (!mount() || !_device.open(PATH, FILE_SIZE)) {
+            BINLOG_W("Flight recorder disabled: cannot open %s", PATH);
+            return;
+        }
+        _log.emplace(_device);
+
+        xTaskCreatePinnedToCore(
+            [](void* arg) {
+                static_cast<FlightRecorder*>(arg)->writerLoop();
+            },
+            "flight_rec", 4096, this, tskIDLE_PRIORITY + 1, &_task, 0
+        );
+    }
+
+    void record(RecordType type, std::span<const uint8_t> payload) {
+        if (_log) {
+            _log->record(type, static_cast<uint32_t>(esp_timer_get_time()), payload);
+        }
+    }
+
+    /**
+     * Flushes what was recorded so far to flash without waiting for the
+     * flush period, for events worth looking at after a reboot. Calls
+     * within `TRIGGER_MIN_INTERVAL_US` of the previous one are ignored.
+     */
+    void trigger() {
+        const int64_t now = esp_timer_get_time();
+        if (now - _lastTriggerUs < TRIGGER_MIN_INTERVAL_US) {
+            return;
+        }
+        _lastTriggerUs = now;
+        _flushRequested = true;
+        if (_task) {
+            xTaskNotifyGive(_task);
+        }
+    }
+
+    // streams the whole ring, oldest block first, through the dump callback
+    void requestDump() {
+        _dumpRequested = true;
+        if (_task) {
+            xTaskNotifyGive(_task);
+        }
+    }
+};
+
+
+} // namespace storage
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_vfs_fat.h"
+#include "wear_levelling.h"
+
+#include "protocol/binlog.h"
+
+
+namespace storage {
+
+// the `storage` FAT partition from partitions-4m.csv
+static constexpr const char* BASE_PATH = "/storage";
+static constexpr const char* PARTITION_LABEL = "storage";
+
+
+/**
+ * Mounts the storage partition, formatting it if it has never been used.
+ * Safe to call more than once.
+ */
+inline bool mount() {
+    static bool mounted = false;
+    static wl_handle_t handle = WL_INVALID_HANDLE;
+
+    if (mounted) {
+        return true;
+    }
+
+    esp_vfs_fat_mount_config_t config = {
+        .format_if_mount_failed = true,
+        .max_files = 4,
+        .allocation_unit_size = 4096,
+    };
+
+    const esp_err_t err = esp_vfs_fat_spiflash_mount_rw_wl(BASE_PATH, PARTITION_LABEL, &config, &handle);
+    if (err != ESP_OK) {
+        BINLOG_W("Failed to mount storage: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    mounted = true;
+    return true;
+}
+
+
+} // namespace storage
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdio>
+
+
+namespace check {
+
+inline int failures = 0;
+
+// exit code of a test executable
+inline int result() {
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+    }
+    return failures != 0;
+}
+
+} // namespace check
+
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++check::failures; \
+        } \
+    } while (0)
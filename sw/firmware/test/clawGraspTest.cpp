@@ -0,0 +1,113 @@
+// ClawGrasp: when a sequence ends with and without current sense, and what it leaves on the claw drivers.
+
+#include <cstdint>
+
+#include "check.h"
+#include "driver/clawGrasp.h"
+
+
+namespace {
+
+Claws makeClaws() {
+    return Claws(
+        GPIO_NUM_0, GPIO_NUM_1, LEDC_TIMER_0, LEDC_CHANNEL_0, LEDC_CHANNEL_1,
+        GPIO_NUM_2, GPIO_NUM_3, LEDC_TIMER_0, LEDC_CHANNEL_2, LEDC_CHANNEL_3
+    );
+}
+
+bool clawsStopped() {
+    for (int channel = LEDC_CHANNEL_0; channel <= LEDC_CHANNEL_3; ++channel) {
+        if (hoststub::ledcDuty[channel] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// updates every millisecond from `startUs`, returns when the sequence ended, -1 if not by `untilUs`
+int64_t runUntilEnd(ClawGrasp& grasp, int64_t startUs, int64_t untilUs) {
+    for (int64_t nowUs = startUs; nowUs <= untilUs; nowUs += 1000) {
+        if (grasp.update(nowUs)) {
+            return nowUs;
+        }
+    }
+    return -1;
+}
+
+void blindOpenStopsAtTheBlindTimeout() {
+    Claws claws = makeClaws();
+    NoClawCurrentSense current;
+    ClawGrasp grasp(claws, current);
+
+    grasp.start(GraspConfig { .action = GraspAction::Open }, 0);
+    const int64_t endUs = runUntilEnd(grasp, 0, 2'000'000);
+    CHECK(endUs == int64_t(ClawGrasp::BLIND_TIMEOUT_MS) * 1000);
+    CHECK(grasp.event().action == GraspAction::Open);
+    CHECK(grasp.event().result == GraspResult::TimedOut);
+    CHECK(grasp.event().durationMs == ClawGrasp::BLIND_TIMEOUT_MS);
+    CHECK(clawsStopped());
+}
+
+void blindCloseHoldsAtTheBlindTimeout() {
+    Claws claws = makeClaws();
+    NoClawCurrentSense current;
+    ClawGrasp grasp(claws, current);
+
+    const GraspConfig config;
+    grasp.start(config, 0);
+    const int64_t endUs = runUntilEnd(grasp, 0, 2'000'000);
+    CHECK(endUs == int64_t(ClawGrasp::BLIND_TIMEOUT_MS) * 1000);
+    CHECK(grasp.event().result == GraspResult::TimedOut);
+    CHECK(!grasp.moving());
+    // a negative duty closes, on channel B of the left claw and channel A of the right one
+    CHECK(hoststub::ledcDuty[LEDC_CHANNEL_1] == uint32_t(-config.holdDuty));
+    CHECK(hoststub::ledcDuty[LEDC_CHANNEL_2] == uint32_t(-config.holdDuty));
+}
+
+void shortTimeoutIsKeptWithoutSense() {
+    Claws claws = makeClaws();
+    NoClawCurrentSense current;
+    ClawGrasp grasp(claws, current);
+
+    grasp.start(GraspConfig { .action = GraspAction::Open, .timeoutMs = 300 }, 0);
+    CHECK(runUntilEnd(grasp, 0, 2'000'000) == 300'000);
+}
+
+void sensedOpenRunsToTheConfiguredTimeout() {
+    Claws claws = makeClaws();
+    FixedClawCurrentSense current;
+    current.milliamps = { 200, 200 };
+    ClawGrasp grasp(claws, current);
+
+    grasp.start(GraspConfig { .action = GraspAction::Open }, 0);
+    CHECK(runUntilEnd(grasp, 0, 2'000'000) == int64_t(GraspConfig {}.timeoutMs) * 1000);
+    CHECK(grasp.event().result == GraspResult::TimedOut);
+    CHECK(grasp.event().peakMa[0] == 200);
+}
+
+void sensedOpenStopsOnStall() {
+    Claws claws = makeClaws();
+    FixedClawCurrentSense current;
+    ClawGrasp grasp(claws, current);
+
+    const GraspConfig config { .action = GraspAction::Open };
+    grasp.start(config, 0);
+    CHECK(runUntilEnd(grasp, 0, 199'000) == -1);
+    current.milliamps = { 900, 900 };
+    const int64_t endUs = runUntilEnd(grasp, 200'000, 2'000'000);
+    CHECK(endUs == 200'000 + int64_t(config.stallMs) * 1000);
+    CHECK(grasp.event().result == GraspResult::Stalled);
+    CHECK(clawsStopped());
+}
+
+} // namespace
+
+
+int main() {
+    blindOpenStopsAtTheBlindTimeout();
+    blindCloseHoldsAtTheBlindTimeout();
+    shortTimeoutIsKeptWithoutSense();
+    sensedOpenRunsToTheConfiguredTimeout();
+    sensedOpenStopsOnStall();
+    return check::result();
+}
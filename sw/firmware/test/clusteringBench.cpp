@@ -0,0 +1,39 @@
+// ScanClusterer::detect per revolution at the sample rates the lidar runs at, against the revolution period at
+// 300 rpm, the deadline the control loop has for it. The scene is the map's room with three bears and a box.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "lidar/clustering.h"
+#include "scanScene.h"
+
+
+int main() {
+    constexpr double RPM = 300.0;
+    constexpr double REVOLUTION_US = 60e6 / RPM;
+    constexpr int ROUNDS = 2000;
+
+    ScanScene scene;
+    scene.addRoom(1500.0, 1200.0, -300.0, 200.0);
+    scene.circles = { { 900.0, 0.0, 50.0 }, { -700.0, 800.0, 50.0 }, { 400.0, -1100.0, 50.0 } };
+    scene.segments.push_back({ 1100.0, 700.0, 1400.0, 700.0 });
+    scene.segments.push_back({ 1100.0, 700.0, 1100.0, 900.0 });
+
+    ScanClusterer clusterer;
+    std::vector<BearCandidate> candidates;
+    candidates.reserve(ScanClusterer::MAX_CANDIDATES);
+    std::printf("%8s %8s %10s %10s %10s\n", "samples", "points", "us/rev", "of period", "candidates");
+    for (int sampleRate : { 2000, 4000, 8000, 10000 }) {
+        const int points = static_cast<int>(sampleRate * 60.0 / RPM);
+        const auto scan = scene.revolution(points, 10.0);
+        const auto began = std::chrono::steady_clock::now();
+        for (int round = 0; round < ROUNDS; ++round) {
+            clusterer.detect(scan, candidates);
+        }
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - began).count() / ROUNDS;
+        std::printf("%8d %8d %10.1f %9.3f%% %10zu\n", sampleRate, points, us, 100.0 * us / REVOLUTION_US, candidates.size());
+    }
+    return 0;
+}
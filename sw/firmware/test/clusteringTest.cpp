@@ -0,0 +1,151 @@
+// ScanClusterer on ray cast revolutions of a room with bears, a flat plate and a box: which segments come out
+// as candidates and where.
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "check.h"
+#include "lidar/clustering.h"
+#include "scanScene.h"
+
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+// 300 rpm at 4000 samples/s
+constexpr int SAMPLES = 800;
+constexpr double BEAR_RADIUS_MM = 50.0;
+
+// the room of the map, the robot off its centre
+ScanScene room() {
+    ScanScene scene;
+    scene.addRoom(1500.0, 1200.0, -300.0, 200.0);
+    return scene;
+}
+
+// the candidate closest to the visible side of the circle, nullptr if none is within `toleranceMm`
+const BearCandidate* near(const std::vector<BearCandidate>& candidates, const ScanScene::Circle& circle, double toleranceMm) {
+    const double centre = std::hypot(circle.x, circle.y);
+    // the centroid of the visible half lies between the front and the centre
+    const double expected = centre - circle.radius * PI / 4.0;
+    const BearCandidate* best = nullptr;
+    double bestError = toleranceMm;
+    for (const auto& candidate : candidates) {
+        const double angle = candidate.angleQ6 * PI / (180.0 * 64.0);
+        const double range = candidate.distanceQ2 / 4.0;
+        const double error = std::hypot(range * std::cos(angle) - expected * circle.x / centre, range * std::sin(angle) - expected * circle.y / centre);
+        if (error <= bestError) {
+            bestError = error;
+            best = &candidate;
+        }
+    }
+    return best;
+}
+
+void findsEveryBearAndNothingElse() {
+    ScanScene scene = room();
+    // one crossing 0 degrees, where the revolution starts
+    scene.circles = {
+        { 900.0, 0.0, BEAR_RADIUS_MM },
+        { -700.0, 800.0, BEAR_RADIUS_MM },
+        { 400.0, -1100.0, BEAR_RADIUS_MM },
+    };
+    // a box too wide for a bear
+    scene.segments.push_back({ 1100.0, 700.0, 1400.0, 700.0 });
+    scene.segments.push_back({ 1100.0, 700.0, 1100.0, 900.0 });
+
+    ScanClusterer clusterer;
+    std::vector<BearCandidate> candidates;
+    for (uint32_t seed = 1; seed <= 20; ++seed) {
+        clusterer.detect(scene.revolution(SAMPLES, 10.0, seed), candidates);
+        CHECK(candidates.size() == scene.circles.size());
+        for (const auto& circle : scene.circles) {
+            const BearCandidate* candidate = near(candidates, circle, 30.0);
+            CHECK(candidate != nullptr);
+            if (candidate != nullptr) {
+                CHECK(candidate->points >= 3);
+                CHECK(candidate->widthMm >= 60 && candidate->widthMm <= 110);
+            }
+        }
+    }
+}
+
+void flatSegmentsAreRejected() {
+    ScanScene scene = room();
+    // a plate as wide as a bear, seen face on and at an angle
+    scene.segments.push_back({ -900.0, -350.0, -900.0, -250.0 });
+    scene.segments.push_back({ 600.0, 600.0, 670.0, 670.0 });
+
+    ScanClusterer clusterer;
+    std::vector<BearCandidate> candidates;
+    // the covariance only tells a plate from a bear while the range noise is small against its width:
+    // at 10 mm the minor axis of a 100 mm plate is above the default ratio
+    clusterer.detect(scene.revolution(SAMPLES, 2.0), candidates);
+    CHECK(candidates.empty());
+}
+
+void bestScoresComeFirstAndAreCapped() {
+    ScanScene scene = room();
+    for (int i = 0; i < 12; ++i) {
+        const double angle = 2.0 * PI * (i + 0.5) / 12.0;
+        scene.circles.push_back({ 800.0 * std::cos(angle), 800.0 * std::sin(angle), BEAR_RADIUS_MM });
+    }
+
+    ScanClusterer clusterer;
+    std::vector<BearCandidate> candidates;
+    clusterer.detect(scene.revolution(SAMPLES, 0.0), candidates);
+    CHECK(candidates.size() == ScanClusterer::MAX_CANDIDATES);
+    for (size_t i = 1; i < candidates.size(); ++i) {
+        CHECK(candidates[i - 1].score >= candidates[i].score);
+    }
+}
+
+void templateSelectsTheSize() {
+    ScanScene scene = room();
+    scene.circles = { { 900.0, 400.0, 2.0 * BEAR_RADIUS_MM } };
+
+    ScanClusterer clusterer;
+    std::vector<BearCandidate> candidates;
+    const auto scan = scene.revolution(SAMPLES, 5.0);
+    clusterer.detect(scan, candidates);
+    CHECK(candidates.empty());
+
+    BearTemplate larger;
+    larger.widthMm = 200;
+    larger.widthToleranceMm = 60;
+    clusterer.setTemplate(larger);
+    clusterer.detect(scan, candidates);
+    CHECK(candidates.size() == 1);
+    CHECK(near(candidates, scene.circles[0], 40.0) != nullptr);
+
+    larger.enabled = false;
+    clusterer.setTemplate(larger);
+    clusterer.detect(scan, candidates);
+    CHECK(candidates.empty());
+}
+
+void outOfRangeBearsAreSkipped() {
+    ScanScene scene;
+    scene.addRoom(4000.0, 4000.0, 0.0, 0.0);
+    scene.circles = { { 3500.0, 0.0, BEAR_RADIUS_MM }, { 0.0, 1500.0, BEAR_RADIUS_MM } };
+
+    ScanClusterer clusterer;
+    std::vector<BearCandidate> candidates;
+    // denser sampling, so the far bear still has enough points
+    clusterer.detect(scene.revolution(4 * SAMPLES, 0.0), candidates);
+    CHECK(candidates.size() == 1);
+    CHECK(near(candidates, scene.circles[1], 30.0) != nullptr);
+}
+
+} // namespace
+
+
+int main() {
+    findsEveryBearAndNothingElse();
+    flatSegmentsAreRejected();
+    bestScoresComeFirstAndAreCapped();
+    templateSelectsTheSize();
+    outOfRangeBearsAreSkipped();
+    return check::result();
+}
@@ -0,0 +1,224 @@
+// CollisionGuard in a simulated drive towards a wall: the lidar sweeps at 300 rpm and 4000 samples/s,
+// packets of 32 samples reach the guard as they complete, the robot follows limit() at once.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "check.h"
+#include "lidar/collisionGuard.h"
+
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double SAMPLE_RATE_HZ = 4000.0;
+constexpr double RPM = 300.0;
+constexpr int SAMPLES_PER_PACKET = 32;
+constexpr int64_t PACKET_US = static_cast<int64_t>(SAMPLES_PER_PACKET * 1e6 / SAMPLE_RATE_HZ);
+constexpr int64_t REVOLUTION_US = static_cast<int64_t>(60e6 / RPM);
+constexpr LidarMount MOUNT = { 60, 0, 0 };
+// robot outline, 300 x 240 mm around its centre
+constexpr int16_t HALF_LENGTH_MM = 150;
+constexpr int16_t HALF_WIDTH_MM = 120;
+
+CollisionGuardConfig config() {
+    CollisionGuardConfig config;
+    config.enabled = true;
+    config.lookaheadMs = 500;
+    config.minPoints = 3;
+    config.clearMs = 250;
+    config.vertices[0] = { HALF_LENGTH_MM, HALF_WIDTH_MM };
+    config.vertices[1] = { -HALF_LENGTH_MM, HALF_WIDTH_MM };
+    config.vertices[2] = { -HALF_LENGTH_MM, -HALF_WIDTH_MM };
+    config.vertices[3] = { HALF_LENGTH_MM, -HALF_WIDTH_MM };
+    config.vertexCount = 4;
+    return config;
+}
+
+/**
+ * The robot drives along +x towards a wall across the path at `wallX`,
+ * or backwards towards one at `rearWallX`.
+ * `step` advances one packet: it samples the wall from the pose at each
+ * sample, hands the packet to the guard and moves the robot at the speed
+ * the guard lets through.
+ */
+struct Simulation {
+    CollisionGuard guard;
+    PointTransform transform;
+    double wallX = 1500.0;
+    double rearWallX = -1e6;
+    double robotX = 0.0;
+    int64_t nowUs = 0;
+    uint64_t sample = 0;
+    int16_t speed = 0;
+
+    Simulation() {
+        guard.setConfig(config());
+        transform.setMount(MOUNT);
+    }
+
+    void command(int16_t leftSpeed, int16_t rightSpeed) {
+        guard.setCommand(leftSpeed, rightSpeed);
+        apply();
+    }
+
+    void apply() {
+        const auto [left, right] = guard.limit();
+        speed = static_cast<int16_t>((left + right) / 2);
+    }
+
+    // gap between the front of the robot and the wall
+    double gapMm() const {
+        return wallX - robotX - HALF_LENGTH_MM;
+    }
+
+    // gap between the back of the robot and the rear wall
+    double rearGapMm() const {
+        return robotX - HALF_LENGTH_MM - rearWallX;
+    }
+
+    bool step() {
+        std::vector<Measurement> packet;
+        for (int i = 0; i < SAMPLES_PER_PACKET; ++i, ++sample) {
+            robotX += speed / SAMPLE_RATE_HZ;
+            const double angleDeg = std::fmod(sample * RPM / 60.0 * 360.0 / SAMPLE_RATE_HZ, 360.0);
+            // the lidar turns clockwise
+            const double direction = -angleDeg * PI / 180.0;
+            const double cos = std::cos(direction);
+            const double range = cos > 1e-3 ? (wallX - robotX - MOUNT.xMm) / cos
+                : cos < -1e-3 ? (rearWallX - robotX - MOUNT.xMm) / cos
+                : 0.0;
+            const bool hit = range > 0.0 && range < 12000.0;
+            packet.push_back({
+                static_cast<uint16_t>(hit ? std::lround(range * 4.0) : 0),
+                static_cast<uint16_t>(std::lround(angleDeg * 64.0) % (360 * 64)),
+            });
+        }
+        nowUs += PACKET_US;
+        const bool changed = guard.check(packet, transform, nowUs);
+        if (changed) {
+            apply();
+        }
+        return changed;
+    }
+
+    // steps until the guard changes state, false if it did not within `timeoutUs`
+    bool runUntilChange(int64_t timeoutUs) {
+        const int64_t end = nowUs + timeoutUs;
+        while (nowUs < end) {
+            if (step()) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+void blocksWithinARevolutionOfTheWallEnteringTheReach() {
+    for (int16_t speed : { 200, 400, 600 }) {
+        Simulation simulation;
+        simulation.command(speed, speed);
+        const double reachMm = speed * config().lookaheadMs / 1000.0;
+
+        int64_t enteredUs = -1;
+        bool blocked = false;
+        while (simulation.nowUs < 20'000'000 && !blocked) {
+            blocked = simulation.step();
+            if (enteredUs < 0 && simulation.gapMm() <= reachMm) {
+                enteredUs = simulation.nowUs;
+            }
+        }
+        CHECK(blocked && simulation.guard.blocked() == 1);
+        const int64_t latencyUs = simulation.nowUs - enteredUs;
+        std::printf(
+            "%d mm/s: blocked %.0f ms after the wall entered the reach, %.0f mm before the wall, %u points\n",
+            speed, latencyUs / 1000.0, simulation.gapMm(), simulation.guard.event().points
+        );
+        // the front of the sweep comes around once a revolution
+        CHECK(latencyUs <= REVOLUTION_US + 2 * PACKET_US);
+        CHECK(simulation.gapMm() > 0.0);
+        CHECK(simulation.speed == 0);
+    }
+}
+
+void slowingDownKeepsTheReach() {
+    Simulation simulation;
+    simulation.command(400, 400);
+    CHECK(simulation.runUntilChange(10'000'000) && simulation.guard.blocked() == 1);
+
+    // a slower move would shrink the polygon off the wall, the block holds anyway
+    simulation.command(100, 100);
+    CHECK(!simulation.runUntilChange(2'000'000));
+    CHECK(simulation.guard.blocked() == 1);
+    CHECK(simulation.speed == 0);
+}
+
+void theReleaseDoesNotResumeTheMove() {
+    Simulation simulation;
+    simulation.command(400, 300);
+    CHECK(simulation.runUntilChange(10'000'000) && simulation.guard.blocked() == 1);
+    CHECK(simulation.guard.limit().first == 50 && simulation.guard.limit().second == -50);
+
+    // the obstacle goes away
+    simulation.wallX = 1e6;
+    CHECK(simulation.runUntilChange(1'000'000) && simulation.guard.blocked() == 0);
+    CHECK(simulation.guard.event().leftSpeed == 400 && simulation.guard.event().rightSpeed == 300);
+    CHECK(simulation.guard.limit().first == 50 && simulation.guard.limit().second == -50);
+    CHECK(simulation.speed == 0);
+
+    simulation.command(400, 400);
+    CHECK(simulation.speed == 400);
+}
+
+void reversingWhileBlockedIsGuarded() {
+    Simulation simulation;
+    // the front block holds for the whole test, as behind an obstacle that stays in the held reach
+    auto holding = config();
+    holding.clearMs = 10'000;
+    simulation.guard.setConfig(holding);
+    simulation.command(400, 400);
+    CHECK(simulation.runUntilChange(10'000'000) && simulation.guard.blocked() == 1);
+
+    // the front wall stays in the held reach, the host backs up towards another one
+    simulation.rearWallX = simulation.robotX - HALF_LENGTH_MM - 600.0;
+    simulation.command(-400, -400);
+    CHECK(simulation.speed == -400);
+    CHECK(simulation.runUntilChange(3'000'000) && simulation.guard.blocked() == -1);
+    CHECK(simulation.guard.event().blocked == -1);
+    CHECK(simulation.guard.event().nearest.x < 0);
+    CHECK(simulation.speed == 0);
+    CHECK(simulation.rearGapMm() > 0.0);
+
+    // forward is guarded again at the speed of the move
+    simulation.command(400, 400);
+    CHECK(simulation.runUntilChange(3'000'000) && simulation.guard.blocked() == 1);
+    CHECK(simulation.gapMm() > 0.0);
+    CHECK(simulation.speed == 0);
+}
+
+void disablingReleasesWithoutResuming() {
+    Simulation simulation;
+    simulation.command(400, 400);
+    CHECK(simulation.runUntilChange(10'000'000) && simulation.guard.blocked() == 1);
+
+    auto disabled = config();
+    disabled.enabled = false;
+    simulation.guard.setConfig(disabled);
+    simulation.apply();
+    CHECK(simulation.guard.blocked() == 0);
+    CHECK(simulation.speed == 0);
+}
+
+} // namespace
+
+
+int main() {
+    blocksWithinARevolutionOfTheWallEnteringTheReach();
+    slowingDownKeepsTheReach();
+    theReleaseDoesNotResumeTheMove();
+    reversingWhileBlockedIsGuarded();
+    disablingReleasesWithoutResuming();
+    return check::result();
+}
@@ -0,0 +1,83 @@
+// CommandLanes: which commands wait for the control loop and in which order they come out.
+
+#include <vector>
+
+#include "check.h"
+#include "comm/command_lanes.h"
+
+using comm::Command;
+using comm::CommandLanes;
+using comm::CommandType;
+
+
+namespace {
+
+Command command(CommandType type, int16_t leftSpeed = 0, int16_t rightSpeed = 0) {
+    Command command;
+    command.type = type;
+    command.leftSpeed = leftSpeed;
+    command.rightSpeed = rightSpeed;
+    return command;
+}
+
+std::vector<Command> drained(CommandLanes& lanes) {
+    std::vector<Command> commands;
+    lanes.drain([&](const Command& command) { commands.push_back(command); });
+    return commands;
+}
+
+void stateChangingCommandsGoThroughTheLanes() {
+    for (auto type : {
+        CommandType::Move, CommandType::Claw, CommandType::Grasp, CommandType::Arm, CommandType::CollisionGuard,
+        CommandType::Subscribe, CommandType::LidarFilter, CommandType::BearTemplate, CommandType::TelemetryConfig,
+        CommandType::MotorTrace, CommandType::LidarOutput, CommandType::LidarMotor,
+    }) {
+        CHECK(CommandLanes::accepts(command(type)));
+    }
+    for (auto type : {
+        CommandType::FieldUploadBegin, CommandType::FieldUploadData, CommandType::FieldUploadEnd,
+        CommandType::ScoreParticles, CommandType::RecorderDump, CommandType::ProfileDump,
+    }) {
+        CHECK(!CommandLanes::accepts(command(type)));
+    }
+}
+
+void configurationKeepsItsOrderBeforeTheNewestMove() {
+    CommandLanes lanes;
+    lanes.push(command(CommandType::Move, 100, 100));
+    lanes.push(command(CommandType::LidarFilter));
+    lanes.push(command(CommandType::LidarMotor));
+    lanes.push(command(CommandType::Move, 200, 150));
+    lanes.push(command(CommandType::TelemetryConfig));
+
+    const auto commands = drained(lanes);
+    CHECK(commands.size() == 4);
+    CHECK(commands.size() == 4 && commands[0].type == CommandType::LidarFilter);
+    CHECK(commands.size() == 4 && commands[1].type == CommandType::LidarMotor);
+    CHECK(commands.size() == 4 && commands[2].type == CommandType::TelemetryConfig);
+    CHECK(commands.size() == 4 && commands[3].type == CommandType::Move && commands[3].leftSpeed == 200);
+    CHECK(drained(lanes).empty());
+
+    const auto stats = lanes.takeStats();
+    CHECK(stats.coalesced == 1);
+    CHECK(stats.dropped == 0);
+}
+
+void aFullActionQueueDropsTheRest() {
+    CommandLanes lanes;
+    for (size_t i = 0; i < CommandLanes::MAX_ACTIONS + 3; ++i) {
+        lanes.push(command(CommandType::BearTemplate));
+    }
+    CHECK(drained(lanes).size() == CommandLanes::MAX_ACTIONS);
+    CHECK(lanes.takeStats().dropped == 3);
+}
+
+} // namespace
+
+
+int main() {
+    stateChangingCommandsGoThroughTheLanes();
+    configurationKeepsItsOrderBeforeTheNewestMove();
+    aFullActionQueueDropsTheRest();
+    return check::result();
+}
@@ -0,0 +1,233 @@
+// coro runtime on SimulatedExecutor: when each kind of wait resumes, in which order, on which clock.
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "protocol/coro.h"
+
+using coro::SimulatedExecutor;
+using coro::Task;
+
+
+namespace {
+
+struct Trace {
+    std::vector<std::string> events;
+
+    void add(const std::string& what, int64_t nowUs) {
+        events.push_back(what + "@" + std::to_string(nowUs));
+    }
+};
+
+void sleepsResumeAtTheirDeadlinesInOrder() {
+    SimulatedExecutor executor;
+    Trace trace;
+    auto sleeper = [&](std::string name, int64_t periodUs, int count) -> Task {
+        for (int i = 0; i < count; ++i) {
+            co_await executor.sleepFor(periodUs);
+            trace.add(name, executor.nowUs());
+        }
+    };
+    executor.spawn(sleeper("a", 300, 3));
+    executor.spawn(sleeper("b", 500, 2));
+    executor.spawn(sleeper("c", 600, 1));
+    executor.runUntil(10'000);
+
+    // equal deadlines resume in the order the waits began: c at 0, a at 300
+    const std::vector<std::string> expected = { "a@300", "b@500", "c@600", "a@600", "a@900", "b@1000" };
+    CHECK(trace.events == expected);
+    CHECK(executor.nowUs() == 10'000);
+}
+
+void untilResumesWhenThePredicateHoldsOrAtTheDeadline() {
+    SimulatedExecutor executor;
+    int value = 0;
+    std::optional<int> seen;
+    bool timedOut = false;
+    int64_t resumedUs = -1;
+
+    auto waiter = [&]() -> Task {
+        seen = co_await executor.until([&]() -> std::optional<int> {
+            return value >= 3 ? std::optional<int>(value) : std::nullopt;
+        });
+        resumedUs = executor.nowUs();
+        timedOut = !(co_await executor.until([&] { return value > 100; }, executor.nowUs() + 2'000));
+    };
+    auto producer = [&]() -> Task {
+        for (int i = 0; i < 5; ++i) {
+            co_await executor.sleepFor(1'000);
+            value++;
+        }
+    };
+    executor.spawn(waiter());
+    executor.spawn(producer());
+    executor.runUntil(20'000);
+
+    CHECK(seen == 3);
+    // checked after the producer's resume at 3 ms, not a tick later
+    CHECK(resumedUs == 3'000);
+    CHECK(timedOut);
+}
+
+void signalWaitReturnsTrueWhenSetAndFalseAtTheDeadline() {
+    SimulatedExecutor executor;
+    coro::Signal signal(executor);
+    std::vector<bool> results;
+    std::vector<int64_t> times;
+
+    auto waiter = [&]() -> Task {
+        for (int i = 0; i < 3; ++i) {
+            results.push_back(co_await signal.wait(executor.nowUs() + 1'000));
+            times.push_back(executor.nowUs());
+        }
+    };
+    auto setter = [&]() -> Task {
+        co_await executor.sleepFor(400);
+        signal.set();
+        // a set nobody waits for yet is kept for the next wait
+        co_await executor.sleepFor(100);
+        signal.set();
+    };
+    executor.spawn(waiter());
+    executor.spawn(setter());
+    executor.runUntil(10'000);
+
+    CHECK(results == std::vector<bool>({ true, true, false }));
+    CHECK(times == std::vector<int64_t>({ 400, 500, 1'500 }));
+    CHECK(!signal.take());
+}
+
+void queueKeepsOrderAndRefusesWhenFull() {
+    SimulatedExecutor executor;
+    coro::Queue<int, 3> queue(executor);
+    CHECK(queue.push(1) && queue.push(2) && queue.push(3));
+    CHECK(!queue.push(4));
+
+    std::vector<int> received;
+    bool timedOut = false;
+    auto receiver = [&]() -> Task {
+        while (true) {
+            auto item = co_await queue.receive(executor.nowUs() + 5'000);
+            if (!item) {
+                timedOut = true;
+                co_return;
+            }
+            received.push_back(*item);
+        }
+    };
+    auto sender = [&]() -> Task {
+        co_await executor.sleepFor(1'000);
+        queue.push(5);
+    };
+    executor.spawn(receiver());
+    executor.spawn(sender());
+    executor.runUntil(100'000);
+
+    CHECK(received == std::vector<int>({ 1, 2, 3, 5 }));
+    CHECK(timedOut);
+}
+
+void awaitedTaskRunsToCompletionFirst() {
+    SimulatedExecutor executor;
+    Trace trace;
+    auto inner = [&]() -> Task {
+        trace.add("inner start", executor.nowUs());
+        co_await executor.sleepFor(250);
+        trace.add("inner end", executor.nowUs());
+    };
+    auto outer = [&]() -> Task {
+        trace.add("outer start", executor.nowUs());
+        co_await inner();
+        trace.add("outer end", executor.nowUs());
+    };
+    executor.spawn(outer());
+    executor.runUntil(1'000);
+
+    const std::vector<std::string> expected = { "outer start@0", "inner start@0", "inner end@250", "outer end@250" };
+    CHECK(trace.events == expected);
+}
+
+void detachedTasksFreeTheirFrames() {
+    static int alive = 0;
+    struct Counted {
+        Counted() { alive++; }
+        ~Counted() { alive--; }
+    };
+
+    SimulatedExecutor executor;
+    auto task = [&]() -> Task {
+        Counted counted;
+        co_await executor.sleepFor(100);
+    };
+    for (int i = 0; i < 4; ++i) {
+        executor.spawn(task());
+    }
+    executor.runUntil(50);
+    CHECK(alive == 4);
+    executor.runUntil(200);
+    CHECK(alive == 0);
+}
+
+void yieldLetsTheOthersRunFirst() {
+    SimulatedExecutor executor;
+    std::string order;
+    auto task = [&](char name) -> Task {
+        for (int i = 0; i < 3; ++i) {
+            order += name;
+            co_await executor.yield();
+        }
+    };
+    executor.spawn(task('a'));
+    executor.spawn(task('b'));
+    executor.runUntil(0);
+    CHECK(order == "ababab");
+    CHECK(executor.nowUs() == 0);
+}
+
+// the same program twice gives the same trace, the clock only moves between deadlines
+void runsAreDeterministic() {
+    auto run = [] {
+        SimulatedExecutor executor;
+        coro::Signal signal(executor);
+        Trace trace;
+        uint32_t seed = 7;
+        auto producer = [&]() -> Task {
+            for (int i = 0; i < 50; ++i) {
+                seed = seed * 1664525u + 1013904223u;
+                co_await executor.sleepFor(100 + (seed >> 20));
+                signal.set();
+            }
+        };
+        auto consumer = [&]() -> Task {
+            while (true) {
+                const bool set = co_await signal.wait(executor.nowUs() + 1'500);
+                trace.add(set ? "set" : "timeout", executor.nowUs());
+            }
+        };
+        executor.spawn(producer());
+        executor.spawn(consumer());
+        executor.runUntil(100'000);
+        return trace.events;
+    };
+    const auto first = run();
+    CHECK(first.size() > 50);
+    CHECK(first == run());
+}
+
+} // namespace
+
+
+int main() {
+    sleepsResumeAtTheirDeadlinesInOrder();
+    untilResumesWhenThePredicateHoldsOrAtTheDeadline();
+    signalWaitReturnsTrueWhenSetAndFalseAtTheDeadline();
+    queueKeepsOrderAndRefusesWhenFull();
+    awaitedTaskRunsToCompletionFirst();
+    detachedTasksFreeTheirFrames();
+    yieldLetsTheOthersRunFirst();
+    runsAreDeterministic();
+    return check::result();
+}
@@ -0,0 +1,163 @@
+// Wakeup latency of the control loop: a coroutine waiting on a coro::Signal against the loop it
+// replaced, which checked its inputs every 1 ms tick (vTaskDelay(1)). Another thread sets the
+// input at random intervals, as the lidar UART events and the receive task do.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "protocol/coro.h"
+
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t nowUsSinceStart() {
+    static const auto start = Clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+// FreeRtosExecutor on a thread: a condition variable instead of the task notification
+class ThreadExecutor: public coro::Executor {
+    std::mutex _mutex;
+    std::condition_variable _woken;
+    bool _pending = false;
+
+protected:
+    void idle(int64_t deadlineUs) override {
+        std::unique_lock lock(_mutex);
+        if (deadlineUs == coro::NO_DEADLINE) {
+            _woken.wait(lock, [&] { return _pending; });
+        }
+        else {
+            _woken.wait_for(lock, std::chrono::microseconds(std::max<int64_t>(deadlineUs - nowUs(), 0)), [&] { return _pending; });
+        }
+        _pending = false;
+    }
+
+public:
+    int64_t nowUs() override {
+        return nowUsSinceStart();
+    }
+
+    void wake() override {
+        {
+            std::lock_guard lock(_mutex);
+            _pending = true;
+        }
+        _woken.notify_one();
+    }
+
+    void runWhile(const std::atomic<bool>& running) {
+        while (running) {
+            idle(poll());
+        }
+    }
+};
+
+struct Result {
+    std::vector<int64_t> latenciesUs;
+    uint64_t iterations = 0;
+    double seconds = 0.0;
+
+    void print(const char* name) {
+        std::sort(latenciesUs.begin(), latenciesUs.end());
+        int64_t sum = 0;
+        for (int64_t latency : latenciesUs) {
+            sum += latency;
+        }
+        const size_t n = latenciesUs.size();
+        std::printf(
+            "%-10s %5zu events: latency mean %6.1f us, p50 %5lld, p99 %5lld, max %6lld; %6.0f loop iterations/s\n",
+            name, n, double(sum) / n, (long long)latenciesUs[n / 2], (long long)latenciesUs[n * 99 / 100],
+            (long long)latenciesUs.back(), iterations / seconds
+        );
+    }
+};
+
+// sets the input `events` times at 0.5 to 5 ms intervals, `set(timeUs)` records when
+template <typename Set>
+void produce(int events, Set&& set) {
+    uint32_t seed = 3;
+    for (int i = 0; i < events; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        std::this_thread::sleep_for(std::chrono::microseconds(500 + (seed >> 8) % 4500));
+        set(nowUsSinceStart());
+    }
+}
+
+Result coroutine(int events) {
+    ThreadExecutor executor;
+    coro::Signal signal(executor);
+    std::atomic<int64_t> setUs = 0;
+    std::atomic<bool> running = true;
+    Result result;
+
+    auto loop = [&]() -> coro::Task {
+        while (running) {
+            // the control loop's idle bound, CONTROL_IDLE_MAX_US
+            if (co_await signal.wait(executor.nowUs() + 10'000)) {
+                result.latenciesUs.push_back(executor.nowUs() - setUs.load());
+            }
+            result.iterations++;
+        }
+    };
+    executor.spawn(loop());
+
+    const auto began = Clock::now();
+    std::thread producer([&] {
+        produce(events, [&](int64_t timeUs) {
+            setUs = timeUs;
+            signal.set();
+        });
+        running = false;
+        executor.wake();
+    });
+    executor.runWhile(running);
+    producer.join();
+    result.seconds = std::chrono::duration<double>(Clock::now() - began).count();
+    return result;
+}
+
+Result polling(int events) {
+    std::atomic<bool> flag = false;
+    std::atomic<int64_t> setUs = 0;
+    std::atomic<bool> running = true;
+    Result result;
+
+    const auto began = Clock::now();
+    std::thread producer([&] {
+        produce(events, [&](int64_t timeUs) {
+            setUs = timeUs;
+            flag = true;
+        });
+        running = false;
+    });
+    while (running) {
+        if (flag.exchange(false)) {
+            result.latenciesUs.push_back(nowUsSinceStart() - setUs.load());
+        }
+        result.iterations++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    producer.join();
+    result.seconds = std::chrono::duration<double>(Clock::now() - began).count();
+    return result;
+}
+
+} // namespace
+
+
+int main() {
+    constexpr int EVENTS = 2000;
+    coroutine(EVENTS).print("signal");
+    polling(EVENTS).print("1 ms poll");
+    return 0;
+}
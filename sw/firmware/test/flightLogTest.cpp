@@ -0,0 +1,169 @@
+// FlightLog on RamBlockDevice: what reaches the device, in which order, and what is lost when.
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "check.h"
+#include "storage/blockDevice.h"
+#include "storage/flightLog.h"
+
+using storage::FlightLog;
+using storage::RamBlockDevice;
+using storage::RecordType;
+
+
+namespace {
+
+struct Record {
+    RecordType type;
+    uint32_t timestampUs;
+    std::vector<uint8_t> payload;
+};
+
+std::vector<Record> readAll(FlightLog& log) {
+    std::vector<Record> records;
+    log.forEachBlock([&](std::span<const uint8_t> block) {
+        const uint16_t used = block[8] | (block[9] << 8);
+        for (size_t offset = FlightLog::BLOCK_HEADER_SIZE; offset < used;) {
+            const uint16_t size = block[offset + 1] | (block[offset + 2] << 8);
+            uint32_t timestampUs = 0;
+            for (int i = 0; i < 4; ++i) {
+                timestampUs |= uint32_t(block[offset + 3 + i]) << (8 * i);
+            }
+            const auto payload = block.subspan(offset + FlightLog::RECORD_HEADER_SIZE, size - FlightLog::RECORD_HEADER_SIZE);
+            records.push_back({ RecordType(block[offset]), timestampUs, { payload.begin(), payload.end() } });
+            offset += size;
+        }
+    });
+    return records;
+}
+
+std::vector<uint8_t> payloadOf(uint32_t index, size_t size) {
+    std::vector<uint8_t> payload(size);
+    for (size_t i = 0; i < size; ++i) {
+        payload[i] = static_cast<uint8_t>(index + i);
+    }
+    return payload;
+}
+
+void writeAll(FlightLog& log) {
+    log.sealActive();
+    while (log.writePending()) {
+    }
+}
+
+void recordsComeBackInOrder() {
+    RamBlockDevice device(8 * FlightLog::BLOCK_SIZE);
+    FlightLog log(device);
+    for (uint32_t i = 0; i < 200; ++i) {
+        CHECK(log.record(RecordType::LidarPacket, i * 250, payloadOf(i, 84)));
+        // the writer keeps up
+        while (log.writePending()) {
+        }
+    }
+    writeAll(log);
+
+    const auto records = readAll(log);
+    CHECK(records.size() == 200);
+    for (uint32_t i = 0; i < records.size(); ++i) {
+        CHECK(records[i].type == RecordType::LidarPacket);
+        CHECK(records[i].timestampUs == i * 250);
+        CHECK(records[i].payload == payloadOf(i, 84));
+    }
+    CHECK(log.stats().dropped == 0);
+}
+
+void wrapKeepsTheNewestBlocks() {
+    RamBlockDevice device(4 * FlightLog::BLOCK_SIZE);
+    FlightLog log(device);
+    // 44 records of 91 bytes fill a block
+    for (uint32_t i = 0; i < 1000; ++i) {
+        log.record(RecordType::LidarPacket, i, payloadOf(i, 84));
+        while (log.writePending()) {
+        }
+    }
+    writeAll(log);
+
+    const auto records = readAll(log);
+    CHECK(log.validBlocks() == 4);
+    CHECK(!records.empty() && records.back().timestampUs == 999);
+    for (size_t i = 1; i < records.size(); ++i) {
+        CHECK(records[i].timestampUs == records[i - 1].timestampUs + 1);
+    }
+    // every block rewritten as often as the others
+    const auto writes = device.sectorWrites();
+    CHECK(device.maxSectorWrites() - *std::min_element(writes.begin(), writes.end()) <= 1);
+}
+
+void recordsAreDroppedWhenTheWriterFallsBehind() {
+    RamBlockDevice device(16 * FlightLog::BLOCK_SIZE);
+    FlightLog log(device);
+    uint32_t accepted = 0;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        accepted += log.record(RecordType::LidarPacket, i, payloadOf(i, 84));
+    }
+    // the active block and the sealed ones, one staging block stays free for the writer
+    const uint32_t perBlock = (FlightLog::BLOCK_SIZE - FlightLog::BLOCK_HEADER_SIZE) / (FlightLog::RECORD_HEADER_SIZE + 84);
+    CHECK(accepted == perBlock * FlightLog::STAGING_BLOCKS);
+    CHECK(log.stats().dropped == 1000 - accepted);
+    CHECK(!log.record(RecordType::Command, 0, payloadOf(0, FlightLog::MAX_RECORD_SIZE + 1)));
+
+    writeAll(log);
+    CHECK(log.record(RecordType::Command, 1000, payloadOf(0, 4)));
+}
+
+void recoveryContinuesAfterTheNewestBlock() {
+    RamBlockDevice device(4 * FlightLog::BLOCK_SIZE);
+    {
+        FlightLog log(device);
+        for (uint32_t i = 0; i < 3; ++i) {
+            log.record(RecordType::Encoders, i, payloadOf(i, 8));
+            writeAll(log);
+        }
+    }
+
+    FlightLog log(device);
+    log.record(RecordType::Encoders, 3, payloadOf(3, 8));
+    writeAll(log);
+    log.record(RecordType::Encoders, 4, payloadOf(4, 8));
+    writeAll(log);
+
+    // the oldest block was overwritten, the rest is in order across the reboot
+    const auto records = readAll(log);
+    CHECK(records.size() == 4);
+    for (uint32_t i = 0; i < records.size(); ++i) {
+        CHECK(records[i].timestampUs == i + 1);
+    }
+}
+
+void corruptedBlocksAreSkipped() {
+    RamBlockDevice device(4 * FlightLog::BLOCK_SIZE);
+    FlightLog log(device);
+    for (uint32_t i = 0; i < 3; ++i) {
+        log.record(RecordType::Command, i, payloadOf(i, 16));
+        writeAll(log);
+    }
+
+    std::vector<uint8_t> byte(1);
+    device.read(FlightLog::BLOCK_SIZE + FlightLog::BLOCK_HEADER_SIZE + 10, byte);
+    byte[0] ^= 0x10;
+    device.write(FlightLog::BLOCK_SIZE + FlightLog::BLOCK_HEADER_SIZE + 10, byte);
+
+    const auto records = readAll(log);
+    CHECK(log.validBlocks() == 2);
+    CHECK(records.size() == 2 && records[0].timestampUs == 0 && records[1].timestampUs == 2);
+}
+
+} // namespace
+
+
+int main() {
+    recordsComeBackInOrder();
+    wrapKeepsTheNewestBlocks();
+    recordsAreDroppedWhenTheWriterFallsBehind();
+    recoveryContinuesAfterTheNewestBlock();
+    corruptedBlocksAreSkipped();
+    return check::result();
+}
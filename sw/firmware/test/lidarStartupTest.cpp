@@ -0,0 +1,142 @@
+// LidarStartup against a scripted lidar on the stub UART: every request is answered at once.
+
+#include <cstdint>
+#include <vector>
+
+#include "check.h"
+#include "driver/lidarStartup.h"
+#include "hostStub.h"
+
+
+namespace {
+
+constexpr uart_port_t PORT = UART_NUM_1;
+
+std::vector<uint8_t> descriptor(uint32_t length, uint8_t mode, uint8_t type) {
+    const uint32_t word = length | (uint32_t(mode) << 30);
+    return { 0xA5, 0x5A, uint8_t(word), uint8_t(word >> 8), uint8_t(word >> 16), uint8_t(word >> 24), type };
+}
+
+std::vector<uint8_t> expressPacket(uint16_t startAngleQ6, bool first) {
+    std::vector<uint8_t> packet(ExpressPacket::SIZE);
+    packet[2] = startAngleQ6 & 0xFF;
+    packet[3] = ((startAngleQ6 >> 8) & 0x7F) | (first ? 0x80 : 0);
+    for (size_t i = 4; i < packet.size(); ++i) {
+        packet[i] = static_cast<uint8_t>(i * 7);
+    }
+    uint8_t checksum = 0;
+    for (size_t i = 2; i < packet.size(); ++i) {
+        checksum ^= packet[i];
+    }
+    packet[0] = 0xA0 | (checksum & 0x0F);
+    packet[1] = 0x50 | (checksum >> 4);
+    return packet;
+}
+
+// answers the requests written so far, the scan descriptor together with `packetsWithDescriptor`
+void answer(const std::vector<std::vector<uint8_t>>& packetsWithDescriptor) {
+    auto& uart = hoststub::uarts[PORT];
+    auto send = [&](const std::vector<uint8_t>& bytes) {
+        uart.rx.insert(uart.rx.end(), bytes.begin(), bytes.end());
+    };
+
+    for (size_t i = 0; i + 1 < uart.tx.size(); ++i) {
+        if (uart.tx[i] != 0xA5) {
+            continue;
+        }
+        switch (uart.tx[i + 1]) {
+            case RpLidar::CMD_RESET:
+                send({ 'R', 'P', ' ', 'L', 'I', 'D', 'A', 'R', '\r', '\n' });
+                break;
+            case RpLidar::CMD_GET_HEALTH:
+                send(descriptor(3, 0, 0x06));
+                send({ 0, 0, 0 });
+                break;
+            case RpLidar::CMD_GET_INFO: {
+                send(descriptor(20, 0, 0x04));
+                std::vector<uint8_t> info(20);
+                info[0] = 0x18;
+                send(info);
+                break;
+            }
+            case RpLidar::CMD_EXPRESS_SCAN:
+                send(descriptor(ExpressPacket::SIZE, 1, RpLidar::CMD_EXPRESS_SCAN));
+                for (const auto& packet : packetsWithDescriptor) {
+                    send(packet);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    uart.tx.clear();
+}
+
+bool runStartup(LidarStartup& startup, const std::vector<std::vector<uint8_t>>& packetsWithDescriptor) {
+    startup.begin();
+    for (int step = 0; step < 2000 && !startup.running() && !startup.failed(); ++step) {
+        hoststub::nowUs += 1000;
+        answer(packetsWithDescriptor);
+        startup.poll();
+    }
+    return startup.running();
+}
+
+void packetsReadWithTheDescriptorAreKept() {
+    hoststub::uarts[PORT] = {};
+    RpLidar lidar(PORT, GPIO_NUM_21, GPIO_NUM_47, GPIO_NUM_14);
+    LidarStartup startup(lidar);
+    const std::vector<std::vector<uint8_t>> packets = { expressPacket(0, true), expressPacket(640, false) };
+
+    CHECK(runStartup(startup, packets));
+    CHECK(startup.report().ok);
+    CHECK(lidar.bufferedBytes() == 2 * ExpressPacket::SIZE);
+
+    // the rest of the stream follows in the UART buffer
+    const auto third = expressPacket(1280, false);
+    hoststub::uarts[PORT].rx.insert(hoststub::uarts[PORT].rx.end(), third.begin(), third.end());
+
+    for (const auto& expected : { packets[0], packets[1], third }) {
+        const auto packet = lidar.readExpressPacket();
+        CHECK(packet.has_value());
+        CHECK(packet && std::vector<uint8_t>(packet->bytes.begin(), packet->bytes.end()) == expected);
+    }
+    CHECK(!lidar.readExpressPacket());
+    CHECK(lidar.takeChecksumErrors() == 0);
+}
+
+void aPartialPacketIsCompletedFromTheUart() {
+    hoststub::uarts[PORT] = {};
+    RpLidar lidar(PORT, GPIO_NUM_21, GPIO_NUM_47, GPIO_NUM_14);
+    LidarStartup startup(lidar);
+    const auto packet = expressPacket(0, true);
+    const std::vector<uint8_t> head(packet.begin(), packet.begin() + 30);
+
+    CHECK(runStartup(startup, { head }));
+    CHECK(!lidar.readExpressPacket());
+
+    hoststub::uarts[PORT].rx.insert(hoststub::uarts[PORT].rx.end(), packet.begin() + 30, packet.end());
+    const auto read = lidar.readExpressPacket();
+    CHECK(read && std::vector<uint8_t>(read->bytes.begin(), read->bytes.end()) == packet);
+}
+
+void aResetDropsHandedBackBytes() {
+    hoststub::uarts[PORT] = {};
+    RpLidar lidar(PORT, GPIO_NUM_21, GPIO_NUM_47, GPIO_NUM_14);
+    LidarStartup startup(lidar);
+
+    CHECK(runStartup(startup, { expressPacket(0, true) }));
+    // a second bring-up starts from an empty input
+    CHECK(runStartup(startup, {}));
+    CHECK(lidar.bufferedBytes() == 0);
+}
+
+} // namespace
+
+
+int main() {
+    packetsReadWithTheDescriptorAreKept();
+    aPartialPacketIsCompletedFromTheUart();
+    aResetDropsHandedBackBytes();
+    return check::result();
+}
@@ -0,0 +1,92 @@
+// LocalGrid per lidar packet and per message, the robot driving through a synthetic 3 m x 2.4 m room, and
+// what the grid leaves on the app_main stack.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "lidar/localGrid.h"
+
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double ROOM_HALF_X_MM = 1500.0;
+constexpr double ROOM_HALF_Y_MM = 1200.0;
+// express scan packets carry 32 measurements
+constexpr size_t PACKET_POINTS = 32;
+
+// distance from (x, y) along `angle` to the room wall
+double wallDistanceMm(double x, double y, double angle) {
+    const double dx = std::cos(angle);
+    const double dy = std::sin(angle);
+    double distance = 1e9;
+    if (dx != 0.0) {
+        distance = std::min(distance, ((dx > 0 ? ROOM_HALF_X_MM : -ROOM_HALF_X_MM) - x) / dx);
+    }
+    if (dy != 0.0) {
+        distance = std::min(distance, ((dy > 0 ? ROOM_HALF_Y_MM : -ROOM_HALF_Y_MM) - y) / dy);
+    }
+    return distance;
+}
+
+// one revolution seen by a lidar at the origin of the robot frame, robot at (x, y) heading 0
+std::vector<Measurement> revolution(double x, double y) {
+    std::vector<Measurement> measurements;
+    for (uint16_t angleQ6 = 0; angleQ6 < 360 * 64; angleQ6 += 32) {
+        // the lidar turns clockwise
+        const double angle = -angleQ6 * PI / (180.0 * 64.0);
+        measurements.push_back({ static_cast<uint16_t>(std::lround(wallDistanceMm(x, y, angle) * 4.0)), angleQ6 });
+    }
+    return measurements;
+}
+
+} // namespace
+
+
+int main() {
+    std::printf("sizeof(LocalGrid) %zu B, cells %zu B on the heap, message buffer %zu B once subscribed\n",
+        sizeof(LocalGrid), LocalGrid::TILE_COUNT * LocalGrid::CELLS_PER_TILE, LocalGrid::MAX_TILES_SIZE);
+
+    PointTransform transform;
+    LocalGrid grid;
+    grid.setPeriod(100);
+
+    // drives 1 m along x in 10 mm steps, a revolution per step
+    constexpr int STEPS = 100;
+    constexpr int16_t STEP_MM = 10;
+    double integrateNs = 0.0;
+    size_t packets = 0;
+    double takeNs = 0.0;
+    size_t messages = 0;
+    size_t tiles = 0;
+    size_t largest = 0;
+    for (int step = 0; step < STEPS; ++step) {
+        const auto measurements = revolution(-500.0 + step * STEP_MM, 0.0);
+        grid.move({ STEP_MM, 0, 0 });
+        for (size_t at = 0; at < measurements.size(); at += PACKET_POINTS) {
+            const size_t count = std::min(PACKET_POINTS, measurements.size() - at);
+            const auto began = std::chrono::steady_clock::now();
+            grid.integrate(std::span(measurements).subspan(at, count), transform);
+            integrateNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - began).count();
+            packets++;
+        }
+
+        // the USB link reports up to its whole TX buffer free, take keeps the message under the transport's limit
+        const auto began = std::chrono::steady_clock::now();
+        grid.take(step * 100'000, 10240, [&](const LocalGridUpdate& update) {
+            messages++;
+            tiles += update.tileCount;
+            largest = std::max(largest, update.tiles.size());
+        });
+        takeNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - began).count();
+    }
+
+    std::printf("integrate: %7.2f us/packet of %zu points\n", integrateNs / packets / 1000.0, PACKET_POINTS);
+    std::printf("take:      %7.2f us/message, %.1f tiles/message, largest %zu B of tiles (limit %zu B)\n",
+        takeNs / std::max<size_t>(messages, 1) / 1000.0, double(tiles) / std::max<size_t>(messages, 1), largest, LocalGrid::MAX_TILES_SIZE);
+    return largest <= LocalGrid::MAX_TILES_SIZE ? 0 : 1;
+}
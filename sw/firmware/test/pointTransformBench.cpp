@@ -0,0 +1,90 @@
+// PointTransform per point, fixed point against single precision sin/cos, and the worst error of
+// both against double precision over a revolution of random ranges.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "lidar/pointTransform.h"
+
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+// what the conversion costs with libm floats, the way it was done before the table
+ScanPointMm toRobotFloat(const LidarMount& mount, const Measurement& measurement) {
+    const float angle = mount.theta * static_cast<float>(PI) / 32768.0f - measurement.angleQ6 * static_cast<float>(PI) / (180.0f * 64.0f);
+    const float distance = measurement.distanceQ2 / 4.0f;
+    return {
+        static_cast<int16_t>(std::lround(mount.xMm + distance * std::cos(angle))),
+        static_cast<int16_t>(std::lround(mount.yMm + distance * std::sin(angle))),
+    };
+}
+
+template <typename Convert>
+double nsPerPoint(const std::vector<Measurement>& measurements, int rounds, Convert&& convert) {
+    volatile int32_t sink = 0;
+    const auto began = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (const auto& measurement : measurements) {
+            const auto point = convert(measurement);
+            sink = sink + point.x + point.y;
+        }
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - began).count();
+    return ns / (double(rounds) * measurements.size());
+}
+
+template <typename Convert>
+double worstErrorMm(const LidarMount& mount, const std::vector<Measurement>& measurements, Convert&& convert) {
+    double worst = 0.0;
+    for (const auto& measurement : measurements) {
+        const double angle = mount.theta * PI / 32768.0 - measurement.angleQ6 * PI / (180.0 * 64.0);
+        const double distance = measurement.distanceQ2 / 4.0;
+        const auto point = convert(measurement);
+        worst = std::max(worst, std::fabs(point.x - (mount.xMm + distance * std::cos(angle))));
+        worst = std::max(worst, std::fabs(point.y - (mount.yMm + distance * std::sin(angle))));
+    }
+    return worst;
+}
+
+} // namespace
+
+
+int main() {
+    const LidarMount mount = { 60, -25, 1200 };
+    PointTransform transform;
+    transform.setMount(mount);
+
+    std::vector<Measurement> measurements;
+    uint32_t seed = 1;
+    for (uint16_t angleQ6 = 0; angleQ6 < 360 * 64; angleQ6 += 8) {
+        seed = seed * 1664525u + 1013904223u;
+        measurements.push_back({ static_cast<uint16_t>(400 + (seed >> 16) % 48000), angleQ6 });
+    }
+
+    auto fixed = [&](const Measurement& measurement) { return transform.toRobot(measurement); };
+    auto floating = [&](const Measurement& measurement) { return toRobotFloat(mount, measurement); };
+    constexpr int ROUNDS = 2000;
+    std::printf("%zu points per revolution\n", measurements.size());
+    std::printf("toRobot, fixed point: %6.2f ns/point, worst error %.3f mm\n", nsPerPoint(measurements, ROUNDS, fixed), worstErrorMm(mount, measurements, fixed));
+    std::printf("float sin/cos:        %6.2f ns/point, worst error %.3f mm\n", nsPerPoint(measurements, ROUNDS, floating), worstErrorMm(mount, measurements, floating));
+
+    std::vector<ScanPointMm> points;
+    points.reserve(measurements.size());
+    for (PoseDelta motion : { PoseDelta {}, PoseDelta { 40, -12, 1500 } }) {
+        const auto began = std::chrono::steady_clock::now();
+        for (int round = 0; round < ROUNDS; ++round) {
+            points.clear();
+            transform.transform(measurements, motion, points);
+        }
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - began).count();
+        std::printf(
+            "transform, %-14s %6.2f ns/point\n", motion.theta ? "compensated:" : "uncompensated:", ns / (double(ROUNDS) * measurements.size())
+        );
+    }
+    return 0;
+}
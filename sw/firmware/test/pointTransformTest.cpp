@@ -0,0 +1,112 @@
+// PointTransform against the same conversion in double precision, over every lidar angle.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "check.h"
+#include "lidar/pointTransform.h"
+
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+struct PointD {
+    double x;
+    double y;
+};
+
+PointD reference(const LidarMount& mount, const Measurement& measurement) {
+    const double angle = mount.theta * PI / 32768.0 - measurement.angleQ6 * PI / (180.0 * 64.0);
+    const double distance = measurement.distanceQ2 / 4.0;
+    return { mount.xMm + distance * std::cos(angle), mount.yMm + distance * std::sin(angle) };
+}
+
+// rounding to millimetres plus the trig table error, 1e-5 of the range
+bool withinBound(ScanPointMm point, PointD expected, double distanceMm) {
+    const double bound = 0.5 + 1e-5 * distanceMm + 1.0 / 256;
+    return std::fabs(point.x - expected.x) <= bound && std::fabs(point.y - expected.y) <= bound;
+}
+
+void trigTableError() {
+    double worst = 0.0;
+    for (uint64_t angle = 0; angle < (uint64_t(1) << 32); angle += 65537) {
+        const double radians = angle * (2.0 * PI / 4294967296.0);
+        worst = std::max(worst, std::fabs(fixedTrig::sinQ30(static_cast<uint32_t>(angle)) / double(1 << 30) - std::sin(radians)));
+        worst = std::max(worst, std::fabs(fixedTrig::cosQ30(static_cast<uint32_t>(angle)) / double(1 << 30) - std::cos(radians)));
+    }
+    CHECK(worst < 1e-5);
+}
+
+void everyAngleAndRange() {
+    const LidarMount mounts[] = { { 0, 0, 0 }, { 60, -25, 0 }, { -40, 10, 16384 }, { 15, 15, -12345 }, { 0, 0, -32768 } };
+    const uint16_t distancesQ2[] = { 1, 600, 4000, 12345, 48000, 65535 };
+    int wrong = 0;
+    for (const auto& mount : mounts) {
+        PointTransform transform;
+        transform.setMount(mount);
+        for (uint16_t angleQ6 = 0; angleQ6 < 360 * 64; ++angleQ6) {
+            for (uint16_t distanceQ2 : distancesQ2) {
+                const Measurement measurement = { distanceQ2, angleQ6 };
+                const auto point = transform.toRobot(measurement);
+                const auto expected = reference(mount, measurement);
+                if (!withinBound(point, expected, distanceQ2 / 4.0)) {
+                    if (wrong++ < 5) {
+                        std::printf(
+                            "mount (%d, %d, %d) angle %u distance %u: (%d, %d), expected (%.3f, %.3f)\n",
+                            mount.xMm, mount.yMm, mount.theta, angleQ6, distanceQ2, point.x, point.y, expected.x, expected.y
+                        );
+                    }
+                }
+            }
+        }
+    }
+    CHECK(wrong == 0);
+}
+
+void motionCompensation() {
+    PointTransform transform;
+    const LidarMount mount = { 60, 0, 0 };
+    transform.setMount(mount);
+    const PoseDelta motion = { 40, -12, 1500 };
+
+    std::vector<Measurement> measurements;
+    for (int i = 0; i < 400; ++i) {
+        measurements.push_back({ static_cast<uint16_t>(i == 17 ? 0 : 2000 + 37 * i), static_cast<uint16_t>(i * 57) });
+    }
+    std::vector<ScanPointMm> points;
+    transform.transform(measurements, motion, points);
+    CHECK(points.size() == measurements.size() - 1);
+
+    const double last = measurements.size() - 1;
+    const double dTheta = motion.theta * PI / 32768.0;
+    size_t out = 0;
+    for (size_t i = 0; i < measurements.size() && out < points.size(); ++i) {
+        if (measurements[i].distanceQ2 == 0) {
+            continue;
+        }
+        const auto p = reference(mount, measurements[i]);
+        const double remaining = (last - i) / last;
+        const double c = std::cos(-remaining * dTheta);
+        const double s = std::sin(-remaining * dTheta);
+        const PointD expected = {
+            c * p.x - s * p.y - remaining * motion.xMm,
+            s * p.x + c * p.y - remaining * motion.yMm,
+        };
+        // the share of the motion is truncated to Q16 once more than in the reference
+        CHECK(std::fabs(points[out].x - expected.x) <= 1.0 && std::fabs(points[out].y - expected.y) <= 1.0);
+        out++;
+    }
+}
+
+} // namespace
+
+
+int main() {
+    trigTableError();
+    everyAngleAndRange();
+    motionCompensation();
+    return check::result();
+}
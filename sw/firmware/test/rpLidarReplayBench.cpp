@@ -0,0 +1,91 @@
+// RpLidar reading and decoding an express scan recorded from the lidar emulator, the way the control loop
+// does: every poll, the bytes that arrived are put on the stub UART and every complete packet is read.
+//
+//   logic/$ python lidar_emulator.py dump --sample-rates 8000 --out scan.bin
+//   test/$ build/rpLidarReplayBench ../../logic/scan.bin
+//
+// `python lidar_emulator.py firmware` runs it over the whole sweep of sample and bit error rates.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "driver/rpLidar.h"
+#include "hostStub.h"
+
+
+namespace {
+
+constexpr uart_port_t PORT = UART_NUM_1;
+
+bool readU32(std::ifstream& in, uint32_t& value) {
+    uint8_t bytes[4];
+    if (!in.read(reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+        return false;
+    }
+    value = bytes[0] | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+    return true;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s SCAN_FILE, written by lidar_emulator.py dump\n", argv[0]);
+        return 2;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    uint32_t pollUs = 0;
+    uint32_t scanned = 0;
+    if (!readU32(in, pollUs) || !readU32(in, scanned) || pollUs == 0) {
+        std::fprintf(stderr, "%s: not a scan file\n", argv[1]);
+        return 2;
+    }
+
+    RpLidar lidar(PORT, GPIO_NUM_21, GPIO_NUM_47, GPIO_NUM_14);
+    auto& rx = hoststub::uarts[PORT].rx;
+    uint64_t polls = 0;
+    uint64_t packets = 0;
+    uint64_t points = 0;
+    uint64_t checksumErrors = 0;
+    double ns = 0.0;
+    std::vector<uint8_t> chunk;
+    uint32_t size = 0;
+    while (readU32(in, size)) {
+        chunk.resize(size);
+        if (!in.read(reinterpret_cast<char*>(chunk.data()), size)) {
+            std::fprintf(stderr, "%s: truncated\n", argv[1]);
+            return 2;
+        }
+        rx.insert(rx.end(), chunk.begin(), chunk.end());
+        hoststub::nowUs += pollUs;
+        polls++;
+
+        const auto began = std::chrono::steady_clock::now();
+        while (auto packet = lidar.readExpressPacket()) {
+            packets++;
+            if (auto measurements = lidar.decodeExpress(*packet)) {
+                points += measurements->size();
+            }
+        }
+        checksumErrors += lidar.takeChecksumErrors();
+        ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - began).count();
+    }
+
+    const double seconds = polls * (pollUs / 1e6);
+    const double scannedPackets = std::max<uint32_t>(scanned, 1);
+    std::printf("%zu polls of %u us, %u packets scanned, %zu read\n", size_t(polls), pollUs, scanned, size_t(packets));
+    std::printf("%9s %9s %9s %8s\n", "points/s", "checksum", "dropped", "us/pkt");
+    std::printf(
+        "%9.0f %8.1f%% %8.1f%% %8.2f\n",
+        points / std::max(seconds, 1e-6),
+        100.0 * checksumErrors / scannedPackets,
+        100.0 * (1.0 - packets / scannedPackets),
+        ns / 1000.0 / std::max<uint64_t>(packets, 1)
+    );
+    return 0;
+}
@@ -0,0 +1,135 @@
+// ScanMatcher on synthetic revolutions of a furnished room: time per match and the error of the
+// recovered motion, for the scan sizes the lidar produces at its sample rates.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "localization/scanMatcher.h"
+
+
+namespace {
+
+struct Segment {
+    double x0, y0, x1, y1;
+};
+
+// a 4 x 3 m room with a cupboard, a table leg and a doorway recess
+const std::vector<Segment> ROOM = {
+    { -2000, -1500, 2000, -1500 }, { 2000, -1500, 2000, 1500 }, { 2000, 1500, -600, 1500 },
+    { -600, 1500, -600, 1800 }, { -600, 1800, -1400, 1800 }, { -1400, 1800, -1400, 1500 },
+    { -1400, 1500, -2000, 1500 }, { -2000, 1500, -2000, -1500 },
+    { 1200, -1500, 1200, -900 }, { 1200, -900, 2000, -900 },
+    { -900, 300, -800, 300 }, { -800, 300, -800, 400 }, { -800, 400, -900, 400 }, { -900, 400, -900, 300 },
+};
+
+struct Pose {
+    double x, y, theta;
+};
+
+double raycast(double ox, double oy, double angle) {
+    const double dx = std::cos(angle);
+    const double dy = std::sin(angle);
+    double best = 0.0;
+    for (const auto& s : ROOM) {
+        const double ex = s.x1 - s.x0;
+        const double ey = s.y1 - s.y0;
+        const double det = dx * -ey + dy * ex;
+        if (std::fabs(det) < 1e-9) {
+            continue;
+        }
+        const double wx = s.x0 - ox;
+        const double wy = s.y0 - oy;
+        const double t = (wx * -ey + wy * ex) / det;
+        const double u = (dx * wy - dy * wx) / det;
+        if (t > 0.0 && u >= 0.0 && u <= 1.0 && (best == 0.0 || t < best)) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+std::vector<Measurement> scan(const Pose& robot, int samples, int16_t mountX, int16_t mountY, uint32_t& seed) {
+    const double ox = robot.x + std::cos(robot.theta) * mountX - std::sin(robot.theta) * mountY;
+    const double oy = robot.y + std::sin(robot.theta) * mountX + std::cos(robot.theta) * mountY;
+    std::vector<Measurement> measurements;
+    for (int i = 0; i < samples; ++i) {
+        const uint16_t angleQ6 = static_cast<uint16_t>(i * 360 * 64 / samples);
+        // the lidar turns clockwise
+        const double range = raycast(ox, oy, robot.theta - angleQ6 * M_PI / (180.0 * 64.0));
+        seed = seed * 1664525u + 1013904223u;
+        const double noise = ((seed >> 16) % 21) - 10.0;
+        measurements.push_back({ static_cast<uint16_t>(range > 0.0 ? (range + noise) * 4.0 : 0.0), angleQ6 });
+    }
+    return measurements;
+}
+
+// `to` seen from `from`, in the robot frame of `from`
+PoseDelta delta(const Pose& from, const Pose& to) {
+    const double dx = to.x - from.x;
+    const double dy = to.y - from.y;
+    const double c = std::cos(from.theta);
+    const double s = std::sin(from.theta);
+    return {
+        static_cast<int16_t>(std::lround(c * dx + s * dy)),
+        static_cast<int16_t>(std::lround(-s * dx + c * dy)),
+        static_cast<int16_t>(std::lround((to.theta - from.theta) / M_PI * 32768.0)),
+    };
+}
+
+void run(int samples, int revolutions) {
+    constexpr int16_t MOUNT_X = 60;
+    constexpr int16_t MOUNT_Y = 0;
+    ScanMatcher matcher(MOUNT_X, MOUNT_Y);
+    uint32_t seed = 1;
+
+    Pose pose { 0.0, 0.0, 0.0 };
+    auto previous = pose;
+    matcher.match(scan(pose, samples, MOUNT_X, MOUNT_Y, seed), {});
+
+    double totalUs = 0.0;
+    double worstUs = 0.0;
+    double errorMm = 0.0;
+    double errorDeg = 0.0;
+    int matched = 0;
+    int iterations = 0;
+    for (int i = 0; i < revolutions; ++i) {
+        // a slow curve through the middle of the room, 20 mm and 1 degree per revolution
+        const double phase = i * 0.02;
+        pose = { 300.0 * std::sin(phase), 200.0 * std::sin(2.0 * phase), 0.3 * std::sin(phase) };
+        const auto measurements = scan(pose, samples, MOUNT_X, MOUNT_Y, seed);
+        const auto truth = delta(previous, pose);
+        previous = pose;
+
+        const auto began = std::chrono::steady_clock::now();
+        const auto result = matcher.match(measurements, {});
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - began).count();
+        totalUs += us;
+        worstUs = std::max(worstUs, us);
+        if (result) {
+            matched++;
+            iterations += result->iterations;
+            errorMm += std::hypot(result->delta.xMm - truth.xMm, result->delta.yMm - truth.yMm);
+            errorDeg += std::fabs(result->delta.theta - truth.theta) * 180.0 / 32768.0;
+        }
+    }
+
+    std::printf(
+        "%5d samples: %7.1f us/match mean, %7.1f worst, %3d/%d matched, %4.1f iterations, error %5.2f mm %5.3f deg\n",
+        samples, totalUs / revolutions, worstUs, matched, revolutions,
+        matched ? double(iterations) / matched : 0.0, matched ? errorMm / matched : 0.0, matched ? errorDeg / matched : 0.0
+    );
+}
+
+} // namespace
+
+
+int main() {
+    std::printf("ScanMatcher, %zu bytes of object, prior zero\n", sizeof(ScanMatcher));
+    for (int samples : { 400, 800, 1600, 3200 }) {
+        run(samples, 300);
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "driver/rpLidar.h"
+
+
+/**
+ * A scene around the lidar for the clustering test and bench: straight
+ * segments (walls, boxes) and circles (bears), in the sensor frame in mm
+ * with angles as ScanClusterer reads them. `revolution` ray casts one
+ * sweep of the lidar into it, with a little range noise.
+ */
+struct ScanScene {
+    struct Segment {
+        double x0, y0, x1, y1;
+    };
+    struct Circle {
+        double x, y, radius;
+    };
+
+    std::vector<Segment> segments;
+    std::vector<Circle> circles;
+
+    // axis-aligned room with the sensor at (`sensorX`, `sensorY`) from its centre
+    void addRoom(double halfX, double halfY, double sensorX, double sensorY) {
+        const double left = -halfX - sensorX;
+        const double right = halfX - sensorX;
+        const double bottom = -halfY - sensorY;
+        const double top = halfY - sensorY;
+        segments.push_back({ left, bottom, right, bottom });
+        segments.push_back({ right, bottom, right, top });
+        segments.push_back({ right, top, left, top });
+        segments.push_back({ left, top, left, bottom });
+    }
+
+    // closest hit along the ray at `angle`, 0 if none
+    double cast(double angle) const {
+        const double dx = std::cos(angle);
+        const double dy = std::sin(angle);
+        double nearest = INFINITY;
+        for (const auto& segment : segments) {
+            const double ex = segment.x1 - segment.x0;
+            const double ey = segment.y1 - segment.y0;
+            const double denominator = dx * ey - dy * ex;
+            if (std::fabs(denominator) < 1e-12) {
+                continue;
+            }
+            const double t = (segment.x0 * ey - segment.y0 * ex) / denominator;
+            const double u = (segment.x0 * dy - segment.y0 * dx) / denominator;
+            if (t > 0.0 && u >= 0.0 && u <= 1.0) {
+                nearest = std::min(nearest, t);
+            }
+        }
+        for (const auto& circle : circles) {
+            const double along = circle.x * dx + circle.y * dy;
+            const double discriminant = along * along - (circle.x * circle.x + circle.y * circle.y - circle.radius * circle.radius);
+            if (discriminant >= 0.0 && along - std::sqrt(discriminant) > 0.0) {
+                nearest = std::min(nearest, along - std::sqrt(discriminant));
+            }
+        }
+        return std::isfinite(nearest) ? nearest : 0.0;
+    }
+
+    // one revolution of `samples` measurements ordered by angle, ranges off by up to `noiseMm`
+    std::vector<Measurement> revolution(int samples, double noiseMm, uint32_t seed = 1) const {
+        constexpr double PI = 3.14159265358979323846;
+        std::vector<Measurement> scan;
+        scan.reserve(samples);
+        for (int i = 0; i < samples; ++i) {
+            const auto angleQ6 = static_cast<uint16_t>(int64_t(i) * 360 * 64 / samples);
+            const double range = cast(angleQ6 * PI / (180.0 * 64.0));
+            seed = seed * 1664525u + 1013904223u;
+            const double noise = noiseMm * ((seed >> 8) / double(1 << 24) * 2.0 - 1.0);
+            const double distanceQ2 = range > 0.0 ? std::round((range + noise) * 4.0) : 0.0;
+            scan.push_back({ static_cast<uint16_t>(std::clamp(distanceQ2, 0.0, 65535.0)), angleQ6 });
+        }
+        return scan;
+    }
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+
+// the part of the DCMotor component the tested modules use: a position and a speed setpoint
+class DCMotor {
+public:
+    int32_t position = 0;
+    int32_t speed = 0;
+    bool running = false;
+
+    int32_t getPosition() const {
+        return position;
+    }
+
+    void setSpeed(int32_t ticksPerSecond) {
+        speed = ticksPerSecond;
+    }
+
+    void moveInfinite() {
+        running = true;
+    }
+
+    void stop(bool) {
+        running = false;
+    }
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "../esp_err.h"
+#include "../freertos/FreeRTOS.h"
+#include "../hostStub.h"
+#include "gpio.h"
+
+typedef enum {
+    UART_NUM_0,
+    UART_NUM_1,
+    UART_NUM_2,
+    UART_NUM_MAX,
+} uart_port_t;
+
+enum { UART_DATA_8_BITS = 3 };
+enum { UART_PARITY_DISABLE = 0 };
+enum { UART_STOP_BITS_1 = 1 };
+enum { UART_HW_FLOWCTRL_DISABLE = 0 };
+enum { UART_SCLK_APB = 1 };
+
+#define UART_PIN_NO_CHANGE (-1)
+
+typedef struct {
+    int baud_rate;
+    int data_bits;
+    int parity;
+    int stop_bits;
+    int flow_ctrl;
+    uint8_t rx_flow_ctrl_thresh;
+    int source_clk;
+} uart_config_t;
+
+inline esp_err_t uart_param_config(uart_port_t, const uart_config_t*) {
+    return ESP_OK;
+}
+
+inline esp_err_t uart_set_pin(uart_port_t, int, int, int, int) {
+    return ESP_OK;
+}
+
+inline esp_err_t uart_driver_install(uart_port_t, int, int, int, QueueHandle_t* queue, int) {
+    if (queue) {
+        *queue = nullptr;
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t uart_set_rx_full_threshold(uart_port_t, int) {
+    return ESP_OK;
+}
+
+inline esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t* size) {
+    *size = hoststub::uarts[port].rx.size();
+    return ESP_OK;
+}
+
+inline int uart_read_bytes(uart_port_t port, void* buffer, uint32_t length, TickType_t) {
+    auto& rx = hoststub::uarts[port].rx;
+    const size_t count = std::min<size_t>(length, rx.size());
+    std::copy_n(rx.begin(), count, static_cast<uint8_t*>(buffer));
+    rx.erase(rx.begin(), rx.begin() + count);
+    return static_cast<int>(count);
+}
+
+inline int uart_write_bytes(uart_port_t port, const void* data, size_t size) {
+    auto& tx = hoststub::uarts[port].tx;
+    tx.insert(tx.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+    return static_cast<int>(size);
+}
+
+inline esp_err_t uart_flush_input(uart_port_t port) {
+    hoststub::uarts[port].rx.clear();
+    return ESP_OK;
+}
+
+inline esp_err_t uart_get_tx_buffer_free_size(uart_port_t, size_t* size) {
+    *size = SIZE_MAX;
+    return ESP_OK;
+}
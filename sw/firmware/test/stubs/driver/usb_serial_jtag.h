@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "../esp_err.h"
+#include "../freertos/FreeRTOS.h"
+#include "../hostStub.h"
+
+typedef struct {
+    uint32_t tx_buffer_size;
+    uint32_t rx_buffer_size;
+} usb_serial_jtag_driver_config_t;
+
+
+namespace hoststub {
+
+// the TX ring buffer of the driver, emptied by the host at `drainBytesPerUs`
+struct UsbSerialJtag {
+    size_t capacity = 0;
+    size_t queued = 0;
+    double drainBytesPerUs = 1.0;
+    int64_t drainedAtUs = 0;
+    bool connected = true;
+
+    void drain() {
+        const auto drained = static_cast<size_t>((nowUs - drainedAtUs) * drainBytesPerUs);
+        if (drained > 0) {
+            queued -= std::min(queued, drained);
+            drainedAtUs = nowUs;
+        }
+    }
+};
+
+inline UsbSerialJtag usbSerialJtag;
+
+} // namespace hoststub
+
+
+inline esp_err_t usb_serial_jtag_driver_install(usb_serial_jtag_driver_config_t* config) {
+    hoststub::usbSerialJtag.capacity = config->tx_buffer_size;
+    return ESP_OK;
+}
+
+inline bool usb_serial_jtag_is_connected() {
+    return hoststub::usbSerialJtag.connected;
+}
+
+inline int usb_serial_jtag_read_bytes(void*, uint32_t, TickType_t) {
+    return 0;
+}
+
+// all or nothing like the ring buffer behind it, waiting (on the stub clock) up to `ticks` for room
+inline int usb_serial_jtag_write_bytes(const void*, size_t size, TickType_t ticks) {
+    auto& usb = hoststub::usbSerialJtag;
+    const int64_t deadline = hoststub::nowUs + static_cast<int64_t>(ticks) * 1000;
+    usb.drain();
+    while (usb.capacity - usb.queued < size && hoststub::nowUs < deadline) {
+        hoststub::nowUs += 100;
+        usb.drain();
+    }
+    if (usb.capacity - usb.queued < size) {
+        return 0;
+    }
+    usb.queued += size;
+    return static_cast<int>(size);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+inline BaseType_t xQueueReceive(QueueHandle_t, void*, TickType_t) {
+    return pdFALSE;
+}
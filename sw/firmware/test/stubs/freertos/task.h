@@ -0,0 +1,25 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "../hostStub.h"
+
+// a tick is a millisecond of the stub clock
+inline TickType_t xTaskGetTickCount() {
+    return static_cast<TickType_t>(hoststub::nowUs / 1000);
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    hoststub::nowUs += static_cast<int64_t>(ticks) * 1000;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t, TaskHandle_t*, BaseType_t) {
+    return pdPASS;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) {
+    return 0;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t) {
+    return pdPASS;
+}
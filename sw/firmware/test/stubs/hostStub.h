@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+
+/**
+ * State behind the ESP-IDF stubs, driven by the host tests: the clock
+ * esp_timer_get_time() reads and the bytes on both sides of every UART.
+ */
+namespace hoststub {
+
+inline int64_t nowUs = 0;
+
+struct Uart {
+    // received by the ESP32, read with uart_read_bytes
+    std::deque<uint8_t> rx;
+    // written with uart_write_bytes
+    std::vector<uint8_t> tx;
+};
+
+inline Uart uarts[3];
+
+} // namespace hoststub
@@ -0,0 +1,166 @@
+// FramedTransport over the in-memory loopback: throughput and round trip in both framings. Then
+// the TX free estimate of UsbSerialJtagStream against a stub driver drained at a fixed rate, with
+// a producer that only sends what txFree says fits, as the main loop does.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "comm/transport.h"
+#include "protocol/loopback.h"
+
+using comm::FramedTransport;
+using comm::Framing;
+
+
+namespace {
+
+// both ends with their receive loops running, in `framing`
+struct Link {
+    FramedTransport a;
+    FramedTransport b;
+    std::atomic<bool> running = true;
+    std::thread rxA;
+    std::thread rxB;
+
+    Link(std::pair<std::unique_ptr<comm::ByteStream>, std::unique_ptr<comm::ByteStream>> streams):
+        a(std::move(streams.first)),
+        b(std::move(streams.second))
+    {}
+
+    void start(Framing framing) {
+        rxA = std::thread([this] { while (running) a.receive(5); });
+        rxB = std::thread([this] { while (running) b.receive(5); });
+        if (framing != Framing::V1) {
+            a.requestFraming(framing);
+            while (b.framing() != framing) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+    }
+
+    ~Link() {
+        running = false;
+        rxA.join();
+        rxB.join();
+    }
+};
+
+void throughput(Framing framing, size_t payloadSize, int frames) {
+    Link link(comm::makeLoopbackPair());
+    std::atomic<int> received = 0;
+    link.b.setReceiveCallback([&](std::span<const uint8_t>) { received++; });
+    link.start(framing);
+
+    std::vector<uint8_t> payload(payloadSize);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<uint8_t>(i * 31);
+    }
+
+    const auto began = std::chrono::steady_clock::now();
+    int sent = 0;
+    while (sent < frames) {
+        // like the firmware producers, only what fits
+        if (link.a.txFree() >= payloadSize + 16 && link.a.send(payload)) {
+            sent++;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    while (received < frames) {
+        std::this_thread::yield();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+    std::printf(
+        "v%d %5zu B payloads: %9.0f frames/s, %7.2f MB/s of payload, %u dropped\n",
+        static_cast<int>(framing), payloadSize, frames / seconds, frames * payloadSize / seconds / 1e6, link.a.txDropped()
+    );
+}
+
+void roundTrip(Framing framing, size_t payloadSize, int trips) {
+    Link link(comm::makeLoopbackPair());
+    std::atomic<int> echoed = 0;
+    link.b.setReceiveCallback([&](std::span<const uint8_t> payload) { link.b.send(payload); });
+    link.a.setReceiveCallback([&](std::span<const uint8_t>) { echoed++; });
+    link.start(framing);
+
+    const std::vector<uint8_t> payload(payloadSize, 0x55);
+    const auto began = std::chrono::steady_clock::now();
+    for (int i = 0; i < trips; ++i) {
+        link.a.send(payload);
+        while (echoed <= i) {
+            std::this_thread::yield();
+        }
+    }
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - began).count();
+    std::printf("v%d %5zu B payloads: %7.1f us round trip\n", static_cast<int>(framing), payloadSize, us / trips);
+}
+
+/**
+ * One second of a producer offering a `frameSize` frame every 500 us while
+ * txFree allows, over a host that drains `drainBytesPerUs`. `trustFull`
+ * replaces the estimate with the whole buffer, what txFree used to report.
+ */
+void usbEstimate(double drainBytesPerUs, size_t frameSize, bool trustFull) {
+    hoststub::nowUs = 0;
+    hoststub::usbSerialJtag = {};
+    hoststub::usbSerialJtag.drainBytesPerUs = drainBytesPerUs;
+    comm::UsbSerialJtagStream stream(4096, 10240);
+
+    const std::vector<uint8_t> frame(frameSize);
+    int sent = 0;
+    int dropped = 0;
+    int64_t blockedUs = 0;
+    double errorBytes = 0.0;
+    int samples = 0;
+    while (hoststub::nowUs < 1'000'000) {
+        const size_t free = trustFull ? 10240 : stream.txFree();
+        hoststub::usbSerialJtag.drain();
+        const size_t real = hoststub::usbSerialJtag.capacity - hoststub::usbSerialJtag.queued;
+        errorBytes += std::abs(static_cast<double>(free) - static_cast<double>(real));
+        samples++;
+
+        if (free >= frameSize) {
+            const int64_t began = hoststub::nowUs;
+            if (stream.write(frame) == frameSize) {
+                sent++;
+            }
+            else {
+                dropped++;
+            }
+            blockedUs += hoststub::nowUs - began;
+        }
+        hoststub::nowUs += 500;
+    }
+    std::printf(
+        "%-8s drain %4.2f B/us, %4zu B frames: %5d sent, %3d dropped, %6.1f ms blocked in write, txFree off by %5.0f B\n",
+        trustFull ? "full" : "estimate", drainBytesPerUs, frameSize, sent, dropped, blockedUs / 1000.0, errorBytes / samples
+    );
+}
+
+} // namespace
+
+
+int main() {
+    for (auto framing : { Framing::V1, Framing::V2 }) {
+        for (size_t payloadSize : { 16, 256, 2048 }) {
+            throughput(framing, payloadSize, static_cast<int>(4'000'000 / (payloadSize + 64)));
+        }
+    }
+    for (auto framing : { Framing::V1, Framing::V2 }) {
+        for (size_t payloadSize : { 16, 2048 }) {
+            roundTrip(framing, payloadSize, 2000);
+        }
+    }
+    for (bool trustFull : { true, false }) {
+        for (double drain : { 0.0, 0.1, 0.5, 2.0 }) {
+            usbEstimate(drain, 512, trustFull);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+"""
+Decode time of measurements payloads, the pure Python path of `BinarySerializer` against the
+native protocol library, for polar and Cartesian frames of growing point counts, and of the
+other telemetry messages, which are decoded through the layouts of `comm.wire`.
+
+The library is the one built by setup.py, or compiled here with g++ into a temporary directory
+when it is missing. Run from logic/: python -m bench.measurements_decode_bench
+"""
+
+from __future__ import annotations
+
+import ctypes
+import shutil
+import subprocess
+import tempfile
+import time
+from pathlib import Path
+from typing import Optional
+
+from comm import native_protocol
+from comm.binary_serializer import BinarySerializer
+from tests.test_binary_serializer import _TELEMETRY, _measurements
+
+_PROTOCOL = Path(__file__).resolve().parents[2] / "protocol"
+
+
+def _native_library(directory: str) -> Optional[ctypes.CDLL]:
+    if native_protocol._lib is not None:
+        return native_protocol._lib
+    compiler = shutil.which("g++")
+    if compiler is None:
+        return None
+    path = Path(directory) / "_protocol.so"
+    subprocess.run(
+        [compiler, "-O3", "-std=c++20", "-shared", "-fPIC", f"-I{_PROTOCOL / 'include'}",
+         str(_PROTOCOL / "src/host_api.cpp"), "-o", str(path)],
+        check=True,
+    )
+    return native_protocol._load(str(path))
+
+
+def _time_per_decode(data: bytes, library: Optional[ctypes.CDLL], repeats: int) -> float:
+    native_protocol._lib = library
+    BinarySerializer.deserialize_telemetry(data)
+    # best of five, the machine is rarely quiet
+    best = float("inf")
+    for _ in range(5):
+        began = time.perf_counter()
+        for _ in range(repeats):
+            BinarySerializer.deserialize_telemetry(data)
+        best = min(best, (time.perf_counter() - began) / repeats)
+    return best
+
+
+def main() -> None:
+    with tempfile.TemporaryDirectory() as directory:
+        library = _native_library(directory)
+        saved = native_protocol._lib
+        try:
+            print(f"{'frame':>9} {'points':>6} {'python us':>10} {'native us':>10}")
+            for cartesian in (False, True):
+                for points in (0, 64, 256, 1024, 4096):
+                    data = BinarySerializer.serialize_measurements(_measurements(points, cartesian))
+                    repeats = max(200, 200_000 // max(points, 1))
+                    python = _time_per_decode(data, None, repeats)
+                    native = _time_per_decode(data, library, repeats) if library is not None else float("nan")
+                    frame = "cartesian" if cartesian else "polar"
+                    print(f"{frame:>9} {points:6d} {python * 1e6:10.1f} {native * 1e6:10.1f}")
+
+            print(f"\n{'message':>20} {'python us':>10}")
+            for data, expected in _TELEMETRY:
+                print(f"{type(expected).__name__:>20} {_time_per_decode(data, None, 20_000) * 1e6:10.2f}")
+        finally:
+            native_protocol._lib = saved
+
+
+if __name__ == "__main__":
+    main()
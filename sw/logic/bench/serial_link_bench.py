@@ -0,0 +1,137 @@
+"""
+Throughput and recovery of the host side of the serial link, framing v1 against v2:
+- decode throughput of `SerialTransport` over a recorded byte stream,
+- share of frames received intact when bytes of the stream are corrupted,
+- time from a firmware reboot to the first telemetry frame after the link negotiated v2 again.
+
+Run from logic/: python -m bench.serial_link_bench
+"""
+
+from __future__ import annotations
+
+import random
+import threading
+import time
+from unittest import mock
+
+from comm import serial_transport
+from comm.serial_transport import FRAMING_V1, FRAMING_V2, SerialTransport
+from tests.firmware_link import FirmwareLink
+
+
+class _Replay:
+    """Plays back a byte stream through the `serial.Serial` read interface."""
+
+    def __init__(self, data: bytes, chunk: int = 256) -> None:
+        self._data = data
+        self._offset = 0
+        self._chunk = chunk
+
+    @property
+    def in_waiting(self) -> int:
+        return min(self._chunk, len(self._data) - self._offset)
+
+    def read(self, size: int = 1) -> bytes:
+        size = min(size, self._chunk)
+        data = self._data[self._offset : self._offset + size]
+        self._offset += len(data)
+        return data
+
+    def done(self) -> bool:
+        return self._offset >= len(self._data)
+
+
+def _stream(framing: int, payloads: list[bytes]) -> bytes:
+    encode = SerialTransport._frame_payload_v2 if framing == FRAMING_V2 else SerialTransport._frame_payload
+    return b"".join(encode(nonce & 0xFF, payload) for nonce, payload in enumerate(payloads))
+
+
+def _decode(framing: int, data: bytes) -> list[bytes]:
+    transport = SerialTransport("replay", framing=framing)
+    replay = _Replay(data)
+    transport._serial = replay
+    transport._running = True
+    payloads: list[bytes] = []
+    while not replay.done():
+        if framing == FRAMING_V2:
+            payloads.extend(transport._read_frames_v2())
+        else:
+            payload = transport._read_frame()
+            if payload is not None:
+                payloads.append(payload)
+    return payloads
+
+
+def _corrupt(data: bytes, byte_error_rate: float, rng: random.Random) -> bytes:
+    return bytes(byte ^ (1 << rng.randrange(8)) if rng.random() < byte_error_rate else byte for byte in data)
+
+
+def throughput(payload_size: int, frames: int) -> None:
+    payloads = [bytes((i + j) & 0xFF for j in range(payload_size)) for i in range(frames)]
+    for framing in (FRAMING_V1, FRAMING_V2):
+        data = _stream(framing, payloads)
+        began = time.perf_counter()
+        decoded = _decode(framing, data)
+        elapsed = time.perf_counter() - began
+        assert decoded == payloads
+        print(
+            f"v{framing} {payload_size:5d} B payloads: {frames / elapsed:8.0f} frames/s, "
+            f"{len(data) / elapsed / 1e6:6.2f} MB/s on the wire, {len(data) / frames - payload_size:4.1f} B overhead"
+        )
+
+
+def corruption(byte_error_rate: float, payload_size: int, frames: int) -> None:
+    payloads = [bytes((i + j) & 0xFF for j in range(payload_size)) for i in range(frames)]
+    results = []
+    for framing in (FRAMING_V1, FRAMING_V2):
+        data = _corrupt(_stream(framing, payloads), byte_error_rate, random.Random(1))
+        decoded = _decode(framing, data)
+        wrong = sum(1 for payload in decoded if payload not in payloads)
+        results.append(f"v{framing} {len(decoded) - wrong:5d} intact, {wrong} wrong")
+    print(f"byte error rate {byte_error_rate:.0e}, {frames} frames: " + "; ".join(results))
+
+
+class _Arrival:
+    def __init__(self) -> None:
+        self.event = threading.Event()
+
+    def on_message(self, data: bytes) -> None:
+        self.event.set()
+
+    def on_error(self, error: Exception) -> None:
+        pass
+
+
+def reboot_recovery(silence_timeout: float, boot_s: float) -> None:
+    link = FirmwareLink(boot_s=0.0)
+    with mock.patch.object(serial_transport.serial, "Serial", lambda **_: link):
+        transport = SerialTransport("fake", silence_timeout=silence_timeout)
+        transport.connect()
+    arrival = _Arrival()
+    transport.start_receiving(arrival)
+    try:
+        time.sleep(0.1)
+        link.reboot(boot_s=boot_s)
+        rebooted = time.monotonic()
+        time.sleep(boot_s / 2)
+        arrival.event.clear()
+        arrival.event.wait(10.0)
+        print(
+            f"silence timeout {silence_timeout:.2f} s, boot {boot_s:.2f} s: telemetry back after "
+            f"{time.monotonic() - rebooted:.2f} s, {transport.renegotiations} request(s)"
+        )
+    finally:
+        transport.close()
+
+
+def main() -> None:
+    for payload_size in (16, 128, 1024):
+        throughput(payload_size, frames=max(200, 400_000 // payload_size))
+    for byte_error_rate in (1e-4, 1e-3, 1e-2):
+        corruption(byte_error_rate, payload_size=128, frames=2000)
+    for silence_timeout in (0.25, 0.5, 1.0):
+        reboot_recovery(silence_timeout, boot_s=0.3)
+
+
+if __name__ == "__main__":
+    main()
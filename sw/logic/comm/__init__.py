@@ -5,9 +5,59 @@ from .messages import (
     MoveCommand,
     ClawCommand,
     ArmCommand,
+    LidarFilterCommand,
+    BearTemplateCommand,
+    FieldUploadBeginCommand,
+    FieldUploadDataCommand,
+    FieldUploadEndCommand,
+    ScoreParticlesCommand,
+    RecorderDumpCommand,
+    LidarMotorCommand,
+    TelemetryConfigCommand,
+    ProfileDumpCommand,
+    LidarOutputCommand,
+    MotorTraceCommand,
+    CollisionGuardCommand,
+    SubscribeCommand,
+    GraspCommand,
+    GRASP_STOP,
+    GRASP_CLOSE,
+    GRASP_OPEN,
+    GRASP_STALLED,
+    GRASP_TIMED_OUT,
+    GRASP_ABORTED,
+    STREAM_MEASUREMENTS,
+    STREAM_ENCODERS,
+    STREAM_LIDAR_MOTOR,
+    STREAM_COLLISION_GUARD,
+    STREAM_LINK,
+    STREAM_LOCAL_GRID,
+    STREAM_OFF,
+    STREAM_ON_CHANGE,
+    LidarFilterStats,
+    CommandLaneStats,
+    LidarBatchStats,
     LidarMeasurement,
+    LidarPoints,
     EncodersMeasurement,
     Measurements,
+    BearCandidate,
+    BearCandidates,
+    ParticleScores,
+    FieldUploadResult,
+    RecorderChunk,
+    LidarStartupReport,
+    ScanMatch,
+    ProfileSection,
+    LogRecord,
+    LogBatch,
+    MotorTraceChunk,
+    GuardEvent,
+    LidarRawPackets,
+    StreamSample,
+    LocalGridTiles,
+    GraspEvent,
+    Telemetry,
 )
 from .binary_serializer import BinarySerializer
 from .json_serializer import JsonSerializer
@@ -17,15 +67,70 @@ from .replay_transport import ReplayTransport
 from .serial_transport import SerialTransport
 from .udp_transport import UdpTransport
 from .controller import Controller
+from .express_decoder import ExpressDecoder, ExpressPacketReader
+from .local_grid import LocalGridMap
+from .field_upload import field_upload_commands
+from .flight_log import FlightRecord, parse_flight_log
+from .log_format import LogFormatter
 
 __all__ = [
     "Command",
     "MoveCommand",
     "ClawCommand",
     "ArmCommand",
+    "LidarFilterCommand",
+    "BearTemplateCommand",
+    "FieldUploadBeginCommand",
+    "FieldUploadDataCommand",
+    "FieldUploadEndCommand",
+    "ScoreParticlesCommand",
+    "RecorderDumpCommand",
+    "LidarMotorCommand",
+    "TelemetryConfigCommand",
+    "ProfileDumpCommand",
+    "LidarOutputCommand",
+    "MotorTraceCommand",
+    "CollisionGuardCommand",
+    "SubscribeCommand",
+    "GraspCommand",
+    "GRASP_STOP",
+    "GRASP_CLOSE",
+    "GRASP_OPEN",
+    "GRASP_STALLED",
+    "GRASP_TIMED_OUT",
+    "GRASP_ABORTED",
+    "STREAM_MEASUREMENTS",
+    "STREAM_ENCODERS",
+    "STREAM_LIDAR_MOTOR",
+    "STREAM_COLLISION_GUARD",
+    "STREAM_LINK",
+    "STREAM_LOCAL_GRID",
+    "STREAM_OFF",
+    "STREAM_ON_CHANGE",
+    "LidarFilterStats",
+    "CommandLaneStats",
+    "LidarBatchStats",
     "LidarMeasurement",
+    "LidarPoints",
     "EncodersMeasurement",
     "Measurements",
+    "BearCandidate",
+    "BearCandidates",
+    "ParticleScores",
+    "FieldUploadResult",
+    "RecorderChunk",
+    "LidarStartupReport",
+    "ScanMatch",
+    "ProfileSection",
+    "LogRecord",
+    "LogBatch",
+    "MotorTraceChunk",
+    "GuardEvent",
+    "LidarRawPackets",
+    "StreamSample",
+    "LocalGridTiles",
+    "GraspEvent",
+    "Telemetry",
     "BinarySerializer",
     "JsonSerializer",
     "Serializer",
@@ -36,4 +141,11 @@ __all__ = [
     "SerialTransport",
     "UdpTransport",
     "Controller",
+    "ExpressDecoder",
+    "ExpressPacketReader",
+    "LocalGridMap",
+    "field_upload_commands",
+    "FlightRecord",
+    "parse_flight_log",
+    "LogFormatter",
 ]
@@ -1,38 +1,237 @@
 from __future__ import annotations
 
-import struct
+import math
 
+import numpy as np
+
+from . import native_protocol, wire
+from .log_format import decode_args as decode_log_args
 from .messages import (
+    BearCandidate,
+    BearCandidates,
+    BearTemplateCommand,
     ClawCommand,
+    CollisionGuardCommand,
     Command,
     EncodersMeasurement,
-    LidarMeasurement,
+    FieldUploadBeginCommand,
+    FieldUploadDataCommand,
+    FieldUploadEndCommand,
+    FieldUploadResult,
+    GraspCommand,
+    GraspEvent,
+    GuardEvent,
+    LidarFilterCommand,
+    CommandLaneStats,
+    LidarBatchStats,
+    LidarFilterStats,
+    LidarMotorCommand,
+    LidarOutputCommand,
+    LidarRawPackets,
+    LidarStartupReport,
+    LocalGridTiles,
+    LogBatch,
+    LogRecord,
+    LidarPoints,
     Measurements,
+    MotorTraceChunk,
+    MotorTraceCommand,
     MoveCommand,
     ArmCommand,
+    ParticleScores,
+    ProfileDumpCommand,
+    ProfileSection,
+    RecorderChunk,
+    RecorderDumpCommand,
+    ScanMatch,
+    ScoreParticlesCommand,
+    STREAM_ON_CHANGE,
+    StreamSample,
+    SubscribeCommand,
+    Telemetry,
+    TelemetryConfigCommand,
 )
 
 
+# float32 scales of the native decoder (protocol/src/host_api.cpp), computed in float32 like there
+_RAD_PER_ANGLE_Q6 = np.float32(-1.0) / (np.float32(64) * np.float32(57.295779513))
+_M_PER_DISTANCE_Q2 = np.float32(1.0) / (np.float32(4) * np.float32(1000.0))
+_M_PER_MM = np.float32(1.0) / np.float32(1000.0)
+
+_LIDAR_RAW_PACKET = np.dtype(wire.LIDAR_RAW_PACKET_FIELDS.dtype.descr + [("bytes", "u1", (wire.LIDAR_RAW_PACKET_SIZE,))])
+
+
+def _command(command_type: int, layout: wire.Layout, *values: int) -> bytes:
+    return bytes((command_type,)) + layout.pack(*values)
+
+
+def _unpack_command(layout: wire.Layout, data: bytes, variable: bool = False):
+    """The fields after the type byte; unless `variable`, the payload has to end with them."""
+    if len(data) - 1 < layout.size or (not variable and len(data) - 1 != layout.size):
+        raise ValueError(f"{layout.name}: {len(data) - 1} bytes after the type byte, expected {layout.size}")
+    return layout.unpack_from(data, 1)
+
+
+def _unpack_optional(layout: wire.Layout, data: bytes, offset: int):
+    """The fields at `offset` in order and the offset after them, None if an older firmware's payload ends before."""
+    if len(data) - offset < layout.size:
+        return None, offset
+    return layout.struct.unpack_from(data, offset), offset + layout.size
+
+
+def _wrap_q15(angle: float) -> int:
+    wrapped = (angle + math.pi) % (2 * math.pi) - math.pi
+    return max(-32768, min(32767, round(wrapped / math.pi * 32768)))
+
+
+
+
 class BinarySerializer:
-    _COMMAND_MOVE = 1
-    _COMMAND_CLAW = 2
-    _COMMAND_ARM = 3
+    """Binary payloads of the firmware link, laid out by the field tables of protocol/wire.h (`comm.wire`)."""
 
     @staticmethod
     def serialize_command(command: Command) -> bytes:
         if isinstance(command, MoveCommand):
-            payload = struct.pack("<Bhh", BinarySerializer._COMMAND_MOVE, round(command.left_speed * 1000), round(command.right_speed * 1000))
-            return payload
+            return _command(
+                wire.COMMAND_MOVE,
+                wire.COMMAND_MOVE_FIELDS,
+                round(command.left_speed * 1000),
+                round(command.right_speed * 1000),
+            )
 
         if isinstance(command, ClawCommand):
-            return struct.pack(
-                "<Bh",
-                BinarySerializer._COMMAND_CLAW,
-                command.pwm,
-            )
+            return _command(wire.COMMAND_CLAW, wire.COMMAND_CLAW_FIELDS, command.pwm)
 
         if isinstance(command, ArmCommand):
-            return struct.pack("<B", BinarySerializer._COMMAND_ARM)
+            return bytes((wire.COMMAND_ARM,))
+
+        if isinstance(command, LidarFilterCommand):
+            flags = wire.LIDAR_FILTER_DROP_INVALID if command.drop_invalid else 0
+            max_distance = 0 if command.max_distance is None else max(1, round(command.max_distance * 1000))
+            return _command(
+                wire.COMMAND_LIDAR_FILTER,
+                wire.COMMAND_LIDAR_FILTER_FIELDS,
+                flags,
+                min(round(command.min_distance * 1000), 0xFFFF),
+                min(max_distance, 0xFFFF),
+                command.min_quality,
+            )
+
+        if isinstance(command, BearTemplateCommand):
+            return _command(
+                wire.COMMAND_BEAR_TEMPLATE,
+                wire.COMMAND_BEAR_TEMPLATE_FIELDS,
+                wire.BEAR_TEMPLATE_ENABLED if command.enabled else 0,
+                round(command.jump * 1000),
+                round(command.max_gap * 64),
+                command.min_points,
+                round(command.width * 1000),
+                round(command.width_tolerance * 1000),
+                round(command.min_range * 1000),
+                round(command.max_range * 1000),
+                round(command.min_covariance_ratio * 10000),
+            )
+
+        if isinstance(command, FieldUploadBeginCommand):
+            return _command(wire.COMMAND_FIELD_UPLOAD_BEGIN, wire.COMMAND_FIELD_UPLOAD_BEGIN_FIELDS, command.size)
+
+        if isinstance(command, FieldUploadDataCommand):
+            return _command(wire.COMMAND_FIELD_UPLOAD_DATA, wire.COMMAND_FIELD_UPLOAD_DATA_FIELDS, command.offset) + command.data
+
+        if isinstance(command, FieldUploadEndCommand):
+            return _command(wire.COMMAND_FIELD_UPLOAD_END, wire.COMMAND_FIELD_UPLOAD_END_FIELDS, command.crc)
+
+        if isinstance(command, ScoreParticlesCommand):
+            payload = bytearray(
+                _command(wire.COMMAND_SCORE_PARTICLES, wire.COMMAND_SCORE_PARTICLES_FIELDS, command.sequence, len(command.xs))
+            )
+            for x, y, theta in zip(command.xs, command.ys, command.thetas):
+                payload.extend(wire.PARTICLE_FIELDS.pack(round(x * 1000), round(y * 1000), _wrap_q15(theta)))
+            return bytes(payload)
+
+        if isinstance(command, RecorderDumpCommand):
+            return bytes((wire.COMMAND_RECORDER_DUMP,))
+
+        if isinstance(command, LidarMotorCommand):
+            return _command(wire.COMMAND_LIDAR_MOTOR, wire.COMMAND_LIDAR_MOTOR_FIELDS, command.target_rpm)
+
+        if isinstance(command, TelemetryConfigCommand):
+            return _command(
+                wire.COMMAND_TELEMETRY_CONFIG, wire.COMMAND_TELEMETRY_CONFIG_FIELDS, command.period_ms, command.max_lidar_points
+            )
+
+        if isinstance(command, ProfileDumpCommand):
+            flags = wire.PROFILE_DUMP_RESET if command.reset else 0
+            return _command(wire.COMMAND_PROFILE_DUMP, wire.COMMAND_PROFILE_DUMP_FIELDS, flags)
+
+        if isinstance(command, LidarOutputCommand):
+            flags = (
+                (wire.LIDAR_OUTPUT_CARTESIAN if command.cartesian else 0)
+                | (wire.LIDAR_OUTPUT_MOTION_COMPENSATION if command.motion_compensation else 0)
+                | (wire.LIDAR_OUTPUT_RAW if command.raw else 0)
+            )
+            return _command(
+                wire.COMMAND_LIDAR_OUTPUT,
+                wire.COMMAND_LIDAR_OUTPUT_FIELDS,
+                flags,
+                round(command.mount_x * 1000),
+                round(command.mount_y * 1000),
+                _wrap_q15(command.mount_theta),
+            )
+
+        if isinstance(command, MotorTraceCommand):
+            flags = (wire.MOTOR_TRACE_CAPTURE_NOW if command.capture_now else 0) | (
+                wire.MOTOR_TRACE_STALL_TRIGGER if command.stall_trigger else 0
+            )
+            return _command(
+                wire.COMMAND_MOTOR_TRACE,
+                wire.COMMAND_MOTOR_TRACE_FIELDS,
+                flags,
+                command.period_us,
+                command.post_trigger,
+                command.stall_speed,
+                command.stall_samples,
+            )
+
+        if isinstance(command, CollisionGuardCommand):
+            payload = bytearray(
+                _command(
+                    wire.COMMAND_COLLISION_GUARD,
+                    wire.COMMAND_COLLISION_GUARD_FIELDS,
+                    wire.COLLISION_GUARD_ENABLED if command.enabled else 0,
+                    round(command.lookahead * 1000),
+                    command.min_points,
+                    round(command.clear_time * 1000),
+                    len(command.polygon),
+                )
+            )
+            for x, y in command.polygon:
+                payload.extend(wire.VERTEX_FIELDS.pack(round(x * 1000), round(y * 1000)))
+            return bytes(payload)
+
+        if isinstance(command, GraspCommand):
+            return _command(
+                wire.COMMAND_GRASP,
+                wire.COMMAND_GRASP_FIELDS,
+                command.action,
+                command.close_pwm,
+                round(command.ramp_time * 1000),
+                round(command.timeout * 1000),
+                round(command.stall_current * 1000),
+                round(command.stall_time * 1000),
+                command.hold_pwm,
+            )
+
+        if isinstance(command, SubscribeCommand):
+            payload = bytearray(_command(wire.COMMAND_SUBSCRIBE, wire.COMMAND_SUBSCRIBE_FIELDS, len(command.streams)))
+            for stream, period in command.streams.items():
+                if period == STREAM_ON_CHANGE:
+                    period_ms = wire.STREAM_ON_CHANGE
+                else:
+                    # a period shorter than a millisecond would read as off
+                    period_ms = 0 if period == 0 else min(max(round(period * 1000), 1), wire.STREAM_ON_CHANGE - 1)
+                payload.extend(wire.SUBSCRIPTION_FIELDS.pack(stream, period_ms))
+            return bytes(payload)
 
         raise ValueError(f"Unknown command type: {type(command)}")
 
@@ -42,66 +241,458 @@ class BinarySerializer:
             raise ValueError("Empty command payload")
 
         command_type = data[0]
-        body = data[1:]
 
-        if command_type == BinarySerializer._COMMAND_MOVE:
-            left_speed, right_speed = struct.unpack("<hh", body)
-            return MoveCommand(left_speed=left_speed / 1000, right_speed=right_speed / 1000)
+        if command_type == wire.COMMAND_MOVE:
+            move = _unpack_command(wire.COMMAND_MOVE_FIELDS, data)
+            return MoveCommand(left_speed=move.left_speed_mm_s / 1000, right_speed=move.right_speed_mm_s / 1000)
 
-        if command_type == BinarySerializer._COMMAND_CLAW:
-            (raw_pwm,) = struct.unpack("<h", body)
-            return ClawCommand(pwm=raw_pwm)
+        if command_type == wire.COMMAND_CLAW:
+            return ClawCommand(pwm=_unpack_command(wire.COMMAND_CLAW_FIELDS, data).pwm)
 
-        if command_type == BinarySerializer._COMMAND_ARM:
+        if command_type == wire.COMMAND_ARM:
             return ArmCommand()
 
+        if command_type == wire.COMMAND_LIDAR_FILTER:
+            fields = _unpack_command(wire.COMMAND_LIDAR_FILTER_FIELDS, data)
+            return LidarFilterCommand(
+                drop_invalid=bool(fields.flags & wire.LIDAR_FILTER_DROP_INVALID),
+                min_distance=fields.min_distance_mm / 1000,
+                max_distance=None if fields.max_distance_mm == 0 else fields.max_distance_mm / 1000,
+                min_quality=fields.min_quality,
+            )
+
+        if command_type == wire.COMMAND_BEAR_TEMPLATE:
+            fields = _unpack_command(wire.COMMAND_BEAR_TEMPLATE_FIELDS, data)
+            return BearTemplateCommand(
+                enabled=bool(fields.flags & wire.BEAR_TEMPLATE_ENABLED),
+                jump=fields.jump_mm / 1000,
+                max_gap=fields.max_gap_q6 / 64,
+                min_points=fields.min_points,
+                width=fields.width_mm / 1000,
+                width_tolerance=fields.width_tolerance_mm / 1000,
+                min_range=fields.min_range_mm / 1000,
+                max_range=fields.max_range_mm / 1000,
+                min_covariance_ratio=fields.min_covariance_ratio / 10000,
+            )
+
+        if command_type == wire.COMMAND_FIELD_UPLOAD_BEGIN:
+            return FieldUploadBeginCommand(size=_unpack_command(wire.COMMAND_FIELD_UPLOAD_BEGIN_FIELDS, data).size)
+
+        if command_type == wire.COMMAND_FIELD_UPLOAD_DATA:
+            fields = _unpack_command(wire.COMMAND_FIELD_UPLOAD_DATA_FIELDS, data, variable=True)
+            return FieldUploadDataCommand(offset=fields.offset, data=bytes(data[1 + wire.COMMAND_FIELD_UPLOAD_DATA_FIELDS.size :]))
+
+        if command_type == wire.COMMAND_FIELD_UPLOAD_END:
+            return FieldUploadEndCommand(crc=_unpack_command(wire.COMMAND_FIELD_UPLOAD_END_FIELDS, data).crc)
+
+        if command_type == wire.COMMAND_SCORE_PARTICLES:
+            fields = _unpack_command(wire.COMMAND_SCORE_PARTICLES_FIELDS, data, variable=True)
+            particles = wire.PARTICLE_FIELDS.array(data, fields.count, 1 + wire.COMMAND_SCORE_PARTICLES_FIELDS.size)
+            return ScoreParticlesCommand(
+                sequence=fields.sequence,
+                xs=[x / 1000 for x in particles["x_mm"].tolist()],
+                ys=[y / 1000 for y in particles["y_mm"].tolist()],
+                thetas=[theta / 32768 * math.pi for theta in particles["theta"].tolist()],
+            )
+
+        if command_type == wire.COMMAND_RECORDER_DUMP:
+            return RecorderDumpCommand()
+
+        if command_type == wire.COMMAND_LIDAR_MOTOR:
+            return LidarMotorCommand(target_rpm=_unpack_command(wire.COMMAND_LIDAR_MOTOR_FIELDS, data).target_rpm)
+
+        if command_type == wire.COMMAND_TELEMETRY_CONFIG:
+            fields = _unpack_command(wire.COMMAND_TELEMETRY_CONFIG_FIELDS, data)
+            return TelemetryConfigCommand(period_ms=fields.period_ms, max_lidar_points=fields.max_lidar_points)
+
+        if command_type == wire.COMMAND_PROFILE_DUMP:
+            fields = _unpack_command(wire.COMMAND_PROFILE_DUMP_FIELDS, data)
+            return ProfileDumpCommand(reset=bool(fields.flags & wire.PROFILE_DUMP_RESET))
+
+        if command_type == wire.COMMAND_LIDAR_OUTPUT:
+            fields = _unpack_command(wire.COMMAND_LIDAR_OUTPUT_FIELDS, data)
+            return LidarOutputCommand(
+                cartesian=bool(fields.flags & wire.LIDAR_OUTPUT_CARTESIAN),
+                motion_compensation=bool(fields.flags & wire.LIDAR_OUTPUT_MOTION_COMPENSATION),
+                mount_x=fields.mount_x_mm / 1000,
+                mount_y=fields.mount_y_mm / 1000,
+                mount_theta=fields.mount_theta / 32768 * math.pi,
+                raw=bool(fields.flags & wire.LIDAR_OUTPUT_RAW),
+            )
+
+        if command_type == wire.COMMAND_MOTOR_TRACE:
+            fields = _unpack_command(wire.COMMAND_MOTOR_TRACE_FIELDS, data)
+            return MotorTraceCommand(
+                capture_now=bool(fields.flags & wire.MOTOR_TRACE_CAPTURE_NOW),
+                stall_trigger=bool(fields.flags & wire.MOTOR_TRACE_STALL_TRIGGER),
+                period_us=fields.period_us,
+                post_trigger=fields.post_trigger,
+                stall_speed=fields.stall_speed,
+                stall_samples=fields.stall_samples,
+            )
+
+        if command_type == wire.COMMAND_COLLISION_GUARD:
+            fields = _unpack_command(wire.COMMAND_COLLISION_GUARD_FIELDS, data, variable=True)
+            vertices = wire.VERTEX_FIELDS.array(data, fields.count, 1 + wire.COMMAND_COLLISION_GUARD_FIELDS.size)
+            return CollisionGuardCommand(
+                enabled=bool(fields.flags & wire.COLLISION_GUARD_ENABLED),
+                polygon=[(x / 1000, y / 1000) for x, y in zip(vertices["x_mm"].tolist(), vertices["y_mm"].tolist())],
+                lookahead=fields.lookahead_ms / 1000,
+                min_points=fields.min_points,
+                clear_time=fields.clear_ms / 1000,
+            )
+
+        if command_type == wire.COMMAND_GRASP:
+            fields = _unpack_command(wire.COMMAND_GRASP_FIELDS, data)
+            return GraspCommand(
+                action=fields.action,
+                close_pwm=fields.close_pwm,
+                ramp_time=fields.ramp_ms / 1000,
+                timeout=fields.timeout_ms / 1000,
+                stall_current=fields.stall_ma / 1000,
+                stall_time=fields.stall_ms / 1000,
+                hold_pwm=fields.hold_pwm,
+            )
+
+        if command_type == wire.COMMAND_SUBSCRIBE:
+            fields = _unpack_command(wire.COMMAND_SUBSCRIBE_FIELDS, data, variable=True)
+            subscriptions = wire.SUBSCRIPTION_FIELDS.array(data, fields.count, 1 + wire.COMMAND_SUBSCRIBE_FIELDS.size)
+            streams = {}
+            for stream, period_ms in zip(subscriptions["stream"].tolist(), subscriptions["period_ms"].tolist()):
+                streams[stream] = STREAM_ON_CHANGE if period_ms == wire.STREAM_ON_CHANGE else period_ms / 1000
+            return SubscribeCommand(streams=streams)
+
         raise ValueError(f"Unknown command type: {command_type}")
 
     @staticmethod
     def serialize_measurements(measurements: Measurements) -> bytes:
-        payload = bytearray()
-        payload.extend(struct.pack("<q", measurements.timestamp))
-        payload.extend(struct.pack("<H", len(measurements.lidar)))
-        for measurement in measurements.lidar:
-            # angle: degrees * 64
-            # distance: millimeters * 4
-            angle_raw = int(round(-measurement.angle * 64 * 57.295779513))
-            distance_raw = int(round(measurement.distance * 4 * 1000.0)) & 0xFFFF
-            payload.extend(struct.pack("<hH", angle_raw, distance_raw))
-        payload.extend(
-            struct.pack(
-                "<ii",
-                measurements.encoders.left_ticks,
-                measurements.encoders.right_ticks,
+        if measurements.lidar_xy is not None:
+            xs, ys = measurements.lidar_xy
+            payload = [bytes((wire.MESSAGE_MEASUREMENTS_XY,)), wire.MESSAGE_MEASUREMENTS_FIELDS.pack(measurements.timestamp, len(xs))]
+            for x, y in zip(xs, ys):
+                payload.append(wire.LIDAR_POINT_XY_FIELDS.pack(int(round(x * 1000)), int(round(y * 1000))))
+            flags = wire.MEASUREMENTS_XY_MOTION_COMPENSATED if measurements.motion_compensated else 0
+            payload.append(wire.MEASUREMENTS_XY_FIELDS.pack(flags))
+        else:
+            payload = [
+                bytes((wire.MESSAGE_MEASUREMENTS,)),
+                wire.MESSAGE_MEASUREMENTS_FIELDS.pack(measurements.timestamp, len(measurements.lidar)),
+            ]
+            for measurement in measurements.lidar:
+                # angle: degrees * 64
+                # distance: millimeters * 4
+                angle_raw = int(round(-measurement.angle * 64 * 57.295779513))
+                distance_raw = int(round(measurement.distance * 4 * 1000.0)) & 0xFFFF
+                payload.append(wire.LIDAR_POINT_FIELDS.pack(angle_raw, distance_raw))
+        payload += [
+            wire.MEASUREMENTS_ENCODERS_FIELDS.pack(measurements.encoders.left_ticks, measurements.encoders.right_ticks),
+            wire.MEASUREMENTS_FILTERED_FIELDS.pack(
+                measurements.lidar_filtered.invalid,
+                measurements.lidar_filtered.out_of_range,
+                measurements.lidar_filtered.low_quality,
+            ),
+            wire.MEASUREMENTS_RPM_FIELDS.pack(measurements.lidar_rpm),
+            wire.MEASUREMENTS_BATCH_FIELDS.pack(
+                measurements.lidar_batch.backlog,
+                measurements.lidar_batch.source_backlog,
+                measurements.lidar_batch.age_us,
+                measurements.lidar_batch.dropped,
+            ),
+            wire.MEASUREMENTS_COMMAND_LANES_FIELDS.pack(
+                measurements.command_lanes.coalesced,
+                measurements.command_lanes.preempted,
+                measurements.command_lanes.dropped,
+            ),
+        ]
+        return b"".join(payload)
+
+    @staticmethod
+    def deserialize_measurements(data: bytes) -> Measurements:
+        if not data or data[0] not in (wire.MESSAGE_MEASUREMENTS, wire.MESSAGE_MEASUREMENTS_XY):
+            raise ValueError("Not a measurements payload")
+
+        if native_protocol.available():
+            return BinarySerializer._deserialize_measurements_native(data)
+
+        timestamp, count = wire.MESSAGE_MEASUREMENTS_FIELDS.struct.unpack_from(data, 1)
+        offset = 1 + wire.MESSAGE_MEASUREMENTS_FIELDS.size
+
+        # same float32 arrays as the native decoder
+        lidar = LidarPoints(np.empty(0, dtype="f"), np.empty(0, dtype="f"))
+        lidar_xy = None
+        motion_compensated = False
+        if data[0] == wire.MESSAGE_MEASUREMENTS_XY:
+            points = wire.LIDAR_POINT_XY_FIELDS.array(data, count, offset)
+            offset += points.nbytes
+            lidar_xy = (points["x_mm"].astype("f") * _M_PER_MM, points["y_mm"].astype("f") * _M_PER_MM)
+            (flags,) = wire.MEASUREMENTS_XY_FIELDS.struct.unpack_from(data, offset)
+            offset += wire.MEASUREMENTS_XY_FIELDS.size
+            motion_compensated = bool(flags & wire.MEASUREMENTS_XY_MOTION_COMPENSATED)
+        else:
+            points = wire.LIDAR_POINT_FIELDS.array(data, count, offset)
+            offset += points.nbytes
+            lidar = LidarPoints(
+                points["angle_q6"].astype("f") * _RAD_PER_ANGLE_Q6,
+                points["distance_q2"].astype("f") * _M_PER_DISTANCE_Q2,
             )
+
+        left_ticks, right_ticks = wire.MEASUREMENTS_ENCODERS_FIELDS.struct.unpack_from(data, offset)
+        offset += wire.MEASUREMENTS_ENCODERS_FIELDS.size
+        # firmware before the lidar filter ended after the encoders
+        filtered, offset = _unpack_optional(wire.MEASUREMENTS_FILTERED_FIELDS, data, offset)
+        rpm, offset = _unpack_optional(wire.MEASUREMENTS_RPM_FIELDS, data, offset)
+        batch, offset = _unpack_optional(wire.MEASUREMENTS_BATCH_FIELDS, data, offset)
+        lanes, offset = _unpack_optional(wire.MEASUREMENTS_COMMAND_LANES_FIELDS, data, offset)
+
+        return Measurements(
+            timestamp=timestamp,
+            lidar=lidar,
+            encoders=EncodersMeasurement(left_ticks=left_ticks, right_ticks=right_ticks),
+            lidar_filtered=LidarFilterStats(*filtered) if filtered else LidarFilterStats(),
+            lidar_rpm=rpm[0] if rpm else 0,
+            lidar_batch=LidarBatchStats(*batch) if batch else LidarBatchStats(),
+            command_lanes=CommandLaneStats(*lanes) if lanes else CommandLaneStats(),
+            lidar_xy=lidar_xy,
+            motion_compensated=motion_compensated,
         )
+
+    @staticmethod
+    def _deserialize_measurements_native(data: bytes) -> Measurements:
+        fields, first, second = native_protocol.decode_measurements(data)
+        if fields.cartesian:
+            empty = np.empty(0, dtype=np.float32)
+            lidar, lidar_xy = LidarPoints(empty, empty), (first, second)
+        else:
+            lidar, lidar_xy = LidarPoints(first, second), None
+        return Measurements(
+            timestamp=fields.timestamp,
+            lidar=lidar,
+            encoders=EncodersMeasurement(left_ticks=fields.left_ticks, right_ticks=fields.right_ticks),
+            lidar_filtered=LidarFilterStats(fields.filtered_invalid, fields.filtered_out_of_range, fields.filtered_low_quality),
+            lidar_rpm=fields.lidar_rpm,
+            lidar_batch=LidarBatchStats(fields.batch_backlog, fields.batch_source_backlog, fields.batch_age_us, fields.batch_dropped),
+            command_lanes=CommandLaneStats(fields.commands_coalesced, fields.commands_preempted, fields.commands_dropped),
+            lidar_xy=lidar_xy,
+            motion_compensated=bool(fields.motion_compensated),
+        )
+
+    @staticmethod
+    def serialize_bear_candidates(candidates: BearCandidates) -> bytes:
+        payload = bytearray((wire.MESSAGE_BEAR_CANDIDATES,))
+        payload.extend(wire.MESSAGE_BEAR_CANDIDATES_FIELDS.pack(candidates.timestamp, len(candidates.candidates)))
+        for candidate in candidates.candidates:
+            payload.extend(
+                wire.BEAR_CANDIDATE_FIELDS.pack(
+                    int(round(-candidate.angle * 64 * 57.295779513)),
+                    int(round(candidate.distance * 4 * 1000.0)) & 0xFFFF,
+                    round(candidate.width * 1000),
+                    candidate.points,
+                    round(candidate.score * 255),
+                )
+            )
         return bytes(payload)
 
     @staticmethod
-    def deserialize_measurements(data: bytes) -> Measurements:
-        offset = 0
-        (timestamp,) = struct.unpack_from("<q", data, offset)
-        offset += struct.calcsize("<q")
-
-        (lidar_count,) = struct.unpack_from("<H", data, offset)
-        offset += struct.calcsize("<H")
-
-        lidar: list[LidarMeasurement] = []
-        lidar_size = struct.calcsize("<hH")
-        for _ in range(lidar_count):
-            angle, distance = struct.unpack_from("<hH", data, offset)
-            offset += lidar_size
-            lidar.append(
-                LidarMeasurement(
-                    angle=-angle / (64 * 57.295779513),
-                    distance=distance / (4 * 1000.0),
+    def deserialize_bear_candidates(data: bytes) -> BearCandidates:
+        if not data or data[0] != wire.MESSAGE_BEAR_CANDIDATES:
+            raise ValueError("Not a bear candidates payload")
+
+        header = wire.MESSAGE_BEAR_CANDIDATES_FIELDS.unpack_from(data, 1)
+        offset = 1 + wire.MESSAGE_BEAR_CANDIDATES_FIELDS.size
+
+        candidates: list[BearCandidate] = []
+        for _ in range(header.count):
+            entry = wire.BEAR_CANDIDATE_FIELDS.unpack_from(data, offset)
+            offset += wire.BEAR_CANDIDATE_FIELDS.size
+            candidates.append(
+                BearCandidate(
+                    angle=-entry.angle_q6 / (64 * 57.295779513),
+                    distance=entry.distance_q2 / (4 * 1000.0),
+                    width=entry.width_mm / 1000,
+                    points=entry.points,
+                    score=entry.score / 255,
                 )
             )
+        return BearCandidates(timestamp=header.timestamp, candidates=candidates)
 
-        left_ticks, right_ticks = struct.unpack_from("<ii", data, offset)
-        encoders = EncodersMeasurement(
-            left_ticks=left_ticks,
-            right_ticks=right_ticks,
-        )
+    @staticmethod
+    def deserialize_telemetry(data: bytes) -> Telemetry:
+        if not data:
+            raise ValueError("Empty telemetry payload")
+
+        if data[0] in (wire.MESSAGE_MEASUREMENTS, wire.MESSAGE_MEASUREMENTS_XY):
+            return BinarySerializer.deserialize_measurements(data)
+
+        if data[0] == wire.MESSAGE_BEAR_CANDIDATES:
+            return BinarySerializer.deserialize_bear_candidates(data)
+
+        if data[0] == wire.MESSAGE_PARTICLE_SCORES:
+            scores = wire.MESSAGE_PARTICLE_SCORES_FIELDS.unpack_from(data, 1)
+            costs = wire.PARTICLE_COST_FIELDS.array(data, scores.count, 1 + wire.MESSAGE_PARTICLE_SCORES_FIELDS.size)
+            return ParticleScores(
+                sequence=scores.sequence, scan_timestamp=scores.scan_timestamp, points=scores.points, costs=costs["cost"].tolist()
+            )
+
+        if data[0] == wire.MESSAGE_FIELD_UPLOAD_RESULT:
+            return FieldUploadResult(ok=bool(wire.MESSAGE_FIELD_UPLOAD_RESULT_FIELDS.unpack_from(data, 1).ok))
+
+        if data[0] == wire.MESSAGE_RECORDER_CHUNK:
+            chunk = wire.MESSAGE_RECORDER_CHUNK_FIELDS.unpack_from(data, 1)
+            return RecorderChunk(
+                offset=chunk.offset, total=chunk.total, data=bytes(data[1 + wire.MESSAGE_RECORDER_CHUNK_FIELDS.size :])
+            )
+
+        if data[0] == wire.MESSAGE_LIDAR_STARTUP:
+            report = wire.MESSAGE_LIDAR_STARTUP_FIELDS.unpack_from(data, 1)
+            return LidarStartupReport(
+                ok=bool(report.ok),
+                attempts=report.attempts,
+                health=report.health,
+                model=report.model,
+                firmware_major=report.firmware_major,
+                firmware_minor=report.firmware_minor,
+                hardware=report.hardware,
+                phase_us=[report.stop_us, report.reset_us, report.health_us, report.info_us, report.scan_us],
+            )
+
+        if data[0] == wire.MESSAGE_SCAN_MATCH:
+            match = wire.MESSAGE_SCAN_MATCH_FIELDS.unpack_from(data, 1)
+            return ScanMatch(
+                timestamp=match.timestamp,
+                dx=match.dx_mm / 1000.0,
+                dy=match.dy_mm / 1000.0,
+                dtheta=match.dtheta / 32768 * math.pi,
+                quality=match.quality / 255,
+                iterations=match.iterations,
+                matched=match.matched,
+                duration_us=match.duration_us,
+            )
+
+        if data[0] == wire.MESSAGE_PROFILE:
+            section = wire.MESSAGE_PROFILE_FIELDS.unpack_from(data, 1)
+            offset = 1 + wire.MESSAGE_PROFILE_FIELDS.size
+            name = bytes(data[offset : offset + section.name_size]).decode("ascii", errors="replace")
+            offset += section.name_size
+            histogram = wire.PROFILE_HISTOGRAM_FIELDS.unpack_from(data, offset)
+            offset += wire.PROFILE_HISTOGRAM_FIELDS.size
+            buckets = wire.PROFILE_BUCKET_FIELDS.array(data, histogram.bucket_count, offset)
+            return ProfileSection(
+                index=section.index,
+                total=section.total,
+                ticks_per_us=section.ticks_per_us,
+                core=section.core,
+                name=name,
+                count=histogram.count,
+                total_ticks=histogram.total_ticks,
+                max_ticks=histogram.max_ticks,
+                first_bucket=histogram.first_bucket,
+                buckets=buckets["count"].tolist(),
+            )
+
+        if data[0] == wire.MESSAGE_LOG:
+            batch = wire.MESSAGE_LOG_FIELDS.unpack_from(data, 1)
+            offset = 1 + wire.MESSAGE_LOG_FIELDS.size
+            records = []
+            for _ in range(batch.count):
+                record = wire.LOG_RECORD_FIELDS.unpack_from(data, offset)
+                offset += wire.LOG_RECORD_FIELDS.size
+                args = decode_log_args(bytes(data[offset : offset + record.args_size]))
+                offset += record.args_size
+                records.append(LogRecord(timestamp_us=record.timestamp_us, level=record.level, format_id=record.format_id, args=args))
+            return LogBatch(dropped=batch.dropped, records=records)
+
+        if data[0] == wire.MESSAGE_GUARD_EVENT:
+            event = wire.MESSAGE_GUARD_EVENT_FIELDS.unpack_from(data, 1)
+            return GuardEvent(
+                timestamp=event.timestamp,
+                blocked=event.blocked,
+                points=event.points,
+                nearest_x=event.nearest_x_mm / 1000,
+                nearest_y=event.nearest_y_mm / 1000,
+                left_speed=event.left_speed_mm_s / 1000,
+                right_speed=event.right_speed_mm_s / 1000,
+                reaction_us=event.reaction_us,
+            )
+
+        if data[0] == wire.MESSAGE_GRASP:
+            event = wire.MESSAGE_GRASP_FIELDS.unpack_from(data, 1)
+            return GraspEvent(
+                timestamp=event.timestamp,
+                action=event.action,
+                result=event.result,
+                duration=event.duration_ms / 1000,
+                stall_times=tuple(None if ms == 0xFFFF else ms / 1000 for ms in (event.left_stall_ms, event.right_stall_ms)),
+                peak_currents=(event.left_peak_ma / 1000, event.right_peak_ma / 1000),
+            )
+
+        if data[0] == wire.MESSAGE_LIDAR_RAW:
+            batch = wire.MESSAGE_LIDAR_RAW_FIELDS.unpack_from(data, 1)
+            packets = np.frombuffer(data, dtype=_LIDAR_RAW_PACKET, count=batch.count, offset=1 + wire.MESSAGE_LIDAR_RAW_FIELDS.size)
+            return LidarRawPackets(
+                timestamp=batch.timestamp,
+                dropped=batch.dropped,
+                checksum_errors=batch.checksum_errors,
+                arrival_us=batch.timestamp - packets["age_us"].astype(np.int64),
+                sequences=packets["sequence"].copy(),
+                packets=packets["bytes"].copy(),
+            )
+
+        if data[0] == wire.MESSAGE_STREAMS:
+            # plain tuples, this one comes at up to the control loop rate
+            timestamp, mask = wire.MESSAGE_STREAMS_FIELDS.struct.unpack_from(data, 1)
+            sample = StreamSample(timestamp=timestamp)
+            offset = 1 + wire.MESSAGE_STREAMS_FIELDS.size
+            if mask & (1 << wire.STREAM_ENCODERS):
+                left, right = wire.STREAM_ENCODERS_FIELDS.struct.unpack_from(data, offset)
+                sample.encoders = EncodersMeasurement(left_ticks=left, right_ticks=right)
+                offset += wire.STREAM_ENCODERS_FIELDS.size
+            if mask & (1 << wire.STREAM_LIDAR_MOTOR):
+                sample.lidar_rpm, sample.lidar_target_rpm = wire.STREAM_LIDAR_MOTOR_FIELDS.struct.unpack_from(data, offset)
+                offset += wire.STREAM_LIDAR_MOTOR_FIELDS.size
+            if mask & (1 << wire.STREAM_COLLISION_GUARD):
+                blocked, left, right = wire.STREAM_COLLISION_GUARD_FIELDS.struct.unpack_from(data, offset)
+                sample.guard_blocked = blocked
+                sample.guard_left_speed = left / 1000
+                sample.guard_right_speed = right / 1000
+                offset += wire.STREAM_COLLISION_GUARD_FIELDS.size
+            if mask & (1 << wire.STREAM_LINK):
+                sample.tx_free, sample.tx_dropped = wire.STREAM_LINK_FIELDS.struct.unpack_from(data, offset)
+            return sample
+
+        if data[0] == wire.MESSAGE_LOCAL_GRID:
+            grid = wire.MESSAGE_LOCAL_GRID_FIELDS.unpack_from(data, 1)
+            offset = 1 + wire.MESSAGE_LOCAL_GRID_FIELDS.size
+            tiles = {}
+            for _ in range(grid.count):
+                tile = wire.LOCAL_GRID_TILE_FIELDS.unpack_from(data, offset)
+                offset += wire.LOCAL_GRID_TILE_FIELDS.size
+                runs = wire.LOCAL_GRID_RUN_FIELDS.array(data, tile.runs, offset)
+                offset += runs.nbytes
+                cells = np.repeat(runs["value"], runs["length"])
+                tiles[(tile.tile_x, tile.tile_y)] = cells.reshape(wire.LOCAL_GRID_TILE_CELLS, wire.LOCAL_GRID_TILE_CELLS)
+            return LocalGridTiles(
+                timestamp=grid.timestamp,
+                x=grid.x_mm / 1000,
+                y=grid.y_mm / 1000,
+                theta=grid.theta * math.pi / 32768,
+                origin_tile=(grid.origin_tile_x, grid.origin_tile_y),
+                tiles=tiles,
+            )
+
+        if data[0] == wire.MESSAGE_MOTOR_TRACE:
+            chunk = wire.MESSAGE_MOTOR_TRACE_FIELDS.unpack_from(data, 1)
+            # two motors per sample
+            samples = wire.MOTOR_SAMPLE_FIELDS.array(data, 2 * chunk.count, 1 + wire.MESSAGE_MOTOR_TRACE_FIELDS.size)
+            samples = samples.reshape(chunk.count, 2)
+            return MotorTraceChunk(
+                reason=chunk.reason,
+                period_us=chunk.period_us,
+                total=chunk.total,
+                trigger=chunk.trigger,
+                offset=chunk.offset,
+                setpoints=samples["setpoint"].copy(),
+                speeds=samples["speed"].copy(),
+                positions=samples["position"].copy(),
+            )
 
-        return Measurements(timestamp=timestamp, lidar=lidar, encoders=encoders)
+        raise ValueError(f"Unknown telemetry type: {data[0]}")
@@ -0,0 +1,31 @@
+from __future__ import annotations
+
+
+def cobs_encode(data: bytes) -> bytes:
+    """COBS-encode `data`. The result contains no zero bytes; the frame delimiter is not appended."""
+    out = bytearray()
+    for block in data.split(b"\x00"):
+        while len(block) >= 0xFE:
+            out.append(0xFF)
+            out.extend(block[:0xFE])
+            block = block[0xFE:]
+        out.append(len(block) + 1)
+        out.extend(block)
+    return bytes(out)
+
+
+def cobs_decode(data: bytes) -> bytes:
+    """Decode a single COBS block (without the delimiter). Raises ValueError on malformed input."""
+    out = bytearray()
+    offset = 0
+    while offset < len(data):
+        code = data[offset]
+        offset += 1
+        end = offset + code - 1
+        if code == 0 or end > len(data):
+            raise ValueError("Malformed COBS block")
+        out.extend(data[offset:end])
+        offset = end
+        if code != 0xFF and offset < len(data):
+            out.append(0)
+    return bytes(out)
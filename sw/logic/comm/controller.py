@@ -1,17 +1,95 @@
 from typing import Callable, Optional
 
-from .messages import Command, Measurements
+from .messages import (
+    BearCandidates,
+    Command,
+    FieldUploadResult,
+    GraspEvent,
+    GuardEvent,
+    LidarRawPackets,
+    LidarStartupReport,
+    LocalGridTiles,
+    LogBatch,
+    Measurements,
+    MotorTraceChunk,
+    ParticleScores,
+    ProfileSection,
+    RecorderChunk,
+    ScanMatch,
+    StreamSample,
+)
 from .types import MessageCallback, Serializer, Transport
 
 
 class MeasurementCallback(MessageCallback):
-    def __init__(self, serializer: Serializer, on_measurement: Callable[[Measurements], None]):
+    def __init__(
+        self,
+        serializer: Serializer,
+        on_measurement: Callable[[Measurements], None],
+        on_bear_candidates: Callable[[BearCandidates], None],
+        on_particle_scores: Callable[[ParticleScores], None],
+        on_field_upload_result: Callable[[FieldUploadResult], None],
+        on_recorder_chunk: Callable[[RecorderChunk], None],
+        on_lidar_startup: Callable[[LidarStartupReport], None],
+        on_scan_match: Callable[[ScanMatch], None],
+        on_profile_section: Callable[[ProfileSection], None],
+        on_log: Callable[[LogBatch], None],
+        on_motor_trace: Callable[[MotorTraceChunk], None],
+        on_guard_event: Callable[[GuardEvent], None],
+        on_lidar_raw: Callable[[LidarRawPackets], None],
+        on_streams: Callable[[StreamSample], None],
+        on_local_grid: Callable[[LocalGridTiles], None],
+        on_grasp: Callable[[GraspEvent], None],
+    ):
         self.serializer = serializer
         self.on_measurement = on_measurement
+        self.on_bear_candidates = on_bear_candidates
+        self.on_particle_scores = on_particle_scores
+        self.on_field_upload_result = on_field_upload_result
+        self.on_recorder_chunk = on_recorder_chunk
+        self.on_lidar_startup = on_lidar_startup
+        self.on_scan_match = on_scan_match
+        self.on_profile_section = on_profile_section
+        self.on_log = on_log
+        self.on_motor_trace = on_motor_trace
+        self.on_guard_event = on_guard_event
+        self.on_lidar_raw = on_lidar_raw
+        self.on_streams = on_streams
+        self.on_local_grid = on_local_grid
+        self.on_grasp = on_grasp
 
     def on_message(self, data: bytes) -> None:
-        measurements = self.serializer.deserialize_measurements(data)
-        self.on_measurement(measurements)
+        telemetry = self.serializer.deserialize_telemetry(data)
+        if isinstance(telemetry, Measurements):
+            self.on_measurement(telemetry)
+        elif isinstance(telemetry, BearCandidates):
+            self.on_bear_candidates(telemetry)
+        elif isinstance(telemetry, ParticleScores):
+            self.on_particle_scores(telemetry)
+        elif isinstance(telemetry, FieldUploadResult):
+            self.on_field_upload_result(telemetry)
+        elif isinstance(telemetry, RecorderChunk):
+            self.on_recorder_chunk(telemetry)
+        elif isinstance(telemetry, LidarStartupReport):
+            self.on_lidar_startup(telemetry)
+        elif isinstance(telemetry, ScanMatch):
+            self.on_scan_match(telemetry)
+        elif isinstance(telemetry, ProfileSection):
+            self.on_profile_section(telemetry)
+        elif isinstance(telemetry, LogBatch):
+            self.on_log(telemetry)
+        elif isinstance(telemetry, MotorTraceChunk):
+            self.on_motor_trace(telemetry)
+        elif isinstance(telemetry, GuardEvent):
+            self.on_guard_event(telemetry)
+        elif isinstance(telemetry, LidarRawPackets):
+            self.on_lidar_raw(telemetry)
+        elif isinstance(telemetry, StreamSample):
+            self.on_streams(telemetry)
+        elif isinstance(telemetry, LocalGridTiles):
+            self.on_local_grid(telemetry)
+        elif isinstance(telemetry, GraspEvent):
+            self.on_grasp(telemetry)
 
     def on_error(self, error: Exception) -> None:
         print(f"Controller communication error: {error}")
@@ -22,10 +100,43 @@ class Controller:
         self.transport = transport
         self.serializer = serializer
         self.on_measurement: Optional[Callable[[Measurements], None]] = None
+        self.on_bear_candidates: Optional[Callable[[BearCandidates], None]] = None
+        self.on_particle_scores: Optional[Callable[[ParticleScores], None]] = None
+        self.on_field_upload_result: Optional[Callable[[FieldUploadResult], None]] = None
+        self.on_recorder_chunk: Optional[Callable[[RecorderChunk], None]] = None
+        self.on_lidar_startup: Optional[Callable[[LidarStartupReport], None]] = None
+        self.on_scan_match: Optional[Callable[[ScanMatch], None]] = None
+        self.on_profile_section: Optional[Callable[[ProfileSection], None]] = None
+        self.on_log: Optional[Callable[[LogBatch], None]] = None
+        self.on_motor_trace: Optional[Callable[[MotorTraceChunk], None]] = None
+        self.on_guard_event: Optional[Callable[[GuardEvent], None]] = None
+        self.on_lidar_raw: Optional[Callable[[LidarRawPackets], None]] = None
+        self.on_streams: Optional[Callable[[StreamSample], None]] = None
+        self.on_local_grid: Optional[Callable[[LocalGridTiles], None]] = None
+        self.on_grasp: Optional[Callable[[GraspEvent], None]] = None
 
     def start(self) -> None:
         self.transport.connect()
-        self.transport.start_receiving(MeasurementCallback(self.serializer, self._handle_measurement))
+        self.transport.start_receiving(
+            MeasurementCallback(
+                self.serializer,
+                self._handle_measurement,
+                self._handle_bear_candidates,
+                self._handle_particle_scores,
+                self._handle_field_upload_result,
+                self._handle_recorder_chunk,
+                self._handle_lidar_startup,
+                self._handle_scan_match,
+                self._handle_profile_section,
+                self._handle_log,
+                self._handle_motor_trace,
+                self._handle_guard_event,
+                self._handle_lidar_raw,
+                self._handle_streams,
+                self._handle_local_grid,
+                self._handle_grasp,
+            )
+        )
 
     def stop(self) -> None:
         self.transport.close()
@@ -37,6 +148,104 @@ class Controller:
     def set_measurement_callback(self, callback: Callable[[Measurements], None]) -> None:
         self.on_measurement = callback
 
+    def set_bear_candidates_callback(self, callback: Callable[[BearCandidates], None]) -> None:
+        self.on_bear_candidates = callback
+
+    def set_particle_scores_callback(self, callback: Callable[[ParticleScores], None]) -> None:
+        self.on_particle_scores = callback
+
+    def set_field_upload_result_callback(self, callback: Callable[[FieldUploadResult], None]) -> None:
+        self.on_field_upload_result = callback
+
+    def set_recorder_chunk_callback(self, callback: Callable[[RecorderChunk], None]) -> None:
+        self.on_recorder_chunk = callback
+
+    def set_lidar_startup_callback(self, callback: Callable[[LidarStartupReport], None]) -> None:
+        self.on_lidar_startup = callback
+
+    def set_scan_match_callback(self, callback: Callable[[ScanMatch], None]) -> None:
+        self.on_scan_match = callback
+
+    def set_profile_section_callback(self, callback: Callable[[ProfileSection], None]) -> None:
+        self.on_profile_section = callback
+
+    def set_log_callback(self, callback: Callable[[LogBatch], None]) -> None:
+        self.on_log = callback
+
+    def set_motor_trace_callback(self, callback: Callable[[MotorTraceChunk], None]) -> None:
+        self.on_motor_trace = callback
+
+    def set_guard_event_callback(self, callback: Callable[[GuardEvent], None]) -> None:
+        self.on_guard_event = callback
+
+    def set_lidar_raw_callback(self, callback: Callable[[LidarRawPackets], None]) -> None:
+        self.on_lidar_raw = callback
+
+    def set_streams_callback(self, callback: Callable[[StreamSample], None]) -> None:
+        self.on_streams = callback
+
+    def set_local_grid_callback(self, callback: Callable[[LocalGridTiles], None]) -> None:
+        self.on_local_grid = callback
+
+    def set_grasp_callback(self, callback: Callable[[GraspEvent], None]) -> None:
+        self.on_grasp = callback
+
     def _handle_measurement(self, measurements: Measurements) -> None:
         if self.on_measurement:
             self.on_measurement(measurements)
+
+    def _handle_bear_candidates(self, candidates: BearCandidates) -> None:
+        if self.on_bear_candidates:
+            self.on_bear_candidates(candidates)
+
+    def _handle_particle_scores(self, scores: ParticleScores) -> None:
+        if self.on_particle_scores:
+            self.on_particle_scores(scores)
+
+    def _handle_field_upload_result(self, result: FieldUploadResult) -> None:
+        if self.on_field_upload_result:
+            self.on_field_upload_result(result)
+
+    def _handle_recorder_chunk(self, chunk: RecorderChunk) -> None:
+        if self.on_recorder_chunk:
+            self.on_recorder_chunk(chunk)
+
+    def _handle_lidar_startup(self, report: LidarStartupReport) -> None:
+        if self.on_lidar_startup:
+            self.on_lidar_startup(report)
+
+    def _handle_scan_match(self, match: ScanMatch) -> None:
+        if self.on_scan_match:
+            self.on_scan_match(match)
+
+    def _handle_profile_section(self, section: ProfileSection) -> None:
+        if self.on_profile_section:
+            self.on_profile_section(section)
+
+    def _handle_log(self, batch: LogBatch) -> None:
+        if self.on_log:
+            self.on_log(batch)
+
+    def _handle_motor_trace(self, chunk: MotorTraceChunk) -> None:
+        if self.on_motor_trace:
+            self.on_motor_trace(chunk)
+
+    def _handle_guard_event(self, event: GuardEvent) -> None:
+        if self.on_guard_event:
+            self.on_guard_event(event)
+
+    def _handle_lidar_raw(self, packets: LidarRawPackets) -> None:
+        if self.on_lidar_raw:
+            self.on_lidar_raw(packets)
+
+    def _handle_streams(self, sample: StreamSample) -> None:
+        if self.on_streams:
+            self.on_streams(sample)
+
+    def _handle_local_grid(self, tiles: LocalGridTiles) -> None:
+        if self.on_local_grid:
+            self.on_local_grid(tiles)
+
+    def _handle_grasp(self, event: GraspEvent) -> None:
+        if self.on_grasp:
+            self.on_grasp(event)
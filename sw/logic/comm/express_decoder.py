@@ -0,0 +1,121 @@
+from typing import Optional
+
+import numpy as np
+
+from .messages import LidarPoints, LidarRawPackets
+
+PACKET_SIZE = 84
+_SAMPLES_PER_PACKET = 32
+_FULL_CIRCLE_Q6 = 360 * 64
+
+
+def _start_angles(packets: np.ndarray) -> np.ndarray:
+    return packets[:, 2].astype(np.int32) | ((packets[:, 3].astype(np.int32) & 0x7F) << 8)
+
+
+class ExpressDecoder:
+    """
+    Decodes RPLidar express scan packets in bulk, as the firmware does: the 32 samples of a packet
+    are spread between its start angle and the next packet's, so the points of a packet come out
+    with the packet that follows it. Packets are expected in the order they were read.
+    """
+
+    def __init__(self, drop_invalid: bool = True) -> None:
+        self.drop_invalid = drop_invalid  # the robot side lidar filter does not see raw packets
+        self._last: Optional[np.ndarray] = None
+        self._last_sequence = 0
+
+    def reset(self) -> None:
+        self._last = None
+
+    def decode_raw(self, raw: LidarRawPackets) -> LidarPoints:
+        return self.decode(raw.packets, raw.sequences)
+
+    def decode(self, packets: np.ndarray, sequences: np.ndarray) -> LidarPoints:
+        """`packets` is (packets, 84) uint8 with the sync bytes, `sequences` the low byte of their read counter."""
+        sequences = sequences.astype(np.int32)
+        if self._last is not None:
+            packets = np.concatenate([self._last[None, :], packets])
+            sequences = np.concatenate([[self._last_sequence], sequences])
+        if len(packets) == 0:
+            return LidarPoints(np.empty(0, dtype="f"), np.empty(0, dtype="f"))
+        self._last, self._last_sequence = packets[-1].copy(), int(sequences[-1])
+
+        # only a packet followed by the next one read has its angles known
+        consecutive = ((sequences[1:] - sequences[:-1]) & 0xFF) == 1
+        current = packets[:-1][consecutive]
+        start = _start_angles(current)
+        span = (_start_angles(packets[1:][consecutive]) - start) % _FULL_CIRCLE_Q6
+
+        cabins = current[:, 4:].reshape(-1, 16, 5).astype(np.int32)
+        distances = np.stack(
+            [(cabins[:, :, 0] >> 2) | (cabins[:, :, 1] << 6), (cabins[:, :, 2] >> 2) | (cabins[:, :, 3] << 6)], axis=2
+        ).reshape(-1, _SAMPLES_PER_PACKET)
+        dtheta_q3 = np.stack(
+            [((cabins[:, :, 0] & 0x03) << 4) | (cabins[:, :, 4] & 0x0F), ((cabins[:, :, 2] & 0x03) << 4) | (cabins[:, :, 4] >> 4)],
+            axis=2,
+        ).reshape(-1, _SAMPLES_PER_PACKET)
+
+        step = span.astype("f")[:, None] / _SAMPLES_PER_PACKET
+        angles_q6 = start[:, None] + step * np.arange(_SAMPLES_PER_PACKET, dtype="f") - dtheta_q3 * 8.0
+        angles_q6 = np.floor(np.mod(angles_q6, _FULL_CIRCLE_Q6))
+
+        angles = angles_q6.ravel()
+        distances = distances.ravel()
+        if self.drop_invalid:
+            valid = distances != 0
+            angles, distances = angles[valid], distances[valid]
+        # same units and direction as the decoded points of a measurements frame
+        return LidarPoints(
+            (-angles * (np.pi / (180 * 64))).astype("f"),
+            (distances / 1000).astype("f"),
+        )
+
+
+class ExpressPacketReader:
+    """
+    Cuts express scan packets out of the raw byte stream of a lidar UART as `RpLidar::readExpressPacket`
+    does: bytes are skipped until the two sync nibbles, and a packet with a wrong checksum is dropped
+    but still counted, so the decoder sees the gap in the sequence.
+    """
+
+    def __init__(self) -> None:
+        self.checksum_errors = 0
+        self._buffer = bytearray()
+        self._sequence = 0
+
+    def feed(self, data: bytes) -> tuple[np.ndarray, np.ndarray]:
+        """Returns the complete valid packets in `data` and before, and the low byte of their read counter."""
+        self._buffer.extend(data)
+        packets: list[bytes] = []
+        sequences: list[int] = []
+        offset = 0
+        while len(self._buffer) - offset >= PACKET_SIZE:
+            if self._buffer[offset] >> 4 != 0xA:
+                offset += 1
+                continue
+            # the firmware has read the second byte too by the time it fails
+            if self._buffer[offset + 1] >> 4 != 0x5:
+                offset += 2
+                continue
+            packet = bytes(self._buffer[offset : offset + PACKET_SIZE])
+            offset += PACKET_SIZE
+            sequence = self._sequence
+            self._sequence += 1
+
+            checksum = 0
+            for byte in packet[2:]:
+                checksum ^= byte
+            if checksum != (packet[0] & 0x0F) | ((packet[1] & 0x0F) << 4):
+                self.checksum_errors += 1
+                continue
+            packets.append(packet)
+            sequences.append(sequence & 0xFF)
+        del self._buffer[:offset]
+
+        if not packets:
+            return np.empty((0, PACKET_SIZE), dtype=np.uint8), np.empty(0, dtype=np.uint8)
+        return (
+            np.frombuffer(b"".join(packets), dtype=np.uint8).reshape(-1, PACKET_SIZE),
+            np.array(sequences, dtype=np.uint8),
+        )
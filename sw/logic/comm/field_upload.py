@@ -0,0 +1,14 @@
+from typing import List
+
+import libscrc
+
+from .messages import Command, FieldUploadBeginCommand, FieldUploadDataCommand, FieldUploadEndCommand
+
+
+def field_upload_commands(data: bytes, chunk_size: int = 1024) -> List[Command]:
+    """Splits a likelihood field file into the command sequence that uploads it to the firmware."""
+    commands: List[Command] = [FieldUploadBeginCommand(size=len(data))]
+    for offset in range(0, len(data), chunk_size):
+        commands.append(FieldUploadDataCommand(offset=offset, data=data[offset:offset + chunk_size]))
+    commands.append(FieldUploadEndCommand(crc=libscrc.hacker16(data, 0x1021, 0xFFFF, 0x0000, False, False)))
+    return commands
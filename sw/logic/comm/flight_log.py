@@ -0,0 +1,48 @@
+import struct
+from dataclasses import dataclass
+from typing import List
+
+import libscrc
+
+BLOCK_SIZE = 4096
+_BLOCK_MAGIC = 0x31524C46  # "FLR1"
+_BLOCK_HEADER = struct.Struct("<IIHH")
+_RECORD_HEADER = struct.Struct("<BHI")
+
+RECORD_LIDAR_PACKET = 1  # raw RPLidar express scan packet
+RECORD_ENCODERS = 2  # left, right ticks: int32
+RECORD_COMMAND = 3  # command payload as received, see BinarySerializer.deserialize_command
+
+
+@dataclass
+class FlightRecord:
+    block_sequence: int
+    timestamp_us: int  # firmware esp_timer time, wraps every 2^32 us
+    type: int
+    payload: bytes
+
+
+def parse_flight_log(data: bytes) -> List[FlightRecord]:
+    """Decodes a flight recorder dump, skipping blocks that fail the checksum."""
+    blocks = []
+    for offset in range(0, len(data) - BLOCK_SIZE + 1, BLOCK_SIZE):
+        block = data[offset:offset + BLOCK_SIZE]
+        magic, sequence, used, crc = _BLOCK_HEADER.unpack_from(block)
+        if magic != _BLOCK_MAGIC or not _BLOCK_HEADER.size <= used <= BLOCK_SIZE:
+            continue
+        if libscrc.hacker16(block[_BLOCK_HEADER.size:used], 0x1021, 0xFFFF, 0x0000, False, False) != crc:
+            continue
+        blocks.append((sequence, block[:used]))
+
+    records = []
+    for sequence, block in sorted(blocks):
+        offset = _BLOCK_HEADER.size
+        while offset + _RECORD_HEADER.size <= len(block):
+            record_type, size, timestamp = _RECORD_HEADER.unpack_from(block, offset)
+            if size < _RECORD_HEADER.size or offset + size > len(block):
+                break
+            payload = block[offset + _RECORD_HEADER.size:offset + size]
+            records.append(FlightRecord(sequence, timestamp, record_type, bytes(payload)))
+            offset += size
+
+    return records
@@ -5,9 +5,14 @@ from .messages import (
     MoveCommand,
     ClawCommand,
     ArmCommand,
+    BearTemplateCommand,
+    LidarFilterCommand,
+    LidarMotorCommand,
+    TelemetryConfigCommand,
     LidarMeasurement,
     EncodersMeasurement,
     Measurements,
+    Telemetry,
 )
 
 
@@ -29,6 +34,38 @@ class JsonSerializer:
             return json.dumps({
                 "command": "arm",
             }).encode("utf-8")
+        elif isinstance(command, LidarFilterCommand):
+            return json.dumps({
+                "command": "lidar_filter",
+                "drop_invalid": command.drop_invalid,
+                "min_distance": command.min_distance,
+                "max_distance": command.max_distance,
+                "min_quality": command.min_quality,
+            }).encode("utf-8")
+        elif isinstance(command, BearTemplateCommand):
+            return json.dumps({
+                "command": "bear_template",
+                "enabled": command.enabled,
+                "jump": command.jump,
+                "max_gap": command.max_gap,
+                "min_points": command.min_points,
+                "width": command.width,
+                "width_tolerance": command.width_tolerance,
+                "min_range": command.min_range,
+                "max_range": command.max_range,
+                "min_covariance_ratio": command.min_covariance_ratio,
+            }).encode("utf-8")
+        elif isinstance(command, LidarMotorCommand):
+            return json.dumps({
+                "command": "lidar_motor",
+                "target_rpm": command.target_rpm,
+            }).encode("utf-8")
+        elif isinstance(command, TelemetryConfigCommand):
+            return json.dumps({
+                "command": "telemetry_config",
+                "period_ms": command.period_ms,
+                "max_lidar_points": command.max_lidar_points,
+            }).encode("utf-8")
         else:
             raise ValueError(f"Unknown command type: {type(command)}")
 
@@ -49,6 +86,34 @@ class JsonSerializer:
             )
         elif command_type == "arm":
             return ArmCommand()
+        elif command_type == "lidar_filter":
+            return LidarFilterCommand(
+                drop_invalid=d["drop_invalid"],
+                min_distance=d["min_distance"],
+                max_distance=d["max_distance"],
+                min_quality=d["min_quality"],
+            )
+        elif command_type == "bear_template":
+            return BearTemplateCommand(
+                enabled=d["enabled"],
+                jump=d["jump"],
+                max_gap=d["max_gap"],
+                min_points=d["min_points"],
+                width=d["width"],
+                width_tolerance=d["width_tolerance"],
+                min_range=d["min_range"],
+                max_range=d["max_range"],
+                min_covariance_ratio=d["min_covariance_ratio"],
+            )
+        elif command_type == "lidar_motor":
+            return LidarMotorCommand(
+                target_rpm=d["target_rpm"],
+            )
+        elif command_type == "telemetry_config":
+            return TelemetryConfigCommand(
+                period_ms=d["period_ms"],
+                max_lidar_points=d["max_lidar_points"],
+            )
         else:
             raise ValueError(f"Unknown command type: {command_type}")
 
@@ -87,3 +152,8 @@ class JsonSerializer:
         )
 
         return Measurements(timestamp=d["timestamp"], lidar=lidar, encoders=encoders)
+
+    @staticmethod
+    def deserialize_telemetry(data: bytes) -> Telemetry:
+        # the JSON protocol only carries measurements
+        return JsonSerializer.deserialize_measurements(data)
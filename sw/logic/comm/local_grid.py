@@ -0,0 +1,52 @@
+import numpy as np
+
+from .messages import LocalGridTiles
+
+CELL_SIZE = 0.02  # m
+TILE_CELLS = 10
+TILES = 10  # per side of the window
+LOG_ODDS_SCALE = 16.0  # cell value of one nat
+
+
+class LocalGridMap:
+    """
+    The robot's local occupancy grid, assembled from LocalGridTiles messages. The window follows the
+    robot in whole tiles; tiles that leave it are forgotten, as on the robot, and tiles never sent are
+    unknown (log-odds 0).
+    """
+
+    def __init__(self) -> None:
+        self.tiles: dict[tuple[int, int], np.ndarray] = {}
+        self.origin_tile = (-TILES // 2, -TILES // 2)
+        self.pose = (0.0, 0.0, 0.0)  # x, y in m and theta in rad, grid frame
+
+    def reset(self) -> None:
+        self.__init__()
+
+    def apply(self, update: LocalGridTiles) -> None:
+        self.origin_tile = update.origin_tile
+        self.pose = (update.x, update.y, update.theta)
+        ox, oy = self.origin_tile
+        self.tiles = {
+            tile: cells for tile, cells in self.tiles.items() if ox <= tile[0] < ox + TILES and oy <= tile[1] < oy + TILES
+        }
+        self.tiles.update(update.tiles)
+
+    @property
+    def origin(self) -> tuple[float, float]:
+        """Grid frame position of the window's lowest corner, in m."""
+        return self.origin_tile[0] * TILE_CELLS * CELL_SIZE, self.origin_tile[1] * TILE_CELLS * CELL_SIZE
+
+    def log_odds(self) -> np.ndarray:
+        """(100, 100) int8 in 1/16 nat, indexed [y, x] from `origin`."""
+        grid = np.zeros((TILES * TILE_CELLS, TILES * TILE_CELLS), dtype=np.int8)
+        ox, oy = self.origin_tile
+        for (tile_x, tile_y), cells in self.tiles.items():
+            x = (tile_x - ox) * TILE_CELLS
+            y = (tile_y - oy) * TILE_CELLS
+            grid[y : y + TILE_CELLS, x : x + TILE_CELLS] = cells
+        return grid
+
+    def probabilities(self) -> np.ndarray:
+        """Occupancy probability of every cell, 0.5 where unknown."""
+        return 1.0 / (1.0 + np.exp(-self.log_odds().astype("f") / LOG_ODDS_SCALE))
@@ -0,0 +1,98 @@
+"""Offline formatting of the firmware's deferred log (protocol/binlog.h).
+
+The robot only sends the ID of a format string and the raw arguments. The
+table from ID to format string is generated by sw/protocol/tools/log_table.py
+during the firmware build (build/log_formats.json). When that file is
+missing, the sources are scanned at load time instead.
+"""
+
+from __future__ import annotations
+
+import importlib.util
+import json
+import re
+import struct
+from pathlib import Path
+from typing import Optional
+
+_SW_DIR = Path(__file__).resolve().parents[2]
+DEFAULT_TABLE_PATH = _SW_DIR / "firmware" / "build" / "log_formats.json"
+_TABLE_TOOL_PATH = _SW_DIR / "protocol" / "tools" / "log_table.py"
+_SOURCE_DIRS = (_SW_DIR / "firmware" / "main", _SW_DIR / "protocol" / "include")
+
+LEVEL_NAMES = {1: "E", 2: "W", 3: "I", 4: "D"}
+
+# printf conversion, flags and width kept, length modifiers dropped
+_CONVERSION = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z|j|t|L)?([diouxXeEfgGcsp%])")
+
+
+def decode_args(data: bytes) -> tuple:
+    """Arguments of one record: struct codes each followed by the value, strings with a length byte."""
+    args = []
+    offset = 0
+    while offset < len(data):
+        code = chr(data[offset])
+        offset += 1
+        if code == "s":
+            length = data[offset]
+            args.append(data[offset + 1 : offset + 1 + length].decode("latin-1"))
+            offset += 1 + length
+            continue
+        (value,) = struct.unpack_from("<" + code, data, offset)
+        args.append(value)
+        offset += struct.calcsize("<" + code)
+    return tuple(args)
+
+
+def _to_python(fmt: str, args: tuple) -> str:
+    index = 0
+
+    def convert(match: re.Match) -> str:
+        nonlocal index
+        spec, conversion = match.groups()
+        if conversion == "%":
+            return "%"
+        value = args[index] if index < len(args) else None
+        index += 1
+        if value is None:
+            return "?"
+        if conversion in "up":
+            conversion = "d" if conversion == "u" else "x"
+        try:
+            return f"%{spec}{conversion}" % value
+        except (TypeError, ValueError):
+            return str(value)
+
+    return _CONVERSION.sub(convert, fmt)
+
+
+def _scan_sources() -> dict[int, dict]:
+    # the generator is a standalone script next to the protocol library
+    spec = importlib.util.spec_from_file_location("log_table", _TABLE_TOOL_PATH)
+    if spec is None or spec.loader is None:
+        return {}
+    tool = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(tool)
+    return tool.scan_sources(tool.source_files(_SOURCE_DIRS))
+
+
+class LogFormatter:
+    def __init__(self, table: dict[int, dict]):
+        self.table = table
+
+    @classmethod
+    def load(cls, path: Optional[Path] = None) -> "LogFormatter":
+        """Reads the table generated by the firmware build, or scans the sources if there is none."""
+        path = Path(path) if path is not None else DEFAULT_TABLE_PATH
+        if path.exists():
+            entries = json.loads(path.read_text(encoding="utf-8"))
+            return cls({int(key): value for key, value in entries.items()})
+        return cls(_scan_sources())
+
+    def format(self, record) -> str:
+        """One line for a `LogRecord`: robot time, level, location and the message."""
+        entry = self.table.get(record.format_id)
+        level = LEVEL_NAMES.get(record.level, "?")
+        if entry is None:
+            return f"[{record.timestamp_us / 1e6:10.6f}] {level} unknown format {record.format_id:08x} {record.args}"
+        return f"[{record.timestamp_us / 1e6:10.6f}] {level} {entry['file']}:{entry['line']}: {_to_python(entry['format'], record.args)}"
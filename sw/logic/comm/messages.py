@@ -1,5 +1,30 @@
-from dataclasses import dataclass
-from typing import List, Union
+from dataclasses import dataclass, field
+from typing import List, Optional, Sequence, Union, overload
+
+import numpy as np
+
+
+# Telemetry streams of SubscribeCommand
+
+STREAM_MEASUREMENTS = 0  # the Measurements frame, its period is the telemetry period
+STREAM_ENCODERS = 1
+STREAM_LIDAR_MOTOR = 2
+STREAM_COLLISION_GUARD = 3
+STREAM_LINK = 4
+STREAM_LOCAL_GRID = 5  # LocalGridTiles messages
+
+STREAM_OFF = 0.0
+STREAM_ON_CHANGE = -1.0  # sent whenever the value changes, checked on every control loop wake
+
+# GraspCommand actions
+GRASP_STOP = 0
+GRASP_CLOSE = 1
+GRASP_OPEN = 2
+
+# GraspEvent results
+GRASP_STALLED = 1  # both claws stalled: closed on the object, or fully open
+GRASP_TIMED_OUT = 2
+GRASP_ABORTED = 3  # replaced by another grasp or claw command
 
 
 # Commands
@@ -20,6 +45,119 @@ class ClawCommand:
 class ArmCommand:
     pass
 
+
+@dataclass
+class LidarFilterCommand:
+    drop_invalid: bool = True
+    min_distance: float = 0.0  # meters
+    max_distance: Optional[float] = None  # meters, None = no limit
+    min_quality: int = 0  # standard scan only, express scans carry no quality
+
+
+@dataclass
+class BearTemplateCommand:
+    enabled: bool = True
+    jump: float = 0.06  # m, range step that splits lidar segments
+    max_gap: float = 3.0  # degrees, angular gap that splits lidar segments
+    min_points: int = 3
+    width: float = 0.1  # m, expected visible width of the bear
+    width_tolerance: float = 0.05  # m
+    min_range: float = 0.1  # m
+    max_range: float = 3.0  # m
+    min_covariance_ratio: float = 0.01  # rejects straight segments
+
+
+@dataclass
+class FieldUploadBeginCommand:
+    size: int
+
+
+@dataclass
+class FieldUploadDataCommand:
+    offset: int
+    data: bytes
+
+
+@dataclass
+class FieldUploadEndCommand:
+    crc: int  # CRC-16/CCITT-FALSE of the whole file
+
+
+@dataclass
+class ScoreParticlesCommand:
+    sequence: int
+    xs: Sequence[float]  # m
+    ys: Sequence[float]  # m
+    thetas: Sequence[float]  # rad
+
+
+@dataclass
+class RecorderDumpCommand:
+    pass
+
+
+@dataclass
+class ProfileDumpCommand:
+    reset: bool = False  # clear the histograms after sending them
+
+
+@dataclass
+class LidarMotorCommand:
+    target_rpm: int  # 0 = open loop, motor at full duty
+
+
+@dataclass
+class TelemetryConfigCommand:
+    period_ms: int = 30  # a measurements frame is sent at least this often
+    max_lidar_points: int = 96  # per frame, a frame is sent early once this many are waiting
+
+
+@dataclass
+class LidarOutputCommand:
+    cartesian: bool = True  # robot-frame x / y points instead of angle / distance pairs
+    motion_compensation: bool = False  # compensate the motion during each frame on the robot
+    mount_x: float = 0.0  # m, lidar position in the robot frame
+    mount_y: float = 0.0  # m
+    mount_theta: float = 0.0  # rad, lidar zero direction in the robot frame
+    raw: bool = False  # forward the express packets undecoded as LidarRawPackets, overrides cartesian
+
+
+@dataclass
+class MotorTraceCommand:
+    capture_now: bool = True  # record right away
+    stall_trigger: bool = False  # record when a driven motor stalls; neither flag stops the trace
+    period_us: int = 1000  # sample period, at least 200
+    post_trigger: int = 768  # samples kept after the trigger, of 1024
+    stall_speed: int = 50  # ticks/s, a driven motor slower than this counts as stalled
+    stall_samples: int = 50  # consecutive stalled samples that trigger the capture
+
+
+@dataclass
+class CollisionGuardCommand:
+    enabled: bool = True
+    # convex keep-out polygon at standstill, robot frame in m, at most 8 vertices
+    polygon: Sequence[tuple[float, float]] = ((0.25, 0.15), (-0.2, 0.15), (-0.2, -0.15), (0.25, -0.15))
+    lookahead: float = 0.5  # s, the polygon is stretched by the distance the commanded speed covers in this time
+    min_points: int = 3  # points inside the polygon in one lidar packet that count as an obstacle
+    clear_time: float = 0.2  # s without an obstacle before the block is released
+
+
+@dataclass
+class GraspCommand:
+    action: int = GRASP_CLOSE
+    close_pwm: int = -800  # as in ClawCommand, opening uses the opposite direction
+    ramp_time: float = 0.15  # s, the pwm rises from 0 to close_pwm
+    timeout: float = 1.5  # s, closing or opening ends here at the latest
+    stall_current: float = 0.6  # A, a claw above this counts as stalled
+    stall_time: float = 0.04  # s above stall_current, longer than the inrush at start
+    hold_pwm: int = -300  # a closed claw is held with this
+
+
+@dataclass
+class SubscribeCommand:
+    # stream -> period in s, STREAM_OFF or STREAM_ON_CHANGE; streams not listed keep their subscription
+    streams: dict[int, float]
+
 # Sensor measurements
 
 
@@ -29,17 +167,296 @@ class LidarMeasurement:
     distance: float
 
 
+class LidarPoints(Sequence[LidarMeasurement]):
+    """Lidar points decoded in bulk, held as two contiguous float32 arrays."""
+
+    def __init__(self, angles: np.ndarray, distances: np.ndarray) -> None:
+        self.angles = angles
+        self.distances = distances
+
+    def __len__(self) -> int:
+        return len(self.angles)
+
+    @overload
+    def __getitem__(self, index: int) -> LidarMeasurement: ...
+
+    @overload
+    def __getitem__(self, index: slice) -> List[LidarMeasurement]: ...
+
+    def __getitem__(self, index: Union[int, slice]) -> Union[LidarMeasurement, List[LidarMeasurement]]:
+        if isinstance(index, slice):
+            return [self[i] for i in range(*index.indices(len(self)))]
+        return LidarMeasurement(angle=float(self.angles[index]), distance=float(self.distances[index]))
+
+    def __repr__(self) -> str:
+        return f"LidarPoints({len(self)} points)"
+
+
+def lidar_arrays(lidar: Sequence[LidarMeasurement]) -> tuple[np.ndarray, np.ndarray]:
+    """Angles and distances of `lidar` as float32 arrays, without copying bulk-decoded points."""
+    if isinstance(lidar, LidarPoints):
+        return lidar.angles, lidar.distances
+    angles = np.array([beam.angle for beam in lidar], dtype="f")
+    distances = np.array([beam.distance for beam in lidar], dtype="f")
+    return angles, distances
+
+
 @dataclass
 class EncodersMeasurement:
     left_ticks: int
     right_ticks: int
 
 
+@dataclass
+class LidarFilterStats:
+    invalid: int = 0
+    out_of_range: int = 0
+    low_quality: int = 0
+
+
+@dataclass
+class LidarBatchStats:
+    backlog: int = 0  # points left waiting in the firmware after this frame
+    source_backlog: int = 0  # bytes not yet read from the lidar UART
+    age_us: int = 0  # time the oldest point of this frame spent waiting
+    dropped: int = 0  # points discarded since the previous frame because the link could not keep up
+
+
+@dataclass
+class CommandLaneStats:
+    coalesced: int = 0  # move setpoints replaced by a newer one before they were applied
+    preempted: int = 0  # move setpoints discarded because a later stop overtook them
+    dropped: int = 0  # claw / arm commands refused because their queue was full
+
+
 @dataclass
 class Measurements:
     timestamp: int
-    lidar: List[LidarMeasurement]
+    lidar: Sequence[LidarMeasurement]
     encoders: EncodersMeasurement
+    lidar_filtered: LidarFilterStats = field(default_factory=LidarFilterStats)
+    lidar_rpm: int = 0  # measured lidar revolution rate, 0 = unknown
+    lidar_batch: LidarBatchStats = field(default_factory=LidarBatchStats)
+    command_lanes: CommandLaneStats = field(default_factory=CommandLaneStats)
+    # robot-frame x / y arrays in m, set instead of `lidar` by the Cartesian output mode
+    lidar_xy: Optional[tuple[np.ndarray, np.ndarray]] = None
+    motion_compensated: bool = False  # the robot already compensated the motion during the frame
+
+
+@dataclass
+class BearCandidate:
+    angle: float  # rad, same convention as LidarMeasurement
+    distance: float  # m, to the centroid of the visible points
+    width: float  # m
+    points: int
+    score: float  # 0.0 - 1.0
+
+
+@dataclass
+class BearCandidates:
+    timestamp: int
+    candidates: List[BearCandidate]
+
+
+@dataclass
+class ParticleScores:
+    sequence: int
+    scan_timestamp: int
+    points: int  # scan points the costs are summed over, 0 if the firmware has no likelihood field
+    costs: List[int]  # -ln(likelihood) * cost_scale summed over the scan, per particle
+
+
+@dataclass
+class FieldUploadResult:
+    ok: bool
+
+
+@dataclass
+class LidarStartupReport:
+    ok: bool
+    attempts: int
+    health: int  # 0 = good, 1 = warning, 2 = error, 255 = unknown
+    model: int
+    firmware_major: int
+    firmware_minor: int
+    hardware: int
+    phase_us: List[int]  # stop, reset, health, info, scan
+
+
+@dataclass
+class ScanMatch:
+    timestamp: int  # us, when the revolution was matched
+    dx: float  # m, robot frame of the previous revolution
+    dy: float  # m
+    dtheta: float  # rad
+    quality: float  # share of points that fit the previous revolution, 0.0 - 1.0
+    iterations: int
+    matched: int  # points with a correspondence
+    duration_us: int  # time the matcher took on the robot
+
+
+@dataclass
+class GuardEvent:
+    """The collision guard blocked or released a direction of travel."""
+
+    timestamp: int
+    blocked: int  # 1 forward, -1 backward, 0 released
+    points: int  # points inside the keep-out polygon in the packet
+    nearest_x: float  # m, robot frame, intruding point closest to the robot
+    nearest_y: float
+    left_speed: float  # m/s, commanded at the time
+    right_speed: float
+    reaction_us: int  # from reading the lidar packet to the motors being set
+
+
+@dataclass
+class GraspEvent:
+    """A grasp sequence ended."""
+
+    timestamp: int
+    action: int  # GRASP_CLOSE or GRASP_OPEN
+    result: int  # GRASP_STALLED, GRASP_TIMED_OUT or GRASP_ABORTED
+    duration: float  # s, from the command
+    stall_times: tuple[Optional[float], Optional[float]]  # s from the command to each claw stalling, left first
+    peak_currents: tuple[float, float]  # A, 0 without current sense
+
+
+@dataclass
+class LidarRawPackets:
+    """Express scan packets as the lidar sent them, decoded on the host with ExpressDecoder."""
+
+    timestamp: int
+    dropped: int  # packets discarded on the robot because the link could not keep up
+    checksum_errors: int  # packets the lidar sent with a wrong checksum
+    arrival_us: np.ndarray  # int64, firmware time each packet was read
+    sequences: np.ndarray  # uint8, counts the packets read, a gap means packets are missing
+    packets: np.ndarray  # (packets, 84) uint8, sync bytes included
+
+
+@dataclass
+class StreamSample:
+    """Values of the subscribed streams that were due, the others are None."""
+
+    timestamp: int
+    encoders: Optional[EncodersMeasurement] = None
+    lidar_rpm: Optional[int] = None
+    lidar_target_rpm: Optional[int] = None
+    guard_blocked: Optional[int] = None  # 1 forward, -1 backward, 0 clear
+    guard_left_speed: Optional[float] = None  # m/s, applied after the collision guard
+    guard_right_speed: Optional[float] = None
+    tx_free: Optional[int] = None  # bytes free in the robot's transmit buffer
+    tx_dropped: Optional[int] = None  # frames the robot dropped since boot
+
+
+@dataclass
+class LocalGridTiles:
+    """Tiles of the robot's local occupancy grid that changed, assembled with LocalGridMap."""
+
+    timestamp: int
+    x: float  # m, robot pose in the grid frame, the odometry frame since the grid was switched on
+    y: float
+    theta: float  # rad
+    origin_tile: tuple[int, int]  # grid frame tile of the window's lowest x and y
+    tiles: dict[tuple[int, int], np.ndarray]  # tile -> (10, 10) int8 log-odds in 1/16 nat, indexed [y, x]
+
+
+@dataclass
+class MotorTraceChunk:
+    """Part of a motor regulation capture. Arrays are (samples, 2), left motor first."""
+
+    reason: int  # 1 = command, 2 = stall
+    period_us: int
+    total: int  # samples in the whole capture
+    trigger: int  # index of the sample that triggered the capture
+    offset: int  # index of the first sample of this chunk
+    setpoints: np.ndarray  # ticks/s, as given to the regulator
+    speeds: np.ndarray  # ticks/s, measured over the sample period
+    positions: np.ndarray  # ticks
+
+    @property
+    def errors(self) -> np.ndarray:
+        return self.setpoints.astype(np.int32) - self.speeds
+
+
+@dataclass
+class ProfileSection:
+    """Duration histogram of one profiled section on one core, from the robot or the host library."""
+
+    index: int  # position in the dump
+    total: int  # messages in the dump
+    ticks_per_us: int  # CPU cycles per us on the robot, 1000 (ns) on the host
+    core: int
+    name: str
+    count: int
+    total_ticks: int
+    max_ticks: int
+    first_bucket: int
+    buckets: List[int]  # buckets[i] counts durations of [2^(first_bucket + i), 2^(first_bucket + i + 1)) ticks
+
+    @property
+    def mean_us(self) -> float:
+        return self.total_ticks / self.count / self.ticks_per_us if self.count else 0.0
+
+    @property
+    def max_us(self) -> float:
+        return self.max_ticks / self.ticks_per_us
+
+
+@dataclass
+class LogRecord:
+    timestamp_us: int  # robot time, wraps every 71 minutes
+    level: int  # 1 = error, 2 = warning, 3 = info, 4 = debug
+    format_id: int  # key into the table of comm.log_format
+    args: tuple
+
+
+@dataclass
+class LogBatch:
+    dropped: int  # records lost since the previous batch because the ring on the robot was full
+    records: List[LogRecord]
+
+
+@dataclass
+class RecorderChunk:
+    offset: int
+    total: int  # size of the whole dump, 0 if the flight log is empty
+    data: bytes
 
 
-Command = Union[MoveCommand, ClawCommand, ArmCommand]
+Command = Union[
+    MoveCommand,
+    ClawCommand,
+    ArmCommand,
+    LidarFilterCommand,
+    BearTemplateCommand,
+    FieldUploadBeginCommand,
+    FieldUploadDataCommand,
+    FieldUploadEndCommand,
+    ScoreParticlesCommand,
+    RecorderDumpCommand,
+    LidarMotorCommand,
+    TelemetryConfigCommand,
+    ProfileDumpCommand,
+    LidarOutputCommand,
+    MotorTraceCommand,
+    CollisionGuardCommand,
+    SubscribeCommand,
+    GraspCommand,
+]
+Telemetry = Union[
+    Measurements,
+    BearCandidates,
+    ParticleScores,
+    FieldUploadResult,
+    RecorderChunk,
+    LidarStartupReport,
+    ScanMatch,
+    ProfileSection,
+    LogBatch,
+    MotorTraceChunk,
+    GuardEvent,
+    LidarRawPackets,
+    StreamSample,
+    LocalGridTiles,
+    GraspEvent,
+]
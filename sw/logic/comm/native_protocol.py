@@ -0,0 +1,156 @@
+"""Bindings to the shared protocol library in sw/protocol.
+
+The library is built next to this module by `python setup.py build_ext --inplace`.
+When it is missing or was built from a different ABI version, `available()`
+is False and the serializers fall back to their pure Python decoders.
+"""
+
+from __future__ import annotations
+
+import ctypes
+import importlib.util
+import struct
+import threading
+from collections import namedtuple
+from typing import Any, Optional
+
+import numpy as np
+
+_ABI_VERSION = 4
+
+
+class MeasurementsFields(ctypes.Structure):
+    _fields_ = [
+        ("timestamp", ctypes.c_int64),
+        ("left_ticks", ctypes.c_int32),
+        ("right_ticks", ctypes.c_int32),
+        ("filtered_invalid", ctypes.c_uint16),
+        ("filtered_out_of_range", ctypes.c_uint16),
+        ("filtered_low_quality", ctypes.c_uint16),
+        ("lidar_rpm", ctypes.c_uint16),
+        ("batch_backlog", ctypes.c_uint16),
+        ("batch_source_backlog", ctypes.c_uint16),
+        ("batch_age_us", ctypes.c_uint32),
+        ("batch_dropped", ctypes.c_uint16),
+        ("commands_coalesced", ctypes.c_uint16),
+        ("commands_preempted", ctypes.c_uint16),
+        ("commands_dropped", ctypes.c_uint16),
+        ("cartesian", ctypes.c_uint8),
+        ("motion_compensated", ctypes.c_uint8),
+    ]
+
+
+# the same fields as a plain struct, natively aligned like the ctypes one
+_FIELDS_STRUCT = struct.Struct("@" + "".join(kind._type_ for _, kind in MeasurementsFields._fields_))
+_FieldsTuple = namedtuple("MeasurementsFieldsTuple", [name for name, _ in MeasurementsFields._fields_])
+
+
+def _load(path: Optional[str] = None) -> Optional[ctypes.CDLL]:
+    """Loads the library built next to this module, or the one at `path`."""
+    if path is None:
+        spec = importlib.util.find_spec(f"{__package__}._protocol")
+        if spec is None or spec.origin is None:
+            return None
+        path = spec.origin
+    try:
+        lib = ctypes.CDLL(path)
+    except OSError:
+        return None
+
+    lib.lily_protocol_abi_version.restype = ctypes.c_uint32
+    lib.lily_measurements_struct_size.restype = ctypes.c_size_t
+    if lib.lily_protocol_abi_version() != _ABI_VERSION or lib.lily_measurements_struct_size() != ctypes.sizeof(MeasurementsFields):
+        return None
+
+    lib.lily_decode_measurements.restype = ctypes.c_int32
+    lib.lily_decode_measurements.argtypes = [
+        ctypes.c_char_p,
+        ctypes.c_size_t,
+        # addresses of the reused buffers of _MeasurementsDecoder
+        ctypes.c_void_p,
+        ctypes.c_void_p,
+        ctypes.c_void_p,
+        ctypes.c_size_t,
+    ]
+    lib.lily_profile_dump.restype = ctypes.c_size_t
+    lib.lily_profile_dump.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.c_int]
+    return lib
+
+
+_lib = _load()
+
+
+def available() -> bool:
+    return _lib is not None
+
+
+class _MeasurementsDecoder:
+    """Output buffers of lily_decode_measurements, allocated once and reused.
+
+    Setting up ctypes arguments (a fields struct, two arrays and their pointers) cost more
+    than decoding a frame; with the buffers kept, a call only copies out the decoded points.
+    """
+
+    def __init__(self, capacity: int = 1024) -> None:
+        self._lock = threading.Lock()
+        self._fields = MeasurementsFields()
+        self._fields_address = ctypes.addressof(self._fields)
+        self._reserve(capacity)
+
+    def _reserve(self, capacity: int) -> None:
+        self._first = np.empty(capacity, dtype=np.float32)
+        self._second = np.empty(capacity, dtype=np.float32)
+        self._first_address = self._first.ctypes.data
+        self._second_address = self._second.ctypes.data
+
+    def decode(self, lib: ctypes.CDLL, data: bytes) -> tuple[Any, np.ndarray, np.ndarray]:
+        if not isinstance(data, bytes):
+            data = bytes(data)
+        # the point count follows the type byte and the timestamp
+        capacity = int.from_bytes(data[9:11], "little") if len(data) >= 11 else 0
+        with self._lock:
+            if capacity > len(self._first):
+                self._reserve(capacity)
+            count = lib.lily_decode_measurements(
+                data, len(data), self._fields_address, self._first_address, self._second_address, len(self._first)
+            )
+            if count < 0:
+                raise ValueError("Not a measurements payload")
+            fields = _FieldsTuple._make(_FIELDS_STRUCT.unpack_from(self._fields))
+            return fields, self._first[:count].copy(), self._second[:count].copy()
+
+
+_decoder = _MeasurementsDecoder()
+
+
+def decode_measurements(data: bytes) -> tuple[Any, np.ndarray, np.ndarray]:
+    """Decodes a measurements payload into its fields and two float32 arrays.
+
+    The fields are a named tuple with the members of `MeasurementsFields`. The
+    arrays hold angles and distances, or x and y in the robot frame if
+    `fields.cartesian` is set; they belong to the caller.
+    """
+    assert _lib is not None
+    return _decoder.decode(_lib, data)
+
+
+def profile_dump(reset: bool = False) -> list[bytes]:
+    """Profile message payloads of the library, in the format the robot sends them."""
+    assert _lib is not None
+    size = _lib.lily_profile_dump(None, 0, 0)
+    while True:
+        buffer = ctypes.create_string_buffer(size)
+        needed = _lib.lily_profile_dump(buffer, size, int(reset))
+        if needed <= size:
+            size = needed
+            break
+        # a section was added in between
+        size = needed
+
+    payloads = []
+    offset = 0
+    while offset + 2 <= size:
+        length = int.from_bytes(buffer.raw[offset : offset + 2], "little")
+        payloads.append(buffer.raw[offset + 2 : offset + 2 + length])
+        offset += 2 + length
+    return payloads
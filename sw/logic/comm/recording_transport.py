@@ -8,6 +8,10 @@ from typing import Optional
 from .types import MessageCallback, Transport
 
 
+# version in the "format" row at the start of a recording, see notes/control_protocol.md
+RECORDING_FORMAT = 2
+
+
 class RecordingTransport(Transport, MessageCallback):
     def __init__(self, transport: Transport, csv_path: str):
         self.transport = transport
@@ -26,7 +30,7 @@ class RecordingTransport(Transport, MessageCallback):
                     "payload",
                 ]
             )
-            self._csv_file.flush()
+            self._write_csv_row(event="format", payload=str(RECORDING_FORMAT).encode("ascii"))
 
     def connect(self) -> None:
         self.transport.connect()
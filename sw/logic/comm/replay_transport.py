@@ -8,6 +8,10 @@ from typing import Optional
 from .types import MessageCallback, Transport
 
 
+# telemetry payloads of format 1 recordings are measurements without the type byte
+_LEGACY_MEASUREMENTS_TYPE = b"\x01"
+
+
 @dataclass(frozen=True)
 class _ReplayEvent:
     timestamp: datetime
@@ -114,7 +118,12 @@ class ReplayTransport(Transport):
         with open(csv_path, "r", newline="", encoding="utf-8") as csv_file:
             reader = csv.DictReader(csv_file)
             events: list[_ReplayEvent] = []
+            # recordings from before the type byte have no format row
+            legacy = True
             for row in reader:
+                if row.get("event") == "format":
+                    legacy = (row.get("payload") or "1") == "1"
+                    continue
                 if row.get("event") != "receive":
                     continue
 
@@ -128,7 +137,11 @@ class ReplayTransport(Transport):
                 except ValueError:
                     continue
 
-                events.append(_ReplayEvent(timestamp=timestamp, payload=ReplayTransport._decode_payload(payload)))
+                data = ReplayTransport._decode_payload(payload)
+                # binary payloads are stored base64 encoded, JSON payloads as text were never typed
+                if legacy and payload.startswith("b64:"):
+                    data = _LEGACY_MEASUREMENTS_TYPE + data
+                events.append(_ReplayEvent(timestamp=timestamp, payload=data))
 
         events.sort(key=lambda event: event.timestamp)
         return events
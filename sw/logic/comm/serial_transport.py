@@ -2,37 +2,69 @@ from __future__ import annotations
 
 import struct
 import threading
+import time
 from typing import Optional
 
 import serial
 import libscrc
 
+from .cobs import cobs_decode, cobs_encode
 from .types import MessageCallback, Transport
 
 
 # CRC-8 (polynomial 0x07, init 0xFF, final_xor 0xFF).
 # Matches raw esp_rom_crc8_be(0, ...) behavior.
 
+# CRC-16/CCITT-FALSE (polynomial 0x1021, init 0xFFFF, no final xor).
+# Matches comm::crc16() in the firmware.
+
+
+FRAMING_V1 = 1
+FRAMING_V2 = 2
+
 
 class SerialTransport(Transport):
     _FRAME_INIT = 0xA5
     _HEADER_SIZE = 6
     _MAX_PAYLOAD_SIZE = 2048
+    _MAX_FRAME_V2_SIZE = 1 + _MAX_PAYLOAD_SIZE + 2 + (1 + _MAX_PAYLOAD_SIZE + 2) // 254 + 1
+    # a framing request that is not acknowledged by then is sent again
+    _NEGOTIATION_RETRY_S = 0.25
 
     def __init__(
         self,
         device: str,
         baud_rate: int = 921600,
         timeout: float = 0.05,
+        framing: int = FRAMING_V2,
+        negotiation_timeout: float = 2.0,
+        silence_timeout: float = 1.0,
     ) -> None:
+        """
+        `negotiation_timeout` covers the reset the ESP32 goes through when the port is opened, after it
+        the link falls back to v1. Once in v2, a link without a valid frame for `silence_timeout`
+        negotiates again, since the firmware is back in v1 after a reboot.
+        """
+        if framing not in (FRAMING_V1, FRAMING_V2):
+            raise ValueError(f"Unknown framing: {framing}")
+
         self.device = device
         self.baud_rate = baud_rate
         self.timeout = timeout
+        self.framing = framing
+        self.negotiation_timeout = negotiation_timeout
+        self.silence_timeout = silence_timeout
+        self.renegotiations = 0
+        self._requested_framing = framing
         self._serial: Optional[serial.Serial] = None
         self._receive_thread: Optional[threading.Thread] = None
         self._running = False
         self._callback: Optional[MessageCallback] = None
         self._tx_nonce = 0
+        self._write_lock = threading.Lock()
+        self._rx_buffer = bytearray()
+        self._last_frame_time = 0.0
+        self._next_request_time = 0.0
 
     def connect(self) -> None:
         if self._serial is not None:
@@ -44,6 +76,50 @@ class SerialTransport(Transport):
             timeout=self.timeout,
         )
 
+        if self._requested_framing != FRAMING_V1 and not self._negotiate_framing():
+            self._fall_back_to_v1()
+
+    def _negotiate_framing(self) -> bool:
+        """Switches the link to v2, returns false if the firmware did not acknowledge it in time."""
+        self.framing = FRAMING_V2
+        self._rx_buffer.clear()
+        deadline = time.monotonic() + self.negotiation_timeout
+        while time.monotonic() < deadline:
+            self._send_framing_request(FRAMING_V2)
+            retry_at = min(deadline, time.monotonic() + self._NEGOTIATION_RETRY_S)
+            while time.monotonic() < retry_at:
+                # frames read before the acknowledgement are telemetry nobody listens to yet
+                if any(not payload for payload in self._read_frames_v2()):
+                    self._last_frame_time = time.monotonic()
+                    return True
+        return False
+
+    def _fall_back_to_v1(self) -> None:
+        # a firmware that is in v2 without answering switches back, one that only knows v1 ignores it
+        self._send_framing_request(FRAMING_V1)
+        self.framing = FRAMING_V1
+        self._rx_buffer.clear()
+
+    def _send_framing_request(self, framing: int) -> None:
+        """Asks the firmware to switch framing.
+
+        The request is an empty frame whose nonce carries the framing version.
+        It is sent in both framings (with a delimiter in between) because the
+        firmware may still be in v2 from a previous session.
+        """
+        assert self._serial is not None
+        with self._write_lock:
+            self._serial.write(self._frame_payload(framing, b"") + b"\x00" + self._frame_payload_v2(framing, b""))
+
+    def _check_silence(self) -> None:
+        # a v2 link that went quiet is most likely talking to a firmware that rebooted into v1
+        now = time.monotonic()
+        if now - self._last_frame_time < self.silence_timeout or now < self._next_request_time:
+            return
+        self._next_request_time = now + self._NEGOTIATION_RETRY_S
+        self.renegotiations += 1
+        self._send_framing_request(FRAMING_V2)
+
     def start_receiving(self, callback: MessageCallback) -> None:
         self._callback = callback
         if self._serial is None:
@@ -53,6 +129,7 @@ class SerialTransport(Transport):
             return
 
         self._running = True
+        self._last_frame_time = time.monotonic()
         self._receive_thread = threading.Thread(target=self._receive_loop, daemon=True)
         self._receive_thread.start()
 
@@ -68,9 +145,13 @@ class SerialTransport(Transport):
         if len(data) > self._MAX_PAYLOAD_SIZE:
             raise ValueError(f"Payload too large: {len(data)} > {self._MAX_PAYLOAD_SIZE}")
 
-        frame = self._frame_payload(self._tx_nonce, data)
+        if self.framing == FRAMING_V2:
+            frame = self._frame_payload_v2(self._tx_nonce, data)
+        else:
+            frame = self._frame_payload(self._tx_nonce, data)
         self._tx_nonce = (self._tx_nonce + 1) & 0xFF
-        self._serial.write(frame)
+        with self._write_lock:
+            self._serial.write(frame)
 
     def close(self) -> None:
         self.stop_receiving()
@@ -81,14 +162,24 @@ class SerialTransport(Transport):
     def _receive_loop(self) -> None:
         while self._running:
             try:
-                payload = self._read_frame()
+                if self.framing == FRAMING_V2:
+                    payloads = self._read_frames_v2()
+                    if payloads:
+                        self._last_frame_time = time.monotonic()
+                    else:
+                        self._check_silence()
+                else:
+                    payload = self._read_frame()
+                    payloads = [payload] if payload is not None else []
             except Exception as error:
                 if self._running and self._callback is not None:
                     self._callback.on_error(error)
                 continue
 
-            if payload is not None and self._callback is not None:
-                self._callback.on_message(payload)
+            for payload in payloads:
+                # empty frames are transport control frames (framing acks)
+                if payload and self._callback is not None:
+                    self._callback.on_message(payload)
 
     def _read_frame(self) -> Optional[bytes]:
         if self._serial is None:
@@ -120,6 +211,34 @@ class SerialTransport(Transport):
             return None
         return payload
 
+    def _read_frames_v2(self) -> list[bytes]:
+        if self._serial is None:
+            return []
+
+        chunk = self._serial.read(max(1, self._serial.in_waiting))
+        if not chunk:
+            return []
+
+        self._rx_buffer.extend(chunk)
+        *frames, rest = self._rx_buffer.split(b"\x00")
+        self._rx_buffer = bytearray(rest) if len(rest) <= self._MAX_FRAME_V2_SIZE else bytearray()
+
+        payloads = []
+        for encoded in frames:
+            if not encoded or len(encoded) > self._MAX_FRAME_V2_SIZE:
+                continue
+            try:
+                body = cobs_decode(bytes(encoded))
+            except ValueError:
+                continue
+            if len(body) < 3:
+                continue
+            (checksum,) = struct.unpack_from("<H", body, len(body) - 2)
+            if self._compute_checksum16(body[:-2]) != checksum:
+                continue
+            payloads.append(body[1:-2])
+        return payloads
+
     def _read_exact(self, size: int) -> Optional[bytes]:
         if self._serial is None:
             return None
@@ -143,6 +262,16 @@ class SerialTransport(Transport):
         checksum = cls._compute_checksum(header_without_checksum)
         return header_without_checksum + bytes((checksum,)) + payload
 
+    @classmethod
+    def _frame_payload_v2(cls, nonce: int, payload: bytes) -> bytes:
+        body = bytes((nonce & 0xFF,)) + payload
+        body += struct.pack("<H", cls._compute_checksum16(body))
+        return cobs_encode(body) + b"\x00"
+
     @staticmethod
     def _compute_checksum(data: bytes) -> int:
         return libscrc.hacker8(data, 0x07, 0xFF, 0xFF, False, False)
+
+    @staticmethod
+    def _compute_checksum16(data: bytes) -> int:
+        return libscrc.hacker16(data, 0x1021, 0xFFFF, 0x0000, False, False)
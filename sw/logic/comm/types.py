@@ -1,6 +1,6 @@
 from typing import Protocol
 
-from .messages import Command, Measurements
+from .messages import Command, Measurements, Telemetry
 
 
 class MessageCallback(Protocol):
@@ -57,3 +57,7 @@ class Serializer(Protocol):
     def deserialize_measurements(self, data: bytes) -> Measurements:
         """Deserialize payload bytes to measurements object."""
         pass
+
+    def deserialize_telemetry(self, data: bytes) -> Telemetry:
+        """Deserialize any robot-to-host payload based on its type."""
+        pass
@@ -0,0 +1,68 @@
+"""The wire format of sw/protocol/include/protocol/wire.h: type bytes, flags and field layouts.
+
+Everything here is read from the header at import by sw/protocol/tools/wire_layout.py, the
+firmware writes and reads its payloads through the same tables. Each integer constant of the
+header becomes a module attribute of the same name, each `Field` table a `Layout`.
+"""
+
+from __future__ import annotations
+
+import importlib.util
+import struct
+from collections import namedtuple
+from pathlib import Path
+from typing import Any
+
+import numpy as np
+
+_LAYOUT_TOOL_PATH = Path(__file__).resolve().parents[2] / "protocol" / "tools" / "wire_layout.py"
+
+
+class Layout:
+    """One table of fields, packed little-endian without padding.
+
+    `struct` unpacks plain tuples in field order, for hot paths where the named tuple of
+    `unpack_from` costs too much.
+    """
+
+    def __init__(self, name: str, fields: list[tuple[str, str]], codes: dict[str, str]) -> None:
+        self.name = name
+        self.names = tuple(field for field, _ in fields)
+        self.struct = struct.Struct("<" + "".join(codes[kind] for _, kind in fields))
+        self.size = self.struct.size
+        self.dtype = np.dtype([(field, "<" + codes[kind]) for field, kind in fields])
+        self._tuple = namedtuple(name.title().replace("_", ""), self.names)
+
+    def unpack_from(self, data, offset: int = 0) -> Any:
+        """The fields at `offset` as a named tuple."""
+        return self._tuple._make(self.struct.unpack_from(data, offset))
+
+    def pack(self, *values: int) -> bytes:
+        return self.struct.pack(*values)
+
+    def array(self, data, count: int, offset: int) -> np.ndarray:
+        """`count` consecutive runs at `offset` as a structured array, without copying."""
+        return np.frombuffer(data, dtype=self.dtype, count=count, offset=offset)
+
+    def __repr__(self) -> str:
+        return f"Layout({self.name}, {self.size} bytes)"
+
+
+def _load_tool():
+    # the parser is a standalone script next to the protocol library
+    spec = importlib.util.spec_from_file_location("wire_layout", _LAYOUT_TOOL_PATH)
+    assert spec is not None and spec.loader is not None
+    tool = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(tool)
+    return tool
+
+
+_tool = _load_tool()
+_format = _tool.load()
+
+CONSTANTS: dict[str, int] = _format["constants"]
+LAYOUTS: dict[str, Layout] = {
+    name: Layout(name, [tuple(field) for field in fields], _tool.TYPE_CODES) for name, fields in _format["layouts"].items()
+}
+globals().update(CONSTANTS)
+globals().update(LAYOUTS)
@@ -0,0 +1,60 @@
+from __future__ import annotations
+
+import argparse
+import sys
+import threading
+from collections import Counter
+
+from comm import BinarySerializer, RecorderChunk, RecorderDumpCommand, parse_flight_log
+from comm.serial_transport import SerialTransport
+from comm.types import MessageCallback
+
+
+class _DumpCallback(MessageCallback):
+    def __init__(self) -> None:
+        self.data = bytearray()
+        self.done = threading.Event()
+
+    def on_message(self, data: bytes) -> None:
+        telemetry = BinarySerializer.deserialize_telemetry(data)
+        if not isinstance(telemetry, RecorderChunk):
+            return
+        if telemetry.offset != len(self.data):
+            print(f"Chunk at {telemetry.offset} lost, have {len(self.data)} bytes", file=sys.stderr)
+            return
+        self.data.extend(telemetry.data)
+        if len(self.data) >= telemetry.total:
+            self.done.set()
+
+    def on_error(self, error: Exception) -> None:
+        print(f"Serial error: {error}", file=sys.stderr)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Download the robot flight recorder log")
+    parser.add_argument("output")
+    parser.add_argument("--device", default="/dev/ttyUSB0")
+    parser.add_argument("--timeout", type=float, default=30.0)
+    args = parser.parse_args()
+
+    transport = SerialTransport(device=args.device, baud_rate=921600)
+    callback = _DumpCallback()
+    transport.connect()
+    transport.start_receiving(callback)
+    try:
+        transport.send(BinarySerializer.serialize_command(RecorderDumpCommand()))
+        if not callback.done.wait(args.timeout):
+            print("Dump incomplete", file=sys.stderr)
+    finally:
+        transport.close()
+
+    with open(args.output, "wb") as f:
+        f.write(callback.data)
+
+    records = parse_flight_log(bytes(callback.data))
+    counts = Counter(record.type for record in records)
+    print(f"{len(callback.data)} bytes, {len(records)} records, by type: {dict(counts)}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,223 @@
+from __future__ import annotations
+
+import argparse
+import os
+import struct
+import subprocess
+import tempfile
+import time
+from pathlib import Path
+from typing import Iterator, Optional
+
+from comm import ExpressDecoder, ExpressPacketReader
+from geometry.transforms import Pose
+from map.loader import load_world_from_json
+from params import INITIAL_POSE_THETA, INITIAL_POSE_X, INITIAL_POSE_Y, LIDAR_OFFSET
+from sim.rplidar_emulator import (
+    CMD_EXPRESS_SCAN,
+    CMD_GET_HEALTH,
+    CMD_GET_INFO,
+    CMD_RESET,
+    CMD_STOP,
+    RpLidarEmulator,
+    RpLidarEmulatorConfig,
+)
+
+
+# what `LidarStartup` sends, express scan in legacy mode
+_STARTUP_REQUESTS = [
+    bytes([0xA5, CMD_STOP]),
+    bytes([0xA5, CMD_RESET]),
+    bytes([0xA5, CMD_GET_HEALTH]),
+    bytes([0xA5, CMD_GET_INFO]),
+    bytes([0xA5, CMD_EXPRESS_SCAN, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x22]),
+]
+_DESCRIPTOR_SIZE = 7
+# the firmware's host build, see firmware/test/CMakeLists.txt
+_REPLAY_BENCH = Path(__file__).resolve().parent.parent / "firmware/test/build/rpLidarReplayBench"
+
+
+def _emulator(args: argparse.Namespace, sample_rate_hz: float, bit_error_rate: float) -> RpLidarEmulator:
+    world = load_world_from_json(args.map)
+    config = RpLidarEmulatorConfig(
+        rpm=args.rpm,
+        sample_rate_hz=sample_rate_hz,
+        bit_error_rate=bit_error_rate,
+        baud_rate=args.baud,
+        burst_packets=args.burst,
+        lidar_offset=LIDAR_OFFSET,
+    )
+    pose = Pose(INITIAL_POSE_X, INITIAL_POSE_Y, INITIAL_POSE_THETA)
+    return RpLidarEmulator(world, pose, config, seed=args.seed)
+
+
+def _scan_chunks(emulator: RpLidarEmulator, args: argparse.Namespace) -> Iterator[bytes]:
+    """Starts an express scan and yields what the lidar sent after the response descriptor, every poll."""
+    # the requests go out clean, a corrupted one would only delay the start
+    now_s = 0.0
+    for request in _STARTUP_REQUESTS:
+        now_s += emulator.config.reset_delay_s + 0.01
+        emulator.transmit(now_s)
+        emulator.receive(request, now_s)
+    start_s = now_s
+
+    poll_s = args.poll_ms / 1000.0
+    # `LidarStartup` takes the response descriptor, the reader only sees what follows it
+    head: Optional[bytes] = b""
+    while now_s < start_s + args.duration:
+        now_s += poll_s
+        data = emulator.transmit(now_s)
+        if head is not None:
+            head += data
+            if len(head) < _DESCRIPTOR_SIZE:
+                yield b""
+                continue
+            data, head = head[_DESCRIPTOR_SIZE:], None
+        yield data
+
+
+def _sweep_one(args: argparse.Namespace, sample_rate_hz: float, bit_error_rate: float) -> None:
+    emulator = _emulator(args, sample_rate_hz, bit_error_rate)
+    reader = ExpressPacketReader()
+    decoder = ExpressDecoder(drop_invalid=False)
+
+    packets = 0
+    points = 0
+    decode_s = 0.0
+    for data in _scan_chunks(emulator, args):
+        began = time.perf_counter()
+        raw, sequences = reader.feed(data)
+        points += len(decoder.decode(raw, sequences).angles)
+        decode_s += time.perf_counter() - began
+        packets += len(raw)
+
+    scanned = max(emulator.stats.packets, 1)
+    print(
+        f"{sample_rate_hz:8.0f} {bit_error_rate:8.0e} {points / args.duration:9.0f}"
+        f" {emulator.stats.packets_overflowed / scanned:9.1%} {reader.checksum_errors / scanned:9.1%}"
+        f" {1 - packets / scanned:9.1%} {decode_s / max(packets, 1) * 1e6:8.1f}"
+    )
+
+
+def sweep(args: argparse.Namespace) -> None:
+    """Runs the emulator faster than real time at every sample rate and error rate, decoding on the host."""
+    print(f"{args.rpm:.0f} rpm, {args.baud} baud, bursts of {args.burst} packet(s), {args.duration:.0f} s each")
+    print(f"{'samples':>8} {'ber':>8} {'points/s':>9} {'overflow':>9} {'checksum':>9} {'dropped':>9} {'us/pkt':>8}")
+    for sample_rate_hz in args.sample_rates:
+        for bit_error_rate in args.bit_error_rates:
+            _sweep_one(args, sample_rate_hz, bit_error_rate)
+
+
+def _dump(args: argparse.Namespace, sample_rate_hz: float, bit_error_rate: float, path: Path) -> RpLidarEmulator:
+    """
+    Writes a scan for the firmware's replay bench: the poll interval in us and the number of packets the
+    lidar scanned, then every poll's bytes as a length and the bytes, all integers uint32 little endian.
+    """
+    emulator = _emulator(args, sample_rate_hz, bit_error_rate)
+    with path.open("wb") as out:
+        out.write(struct.pack("<II", round(args.poll_ms * 1000), 0))
+        for data in _scan_chunks(emulator, args):
+            out.write(struct.pack("<I", len(data)) + data)
+        out.seek(4)
+        out.write(struct.pack("<I", emulator.stats.packets))
+    return emulator
+
+
+def dump(args: argparse.Namespace) -> None:
+    """Writes one scan to a file, for `rpLidarReplayBench` or a recording to replay elsewhere."""
+    emulator = _dump(args, args.sample_rates[0], args.bit_error_rates[0], args.out)
+    stats = emulator.stats
+    print(f"{args.out}: {stats.packets} packets, {stats.packets_overflowed} overflowed, {stats.bits_flipped} bits flipped")
+
+
+def firmware(args: argparse.Namespace) -> None:
+    """As `sweep`, with the firmware's RpLidar built for the host reading every poll, see `rpLidarReplayBench`."""
+    if not args.bench.exists():
+        raise SystemExit(f"{args.bench} not found, build firmware/test first")
+    print(f"{args.rpm:.0f} rpm, {args.baud} baud, bursts of {args.burst} packet(s), {args.duration:.0f} s each")
+    print(f"{'samples':>8} {'ber':>8} {'overflow':>9} {'points/s':>9} {'checksum':>9} {'dropped':>9} {'us/pkt':>8}")
+    with tempfile.TemporaryDirectory() as directory:
+        path = Path(directory) / "scan.bin"
+        for sample_rate_hz in args.sample_rates:
+            for bit_error_rate in args.bit_error_rates:
+                emulator = _dump(args, sample_rate_hz, bit_error_rate, path)
+                result = subprocess.run([str(args.bench), str(path)], capture_output=True, text=True, check=True)
+                overflow = emulator.stats.packets_overflowed / max(emulator.stats.packets, 1)
+                # the bench's last line has the columns from points/s on
+                print(f"{sample_rate_hz:8.0f} {bit_error_rate:8.0e} {overflow:9.1%} {result.stdout.splitlines()[-1]}")
+
+
+def serve(args: argparse.Namespace) -> None:
+    """Plays the lidar in real time on a serial port, or on a pseudo terminal when no device is given."""
+    emulator = _emulator(args, args.sample_rates[0], args.bit_error_rates[0])
+    if args.device:
+        import serial
+
+        port = serial.Serial(port=args.device, baudrate=args.baud, timeout=0)
+        read = lambda: port.read(4096)
+        write = port.write
+    else:
+        master, slave = os.openpty()
+        os.set_blocking(master, False)
+        print(f"Lidar on {os.ttyname(slave)}")
+
+        def read() -> bytes:
+            try:
+                return os.read(master, 4096)
+            except BlockingIOError:
+                return b""
+
+        write = lambda data: os.write(master, data)
+
+    began = time.monotonic()
+    next_report_s = 5.0
+    try:
+        while True:
+            now_s = time.monotonic() - began
+            request = read()
+            if request:
+                emulator.receive(request, now_s)
+            data = emulator.transmit(now_s)
+            if data:
+                write(data)
+            if now_s >= next_report_s:
+                next_report_s += 5.0
+                stats = emulator.stats
+                print(
+                    f"{stats.requests} requests, {stats.packets} packets, {stats.packets_overflowed} overflowed, "
+                    f"{stats.bytes_sent} bytes, {stats.bits_flipped} bits flipped"
+                )
+            time.sleep(args.poll_ms / 1000.0)
+    except KeyboardInterrupt:
+        pass
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Emulate an RPLidar from a map, for load tests of the lidar driver")
+    parser.add_argument("mode", choices=["sweep", "firmware", "dump", "serve"])
+    parser.add_argument("--map", type=Path, default=Path(__file__).resolve().parent / "data/map_bear_rescue.json")
+    parser.add_argument("--rpm", type=float, default=300.0)
+    parser.add_argument("--sample-rates", type=float, nargs="+", default=[2000, 4000, 8000, 16000])
+    parser.add_argument("--bit-error-rates", type=float, nargs="+", default=[0.0, 1e-5, 1e-4])
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--burst", type=int, default=1)
+    parser.add_argument("--duration", type=float, default=10.0)
+    parser.add_argument("--poll-ms", type=float, default=1.0)
+    parser.add_argument("--device", help="serial port wired to the lidar UART of the robot, a pty if not given")
+    parser.add_argument("--seed", type=int)
+    parser.add_argument("--bench", type=Path, default=_REPLAY_BENCH, help="rpLidarReplayBench for the firmware mode")
+    parser.add_argument("--out", type=Path, default=Path("lidar_scan.bin"), help="file the dump mode writes")
+    args = parser.parse_args()
+
+    if args.mode == "sweep":
+        sweep(args)
+    elif args.mode == "firmware":
+        firmware(args)
+    elif args.mode == "dump":
+        dump(args)
+    else:
+        serve(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -3,6 +3,7 @@ from __future__ import annotations
 from dataclasses import dataclass
 from math import atan2, exp, pi
 import random
+from typing import Optional
 
 from geometry import (
     ShapeGroup,
@@ -12,12 +13,14 @@ from geometry.util import lerp
 
 import numpy as np
 
+from comm.messages import ParticleScores, ScoreParticlesCommand
 from localization.types import LidarMeasurementsRel
 from map.raster import RasterMap
 from params import (
     PF_LIDAR_SUBSAMPLING_FACTOR,
     PF_RESAMPLE_TINY_THRESH,
     PF_RESAMPLE_TINY_WEIGHT,
+    PF_SCORE_TEMPERATURE,
 )
 
 
@@ -53,6 +56,8 @@ class ParticleFilterLocalizer:
         self.ys = np.full(n, initial_pose.y, dtype="f")
         self.thetas = np.full(n, initial_pose.yaw, dtype="f")
         self.weights = np.full(n, 1.0 / n, dtype="f")
+        # sequence of the score_command whose scores are still awaited
+        self._score_sequence: Optional[int] = None
 
         self._normalize_weights()
 
@@ -62,6 +67,25 @@ class ParticleFilterLocalizer:
         self._normalize_weights()
         self._resample_particles()
 
+    def predict(self, delta_x: float, delta_y: float, delta_theta: float) -> None:
+        """Motion update alone, for the sensor model evaluated by the firmware (see score_command)."""
+        self._apply_motion_model(delta_x, delta_y, delta_theta)
+
+    def score_command(self, sequence: int) -> ScoreParticlesCommand:
+        """Asks the firmware to score the current poses, the particles must not move until update_with_scores."""
+        self._score_sequence = sequence
+        return ScoreParticlesCommand(sequence=sequence, xs=self.xs, ys=self.ys, thetas=self.thetas)
+
+    def update_with_scores(self, scores: ParticleScores, cost_scale: int) -> bool:
+        """Sensor update with the costs of the last score_command, False for scores of any other."""
+        if scores.sequence != self._score_sequence:
+            return False
+        self._score_sequence = None
+        self._apply_scores(scores, cost_scale)
+        self._normalize_weights()
+        self._resample_particles()
+        return True
+
     def estimate_pose(self) -> Pose:
         x = np.sum(self.xs * self.weights)
         y = np.sum(self.ys * self.weights)
@@ -129,6 +153,16 @@ class ParticleFilterLocalizer:
             likelihoods = self.config.lidar_likelihood_map.get_many(lidar_xs, lidar_ys)
             self.weights *= likelihoods
 
+    def _apply_scores(self, scores: ParticleScores, cost_scale: int) -> None:
+        if scores.points == 0 or len(scores.costs) != len(self.weights):
+            return
+
+        # costs are -ln(likelihood) * cost_scale summed over every scan point; neighbouring
+        # beams are not independent, the summed log-likelihood is tempered by PF_SCORE_TEMPERATURE
+        costs = np.asarray(scores.costs, dtype="f")
+        log_weights = -(costs - costs.min()) / cost_scale * PF_SCORE_TEMPERATURE
+        self.weights *= np.exp(log_weights)
+
     def _normalize_weights(self) -> None:
         total_weight: float = np.sum(self.weights)
         if total_weight == 0.0:
@@ -1,14 +1,19 @@
 from collections import deque
 from dataclasses import dataclass
-from typing import Optional
+from typing import Callable, Optional
 
 import numpy as np
 
-from comm.messages import Measurements
+from comm.messages import Measurements, ParticleScores, ScoreParticlesCommand, lidar_arrays
 from geometry.shapes import Point, ShapeGroup, Vector
 from localization.bear_detector import BearDetector
 from localization.particle_filter import ParticleFilterLocalizer
 from localization.types import Encoders, LidarMeasurementsRel
+from params import PF_FIRMWARE_MAX_PARTICLES
+
+
+# measurement frames to wait for particle scores before asking again, a lost reply must not stall the filter
+_SCORES_TIMEOUT_FRAMES = 25
 
 
 @dataclass
@@ -35,6 +40,41 @@ class LocalizationStack:
         self.last_encoders: Optional[Encoders] = None
         self.params = robot_params
 
+        # firmware sensor model, see enable_firmware_scoring
+        self._send_score_command: Optional[Callable[[ScoreParticlesCommand], None]] = None
+        self._cost_scale = 1
+        self._score_sequence = 0
+        self._scores_awaited_frames: Optional[int] = None
+        self._scored_scan_timestamp: Optional[int] = None
+        # odometry that arrived while the particles waited for their scores
+        self._pending_motion: list[tuple[float, float, float]] = []
+
+    def enable_firmware_scoring(self, send: Callable[[ScoreParticlesCommand], None], cost_scale: int) -> None:
+        """
+        Leaves the sensor model to the firmware, which scores the particles against its latest full
+        scan and the likelihood field uploaded to it (`cost_scale` of that field). Particle scores
+        have to be passed to on_particle_scores.
+        """
+        if len(self.localizer.xs) > PF_FIRMWARE_MAX_PARTICLES:
+            raise ValueError(f"the firmware scores at most {PF_FIRMWARE_MAX_PARTICLES} particles")
+        self._send_score_command = send
+        self._cost_scale = cost_scale
+
+    def on_particle_scores(self, scores: ParticleScores) -> None:
+        # a scan is weighed once, the firmware keeps scoring against the last one until a new revolution
+        if scores.scan_timestamp != self._scored_scan_timestamp and self.localizer.update_with_scores(
+            scores, self._cost_scale
+        ):
+            self._scored_scan_timestamp = scores.scan_timestamp
+        if scores.sequence != self._score_sequence:
+            return
+
+        # the scores were for the poses before the motion that arrived meanwhile
+        self._scores_awaited_frames = None
+        for delta in self._pending_motion:
+            self.localizer.predict(*delta)
+        self._pending_motion.clear()
+
     def on_measurements(self, measurements: Measurements) -> None:
         enc = Encoders(
             left=measurements.encoders.left_ticks / self.params.ticks_per_meter,
@@ -55,24 +95,66 @@ class LocalizationStack:
 
         self.last_encoders = enc
 
-        n_beams = len(measurements.lidar)
-        lidar_angles = np.array([beam.angle for beam in measurements.lidar], dtype="f") + np.linspace(-delta_theta, 0, n_beams, dtype="f")
-        lidar_distances = np.array([beam.distance for beam in measurements.lidar], dtype="f")
+        if measurements.lidar_xy is not None:
+            lidar_dxs, lidar_dys, lidar_angles, lidar_distances = self._cartesian_points(measurements, delta_x, delta_y, delta_theta)
+        else:
+            beam_angles, lidar_distances = lidar_arrays(measurements.lidar)
+            n_beams = len(beam_angles)
+            lidar_angles = beam_angles + np.linspace(-delta_theta, 0, n_beams, dtype="f")
 
-        delta_theta_i = np.linspace(delta_theta, 0, n_beams, dtype="f")
-        ox = self.lidar_offset.x
-        oy = self.lidar_offset.y
-        ox_i = ox * np.cos(delta_theta_i) + oy * np.sin(delta_theta_i)
-        oy_i = -ox * np.sin(delta_theta_i) + oy * np.cos(delta_theta_i)
+            delta_theta_i = np.linspace(delta_theta, 0, n_beams, dtype="f")
+            ox = self.lidar_offset.x
+            oy = self.lidar_offset.y
+            ox_i = ox * np.cos(delta_theta_i) + oy * np.sin(delta_theta_i)
+            oy_i = -ox * np.sin(delta_theta_i) + oy * np.cos(delta_theta_i)
 
-        lidar_dxs = np.cos(lidar_angles) * lidar_distances + np.linspace(-delta_x, 0, n_beams, dtype="f") + ox_i
-        lidar_dys = np.sin(lidar_angles) * lidar_distances + np.linspace(-delta_y, 0, n_beams, dtype="f") + oy_i
+            lidar_dxs = np.cos(lidar_angles) * lidar_distances + np.linspace(-delta_x, 0, n_beams, dtype="f") + ox_i
+            lidar_dys = np.sin(lidar_angles) * lidar_distances + np.linspace(-delta_y, 0, n_beams, dtype="f") + oy_i
 
         measurements_rel = LidarMeasurementsRel(lidar_dxs, lidar_dys, lidar_angles, lidar_distances)
 
-        self.localizer.update(delta_x, delta_y, delta_theta, measurements_rel)
+        if self._send_score_command is None:
+            self.localizer.update(delta_x, delta_y, delta_theta, measurements_rel)
+        else:
+            self._update_with_firmware_scores(delta_x, delta_y, delta_theta)
         estimated_pose = self.localizer.estimate_pose()
 
         feature_points = self.bear_detector.update(estimated_pose, delta_x, delta_y, delta_theta, measurements_rel)
         for point, feature in feature_points:
             self.lidar_history.append((point, feature))
+
+    def _update_with_firmware_scores(self, delta_x: float, delta_y: float, delta_theta: float) -> None:
+        assert self._send_score_command is not None
+        if self._scores_awaited_frames is not None and self._scores_awaited_frames < _SCORES_TIMEOUT_FRAMES:
+            self._scores_awaited_frames += 1
+            self._pending_motion.append((delta_x, delta_y, delta_theta))
+            return
+
+        for delta in self._pending_motion:
+            self.localizer.predict(*delta)
+        self._pending_motion.clear()
+        self.localizer.predict(delta_x, delta_y, delta_theta)
+
+        self._score_sequence = (self._score_sequence + 1) & 0xFFFF
+        self._scores_awaited_frames = 0
+        self._send_score_command(self.localizer.score_command(self._score_sequence))
+
+    def _cartesian_points(
+        self, measurements: Measurements, delta_x: float, delta_y: float, delta_theta: float
+    ) -> tuple[np.ndarray, np.ndarray, np.ndarray, np.ndarray]:
+        """Robot-frame points of the Cartesian output mode, motion compensated here unless the robot did."""
+        assert measurements.lidar_xy is not None
+        xs, ys = measurements.lidar_xy
+        if not measurements.motion_compensated:
+            share = np.linspace(1, 0, len(xs), dtype="f")
+            cos_i = np.cos(share * delta_theta)
+            sin_i = np.sin(share * delta_theta)
+            xs, ys = (
+                xs * cos_i + ys * sin_i - share * delta_x,
+                -xs * sin_i + ys * cos_i - share * delta_y,
+            )
+
+        # beam angles and ranges as seen from the lidar
+        rel_x = xs - self.lidar_offset.x
+        rel_y = ys - self.lidar_offset.y
+        return xs, ys, np.arctan2(rel_y, rel_x).astype("f"), np.hypot(rel_x, rel_y).astype("f")
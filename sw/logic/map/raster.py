@@ -1,3 +1,5 @@
+import struct
+
 import numpy as np
 
 from geometry.util import find_nearest, shape_bounds
@@ -96,3 +98,48 @@ def load_raster_map(path: str) -> RasterMap:
         data=npz["data"],
         default_value=float(npz["default_value"]),
     )
+
+
+def save_likelihood_field(
+    likelihood_map: RasterMap,
+    path: str,
+    cell_size: float = 0.01,
+    tile_shift: int = 4,
+    cost_scale: int = 32,
+) -> None:
+    """Write a likelihood map in the firmware LKF1 format.
+
+    Each cell holds -ln(likelihood / max likelihood) * cost_scale clipped
+    to 255, resampled to `cell_size` and stored in square tiles of
+    2**tile_shift cells. See localization/likelihoodField.h in the firmware.
+    """
+    step = max(1, round(cell_size / likelihood_map.scale))
+    data = likelihood_map.data[::step, ::step]
+    height, width = data.shape
+
+    max_likelihood = float(np.max(data))
+    costs = np.clip(np.round(-np.log(data / max_likelihood) * cost_scale), 0, 255).astype(np.uint8)
+    default_cost = int(np.clip(round(-np.log(likelihood_map.default_value / max_likelihood) * cost_scale), 0, 255))
+
+    tile = 1 << tile_shift
+    tiles_y = (height + tile - 1) // tile
+    tiles_x = (width + tile - 1) // tile
+    padded = np.full((tiles_y * tile, tiles_x * tile), default_cost, dtype=np.uint8)
+    padded[:height, :width] = costs
+    tiled = padded.reshape(tiles_y, tile, tiles_x, tile).transpose(0, 2, 1, 3)
+
+    header = b"LKF1" + struct.pack(
+        "<HHBBBBIii",
+        width,
+        height,
+        tile_shift,
+        cost_scale,
+        default_cost,
+        0,
+        round(likelihood_map.scale * step * 1e6),
+        round(likelihood_map.offset_x * 1e6),
+        round(likelihood_map.offset_y * 1e6),
+    )
+    with open(path, "wb") as file:
+        file.write(header)
+        file.write(np.ascontiguousarray(tiled).tobytes())
@@ -1,5 +1,5 @@
 from params import ROBOT_BODY_RADIUS
-from map.raster import make_distance_map, save_raster_map
+from map.raster import make_distance_map, save_likelihood_field, save_raster_map
 from map.loader import load_world_from_json
 
 from PIL import Image
@@ -20,6 +20,8 @@ likelyhood_map.default_value = baseline
 
 
 save_raster_map(likelyhood_map, "data/map_lidar_likelihood.npz")
+# coarser copy for firmware-side particle scoring
+save_likelihood_field(likelyhood_map, "data/map_lidar_likelihood.lkf", cell_size=0.009)
 
 
 img = Image.fromarray((likelyhood_map.data * 600).clip(0, 255).astype('uint8'))
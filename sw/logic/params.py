@@ -65,6 +65,10 @@ PF_SMOOTHING_ALPHA: float = 0.1
 PF_LIDAR_SUBSAMPLING_FACTOR: int = LIDAR_SAMPLE_RATE // 5 // 40
 PF_RESAMPLE_TINY_WEIGHT: float = 0.25
 PF_RESAMPLE_TINY_THRESH: float = 0.5
+# share of the summed log-likelihood of a whole scan scored by the firmware that weighs the particles
+PF_SCORE_TEMPERATURE: float = 0.1
+# ParticleScoringService::MAX_PARTICLES in the firmware
+PF_FIRMWARE_MAX_PARTICLES: int = 340
 
 
 # --- Bear Detector ---
@@ -1,4 +1,4 @@
-"""Build script for Cython extensions inside logic/."""
+"""Build script for the native extensions inside logic/: Cython modules and the protocol library."""
 
 from setuptools import setup, Extension
 from Cython.Build import cythonize
@@ -11,6 +11,15 @@ extensions = [
         include_dirs=[numpy.get_include()],
         extra_compile_args=["-O3"],
     ),
+    # plain C ABI shared library loaded with ctypes by comm/native_protocol.py
+    Extension(
+        "comm._protocol",
+        sources=["../protocol/src/host_api.cpp"],
+        include_dirs=["../protocol/include"],
+        language="c++",
+        extra_compile_args=["-O3", "-std=c++20"],
+        define_macros=[("PROFILING_ENABLED", "1")],
+    ),
 ]
 
 setup(
@@ -8,6 +8,7 @@ from .sensors import (
     MotorConfig,
     MotorSimulator,
 )
+from .rplidar_emulator import RpLidarEmulator, RpLidarEmulatorConfig
 from .server import RobotSimulatorServer, create_server_from_map
 
 __all__ = [
@@ -18,6 +19,8 @@ __all__ = [
     "MotorSimulator",
     "LidarSensorSimulator",
     "LidarSensorConfig",
+    "RpLidarEmulator",
+    "RpLidarEmulatorConfig",
     "RobotSimulatorServer",
     "create_server_from_map",
 ]
@@ -0,0 +1,269 @@
+from __future__ import annotations
+
+from collections import deque
+from dataclasses import dataclass
+from math import pi
+from typing import Optional
+
+import numpy as np
+
+from geometry.raycast import raycast_from_angle
+from geometry.shapes import Point, ShapeGroup, Vector
+from geometry.transforms import Pose
+
+
+CMD_STOP = 0x25
+CMD_RESET = 0x40
+CMD_GET_INFO = 0x50
+CMD_GET_HEALTH = 0x52
+CMD_EXPRESS_SCAN = 0x82
+
+HEALTH_GOOD = 0
+HEALTH_ERROR = 2
+
+EXPRESS_PACKET_SIZE = 84
+_SAMPLES_PER_PACKET = 32
+_FULL_CIRCLE_Q6 = 360 * 64
+# 1/8 degree, finer than any sample rate the lidar runs at
+_SCENE_STEPS = 360 * 8
+_MAX_DISTANCE_MM = (1 << 14) - 1
+
+_BANNER = b"RP LIDAR System.\r\nFirmware Ver 1.29 - rtm, HW Ver 7\r\nModel: 24\r\n"
+_MODEL = 0x18
+_FIRMWARE = (29, 1)  # minor, major
+_HARDWARE = 7
+
+
+def _descriptor(length: int, mode: int, data_type: int) -> bytes:
+    return bytes([0xA5, 0x5A]) + (length | (mode << 30)).to_bytes(4, "little") + bytes([data_type])
+
+
+@dataclass(frozen=True)
+class RpLidarEmulatorConfig:
+    rpm: float = 300.0
+    sample_rate_hz: float = 4000.0
+    # probability of every bit on the line to flip, requests and responses alike
+    bit_error_rate: float = 0.0
+    # 10 bits per byte on the line, packets the line cannot carry in time are dropped
+    baud_rate: int = 115200
+    # bytes reach the reader in chunks of this many packets, as through a USB adapter's latency timer
+    burst_packets: int = 1
+    max_distance: float = 12.0
+    lidar_offset: Vector = Vector(0.0, 0.0)
+    # the first this many health requests are answered with an error
+    health_errors: int = 0
+    reset_delay_s: float = 0.3
+
+    def __post_init__(self) -> None:
+        if self.rpm <= 0.0:
+            raise ValueError("rpm must be positive")
+        if self.sample_rate_hz <= 0.0:
+            raise ValueError("sample_rate_hz must be positive")
+        if self.bit_error_rate < 0.0 or self.bit_error_rate > 1.0:
+            raise ValueError("bit_error_rate must be in [0, 1]")
+        if self.baud_rate <= 0:
+            raise ValueError("baud_rate must be positive")
+        if self.burst_packets < 1:
+            raise ValueError("burst_packets must be at least 1")
+
+
+@dataclass
+class RpLidarEmulatorStats:
+    requests: int = 0
+    # express packets scanned, sent or not
+    packets: int = 0
+    # packets dropped because the line was still busy with earlier ones
+    packets_overflowed: int = 0
+    bytes_sent: int = 0
+    bits_flipped: int = 0
+
+
+class RpLidarEmulator:
+    """
+    Device side of the RPLidar serial protocol, for driving `RpLidar` and the host decoders at loads
+    the real sensor cannot produce. Answers stop, reset (with the boot banner), health, device info
+    and express scan requests the way an A1 does, and while scanning sends legacy express packets
+    whose distances are ray cast into `world` from a fixed pose. The line is modelled at `baud_rate`
+    with bit errors; time is passed in by the caller, so the emulator can be run faster than real time.
+    """
+
+    def __init__(
+        self,
+        world: ShapeGroup,
+        pose: Pose,
+        config: RpLidarEmulatorConfig = RpLidarEmulatorConfig(),
+        seed: Optional[int] = None,
+    ) -> None:
+        self.world = world
+        self.config = config
+        self.stats = RpLidarEmulatorStats()
+
+        self._random = np.random.default_rng(seed)
+        self._distances_mm = np.zeros(_SCENE_STEPS, dtype=np.uint16)
+        self._request = bytearray()
+        # (time the first byte starts, bytes) in the order they go out, back to back
+        self._line: deque[tuple[float, bytes]] = deque()
+        self._line_busy_until_s = 0.0
+        self._delivered = bytearray()
+        self._reset_until_s: Optional[float] = None
+        self._health_errors = config.health_errors
+
+        self._scanning = False
+        self._scan_start_s = 0.0
+        self._next_packet = 0
+        self._angle_q6 = 0.0
+        self.set_pose(pose)
+
+    def set_pose(self, pose: Pose) -> None:
+        """Ray casts the scene around `pose` once, the packets sample it by angle."""
+        origin = pose.to_transform().apply_to_point(self.config.lidar_offset.x, self.config.lidar_offset.y)
+        for step in range(_SCENE_STEPS):
+            # the lidar turns clockwise
+            angle = pose.yaw - step * (2.0 * pi / _SCENE_STEPS)
+            hit = raycast_from_angle(self.world, Point(origin[0], origin[1]), angle, self.config.max_distance)
+            self._distances_mm[step] = 0 if hit is None else min(round(hit.distance * 1000), _MAX_DISTANCE_MM)
+
+    @property
+    def scanning(self) -> bool:
+        return self._scanning
+
+    def receive(self, data: bytes, now_s: float) -> None:
+        """Bytes written to the lidar, the responses go out on the line from `now_s`."""
+        self._request.extend(self._corrupt(data))
+        while True:
+            start = self._request.find(0xA5)
+            if start < 0:
+                self._request.clear()
+                return
+            del self._request[:start]
+            if len(self._request) < 2:
+                return
+            command = self._request[1]
+            size = 2
+            if command & 0x80:
+                # payload size, payload and checksum follow
+                if len(self._request) < 3:
+                    return
+                size = 3 + self._request[2] + 1
+                if len(self._request) < size:
+                    return
+                checksum = 0
+                for byte in self._request[: size - 1]:
+                    checksum ^= byte
+                if checksum != self._request[size - 1]:
+                    del self._request[:size]
+                    continue
+            del self._request[:size]
+            self._handle(command, now_s)
+
+    def transmit(self, now_s: float) -> bytes:
+        """What the reader has received by `now_s`."""
+        if self._reset_until_s is not None and now_s >= self._reset_until_s:
+            self._write(_BANNER, self._reset_until_s)
+            self._reset_until_s = None
+        if self._scanning:
+            self._scan_until(now_s)
+
+        byte_s = 10.0 / self.config.baud_rate
+        while self._line:
+            start_s, data = self._line[0]
+            done = min(len(data), int((now_s - start_s) / byte_s))
+            if done <= 0:
+                break
+            self._delivered.extend(data[:done])
+            if done == len(data):
+                self._line.popleft()
+            else:
+                self._line[0] = (start_s + done * byte_s, data[done:])
+                break
+
+        chunk = self.config.burst_packets * EXPRESS_PACKET_SIZE if self._scanning else 1
+        size = len(self._delivered) - len(self._delivered) % chunk
+        out = self._corrupt(bytes(self._delivered[:size]))
+        del self._delivered[:size]
+        self.stats.bytes_sent += len(out)
+        return out
+
+    def _handle(self, command: int, now_s: float) -> None:
+        self.stats.requests += 1
+        if command == CMD_STOP:
+            self._scanning = False
+        elif command == CMD_RESET:
+            self._scanning = False
+            self._line.clear()
+            self._line_busy_until_s = now_s
+            self._delivered.clear()
+            self._reset_until_s = now_s + self.config.reset_delay_s
+        elif self._reset_until_s is not None:
+            # still booting
+            return
+        elif command == CMD_GET_HEALTH:
+            status = HEALTH_ERROR if self._health_errors > 0 else HEALTH_GOOD
+            self._health_errors = max(self._health_errors - 1, 0)
+            self._write(_descriptor(3, 0, 0x06) + bytes([status, 0, 0]), now_s)
+        elif command == CMD_GET_INFO:
+            serial = bytes(range(16))
+            self._write(_descriptor(20, 0, 0x04) + bytes([_MODEL, *_FIRMWARE, _HARDWARE]) + serial, now_s)
+        elif command == CMD_EXPRESS_SCAN:
+            self._write(_descriptor(EXPRESS_PACKET_SIZE, 1, CMD_EXPRESS_SCAN), now_s)
+            self._scanning = True
+            self._scan_start_s = now_s
+            self._next_packet = 0
+
+    def _write(self, data: bytes, now_s: float) -> None:
+        start_s = max(now_s, self._line_busy_until_s)
+        self._line.append((start_s, data))
+        self._line_busy_until_s = start_s + len(data) * 10.0 / self.config.baud_rate
+
+    def _corrupt(self, data: bytes) -> bytes:
+        if self.config.bit_error_rate == 0.0 or not data:
+            return data
+        flips = self._random.binomial(len(data) * 8, self.config.bit_error_rate)
+        if flips == 0:
+            return data
+        corrupted = bytearray(data)
+        for bit in self._random.integers(0, len(data) * 8, flips):
+            corrupted[bit >> 3] ^= 1 << (bit & 7)
+        self.stats.bits_flipped += int(flips)
+        return bytes(corrupted)
+
+    def _scan_until(self, now_s: float) -> None:
+        packet_period = _SAMPLES_PER_PACKET / self.config.sample_rate_hz
+        # a packet leaves once its last sample is measured
+        while self._scan_start_s + (self._next_packet + 1) * packet_period <= now_s:
+            ready_s = self._scan_start_s + (self._next_packet + 1) * packet_period
+            packet = self._packet(first=self._next_packet == 0)
+            self._next_packet += 1
+            self.stats.packets += 1
+            # the sensor buffers one packet, one that finds the line still busy with an earlier one is lost
+            if self._line_busy_until_s > ready_s + EXPRESS_PACKET_SIZE * 10.0 / self.config.baud_rate:
+                self.stats.packets_overflowed += 1
+                continue
+            self._write(packet, ready_s)
+
+    def _packet(self, first: bool) -> bytes:
+        step_q6 = self.config.rpm / 60.0 * _FULL_CIRCLE_Q6 / self.config.sample_rate_hz
+        start_q6 = int(self._angle_q6) % _FULL_CIRCLE_Q6
+        samples_q6 = start_q6 + step_q6 * np.arange(_SAMPLES_PER_PACKET)
+        self._angle_q6 = (self._angle_q6 + step_q6 * _SAMPLES_PER_PACKET) % _FULL_CIRCLE_Q6
+
+        steps = (samples_q6 * (_SCENE_STEPS / _FULL_CIRCLE_Q6)).astype(np.int64) % _SCENE_STEPS
+        distances = self._distances_mm[steps].astype(np.int32)
+
+        packet = bytearray(EXPRESS_PACKET_SIZE)
+        packet[2] = start_q6 & 0xFF
+        packet[3] = ((start_q6 >> 8) & 0x7F) | (0x80 if first else 0)
+        # the sample angles are spread evenly between start angles, dtheta stays 0
+        cabins = np.zeros((16, 5), dtype=np.uint8)
+        cabins[:, 0] = (distances[0::2] << 2) & 0xFC
+        cabins[:, 1] = distances[0::2] >> 6
+        cabins[:, 2] = (distances[1::2] << 2) & 0xFC
+        cabins[:, 3] = distances[1::2] >> 6
+        packet[4:] = cabins.tobytes()
+
+        checksum = 0
+        for byte in packet[2:]:
+            checksum ^= byte
+        packet[0] = 0xA0 | (checksum & 0x0F)
+        packet[1] = 0x50 | (checksum >> 4)
+        return bytes(packet)
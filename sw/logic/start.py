@@ -47,6 +47,11 @@ def parse_args() -> argparse.Namespace:
     parser.add_argument(
         "--map", default="data/map_bear_rescue.json", help="Path to map JSON"
     )
+    parser.add_argument(
+        "--firmware-scoring",
+        action="store_true",
+        help="Upload the likelihood field and let the robot score the particles (serial only)",
+    )
     return parser.parse_args()
 
 
@@ -65,6 +70,7 @@ def main() -> None:
         kwargs["recording_path"] = args.recording_path
     if args.transport == "serial":
         kwargs["device"] = args.device
+        kwargs["firmware_scoring"] = args.firmware_scoring
     elif args.transport == "udp":
         kwargs["host"] = args.host
 
@@ -0,0 +1,162 @@
+from __future__ import annotations
+
+import random
+import struct
+import threading
+import time
+from typing import Optional
+
+from comm.cobs import cobs_decode
+from comm.serial_transport import FRAMING_V1, FRAMING_V2, SerialTransport
+
+
+class FirmwareLink:
+    """
+    Firmware end of the host link as `FramedTransport` runs it, behind the part of the `serial.Serial`
+    interface `SerialTransport` uses. It boots in v1 and ignores what is written while it boots (opening
+    the port resets the ESP32), switches framing on request and acknowledges in the new framing, and
+    sends a telemetry frame every `telemetry_period_s`. Bytes towards the host are corrupted at
+    `byte_error_rate`.
+    """
+
+    def __init__(
+        self,
+        boot_s: float = 0.3,
+        telemetry_period_s: float = 0.01,
+        telemetry: bytes = bytes(range(64)),
+        byte_error_rate: float = 0.0,
+        timeout: float = 0.05,
+        seed: int = 0,
+    ) -> None:
+        self.timeout = timeout
+        self.framing = FRAMING_V1
+        self.telemetry = telemetry
+        self.telemetry_period_s = telemetry_period_s
+        self.byte_error_rate = byte_error_rate
+        self.commands: list[bytes] = []
+        self.acks = 0
+        self.frames_sent = 0
+
+        self._random = random.Random(seed)
+        self._lock = threading.Lock()
+        self._out = bytearray()
+        self._rx = bytearray()
+        self._tx_nonce = 0
+        self._boot_until = 0.0
+        self._next_telemetry = 0.0
+        self.reboot(boot_s)
+
+    def reboot(self, boot_s: float = 0.3) -> None:
+        with self._lock:
+            self.framing = FRAMING_V1
+            self._rx.clear()
+            self._boot_until = time.monotonic() + boot_s
+            self._next_telemetry = self._boot_until
+
+    # serial.Serial
+
+    @property
+    def in_waiting(self) -> int:
+        with self._lock:
+            self._produce()
+            return len(self._out)
+
+    def read(self, size: int = 1) -> bytes:
+        deadline = time.monotonic() + self.timeout
+        while True:
+            with self._lock:
+                self._produce()
+                if self._out or time.monotonic() >= deadline:
+                    data = bytes(self._out[:size])
+                    del self._out[:size]
+                    return data
+            time.sleep(0.0005)
+
+    def write(self, data: bytes) -> int:
+        with self._lock:
+            if time.monotonic() < self._boot_until:
+                return len(data)
+            # like `FramedTransport::receive`, a switch applies from the next chunk on
+            framing = self.framing
+            self._rx.extend(data)
+            if framing == FRAMING_V2:
+                self._receive_v2()
+            else:
+                self._receive_v1()
+        return len(data)
+
+    def close(self) -> None:
+        pass
+
+    # firmware side
+
+    def _produce(self) -> None:
+        now = time.monotonic()
+        while now >= self._boot_until and now >= self._next_telemetry:
+            self._next_telemetry += self.telemetry_period_s
+            self._send(self.telemetry)
+
+    def _send(self, payload: bytes) -> None:
+        if self.framing == FRAMING_V2:
+            frame = SerialTransport._frame_payload_v2(self._tx_nonce, payload)
+        else:
+            frame = SerialTransport._frame_payload(self._tx_nonce, payload)
+        self._tx_nonce = (self._tx_nonce + 1) & 0xFF
+        self.frames_sent += bool(payload)
+        if self.byte_error_rate > 0.0:
+            frame = bytes(
+                byte ^ (1 << self._random.randrange(8)) if self._random.random() < self.byte_error_rate else byte
+                for byte in frame
+            )
+        self._out.extend(frame)
+
+    def _handle(self, nonce: int, payload: bytes) -> None:
+        if payload:
+            self.commands.append(payload)
+            return
+        if nonce in (FRAMING_V1, FRAMING_V2):
+            self.framing = nonce
+            self.acks += 1
+            self._send(b"")
+
+    def _receive_v1(self) -> None:
+        while True:
+            start = self._rx.find(0xA5)
+            if start < 0:
+                self._rx.clear()
+                return
+            del self._rx[:start]
+            if len(self._rx) < 6:
+                return
+            header = bytes(self._rx[:6])
+            nonce, size, data_checksum, checksum = struct.unpack("<BHBB", header[1:])
+            if checksum != SerialTransport._compute_checksum(header[:5]):
+                del self._rx[:1]
+                continue
+            if len(self._rx) < 6 + size:
+                return
+            payload = bytes(self._rx[6 : 6 + size])
+            del self._rx[: 6 + size]
+            if SerialTransport._compute_checksum(payload) == data_checksum:
+                self._handle(nonce, payload)
+
+    def _receive_v2(self) -> None:
+        *frames, rest = self._rx.split(b"\x00")
+        self._rx = bytearray(rest)
+        for encoded in frames:
+            body = _decode_v2(bytes(encoded))
+            if body is not None:
+                self._handle(body[0], body[1:-2])
+
+
+def _decode_v2(encoded: bytes) -> Optional[bytes]:
+    if not encoded:
+        return None
+    try:
+        body = cobs_decode(encoded)
+    except ValueError:
+        return None
+    if len(body) < 3:
+        return None
+    (checksum,) = struct.unpack_from("<H", body, len(body) - 2)
+    return body if SerialTransport._compute_checksum16(body[:-2]) == checksum else None
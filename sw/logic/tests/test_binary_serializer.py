@@ -0,0 +1,248 @@
+import base64
+import math
+import struct
+from pathlib import Path
+
+import numpy as np
+import pytest
+
+from comm import native_protocol, wire
+from comm.binary_serializer import BinarySerializer
+from comm.messages import (
+    ArmCommand,
+    BearCandidate,
+    BearCandidates,
+    BearTemplateCommand,
+    ClawCommand,
+    CollisionGuardCommand,
+    CommandLaneStats,
+    EncodersMeasurement,
+    FieldUploadBeginCommand,
+    FieldUploadDataCommand,
+    FieldUploadEndCommand,
+    FieldUploadResult,
+    GraspCommand,
+    GraspEvent,
+    GuardEvent,
+    LidarBatchStats,
+    LidarFilterCommand,
+    LidarFilterStats,
+    LidarMotorCommand,
+    LidarOutputCommand,
+    LidarPoints,
+    LidarStartupReport,
+    LogBatch,
+    Measurements,
+    MotorTraceCommand,
+    MoveCommand,
+    ParticleScores,
+    ProfileDumpCommand,
+    ProfileSection,
+    RecorderChunk,
+    RecorderDumpCommand,
+    ScanMatch,
+    ScoreParticlesCommand,
+    STREAM_ON_CHANGE,
+    StreamSample,
+    SubscribeCommand,
+    TelemetryConfigCommand,
+)
+from comm.recording_transport import RecordingTransport
+from comm.replay_transport import ReplayTransport
+from comm.types import MessageCallback, Transport
+
+def _measurements(points: int = 100, cartesian: bool = False) -> Measurements:
+    rng = np.random.default_rng(points)
+    first = rng.uniform(-3.0, 3.0, points).astype("f")
+    second = rng.uniform(0.1, 12.0, points).astype("f")
+    empty = np.empty(0, dtype="f")
+    return Measurements(
+        timestamp=123_456_789,
+        lidar=LidarPoints(empty, empty) if cartesian else LidarPoints(first, second),
+        encoders=EncodersMeasurement(left_ticks=-42, right_ticks=1_000_000),
+        lidar_filtered=LidarFilterStats(1, 2, 3),
+        lidar_rpm=300,
+        lidar_batch=LidarBatchStats(4, 5, 6_000, 7),
+        command_lanes=CommandLaneStats(8, 9, 10),
+        lidar_xy=(first, second) if cartesian else None,
+        motion_compensated=cartesian,
+    )
+
+
+def _decode(data: bytes) -> Measurements:
+    with pytest.MonkeyPatch.context() as patch:
+        patch.setattr(native_protocol, "_lib", None)
+        return BinarySerializer.deserialize_measurements(data)
+
+
+def test_round_trip_within_wire_resolution():
+    measurements = _measurements()
+    decoded = _decode(BinarySerializer.serialize_measurements(measurements))
+
+    # angles in 1/64 degree, distances in 1/4 mm
+    np.testing.assert_allclose(decoded.lidar.angles, measurements.lidar.angles, atol=np.radians(1 / 64))
+    np.testing.assert_allclose(decoded.lidar.distances, measurements.lidar.distances, atol=0.00025)
+    assert decoded.encoders == measurements.encoders
+    assert decoded.lidar_batch == measurements.lidar_batch
+    assert decoded.command_lanes == measurements.command_lanes
+
+
+# reference encodings written out with struct, independent of the tables in wire.h
+_COMMANDS = [
+    (MoveCommand(0.25, -0.5), struct.pack("<Bhh", 1, 250, -500)),
+    (ClawCommand(-800), struct.pack("<Bh", 2, -800)),
+    (ArmCommand(), struct.pack("<B", 3)),
+    (LidarFilterCommand(True, 0.15, 6.0, 10), struct.pack("<BBHHB", 4, 1, 150, 6000, 10)),
+    (
+        BearTemplateCommand(True, 0.06, 3.0, 3, 0.1, 0.05, 0.1, 3.0, 0.01),
+        struct.pack("<BBHHBHHHHH", 5, 1, 60, 192, 3, 100, 50, 100, 3000, 100),
+    ),
+    (FieldUploadBeginCommand(70_000), struct.pack("<BI", 6, 70_000)),
+    (FieldUploadDataCommand(512, b"\x01\x02\x03"), struct.pack("<BI", 7, 512) + b"\x01\x02\x03"),
+    (FieldUploadEndCommand(0xBEEF), struct.pack("<BH", 8, 0xBEEF)),
+    (
+        ScoreParticlesCommand(7, [0.5, -1.0], [0.25, 2.0], [math.pi / 2, -math.pi / 4]),
+        struct.pack("<BHH6h", 9, 7, 2, 500, 250, 16384, -1000, 2000, -8192),
+    ),
+    (RecorderDumpCommand(), struct.pack("<B", 10)),
+    (LidarMotorCommand(600), struct.pack("<BH", 11, 600)),
+    (TelemetryConfigCommand(30, 96), struct.pack("<BHH", 12, 30, 96)),
+    (ProfileDumpCommand(True), struct.pack("<BB", 13, 1)),
+    (LidarOutputCommand(True, True, 0.1, -0.02, math.pi / 2, False), struct.pack("<BBhhh", 14, 3, 100, -20, 16384)),
+    (MotorTraceCommand(False, True, 500, 768, 50, 40), struct.pack("<BBHHHH", 15, 2, 500, 768, 50, 40)),
+    (
+        CollisionGuardCommand(True, [(0.25, 0.15), (-0.2, -0.15)], 0.5, 3, 0.2),
+        struct.pack("<BBHBHB4h", 16, 1, 500, 3, 200, 2, 250, 150, -200, -150),
+    ),
+    (SubscribeCommand({0: 0.05, 2: STREAM_ON_CHANGE}), struct.pack("<BBBHBH", 17, 2, 0, 50, 2, 0xFFFF)),
+    (GraspCommand(1, -800, 0.15, 1.5, 0.6, 0.04, -300), struct.pack("<BBhHHHHh", 18, 1, -800, 150, 1500, 600, 40, -300)),
+]
+
+
+@pytest.mark.parametrize("command, payload", _COMMANDS, ids=lambda value: type(value).__name__)
+def test_commands_match_the_reference_layout(command, payload):
+    assert BinarySerializer.serialize_command(command) == payload
+    assert BinarySerializer.deserialize_command(payload) == command
+
+
+def test_command_of_the_wrong_size_is_rejected():
+    with pytest.raises(ValueError):
+        BinarySerializer.deserialize_command(struct.pack("<Bh", 1, 250))
+
+
+_TELEMETRY = [
+    (
+        struct.pack("<BqB", 2, 1_000, 1) + struct.pack("<hHHBB", -5760, 2000, 100, 12, 255),
+        BearCandidates(1_000, [BearCandidate(-5760 / -(64 * 57.295779513), 0.5, 0.1, 12, 1.0)]),
+    ),
+    (struct.pack("<BHqHH2I", 3, 4, 5_000, 360, 2, 10, 4_000_000_000), ParticleScores(4, 5_000, 360, [10, 4_000_000_000])),
+    (struct.pack("<BB", 4, 1), FieldUploadResult(True)),
+    (struct.pack("<BII", 5, 256, 1024) + b"abc", RecorderChunk(256, 1024, b"abc")),
+    (
+        struct.pack("<B7B5I", 6, 1, 2, 0, 24, 1, 29, 7, 10, 20, 30, 40, 50),
+        LidarStartupReport(True, 2, 0, 24, 1, 29, 7, [10, 20, 30, 40, 50]),
+    ),
+    (
+        struct.pack("<BqhhhBBHI", 7, 9_000, 25, -50, 8192, 51, 6, 300, 1_200),
+        ScanMatch(9_000, 0.025, -0.05, math.pi / 4, 0.2, 6, 300, 1_200),
+    ),
+    (
+        struct.pack("<BBBHBB", 8, 0, 1, 240, 1, 4) + b"loop" + struct.pack("<IQIBB2I", 3, 2**40, 99, 5, 2, 1, 2),
+        ProfileSection(0, 1, 240, 1, "loop", 3, 2**40, 99, 5, [1, 2]),
+    ),
+    (struct.pack("<BHB", 9, 3, 0), LogBatch(3, [])),
+    (
+        struct.pack("<BqbBhhhhI", 12, 77, -1, 4, 300, -20, -100, -120, 850),
+        GuardEvent(77, -1, 4, 0.3, -0.02, -0.1, -0.12, 850),
+    ),
+    (
+        struct.pack("<BqBBHHHHH", 16, 88, 1, 2, 420, 300, 0xFFFF, 650, 0),
+        GraspEvent(88, 1, 2, 0.42, (0.3, None), (0.65, 0.0)),
+    ),
+    (
+        struct.pack("<BqB", 14, 99, 0b11110) + struct.pack("<iiHHbhhHI", -3, 4, 600, 650, 1, 100, -100, 2048, 5),
+        StreamSample(99, EncodersMeasurement(-3, 4), 600, 650, 1, 0.1, -0.1, 2048, 5),
+    ),
+]
+
+
+@pytest.mark.parametrize("payload, expected", _TELEMETRY, ids=lambda value: type(value).__name__)
+def test_telemetry_matches_the_reference_layout(payload, expected):
+    assert BinarySerializer.deserialize_telemetry(payload) == expected
+
+
+def test_array_telemetry_matches_the_reference_layout():
+    raw = BinarySerializer.deserialize_telemetry(
+        struct.pack("<BqHHB", 13, 10_000, 1, 2, 2) + struct.pack("<IB", 300, 7) + bytes(range(84)) + struct.pack("<IB", 0, 8) + bytes(84)
+    )
+    assert (raw.timestamp, raw.dropped, raw.checksum_errors) == (10_000, 1, 2)
+    assert raw.arrival_us.tolist() == [9_700, 10_000]
+    assert raw.sequences.tolist() == [7, 8]
+    assert raw.packets.shape == (2, 84) and raw.packets[0].tolist() == list(range(84))
+
+    grid = BinarySerializer.deserialize_telemetry(
+        struct.pack("<BqiihhhB", 15, 5, 1_000, -2_000, 16384, -3, 4, 1) + struct.pack("<hhB", -2, 5, 2) + bytes([40, 0x90, 60, 3])
+    )
+    assert (grid.x, grid.y, grid.theta, grid.origin_tile) == (1.0, -2.0, math.pi / 2, (-3, 4))
+    cells = grid.tiles[(-2, 5)]
+    assert cells.shape == (wire.LOCAL_GRID_TILE_CELLS, wire.LOCAL_GRID_TILE_CELLS) and cells.dtype == np.int8
+    assert cells.ravel().tolist() == [-112] * 40 + [3] * 60
+
+    trace = BinarySerializer.deserialize_telemetry(struct.pack("<BBHHHHB", 11, 2, 1000, 1024, 256, 10, 1) + struct.pack("<hhihhi", 100, 90, -5, -100, -80, 7))
+    assert (trace.reason, trace.period_us, trace.total, trace.trigger, trace.offset) == (2, 1000, 1024, 256, 10)
+    assert trace.setpoints.tolist() == [[100, -100]]
+    assert trace.speeds.tolist() == [[90, -80]]
+    assert trace.positions.tolist() == [[-5, 7]]
+
+
+def test_every_command_and_message_has_a_layout():
+    # the commands without fields, and the Cartesian measurements, which share the polar header
+    no_layout = {"COMMAND_ARM", "COMMAND_RECORDER_DUMP", "MESSAGE_MEASUREMENTS_XY"}
+    for name in wire.CONSTANTS:
+        if name.startswith(("COMMAND_", "MESSAGE_")) and name not in no_layout:
+            assert f"{name}_FIELDS" in wire.LAYOUTS, name
+
+
+class _Silent(Transport):
+    def connect(self) -> None:
+        pass
+
+    def start_receiving(self, callback: MessageCallback) -> None:
+        pass
+
+    def stop_receiving(self) -> None:
+        pass
+
+    def send(self, data: bytes) -> None:
+        pass
+
+    def close(self) -> None:
+        pass
+
+
+def _replay(path: Path) -> list[bytes]:
+    return [event.payload for event in ReplayTransport._load_events(str(path))]
+
+
+def test_replays_recordings_of_the_current_format(tmp_path):
+    payload = BinarySerializer.serialize_measurements(_measurements())
+    recording = RecordingTransport(_Silent(), str(tmp_path / "current.csv"))
+    recording.on_message(payload)
+    recording.close()
+
+    assert _replay(tmp_path / "current.csv") == [payload]
+
+
+def test_replays_recordings_from_before_the_type_byte(tmp_path):
+    payload = BinarySerializer.serialize_measurements(_measurements())
+    # format 1: no format row, measurements without their type byte
+    (tmp_path / "legacy.csv").write_text(
+        "timestamp_utc,event,payload\r\n"
+        f"2025-01-01T00:00:00+00:00,receive,b64:{base64.b64encode(payload[1:]).decode('ascii')}\r\n"
+        '2025-01-01T00:00:01+00:00,receive,{"type": "ping"}\r\n'
+    )
+
+    replayed = _replay(tmp_path / "legacy.csv")
+
+    assert replayed == [payload, b'{"type": "ping"}']
+    assert BinarySerializer.deserialize_measurements(replayed[0]).encoders == EncodersMeasurement(-42, 1_000_000)
@@ -0,0 +1,88 @@
+import ctypes
+import shutil
+import subprocess
+from pathlib import Path
+
+import numpy as np
+import pytest
+
+from comm import native_protocol
+from comm.binary_serializer import BinarySerializer
+from comm.messages import LidarPoints, Measurements
+from tests.test_binary_serializer import _measurements
+
+_PROTOCOL = Path(__file__).resolve().parents[2] / "protocol"
+
+
+@pytest.fixture(scope="module")
+def native_library(tmp_path_factory):
+    compiler = shutil.which("g++")
+    if compiler is None:
+        pytest.skip("no C++ compiler for the protocol library")
+    path = tmp_path_factory.mktemp("native") / "_protocol.so"
+    subprocess.run(
+        [compiler, "-O2", "-std=c++20", "-shared", "-fPIC", f"-I{_PROTOCOL / 'include'}",
+         str(_PROTOCOL / "src/host_api.cpp"), "-o", str(path)],
+        check=True,
+    )
+    library = native_protocol._load(str(path))
+    assert library is not None
+    return library
+
+
+def _decode(data: bytes, library) -> Measurements:
+    with pytest.MonkeyPatch.context() as patch:
+        patch.setattr(native_protocol, "_lib", library)
+        return BinarySerializer.deserialize_measurements(data)
+
+
+@pytest.mark.parametrize("cartesian", [False, True])
+def test_python_and_native_decoders_agree(native_library, cartesian):
+    data = BinarySerializer.serialize_measurements(_measurements(cartesian=cartesian))
+    python = _decode(data, None)
+    native = _decode(data, native_library)
+
+    assert type(python.lidar) is type(native.lidar) is LidarPoints
+    for decoded in (python, native):
+        assert decoded.lidar.angles.dtype == decoded.lidar.distances.dtype == np.float32
+    np.testing.assert_array_equal(python.lidar.angles, native.lidar.angles)
+    np.testing.assert_array_equal(python.lidar.distances, native.lidar.distances)
+    if cartesian:
+        for python_axis, native_axis in zip(python.lidar_xy, native.lidar_xy):
+            assert python_axis.dtype == native_axis.dtype == np.float32
+            np.testing.assert_array_equal(python_axis, native_axis)
+    python.lidar = native.lidar = None
+    python.lidar_xy = native.lidar_xy = None
+    assert python == native
+
+
+def test_fields_struct_matches_the_ctypes_layout():
+    offset = 0
+    for name, kind in native_protocol.MeasurementsFields._fields_:
+        offset += -offset % ctypes.alignment(kind)
+        assert getattr(native_protocol.MeasurementsFields, name).offset == offset, name
+        offset += ctypes.sizeof(kind)
+    assert native_protocol._FIELDS_STRUCT.size == offset
+
+
+def test_reused_buffers_do_not_leak_into_earlier_results(native_library):
+    with pytest.MonkeyPatch.context() as patch:
+        patch.setattr(native_protocol, "_lib", native_library)
+        # more points than the buffers start with, so they grow in between
+        large = BinarySerializer.serialize_measurements(_measurements(5000))
+        small = BinarySerializer.serialize_measurements(_measurements(10))
+        first = BinarySerializer.deserialize_measurements(small)
+        kept = first.lidar.angles.copy()
+        second = BinarySerializer.deserialize_measurements(large)
+        BinarySerializer.deserialize_measurements(small)
+
+        np.testing.assert_array_equal(first.lidar.angles, kept)
+        assert len(first.lidar) == 10 and len(second.lidar) == 5000
+        assert first.lidar.angles.flags.owndata and second.lidar.angles.flags.owndata
+
+
+def test_native_decoder_rejects_other_payloads(native_library):
+    with pytest.MonkeyPatch.context() as patch:
+        patch.setattr(native_protocol, "_lib", native_library)
+        with pytest.raises(ValueError):
+            native_protocol.decode_measurements(b"\x01\x00")
@@ -0,0 +1,91 @@
+from __future__ import annotations
+
+import threading
+import time
+
+import pytest
+
+from comm import serial_transport
+from comm.serial_transport import FRAMING_V1, FRAMING_V2, SerialTransport
+from tests.firmware_link import FirmwareLink
+
+
+class _Collect:
+    def __init__(self) -> None:
+        self.payloads: list[bytes] = []
+        self.received = threading.Event()
+
+    def on_message(self, data: bytes) -> None:
+        self.payloads.append(data)
+        self.received.set()
+
+    def on_error(self, error: Exception) -> None:
+        raise error
+
+
+class _V1OnlyLink(FirmwareLink):
+    """Firmware from before framing v2, it ignores framing requests."""
+
+    def _handle(self, nonce: int, payload: bytes) -> None:
+        if payload:
+            self.commands.append(payload)
+
+
+def _connect(monkeypatch: pytest.MonkeyPatch, link: FirmwareLink, **kwargs) -> SerialTransport:
+    monkeypatch.setattr(serial_transport.serial, "Serial", lambda **_: link)
+    transport = SerialTransport("fake", **kwargs)
+    transport.connect()
+    return transport
+
+
+def test_negotiates_v2_after_the_reset_on_open(monkeypatch: pytest.MonkeyPatch) -> None:
+    link = FirmwareLink(boot_s=0.4)
+    transport = _connect(monkeypatch, link)
+    assert transport.framing == FRAMING_V2
+    assert link.framing == FRAMING_V2
+
+    callback = _Collect()
+    transport.start_receiving(callback)
+    try:
+        transport.send(b"\x01command")
+        assert callback.received.wait(1.0)
+        assert callback.payloads[-1] == link.telemetry
+        assert link.commands == [b"\x01command"]
+    finally:
+        transport.close()
+
+
+def test_falls_back_to_v1_without_acknowledgement(monkeypatch: pytest.MonkeyPatch) -> None:
+    link = _V1OnlyLink(boot_s=0.0)
+    transport = _connect(monkeypatch, link, negotiation_timeout=0.5)
+    assert transport.framing == FRAMING_V1
+
+    callback = _Collect()
+    transport.start_receiving(callback)
+    try:
+        transport.send(b"\x01command")
+        assert callback.received.wait(1.0)
+        assert callback.payloads[-1] == link.telemetry
+        assert link.commands == [b"\x01command"]
+    finally:
+        transport.close()
+
+
+def test_negotiates_again_after_a_reboot(monkeypatch: pytest.MonkeyPatch) -> None:
+    link = FirmwareLink(boot_s=0.0)
+    transport = _connect(monkeypatch, link, silence_timeout=0.3)
+    callback = _Collect()
+    transport.start_receiving(callback)
+    try:
+        link.reboot(boot_s=0.2)
+        time.sleep(0.3)
+        callback.received.clear()
+        assert callback.received.wait(2.0)
+        assert link.framing == FRAMING_V2
+        assert transport.renegotiations >= 1
+
+        transport.send(b"\x01after")
+        time.sleep(0.1)
+        assert link.commands[-1] == b"\x01after"
+    finally:
+        transport.close()
@@ -122,12 +122,13 @@ def connect_keyboard_ctrl(
 def build_localization_stack(
     map_path: Path,
     initial_pose: Pose,
+    num_particles: int = PF_NUM_PARTICLES,
 ) -> LocalizationStack:
     world = load_world_from_json(map_path)
     localizer = ParticleFilterLocalizer(
         world=world,
         config=ParticleFilterConfig(
-            num_particles=PF_NUM_PARTICLES,
+            num_particles=num_particles,
             position_noise=PF_POSITION_NOISE,
             heading_noise=PF_HEADING_NOISE,
             blocked_heading_noise=PF_BLOCKED_HEADING_NOISE,
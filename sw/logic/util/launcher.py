@@ -5,11 +5,18 @@ from pathlib import Path
 from typing import TYPE_CHECKING, Any, Optional, Protocol
 
 from comm.controller import Controller
-from comm.messages import ArmCommand, Measurements, MoveCommand
+from comm.field_upload import field_upload_commands
+from comm.log_format import LogFormatter
+from comm.messages import ArmCommand, LogBatch, Measurements, MoveCommand
 from comm.types import Transport
 from geometry.transforms import Pose
 from localization.stack import LocalizationStack
-from params import INITIAL_POSE_THETA, INITIAL_POSE_X, INITIAL_POSE_Y
+from params import INITIAL_POSE_THETA, INITIAL_POSE_X, INITIAL_POSE_Y, PF_FIRMWARE_MAX_PARTICLES, PF_NUM_PARTICLES
+
+# likelihood field uploaded for firmware particle scoring, written by mk_lidar_raster.py
+_FIELD_PATH = "data/map_lidar_likelihood.lkf"
+# costScale in the LKF1 header
+_FIELD_COST_SCALE_OFFSET = 9
 
 if TYPE_CHECKING:
     from sim.server import RobotSimulatorServer
@@ -69,6 +76,7 @@ def run(
     map_path: str = "data/map_bear_rescue.json",
     recording_path: str | None = None,
     speed: float = 1.0,
+    firmware_scoring: bool = False,
 ) -> None:
     from comm.serial_transport import SerialTransport
     from comm.udp_transport import UdpTransport
@@ -109,7 +117,8 @@ def run(
         initial_pose = sim_server.robot.pose
     else:
         initial_pose = Pose(INITIAL_POSE_X, INITIAL_POSE_Y, INITIAL_POSE_THETA)
-    localization = build_localization_stack(resolved_map, initial_pose)
+    num_particles = min(PF_NUM_PARTICLES, PF_FIRMWARE_MAX_PARTICLES) if firmware_scoring else PF_NUM_PARTICLES
+    localization = build_localization_stack(resolved_map, initial_pose, num_particles)
 
     visualizer = None
     if use_vis:
@@ -129,6 +138,16 @@ def run(
 
     controller.set_measurement_callback(on_measurements)
 
+    log_formatter = LogFormatter.load()
+
+    def on_log(batch: LogBatch) -> None:
+        if batch.dropped:
+            print(f"robot: {batch.dropped} log records dropped")
+        for record in batch.records:
+            print(f"robot: {log_formatter.format(record)}")
+
+    controller.set_log_callback(on_log)
+
     if visualizer is not None:
         from util.vis_common import draw_sim_truth
 
@@ -148,6 +167,12 @@ def run(
     if sim_server is not None:
         sim_server.start()
     controller.start()
+    if firmware_scoring:
+        field = (repo_root / _FIELD_PATH).read_bytes()
+        for command in field_upload_commands(field):
+            controller.send_command(command)
+        controller.set_particle_scores_callback(localization.on_particle_scores)
+        localization.enable_firmware_scoring(controller.send_command, cost_scale=field[_FIELD_COST_SCALE_OFFSET])
     controller.send_command(ArmCommand())
 
     try:
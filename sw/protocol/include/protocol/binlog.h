@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <chrono>
+#endif
+
+#include "util.h"
+#include "wire.h"
+
+
+/**
+ * Deferred-format log. A log call stores the ID of its format string and
+ * the raw arguments in a lock-free ring; no formatting happens on the
+ * robot. The ring is sent as log messages and formatted on the host with a
+ * table of the format strings, generated from the sources by
+ * sw/protocol/tools/log_table.py. IDs are FNV-1a hashes of the format string.
+ *
+ * The format has to be a single string literal for the table generator.
+ */
+namespace binlog {
+
+
+enum class Level : uint8_t {
+    Error = 1,
+    Warn = 2,
+    Info = 3,
+    Debug = 4,
+};
+
+
+inline constexpr size_t SLOTS = 64;
+inline constexpr size_t ARGS_SIZE = 40;
+inline constexpr size_t MAX_STRING_SIZE = 15;
+// one log message, small enough not to hold up telemetry
+inline constexpr size_t MAX_PAYLOAD_SIZE = 512;
+
+
+consteval uint32_t formatId(std::string_view format) {
+    uint32_t hash = 2166136261u;
+    for (char c : format) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+
+struct Record {
+    uint32_t timestampUs = 0;
+    uint32_t id = 0;
+    Level level = Level::Info;
+    uint8_t argsSize = 0;
+    // an argument did not fit, it and all after it are missing
+    bool truncated = false;
+    // each argument is a Python struct code followed by its little-endian value,
+    // strings are 's', a length byte and the characters
+    std::array<uint8_t, ARGS_SIZE> args {};
+};
+
+
+/**
+ * Appends one argument to the record, or nothing if it does not fit; the
+ * host shows missing arguments as '?'.
+ */
+template <typename T>
+void appendArg(Record& record, T value) {
+    auto put = [&](char code, const void* data, size_t size) {
+        if (record.truncated || record.argsSize + 1 + size > ARGS_SIZE) {
+            record.truncated = true;
+            return;
+        }
+        record.args[record.argsSize++] = code;
+        std::memcpy(record.args.data() + record.argsSize, data, size);
+        record.argsSize += size;
+    };
+
+    if constexpr (std::is_enum_v<T>) {
+        appendArg(record, static_cast<std::underlying_type_t<T>>(value));
+    }
+    else if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+        const size_t length = value ? strnlen(value, MAX_STRING_SIZE) : 0;
+        uint8_t data[1 + MAX_STRING_SIZE];
+        data[0] = length;
+        if (length > 0) {
+            std::memcpy(data + 1, value, length);
+        }
+        put('s', data, 1 + length);
+    }
+    else if constexpr (std::is_same_v<T, float>) {
+        put('f', &value, sizeof(value));
+    }
+    else if constexpr (std::is_same_v<T, double>) {
+        put('d', &value, sizeof(value));
+    }
+    else if constexpr (std::is_integral_v<T> && sizeof(T) <= 4) {
+        if constexpr (std::is_signed_v<T>) {
+            const int32_t widened = value;
+            put('i', &widened, sizeof(widened));
+        }
+        else {
+            const uint32_t widened = value;
+            put('I', &widened, sizeof(widened));
+        }
+    }
+    else if constexpr (std::is_integral_v<T>) {
+        if constexpr (std::is_signed_v<T>) {
+            const int64_t widened = value;
+            put('q', &widened, sizeof(widened));
+        }
+        else {
+            const uint64_t widened = value;
+            put('Q', &widened, sizeof(widened));
+        }
+    }
+    else {
+        static_assert(std::is_integral_v<T>, "unsupported log argument type");
+    }
+}
+
+
+/**
+ * Bounded multi-producer, single-consumer ring of records. Each slot
+ * carries a sequence number telling whose turn it is; writers claim a
+ * slot with a compare-and-swap on the head and never wait. A full ring
+ * drops the new record.
+ */
+class Ring {
+    static_assert((SLOTS & (SLOTS - 1)) == 0, "the slot index must survive the position wrapping around");
+
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        Record record;
+    };
+
+    std::array<Slot, SLOTS> _slots;
+    std::atomic<uint32_t> _head = 0;
+    uint32_t _tail = 0;
+    std::atomic<uint32_t> _dropped = 0;
+
+public:
+    Ring() {
+        for (size_t i = 0; i < SLOTS; ++i) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(const Record& record) {
+        uint32_t position = _head.load(std::memory_order_relaxed);
+        while (true) {
+            auto& slot = _slots[position % SLOTS];
+            const int32_t lag = static_cast<int32_t>(slot.sequence.load(std::memory_order_acquire) - position);
+            if (lag == 0) {
+                if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.record = record;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lag < 0) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else {
+                position = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // consumer side, one task only
+    bool pop(Record& record) {
+        auto& slot = _slots[_tail % SLOTS];
+        if (slot.sequence.load(std::memory_order_acquire) != _tail + 1) {
+            return false;
+        }
+        record = slot.record;
+        slot.sequence.store(_tail + SLOTS, std::memory_order_release);
+        _tail++;
+        return true;
+    }
+
+    bool empty() const {
+        return _slots[_tail % SLOTS].sequence.load(std::memory_order_acquire) != _tail + 1;
+    }
+
+    uint32_t takeDropped() {
+        return _dropped.exchange(0, std::memory_order_relaxed);
+    }
+};
+
+
+class Log {
+    Ring _ring;
+
+    static uint32_t nowUs() {
+#ifdef ESP_PLATFORM
+        return static_cast<uint32_t>(esp_timer_get_time());
+#else
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch());
+        return static_cast<uint32_t>(us.count());
+#endif
+    }
+
+public:
+    static Log& instance() {
+        static Log log;
+        return log;
+    }
+
+    template <typename... Args>
+    void write(Level level, uint32_t id, Args... args) {
+        Record record;
+        record.timestampUs = nowUs();
+        record.id = id;
+        record.level = level;
+        (appendArg(record, args), ...);
+        _ring.push(record);
+    }
+
+    bool pending() const {
+        return !_ring.empty();
+    }
+
+    /**
+     * Moves everything in the ring into log messages, calling `emit(payload)`
+     * for each. Only one task may do this.
+     *
+     * Payload: the type byte and `wire::MESSAGE_LOG_FIELDS`, then per
+     * record `wire::LOG_RECORD_FIELDS` and the argument bytes.
+     */
+    template <typename Emit>
+    void serialize(Emit&& emit) {
+        std::vector<uint8_t> payload;
+        payload.reserve(MAX_PAYLOAD_SIZE);
+        Record record;
+        bool more = _ring.pop(record);
+        while (more) {
+            payload.clear();
+            // the count is the last header field, filled in below
+            comm::appendLe<uint8_t>(payload, comm::wire::MESSAGE_LOG);
+            comm::wire::append<comm::wire::MESSAGE_LOG_FIELDS>(payload, std::min<uint32_t>(_ring.takeDropped(), UINT16_MAX), 0);
+            const size_t countAt = payload.size() - 1;
+
+            uint8_t count = 0;
+            constexpr size_t RECORD_SIZE = comm::wire::layoutSize(comm::wire::LOG_RECORD_FIELDS);
+            while (more && count < UINT8_MAX && payload.size() + RECORD_SIZE + record.argsSize <= MAX_PAYLOAD_SIZE) {
+                comm::wire::append<comm::wire::LOG_RECORD_FIELDS>(payload, record.timestampUs, record.id, record.level, record.argsSize);
+                payload.insert(payload.end(), record.args.begin(), record.args.begin() + record.argsSize);
+                count++;
+                more = _ring.pop(record);
+            }
+            payload[countAt] = count;
+            emit(payload);
+        }
+    }
+};
+
+
+} // namespace binlog
+
+
+#define BINLOG(level, format, ...) \
+    ::binlog::Log::instance().write(level, std::integral_constant<uint32_t, ::binlog::formatId(format)>::value __VA_OPT__(,) __VA_ARGS__)
+
+#define BINLOG_E(format, ...) BINLOG(::binlog::Level::Error, format __VA_OPT__(,) __VA_ARGS__)
+#define BINLOG_W(format, ...) BINLOG(::binlog::Level::Warn, format __VA_OPT__(,) __VA_ARGS__)
+#define BINLOG_I(format, ...) BINLOG(::binlog::Level::Info, format __VA_OPT__(,) __VA_ARGS__)
+#define BINLOG_D(format, ...) BINLOG(::binlog::Level::Debug, format __VA_OPT__(,) __VA_ARGS__)
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+
+namespace comm {
+
+
+/**
+ * Appends the COBS encoding of `data` to `out`. The encoded bytes never
+ * contain 0x00, so a zero byte can be used as an unambiguous frame delimiter.
+ * The delimiter itself is not appended.
+ */
+inline void cobsEncode(std::span<const uint8_t> data, std::vector<uint8_t>& out) {
+    size_t codeIndex = out.size();
+    out.push_back(0);
+    uint8_t code = 1;
+
+    for (uint8_t byte : data) {
+        if (byte != 0) {
+            out.push_back(byte);
+            ++code;
+        }
+
+        if (byte == 0 || code == 0xFF) {
+            out[codeIndex] = code;
+            codeIndex = out.size();
+            out.push_back(0);
+            code = 1;
+        }
+    }
+
+    out[codeIndex] = code;
+}
+
+
+/**
+ * Decodes a single COBS block (without the trailing delimiter) into `out`,
+ * replacing its previous contents. Returns false on malformed input.
+ */
+inline bool cobsDecode(std::span<const uint8_t> data, std::vector<uint8_t>& out) {
+    out.clear();
+
+    size_t offset = 0;
+    while (offset < data.size()) {
+        const uint8_t code = data[offset++];
+        if (code == 0 || offset + code - 1 > data.size()) {
+            return false;
+        }
+
+        out.insert(out.end(), data.begin() + offset, data.begin() + offset + code - 1);
+        offset += code - 1;
+
+        if (code != 0xFF && offset < data.size()) {
+            out.push_back(0);
+        }
+    }
+
+    return true;
+}
+
+
+} // namespace comm
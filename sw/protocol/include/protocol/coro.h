@@ -0,0 +1,419 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/**
+ * Cooperative coroutine runtime for code that waits on I/O and deadlines.
+ * An `Executor` runs its coroutines on one thread. A suspended coroutine
+ * waits on a condition, a deadline or both, and is resumed exactly when
+ * one of them holds; while nothing is ready the thread sleeps until the
+ * earliest deadline or until another thread calls `wake()`. How it sleeps
+ * is left to the platform: the firmware blocks on a FreeRTOS task
+ * notification, `SimulatedExecutor` moves a virtual clock for host tests.
+ *
+ * Waiting allocates nothing, the state of a wait lives in the coroutine
+ * frame. Frames themselves are allocated when a `Task` is created.
+ */
+namespace coro {
+
+
+inline constexpr int64_t NO_DEADLINE = INT64_MAX;
+
+
+/**
+ * Coroutine started by `Executor::spawn` or by being awaited; exceptions
+ * terminate. A lambda coroutine reads its captures from the closure, which
+ * has to outlive the task, so it cannot be a temporary.
+ */
+class Task {
+public:
+    struct promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        bool detached = false;
+
+        Task get_return_object() {
+            return Task(Handle::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+                const std::coroutine_handle<> continuation = handle.promise().continuation;
+                if (handle.promise().detached) {
+                    handle.destroy();
+                }
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+
+private:
+    Handle _handle;
+
+public:
+    explicit Task(Handle handle):
+        _handle(handle)
+    {}
+
+    Task(Task&& other) noexcept:
+        _handle(std::exchange(other._handle, nullptr))
+    {}
+
+    Task(const Task&) = delete;
+
+    ~Task() {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    // hands the coroutine over to whoever resumes it, it frees itself when done
+    Handle detach() {
+        _handle.promise().detached = true;
+        return std::exchange(_handle, nullptr);
+    }
+
+    // runs the task to completion before the awaiting coroutine continues
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            Handle handle;
+
+            bool await_ready() noexcept {
+                return !handle || handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            void await_resume() noexcept {}
+        };
+        return Awaiter { _handle };
+    }
+};
+
+
+class Executor {
+public:
+    // what a suspended coroutine waits for, kept in its frame
+    struct Waiter {
+        int64_t deadlineUs = NO_DEADLINE;
+        // null waits for the deadline only
+        bool (*check)(Waiter&) = nullptr;
+        std::coroutine_handle<> handle;
+        Waiter* next = nullptr;
+    };
+
+private:
+    std::vector<std::coroutine_handle<>> _ready;
+    std::vector<std::coroutine_handle<>> _running;
+    Waiter* _waiters = nullptr;
+
+    template <typename Predicate>
+    class UntilAwaiter: Waiter {
+        using Result = std::invoke_result_t<Predicate&>;
+
+        Executor& _executor;
+        Predicate _predicate;
+        Result _result {};
+
+    public:
+        UntilAwaiter(Executor& executor, Predicate predicate, int64_t deadlineUs):
+            _executor(executor),
+            _predicate(std::move(predicate))
+        {
+            this->deadlineUs = deadlineUs;
+        }
+
+        bool await_ready() {
+            _result = _predicate();
+            return static_cast<bool>(_result);
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            this->handle = handle;
+            this->check = [](Waiter& waiter) {
+                auto& self = static_cast<UntilAwaiter&>(waiter);
+                self._result = self._predicate();
+                return static_cast<bool>(self._result);
+            };
+            _executor.suspend(*this);
+        }
+
+        // what the predicate returned last, false or empty if the deadline passed
+        Result await_resume() {
+            return std::move(_result);
+        }
+    };
+
+    class SleepAwaiter: Waiter {
+        Executor& _executor;
+
+    public:
+        SleepAwaiter(Executor& executor, int64_t deadlineUs):
+            _executor(executor)
+        {
+            this->deadlineUs = deadlineUs;
+        }
+
+        bool await_ready() {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            this->handle = handle;
+            _executor.suspend(*this);
+        }
+
+        void await_resume() {}
+    };
+
+    void suspend(Waiter& waiter) {
+        waiter.next = _waiters;
+        _waiters = &waiter;
+    }
+
+protected:
+    /**
+     * Blocks the executor thread until `deadlineUs` or a `wake()`,
+     * whichever comes first. Returning early is allowed.
+     */
+    virtual void idle(int64_t deadlineUs) = 0;
+
+public:
+    Executor() {
+        _ready.reserve(16);
+        _running.reserve(16);
+    }
+
+    virtual ~Executor() = default;
+
+    virtual int64_t nowUs() = 0;
+
+    // makes the executor check its waiters again; may be called from any thread
+    virtual void wake() = 0;
+
+    // runs `task` from the next `poll()` on, until it returns
+    void spawn(Task task) {
+        _ready.push_back(task.detach());
+    }
+
+    /**
+     * Resumes the waiting coroutine as soon as `predicate()` returns
+     * something true, or at `deadlineUs`. The predicate is evaluated on
+     * the executor thread, after every wake and resume, so anything it
+     * depends on has to come with a `wake()`. Awaiting returns what the
+     * predicate returned last, e.g. an optional.
+     */
+    template <typename Predicate>
+    auto until(Predicate predicate, int64_t deadlineUs = NO_DEADLINE) {
+        return UntilAwaiter<Predicate>(*this, std::move(predicate), deadlineUs);
+    }
+
+    auto sleepUntil(int64_t deadlineUs) {
+        return SleepAwaiter(*this, deadlineUs);
+    }
+
+    auto sleepFor(int64_t durationUs) {
+        return SleepAwaiter(*this, nowUs() + durationUs);
+    }
+
+    // lets the other ready coroutines run first
+    auto yield() {
+        return SleepAwaiter(*this, INT64_MIN);
+    }
+
+    /**
+     * Resumes everything that is ready, until all coroutines wait.
+     * Returns the earliest deadline among them.
+     */
+    int64_t poll() {
+        while (true) {
+            std::swap(_ready, _running);
+            for (auto handle : _running) {
+                handle.resume();
+            }
+            _running.clear();
+
+            const int64_t now = nowUs();
+            int64_t next = NO_DEADLINE;
+            const size_t spawned = _ready.size();
+            for (Waiter** link = &_waiters; *link != nullptr;) {
+                Waiter& waiter = **link;
+                if ((waiter.check && waiter.check(waiter)) || now >= waiter.deadlineUs) {
+                    *link = waiter.next;
+                    _ready.push_back(waiter.handle);
+                    continue;
+                }
+                next = std::min(next, waiter.deadlineUs);
+                link = &waiter.next;
+            }
+            // the list is newest first, resume in the order they suspended
+            std::reverse(_ready.begin() + spawned, _ready.end());
+
+            if (_ready.empty()) {
+                return next;
+            }
+        }
+    }
+
+    [[noreturn]] void run() {
+        while (true) {
+            idle(poll());
+        }
+    }
+};
+
+
+// flag set from any thread and awaited on the executor
+class Signal {
+    Executor& _executor;
+    std::atomic<bool> _set = false;
+
+public:
+    explicit Signal(Executor& executor):
+        _executor(executor)
+    {}
+
+    void set() {
+        _set.store(true, std::memory_order_release);
+        _executor.wake();
+    }
+
+    // clears the flag, returns whether it was set
+    bool take() {
+        return _set.exchange(false, std::memory_order_acq_rel);
+    }
+
+    // true once set, false at the deadline
+    auto wait(int64_t deadlineUs = NO_DEADLINE) {
+        return _executor.until([this] { return take(); }, deadlineUs);
+    }
+};
+
+
+/**
+ * Bounded queue filled from any thread and received from on the executor.
+ * A push that does not fit is refused.
+ */
+template <typename T, size_t Capacity>
+class Queue {
+    Executor& _executor;
+    std::mutex _mutex;
+    std::array<T, Capacity> _items {};
+    size_t _head = 0;
+    size_t _size = 0;
+
+public:
+    explicit Queue(Executor& executor):
+        _executor(executor)
+    {}
+
+    bool push(T item) {
+        {
+            std::lock_guard lock(_mutex);
+            if (_size == Capacity) {
+                return false;
+            }
+            _items[(_head + _size) % Capacity] = std::move(item);
+            _size++;
+        }
+        _executor.wake();
+        return true;
+    }
+
+    std::optional<T> tryPop() {
+        std::lock_guard lock(_mutex);
+        if (_size == 0) {
+            return std::nullopt;
+        }
+        std::optional<T> item = std::move(_items[_head]);
+        _head = (_head + 1) % Capacity;
+        _size--;
+        return item;
+    }
+
+    // the oldest item, or empty at the deadline
+    auto receive(int64_t deadlineUs = NO_DEADLINE) {
+        return _executor.until([this] { return tryPop(); }, deadlineUs);
+    }
+};
+
+
+/**
+ * Executor on a virtual clock for host tests and benchmarks. Time only
+ * moves while every coroutine waits, straight to the next deadline, so a
+ * run is deterministic and takes no real time.
+ */
+class SimulatedExecutor: public Executor {
+    int64_t _nowUs = 0;
+
+protected:
+    void idle(int64_t deadlineUs) override {
+        if (deadlineUs != NO_DEADLINE) {
+            _nowUs = std::max(_nowUs, deadlineUs);
+        }
+    }
+
+public:
+    int64_t nowUs() override {
+        return _nowUs;
+    }
+
+    // single threaded, the next `poll()` checks the waiters anyway
+    void wake() override {}
+
+    void advance(int64_t durationUs) {
+        _nowUs += durationUs;
+    }
+
+    // runs the coroutines until the clock reaches `untilUs`
+    void runUntil(int64_t untilUs) {
+        while (true) {
+            const int64_t next = poll();
+            if (next > untilUs) {
+                _nowUs = std::max(_nowUs, untilUs);
+                return;
+            }
+            idle(next);
+        }
+    }
+};
+
+
+} // namespace coro
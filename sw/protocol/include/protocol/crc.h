@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#ifdef ESP_PLATFORM
+#include "esp_rom_crc.h"
+#endif
+
+
+namespace comm {
+
+
+namespace detail {
+
+
+constexpr std::array<uint8_t, 256> makeCrc8Table() {
+    std::array<uint8_t, 256> table {};
+    for (unsigned i = 0; i < 256; ++i) {
+        uint8_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+
+// tables[k][i] is the CRC of byte i followed by k zero bytes, which lets
+// crc16() fold four input bytes per iteration (slicing-by-4)
+constexpr std::array<std::array<uint16_t, 256>, 4> makeCrc16Tables() {
+    std::array<std::array<uint16_t, 256>, 4> tables {};
+    for (unsigned i = 0; i < 256; ++i) {
+        uint16_t crc = i << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+        tables[0][i] = crc;
+    }
+    for (unsigned k = 1; k < tables.size(); ++k) {
+        for (unsigned i = 0; i < 256; ++i) {
+            const uint16_t prev = tables[k - 1][i];
+            tables[k][i] = static_cast<uint16_t>(prev << 8) ^ tables[0][prev >> 8];
+        }
+    }
+    return tables;
+}
+
+
+inline constexpr auto CRC8_TABLE = makeCrc8Table();
+inline constexpr auto CRC16_TABLES = makeCrc16Tables();
+
+
+} // namespace detail
+
+
+/**
+ * CRC-8, polynomial 0x07, with the same seed/result inversion as
+ * esp_rom_crc8_be(), so crc8(data) == esp_rom_crc8_be(0, data) and
+ * calls can be chained the same way.
+ */
+inline uint8_t crc8(std::span<const uint8_t> data, uint8_t crc = 0) {
+#ifdef ESP_PLATFORM
+    return esp_rom_crc8_be(crc, data.data(), data.size());
+#else
+    crc = ~crc;
+    for (uint8_t byte : data) {
+        crc = detail::CRC8_TABLE[crc ^ byte];
+    }
+    return ~crc;
+#endif
+}
+
+
+/**
+ * CRC-16/CCITT-FALSE (polynomial 0x1021, init 0xFFFF, no reflection,
+ * no final xor). Pass the previous result as `crc` to continue a CRC
+ * over several spans.
+ */
+inline uint16_t crc16(std::span<const uint8_t> data, uint16_t crc = 0xFFFF) {
+    const auto& t = detail::CRC16_TABLES;
+
+    const uint8_t* p = data.data();
+    size_t remaining = data.size();
+
+    while (remaining >= 4) {
+        const uint8_t b0 = p[0] ^ (crc >> 8);
+        const uint8_t b1 = p[1] ^ (crc & 0xFF);
+        crc = t[3][b0] ^ t[2][b1] ^ t[1][p[2]] ^ t[0][p[3]];
+        p += 4;
+        remaining -= 4;
+    }
+
+    while (remaining > 0) {
+        crc = static_cast<uint16_t>(crc << 8) ^ t[0][(crc >> 8) ^ *p];
+        ++p;
+        --remaining;
+    }
+
+    return crc;
+}
+
+
+} // namespace comm
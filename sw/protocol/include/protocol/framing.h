@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "cobs.h"
+#include "crc.h"
+#include "util.h"
+
+
+namespace comm {
+
+
+enum class Framing : uint8_t {
+    V1 = 1, // 0xA5-synchronized header with CRC-8
+    V2 = 2, // COBS-delimited, CRC-16
+};
+
+
+struct FrameStats {
+    uint32_t frames = 0;
+    uint32_t checksumErrors = 0;
+    uint32_t malformed = 0;
+    uint32_t oversized = 0;
+};
+
+
+inline constexpr uint8_t FRAME_V1_INIT = 0xA5;
+inline constexpr size_t FRAME_V1_HEADER_SIZE = 6;
+
+
+/**
+ * Appends a complete v1 frame to `out`:
+ * 0xA5, nonce, size u16 LE, crc8(payload), crc8 over the preceding header bytes, payload.
+ */
+inline void encodeFrameV1(uint8_t nonce, std::span<const uint8_t> payload, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + FRAME_V1_HEADER_SIZE + payload.size());
+    const size_t start = out.size();
+    appendLe<uint8_t>(out, FRAME_V1_INIT);
+    appendLe<uint8_t>(out, nonce);
+    appendLe<uint16_t>(out, payload.size());
+    appendLe<uint8_t>(out, crc8(payload));
+    appendLe<uint8_t>(out, crc8(std::span<const uint8_t>(out.data() + start, FRAME_V1_HEADER_SIZE - 1)));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+
+/**
+ * Incremental v1 frame decoder. Bytes outside a frame are skipped until the
+ * next 0xA5; a header that fails its checksum is dropped and the search
+ * continues after it.
+ */
+class FrameV1Decoder {
+    std::vector<uint8_t> _frame;
+    size_t _maxPayloadSize;
+    size_t _payloadSize = 0;
+    FrameStats _stats;
+
+public:
+    explicit FrameV1Decoder(size_t maxPayloadSize):
+        _maxPayloadSize(maxPayloadSize)
+    {
+        _frame.reserve(FRAME_V1_HEADER_SIZE + maxPayloadSize);
+    }
+
+    const FrameStats& stats() const {
+        return _stats;
+    }
+
+    void reset() {
+        _frame.clear();
+        _payloadSize = 0;
+    }
+
+    /**
+     * Feeds bytes into the decoder and calls `onFrame(nonce, payload)` for
+     * every valid frame completed by them.
+     */
+    template <typename OnFrame>
+    void push(std::span<const uint8_t> data, OnFrame&& onFrame) {
+        for (uint8_t byte : data) {
+            if (_frame.empty() && byte != FRAME_V1_INIT) {
+                continue;
+            }
+            _frame.push_back(byte);
+
+            if (_frame.size() == FRAME_V1_HEADER_SIZE && !acceptHeader()) {
+                reset();
+                continue;
+            }
+            if (_frame.size() >= FRAME_V1_HEADER_SIZE && _frame.size() == FRAME_V1_HEADER_SIZE + _payloadSize) {
+                finishFrame(onFrame);
+                reset();
+            }
+        }
+    }
+
+private:
+    bool acceptHeader() {
+        const std::span<const uint8_t> header(_frame);
+        if (header[5] != crc8(header.first(FRAME_V1_HEADER_SIZE - 1))) {
+            _stats.checksumErrors++;
+            return false;
+        }
+
+        size_t offset = 2;
+        uint16_t size = 0;
+        readLe(header, offset, size);
+        if (size > _maxPayloadSize) {
+            _stats.oversized++;
+            return false;
+        }
+        _payloadSize = size;
+        return true;
+    }
+
+    template <typename OnFrame>
+    void finishFrame(OnFrame& onFrame) {
+        const auto payload = std::span<const uint8_t>(_frame).subspan(FRAME_V1_HEADER_SIZE);
+        if (_frame[4] != crc8(payload)) {
+            _stats.checksumErrors++;
+            return;
+        }
+
+        _stats.frames++;
+        onFrame(_frame[1], payload);
+    }
+};
+
+
+/**
+ * Appends a complete v2 frame to `out`:
+ * COBS(nonce, payload, crc16 LE over nonce + payload) followed by a 0x00 delimiter.
+ */
+inline void encodeFrameV2(uint8_t nonce, std::span<const uint8_t> payload, std::vector<uint8_t>& out) {
+    std::vector<uint8_t> body;
+    body.reserve(1 + payload.size() + 2);
+    body.push_back(nonce);
+    body.insert(body.end(), payload.begin(), payload.end());
+    appendLe<uint16_t>(body, crc16(body));
+
+    out.reserve(out.size() + body.size() + body.size() / 254 + 2);
+    cobsEncode(body, out);
+    out.push_back(0);
+}
+
+
+/**
+ * Incremental v2 frame decoder. Bytes can be pushed in chunks of any size;
+ * every zero byte terminates the current frame, so after corruption the
+ * decoder is back in sync at the next delimiter.
+ */
+class FrameV2Decoder {
+    std::vector<uint8_t> _encoded;
+    std::vector<uint8_t> _decoded;
+    size_t _maxPayloadSize;
+    bool _overflow = false;
+    FrameStats _stats;
+
+public:
+    explicit FrameV2Decoder(size_t maxPayloadSize):
+        _maxPayloadSize(maxPayloadSize)
+    {
+        _encoded.reserve(maxEncodedSize());
+        _decoded.reserve(maxPayloadSize + 3);
+    }
+
+    size_t maxEncodedSize() const {
+        const size_t bodySize = 1 + _maxPayloadSize + 2;
+        return bodySize + bodySize / 254 + 1;
+    }
+
+    const FrameStats& stats() const {
+        return _stats;
+    }
+
+    void reset() {
+        _encoded.clear();
+        _overflow = false;
+    }
+
+    /**
+     * Feeds bytes into the decoder and calls `onFrame(nonce, payload)` for
+     * every valid frame completed by them.
+     */
+    template <typename OnFrame>
+    void push(std::span<const uint8_t> data, OnFrame&& onFrame) {
+        for (uint8_t byte : data) {
+            if (byte != 0) {
+                if (_encoded.size() < maxEncodedSize()) {
+                    _encoded.push_back(byte);
+                }
+                else {
+                    _overflow = true;
+                }
+                continue;
+            }
+
+            if (_overflow) {
+                _stats.oversized++;
+            }
+            else if (!_encoded.empty()) {
+                finishFrame(onFrame);
+            }
+            reset();
+        }
+    }
+
+private:
+    template <typename OnFrame>
+    void finishFrame(OnFrame& onFrame) {
+        if (!cobsDecode(_encoded, _decoded) || _decoded.size() < 3) {
+            _stats.malformed++;
+            return;
+        }
+
+        const size_t bodySize = _decoded.size() - 2;
+        size_t offset = bodySize;
+        uint16_t checksum = 0;
+        readLe(std::span<const uint8_t>(_decoded), offset, checksum);
+
+        if (checksum != crc16(std::span<const uint8_t>(_decoded.data(), bodySize))) {
+            _stats.checksumErrors++;
+            return;
+        }
+
+        _stats.frames++;
+        onFrame(_decoded[0], std::span<const uint8_t>(_decoded.data() + 1, bodySize - 1));
+    }
+};
+
+
+} // namespace comm
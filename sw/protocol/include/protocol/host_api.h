@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ * C interface of the protocol library for host programs, built as a shared
+ * library by sw/logic/setup.py and loaded from Python with ctypes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// bumped whenever a signature or a struct below changes
+#define LILY_PROTOCOL_ABI_VERSION 4
+
+
+typedef struct {
+    int64_t timestamp;
+    int32_t left_ticks;
+    int32_t right_ticks;
+    uint16_t filtered_invalid;
+    uint16_t filtered_out_of_range;
+    uint16_t filtered_low_quality;
+    uint16_t lidar_rpm;
+    uint16_t batch_backlog;
+    uint16_t batch_source_backlog;
+    uint32_t batch_age_us;
+    uint16_t batch_dropped;
+    uint16_t commands_coalesced;
+    uint16_t commands_preempted;
+    uint16_t commands_dropped;
+    // robot-frame points instead of angle / distance pairs
+    uint8_t cartesian;
+    uint8_t motion_compensated;
+} lily_measurements;
+
+
+uint32_t lily_protocol_abi_version(void);
+size_t lily_measurements_struct_size(void);
+
+/**
+ * Decodes a measurements payload into `fields` and the lidar points into
+ * `angles` (rad, counter-clockwise) and `distances` (m), writing at most
+ * `capacity` points. For a Cartesian payload (`fields->cartesian`) the two
+ * arrays receive the robot-frame x and y in m instead. Returns the number
+ * of points in the payload, or -1 if it is not a measurements payload.
+ */
+int32_t lily_decode_measurements(
+    const uint8_t* data, size_t size, lily_measurements* fields, float* angles, float* distances, size_t capacity);
+
+/**
+ * Writes the profile messages of this library, the same payloads the robot
+ * sends on a profile dump command, each preceded by its size as a
+ * little-endian uint16. Returns the number of bytes needed; nothing is
+ * written if that exceeds `capacity`. A non-zero `reset` clears the
+ * histograms afterwards.
+ */
+size_t lily_profile_dump(uint8_t* out, size_t capacity, int reset);
+
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
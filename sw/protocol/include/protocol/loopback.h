@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+
+#include "transport.h"
+
+
+namespace comm {
+
+
+/**
+ * One direction of an in-memory link: a bounded byte queue. Writes that
+ * do not fit are refused whole, like a full TX buffer.
+ */
+class LoopbackPipe {
+    std::deque<uint8_t> _bytes;
+    size_t _capacity;
+    std::mutex _mutex;
+    std::condition_variable _readable;
+
+public:
+    explicit LoopbackPipe(size_t capacity):
+        _capacity(capacity)
+    {}
+
+    size_t read(std::span<uint8_t> buffer, uint32_t timeoutMs) {
+        std::unique_lock lock(_mutex);
+        auto ready = [&] { return !_bytes.empty(); };
+        if (timeoutMs == ByteStream::WAIT_FOREVER) {
+            _readable.wait(lock, ready);
+        }
+        else if (!_readable.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready)) {
+            return 0;
+        }
+
+        const size_t size = std::min(buffer.size(), _bytes.size());
+        std::copy_n(_bytes.begin(), size, buffer.begin());
+        _bytes.erase(_bytes.begin(), _bytes.begin() + size);
+        return size;
+    }
+
+    size_t write(std::span<const uint8_t> data) {
+        {
+            std::lock_guard lock(_mutex);
+            if (data.size() > _capacity - _bytes.size()) {
+                return 0;
+            }
+            _bytes.insert(_bytes.end(), data.begin(), data.end());
+        }
+        _readable.notify_one();
+        return data.size();
+    }
+
+    size_t free() {
+        std::lock_guard lock(_mutex);
+        return _capacity - _bytes.size();
+    }
+};
+
+
+class LoopbackStream: public ByteStream {
+    std::shared_ptr<LoopbackPipe> _rx;
+    std::shared_ptr<LoopbackPipe> _tx;
+
+public:
+    LoopbackStream(std::shared_ptr<LoopbackPipe> rx, std::shared_ptr<LoopbackPipe> tx):
+        _rx(std::move(rx)),
+        _tx(std::move(tx))
+    {}
+
+    size_t read(std::span<uint8_t> buffer, uint32_t timeoutMs) override {
+        return _rx->read(buffer, timeoutMs);
+    }
+
+    size_t write(std::span<const uint8_t> data) override {
+        return _tx->write(data);
+    }
+
+    size_t txFree() override {
+        return _tx->free();
+    }
+};
+
+
+/**
+ * Two streams connected back to back, what one writes the other reads.
+ * Runs the framing layer on the host without hardware.
+ */
+inline std::pair<std::unique_ptr<ByteStream>, std::unique_ptr<ByteStream>> makeLoopbackPair(size_t capacity = 10240) {
+    auto aToB = std::make_shared<LoopbackPipe>(capacity);
+    auto bToA = std::make_shared<LoopbackPipe>(capacity);
+    return {
+        std::make_unique<LoopbackStream>(bToA, aToB),
+        std::make_unique<LoopbackStream>(aToB, bToA),
+    };
+}
+
+
+} // namespace comm
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#else
+#include <chrono>
+#endif
+
+#include "util.h"
+#include "wire.h"
+
+// PROFILE_SCOPE compiles to nothing unless this is set
+#ifndef PROFILING_ENABLED
+#define PROFILING_ENABLED 0
+#endif
+
+
+namespace profiling {
+
+
+inline constexpr size_t MAX_SECTIONS = 32;
+inline constexpr size_t MAX_CORES = 2;
+// bucket b counts durations of [2^b, 2^(b+1)) ticks, bucket 0 also 0
+inline constexpr size_t BUCKETS = 32;
+inline constexpr size_t MAX_NAME_SIZE = 31;
+
+
+/**
+ * Tick source of the profiler: the CPU cycle counter of the current core on
+ * the robot, nanoseconds of the steady clock on the host. The dump carries
+ * ticks per microsecond, so both can be compared.
+ */
+struct Clock {
+#ifdef ESP_PLATFORM
+    static uint32_t now() {
+        return esp_cpu_get_cycle_count();
+    }
+
+    static uint8_t core() {
+        return esp_cpu_get_core_id();
+    }
+
+    static uint16_t ticksPerUs() {
+        return esp_rom_get_cpu_ticks_per_us();
+    }
+#else
+    static uint32_t now() {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch());
+        return static_cast<uint32_t>(ns.count());
+    }
+
+    static uint8_t core() {
+        return 0;
+    }
+
+    static uint16_t ticksPerUs() {
+        return 1000;
+    }
+#endif
+};
+
+
+struct Histogram {
+    uint32_t count = 0;
+    uint64_t totalTicks = 0;
+    uint32_t maxTicks = 0;
+    std::array<uint32_t, BUCKETS> buckets {};
+
+    void add(uint32_t ticks) {
+        count++;
+        totalTicks += ticks;
+        maxTicks = ticks > maxTicks ? ticks : maxTicks;
+        buckets[ticks == 0 ? 0 : std::bit_width(ticks) - 1]++;
+    }
+};
+
+
+// the histograms of one section are only written from their own core, no locking needed;
+// a task preempted mid-update by another task on the same core can lose a sample
+struct Section {
+    char name[MAX_NAME_SIZE + 1] = {};
+    std::array<Histogram, MAX_CORES> cores;
+};
+
+
+class Profiler {
+    std::array<Section, MAX_SECTIONS> _sections;
+    // sections are only ever added, readers see the ones below this count complete
+    std::atomic<size_t> _count = 0;
+    // serializes section registration
+    std::mutex _mutex;
+
+public:
+    static Profiler& instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    /**
+     * The section called `name`, created on first use. Returns nullptr once
+     * all sections are taken, the scope is then not recorded.
+     */
+    Section* section(const char* name) {
+        std::lock_guard lock(_mutex);
+        const size_t count = _count.load();
+        for (size_t i = 0; i < count; ++i) {
+            if (std::strncmp(_sections[i].name, name, MAX_NAME_SIZE) == 0) {
+                return &_sections[i];
+            }
+        }
+        if (count == MAX_SECTIONS) {
+            return nullptr;
+        }
+        auto& section = _sections[count];
+        std::strncpy(section.name, name, MAX_NAME_SIZE);
+        _count.store(count + 1);
+        return &section;
+    }
+
+    void reset() {
+        const size_t count = _count.load();
+        for (size_t i = 0; i < count; ++i) {
+            _sections[i].cores = {};
+        }
+    }
+
+    /**
+     * Calls `emit(payload)` with one profile message per section and core
+     * that has samples. Bucket counts are trimmed to the non-empty range.
+     * Takes no lock, so `emit` may run profiled code itself.
+     */
+    template <typename Emit>
+    void serialize(Emit&& emit) {
+        const size_t count = _count.load();
+
+        uint8_t total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            for (const auto& histogram : _sections[i].cores) {
+                total += histogram.count > 0;
+            }
+        }
+
+        std::vector<uint8_t> payload;
+        uint8_t index = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const auto& section = _sections[i];
+            for (uint8_t core = 0; core < MAX_CORES; ++core) {
+                const auto& histogram = section.cores[core];
+                if (histogram.count == 0) {
+                    continue;
+                }
+
+                size_t first = 0;
+                while (first < BUCKETS && histogram.buckets[first] == 0) {
+                    first++;
+                }
+                // the count is bumped before the bucket, an update can be in flight
+                if (first == BUCKETS) {
+                    continue;
+                }
+                size_t last = BUCKETS - 1;
+                while (histogram.buckets[last] == 0) {
+                    last--;
+                }
+
+                const size_t nameSize = std::strlen(section.name);
+                payload.clear();
+                comm::appendLe<uint8_t>(payload, comm::wire::MESSAGE_PROFILE);
+                comm::wire::append<comm::wire::MESSAGE_PROFILE_FIELDS>(payload, index++, total, Clock::ticksPerUs(), core, nameSize);
+                payload.insert(payload.end(), section.name, section.name + nameSize);
+                comm::wire::append<comm::wire::PROFILE_HISTOGRAM_FIELDS>(
+                    payload, histogram.count, histogram.totalTicks, histogram.maxTicks, first, last - first + 1);
+                for (size_t b = first; b <= last; ++b) {
+                    comm::wire::append<comm::wire::PROFILE_BUCKET_FIELDS>(payload, histogram.buckets[b]);
+                }
+                emit(payload);
+            }
+        }
+    }
+};
+
+
+/**
+ * Records the time from construction to destruction into a section.
+ * Samples where the task migrated to another core are dropped, the
+ * cycle counters of the two cores are unrelated.
+ */
+class Scope {
+    Section* _section;
+    uint32_t _start;
+    uint8_t _core;
+
+public:
+    explicit Scope(Section* section):
+        _section(section),
+        _start(Clock::now()),
+        _core(Clock::core())
+    {}
+
+    Scope(Scope const&) = delete;
+
+    ~Scope() {
+        const uint32_t ticks = Clock::now() - _start;
+        if (_section && Clock::core() == _core && _core < MAX_CORES) {
+            _section->cores[_core].add(ticks);
+        }
+    }
+};
+
+
+} // namespace profiling
+
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILING_ENABLED
+// profiles the rest of the enclosing block as section `name`
+#define PROFILE_SCOPE(name) \
+    static ::profiling::Section* const PROFILE_CONCAT(profileSection, __LINE__) = ::profiling::Profiler::instance().section(name); \
+    ::profiling::Scope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileSection, __LINE__))
+#else
+#define PROFILE_SCOPE(name) static_cast<void>(0)
+#endif
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "framing.h"
+#include "profiler.h"
+
+
+namespace comm {
+
+
+/**
+ * Byte-oriented link under a `FramedTransport`: a UART, the USB
+ * Serial/JTAG peripheral or an in-memory loopback.
+ */
+class ByteStream {
+public:
+    static constexpr uint32_t WAIT_FOREVER = UINT32_MAX;
+
+    virtual ~ByteStream() = default;
+
+    /**
+     * Waits up to `timeoutMs` for the first byte, then returns whatever
+     * else is already available, at most `buffer.size()` bytes.
+     */
+    virtual size_t read(std::span<uint8_t> buffer, uint32_t timeoutMs) = 0;
+
+    // returns the number of bytes accepted, a frame is dropped unless all of it is
+    virtual size_t write(std::span<const uint8_t> data) = 0;
+
+    // room left in the TX buffer, what can be sent right now without waiting
+    virtual size_t txFree() = 0;
+};
+
+
+/**
+ * Framed link over a `ByteStream`. Frames with an empty payload are
+ * reserved for the transport itself: an empty frame whose nonce is a
+ * `Framing` value asks to switch both directions to that framing. The
+ * switch is acknowledged with an empty frame in the new framing.
+ *
+ * The transport has no thread of its own, `receive` has to be called in a
+ * loop; the firmware does that from a dedicated task.
+ */
+class FramedTransport {
+public:
+    using ReceiveCallback = std::function<void(std::span<const uint8_t>)>;
+
+    static constexpr size_t MAX_PAYLOAD_SIZE = 2048;
+
+private:
+    std::unique_ptr<ByteStream> _stream;
+    ReceiveCallback _receiveCallback;
+    uint8_t _txNonce = 0;
+    std::vector<uint8_t> _txFrame;
+    std::mutex _txMutex;
+    std::atomic<Framing> _framing = Framing::V1;
+    // set between `requestFraming` and its acknowledgement
+    std::atomic<bool> _requestPending = false;
+    std::array<uint8_t, 256> _rxChunk {};
+    // framing the decoders were last fed with, only touched by `receive`
+    Framing _rxFraming = Framing::V1;
+    FrameV1Decoder _decoderV1 { MAX_PAYLOAD_SIZE };
+    FrameV2Decoder _decoderV2 { MAX_PAYLOAD_SIZE };
+    std::atomic<uint32_t> _txDropped = 0;
+
+    void handleFrame(uint8_t nonce, std::span<const uint8_t> payload) {
+        if (payload.empty()) {
+            handleControlFrame(nonce);
+            return;
+        }
+
+        if (_receiveCallback) {
+            _receiveCallback(payload);
+        }
+    }
+
+    void handleControlFrame(uint8_t nonce) {
+        // our own request being acknowledged, answering would ping-pong
+        if (_requestPending.exchange(false)) {
+            return;
+        }
+
+        const auto requested = static_cast<Framing>(nonce);
+        if (requested != Framing::V1 && requested != Framing::V2) {
+            return;
+        }
+
+        _framing = requested;
+        std::lock_guard lock(_txMutex);
+        writeFrame(requested, _txNonce++, {});
+    }
+
+    bool writeFrame(Framing framing, uint8_t nonce, std::span<const uint8_t> payload) {
+        _txFrame.clear();
+        if (framing == Framing::V2) {
+            encodeFrameV2(nonce, payload, _txFrame);
+        }
+        else {
+            encodeFrameV1(nonce, payload, _txFrame);
+        }
+
+        if (_stream->write(_txFrame) != _txFrame.size()) {
+            _txDropped++;
+            return false;
+        }
+        return true;
+    }
+
+public:
+    explicit FramedTransport(std::unique_ptr<ByteStream> stream):
+        _stream(std::move(stream))
+    {
+        _txFrame.reserve(FRAME_V1_HEADER_SIZE + MAX_PAYLOAD_SIZE + MAX_PAYLOAD_SIZE / 254 + 8);
+    }
+
+    void setReceiveCallback(ReceiveCallback callback) {
+        _receiveCallback = std::move(callback);
+    }
+
+    /**
+     * Sends one frame in the current framing. Returns false if the payload
+     * is too large or the stream did not take the whole frame.
+     */
+    bool send(std::span<const uint8_t> payload) {
+        PROFILE_SCOPE("transport_send");
+        if (payload.size() > MAX_PAYLOAD_SIZE) {
+            _txDropped++;
+            return false;
+        }
+
+        std::lock_guard lock(_txMutex);
+        return writeFrame(_framing, _txNonce++, payload);
+    }
+
+    /**
+     * Reads one chunk from the stream, waiting up to `timeoutMs` for it,
+     * and dispatches the frames it completes. Returns the number of bytes
+     * read.
+     */
+    size_t receive(uint32_t timeoutMs = ByteStream::WAIT_FOREVER) {
+        const Framing framing = _framing;
+        if (framing != _rxFraming) {
+            _decoderV1.reset();
+            _decoderV2.reset();
+            _rxFraming = framing;
+        }
+
+        const size_t size = _stream->read(_rxChunk, timeoutMs);
+        const auto chunk = std::span<const uint8_t>(_rxChunk.data(), size);
+        auto onFrame = [&](uint8_t nonce, std::span<const uint8_t> payload) {
+            handleFrame(nonce, payload);
+        };
+
+        // a framing switch inside the chunk applies from the next chunk on,
+        // the peer waits for the acknowledgement before using it
+        if (framing == Framing::V2) {
+            _decoderV2.push(chunk, onFrame);
+        }
+        else {
+            _decoderV1.push(chunk, onFrame);
+        }
+        return size;
+    }
+
+    /**
+     * Peer side of the framing switch: sends the request in the current
+     * framing and expects the acknowledgement in the new one.
+     */
+    void requestFraming(Framing framing) {
+        std::lock_guard lock(_txMutex);
+        _requestPending = true;
+        // the nonce of the request carries the framing
+        writeFrame(_framing, static_cast<uint8_t>(framing), {});
+        _framing = framing;
+    }
+
+    Framing framing() const {
+        return _framing;
+    }
+
+    size_t txFree() {
+        return _stream->txFree();
+    }
+
+    // frames dropped on send, too large or not taken by the stream
+    uint32_t txDropped() const {
+        return _txDropped;
+    }
+
+    const FrameStats& frameStats() const {
+        return _framing == Framing::V2 ? _decoderV2.stats() : _decoderV1.stats();
+    }
+};
+
+
+} // namespace comm
@@ -23,7 +23,10 @@ void appendLe(std::vector<uint8_t>& out, T value) {
 #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
     std::reverse(bytes.begin(), bytes.end());
 #endif
-    out.insert(out.end(), bytes.begin(), bytes.end());
+    // resize and copy: GCC 12 reports a bogus overflow for insert of a range into a fresh vector
+    const size_t size = out.size();
+    out.resize(size + sizeof(T));
+    std::memcpy(out.data() + size, bytes.data(), sizeof(T));
 }
 
 
@@ -0,0 +1,714 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "util.h"
+
+
+namespace comm::wire {
+
+
+// first byte of every command payload
+inline constexpr uint8_t COMMAND_MOVE = 1;
+inline constexpr uint8_t COMMAND_CLAW = 2;
+inline constexpr uint8_t COMMAND_ARM = 3;
+inline constexpr uint8_t COMMAND_LIDAR_FILTER = 4;
+inline constexpr uint8_t COMMAND_BEAR_TEMPLATE = 5;
+inline constexpr uint8_t COMMAND_FIELD_UPLOAD_BEGIN = 6;
+inline constexpr uint8_t COMMAND_FIELD_UPLOAD_DATA = 7;
+inline constexpr uint8_t COMMAND_FIELD_UPLOAD_END = 8;
+inline constexpr uint8_t COMMAND_SCORE_PARTICLES = 9;
+inline constexpr uint8_t COMMAND_RECORDER_DUMP = 10;
+inline constexpr uint8_t COMMAND_LIDAR_MOTOR = 11;
+inline constexpr uint8_t COMMAND_TELEMETRY_CONFIG = 12;
+inline constexpr uint8_t COMMAND_PROFILE_DUMP = 13;
+inline constexpr uint8_t COMMAND_LIDAR_OUTPUT = 14;
+inline constexpr uint8_t COMMAND_MOTOR_TRACE = 15;
+inline constexpr uint8_t COMMAND_COLLISION_GUARD = 16;
+inline constexpr uint8_t COMMAND_SUBSCRIBE = 17;
+inline constexpr uint8_t COMMAND_GRASP = 18;
+
+inline constexpr uint8_t LIDAR_FILTER_DROP_INVALID = 0x01;
+inline constexpr uint8_t BEAR_TEMPLATE_ENABLED = 0x01;
+inline constexpr uint8_t PROFILE_DUMP_RESET = 0x01;
+inline constexpr uint8_t LIDAR_OUTPUT_CARTESIAN = 0x01;
+inline constexpr uint8_t LIDAR_OUTPUT_MOTION_COMPENSATION = 0x02;
+inline constexpr uint8_t LIDAR_OUTPUT_RAW = 0x04;
+inline constexpr uint8_t MOTOR_TRACE_CAPTURE_NOW = 0x01;
+inline constexpr uint8_t MOTOR_TRACE_STALL_TRIGGER = 0x02;
+inline constexpr uint8_t COLLISION_GUARD_ENABLED = 0x01;
+
+// first byte of every telemetry payload
+inline constexpr uint8_t MESSAGE_MEASUREMENTS = 1;
+inline constexpr uint8_t MESSAGE_BEAR_CANDIDATES = 2;
+inline constexpr uint8_t MESSAGE_PARTICLE_SCORES = 3;
+inline constexpr uint8_t MESSAGE_FIELD_UPLOAD_RESULT = 4;
+inline constexpr uint8_t MESSAGE_RECORDER_CHUNK = 5;
+inline constexpr uint8_t MESSAGE_LIDAR_STARTUP = 6;
+inline constexpr uint8_t MESSAGE_SCAN_MATCH = 7;
+inline constexpr uint8_t MESSAGE_PROFILE = 8;
+inline constexpr uint8_t MESSAGE_LOG = 9;
+inline constexpr uint8_t MESSAGE_MEASUREMENTS_XY = 10;
+inline constexpr uint8_t MESSAGE_MOTOR_TRACE = 11;
+inline constexpr uint8_t MESSAGE_GUARD_EVENT = 12;
+inline constexpr uint8_t MESSAGE_LIDAR_RAW = 13;
+inline constexpr uint8_t MESSAGE_STREAMS = 14;
+inline constexpr uint8_t MESSAGE_LOCAL_GRID = 15;
+inline constexpr uint8_t MESSAGE_GRASP = 16;
+
+inline constexpr uint8_t MEASUREMENTS_XY_MOTION_COMPENSATED = 0x01;
+
+// telemetry streams of the subscribe command, bit positions in a stream frame's mask
+inline constexpr uint8_t STREAM_MEASUREMENTS = 0;
+inline constexpr uint8_t STREAM_ENCODERS = 1;
+inline constexpr uint8_t STREAM_LIDAR_MOTOR = 2;
+inline constexpr uint8_t STREAM_COLLISION_GUARD = 3;
+inline constexpr uint8_t STREAM_LINK = 4;
+inline constexpr uint8_t STREAM_LOCAL_GRID = 5;
+inline constexpr uint8_t STREAM_COUNT = 6;
+// subscription periods besides milliseconds
+inline constexpr uint16_t STREAM_OFF = 0;
+inline constexpr uint16_t STREAM_ON_CHANGE = 0xFFFF;
+
+// bytes of one express packet in a raw lidar message
+inline constexpr size_t LIDAR_RAW_PACKET_SIZE = 84;
+// cells along either side of a local grid tile
+inline constexpr size_t LOCAL_GRID_TILE_CELLS = 10;
+
+
+/**
+ * Every run of fixed-size fields on the wire is listed once, as a table of
+ * names and types. A table named after a type byte holds the fields that
+ * follow that byte; variable parts are a count field followed by that many
+ * runs of a record table. The firmware writes and reads payloads through
+ * `append` and `read` below, the host builds its decoders from the same
+ * tables (sw/protocol/tools/wire_layout.py parses this file), so keep them
+ * one field per line. Names carry their unit.
+ */
+enum class FieldType : uint8_t {
+    U8,
+    I8,
+    U16,
+    I16,
+    U32,
+    I32,
+    U64,
+    I64,
+};
+
+struct Field {
+    const char* name;
+    FieldType type;
+};
+
+
+// commands without a table carry nothing but their type byte
+
+inline constexpr Field COMMAND_MOVE_FIELDS[] = {
+    { "left_speed_mm_s", FieldType::I16 },
+    { "right_speed_mm_s", FieldType::I16 },
+};
+
+inline constexpr Field COMMAND_CLAW_FIELDS[] = {
+    { "pwm", FieldType::I16 },
+};
+
+inline constexpr Field COMMAND_LIDAR_FILTER_FIELDS[] = {
+    { "flags", FieldType::U8 },
+    { "min_distance_mm", FieldType::U16 },
+    // 0 = no limit
+    { "max_distance_mm", FieldType::U16 },
+    { "min_quality", FieldType::U8 },
+};
+
+inline constexpr Field COMMAND_BEAR_TEMPLATE_FIELDS[] = {
+    { "flags", FieldType::U8 },
+    { "jump_mm", FieldType::U16 },
+    { "max_gap_q6", FieldType::U16 },
+    { "min_points", FieldType::U8 },
+    { "width_mm", FieldType::U16 },
+    { "width_tolerance_mm", FieldType::U16 },
+    { "min_range_mm", FieldType::U16 },
+    { "max_range_mm", FieldType::U16 },
+    // 1/10000
+    { "min_covariance_ratio", FieldType::U16 },
+};
+
+inline constexpr Field COMMAND_FIELD_UPLOAD_BEGIN_FIELDS[] = {
+    { "size", FieldType::U32 },
+};
+
+// followed by the data up to the end of the payload
+inline constexpr Field COMMAND_FIELD_UPLOAD_DATA_FIELDS[] = {
+    { "offset", FieldType::U32 },
+};
+
+inline constexpr Field COMMAND_FIELD_UPLOAD_END_FIELDS[] = {
+    { "crc", FieldType::U16 },
+};
+
+// followed by `count` PARTICLE_FIELDS
+inline constexpr Field COMMAND_SCORE_PARTICLES_FIELDS[] = {
+    { "sequence", FieldType::U16 },
+    { "count", FieldType::U16 },
+};
+
+inline constexpr Field PARTICLE_FIELDS[] = {
+    { "x_mm", FieldType::I16 },
+    { "y_mm", FieldType::I16 },
+    // 32768 = pi
+    { "theta", FieldType::I16 },
+};
+
+inline constexpr Field COMMAND_LIDAR_MOTOR_FIELDS[] = {
+    { "target_rpm", FieldType::U16 },
+};
+
+inline constexpr Field COMMAND_TELEMETRY_CONFIG_FIELDS[] = {
+    { "period_ms", FieldType::U16 },
+    { "max_lidar_points", FieldType::U16 },
+};
+
+inline constexpr Field COMMAND_PROFILE_DUMP_FIELDS[] = {
+    { "flags", FieldType::U8 },
+};
+
+inline constexpr Field COMMAND_LIDAR_OUTPUT_FIELDS[] = {
+    { "flags", FieldType::U8 },
+    { "mount_x_mm", FieldType::I16 },
+    { "mount_y_mm", FieldType::I16 },
+    // 32768 = pi
+    { "mount_theta", FieldType::I16 },
+};
+
+inline constexpr Field COMMAND_MOTOR_TRACE_FIELDS[] = {
+    { "flags", FieldType::U8 },
+    { "period_us", FieldType::U16 },
+    { "post_trigger", FieldType::U16 },
+    { "stall_speed", FieldType::U16 },
+    { "stall_samples", FieldType::U16 },
+};
+
+// followed by `count` VERTEX_FIELDS
+inline constexpr Field COMMAND_COLLISION_GUARD_FIELDS[] = {
+    { "flags", FieldType::U8 },
+    { "lookahead_ms", FieldType::U16 },
+    { "min_points", FieldType::U8 },
+    { "clear_ms", FieldType::U16 },
+    { "count", FieldType::U8 },
+};
+
+inline constexpr Field VERTEX_FIELDS[] = {
+    { "x_mm", FieldType::I16 },
+    { "y_mm", FieldType::I16 },
+};
+
+// followed by `count` SUBSCRIPTION_FIELDS
+inline constexpr Field COMMAND_SUBSCRIBE_FIELDS[] = {
+    { "count", FieldType::U8 },
+};
+
+inline constexpr Field SUBSCRIPTION_FIELDS[] = {
+    { "stream", FieldType::U8 },
+    // STREAM_OFF, STREAM_ON_CHANGE or a period
+    { "period_ms", FieldType::U16 },
+};
+
+inline constexpr Field COMMAND_GRASP_FIELDS[] = {
+    { "action", FieldType::U8 },
+    { "close_pwm", FieldType::I16 },
+    { "ramp_ms", FieldType::U16 },
+    { "timeout_ms", FieldType::U16 },
+    { "stall_ma", FieldType::U16 },
+    { "stall_ms", FieldType::U16 },
+    { "hold_pwm", FieldType::I16 },
+};
+
+
+// followed by `count` LIDAR_POINT_FIELDS, or LIDAR_POINT_XY_FIELDS and
+// MEASUREMENTS_XY_FIELDS, then the MEASUREMENTS_*_FIELDS groups in order
+inline constexpr Field MESSAGE_MEASUREMENTS_FIELDS[] = {
+    { "timestamp", FieldType::I64 },
+    { "count", FieldType::U16 },
+};
+
+inline constexpr Field LIDAR_POINT_FIELDS[] = {
+    // 1/64 degree clockwise, below 360 degrees so either signedness reads it
+    { "angle_q6", FieldType::I16 },
+    { "distance_q2", FieldType::U16 },
+};
+
+inline constexpr Field LIDAR_POINT_XY_FIELDS[] = {
+    { "x_mm", FieldType::I16 },
+    { "y_mm", FieldType::I16 },
+};
+
+inline constexpr Field MEASUREMENTS_XY_FIELDS[] = {
+    { "flags", FieldType::U8 },
+};
+
+inline constexpr Field MEASUREMENTS_ENCODERS_FIELDS[] = {
+    { "left_ticks", FieldType::I32 },
+    { "right_ticks", FieldType::I32 },
+};
+
+// the groups from here on are missing in payloads of older firmware
+inline constexpr Field MEASUREMENTS_FILTERED_FIELDS[] = {
+    { "invalid", FieldType::U16 },
+    { "out_of_range", FieldType::U16 },
+    { "low_quality", FieldType::U16 },
+};
+
+inline constexpr Field MEASUREMENTS_RPM_FIELDS[] = {
+    { "lidar_rpm", FieldType::U16 },
+};
+
+inline constexpr Field MEASUREMENTS_BATCH_FIELDS[] = {
+    { "backlog", FieldType::U16 },
+    { "source_backlog", FieldType::U16 },
+    { "age_us", FieldType::U32 },
+    { "dropped", FieldType::U16 },
+};
+
+inline constexpr Field MEASUREMENTS_COMMAND_LANES_FIELDS[] = {
+    { "coalesced", FieldType::U16 },
+    { "preempted", FieldType::U16 },
+    { "dropped", FieldType::U16 },
+};
+
+// followed by `count` BEAR_CANDIDATE_FIELDS
+inline constexpr Field MESSAGE_BEAR_CANDIDATES_FIELDS[] = {
+    { "timestamp", FieldType::I64 },
+    { "count", FieldType::U8 },
+};
+
+inline constexpr Field BEAR_CANDIDATE_FIELDS[] = {
+    { "angle_q6", FieldType::I16 },
+    { "distance_q2", FieldType::U16 },
+    { "width_mm", FieldType::U16 },
+    { "points", FieldType::U8 },
+    // 255 = 1.0
+    { "score", FieldType::U8 },
+};
+
+// followed by `count` PARTICLE_COST_FIELDS
+inline constexpr Field MESSAGE_PARTICLE_SCORES_FIELDS[] = {
+    { "sequence", FieldType::U16 },
+    { "scan_timestamp", FieldType::I64 },
+    { "points", FieldType::U16 },
+    { "count", FieldType::U16 },
+};
+
+inline constexpr Field PARTICLE_COST_FIELDS[] = {
+    { "cost", FieldType::U32 },
+};
+
+inline constexpr Field MESSAGE_FIELD_UPLOAD_RESULT_FIELDS[] = {
+    { "ok", FieldType::U8 },
+};
+
+// followed by the data up to the end of the payload
+inline constexpr Field MESSAGE_RECORDER_CHUNK_FIELDS[] = {
+    { "offset", FieldType::U32 },
+    { "total", FieldType::U32 },
+};
+
+inline constexpr Field MESSAGE_LIDAR_STARTUP_FIELDS[] = {
+    { "ok", FieldType::U8 },
+    { "attempts", FieldType::U8 },
+    { "health", FieldType::U8 },
+    { "model", FieldType::U8 },
+    { "firmware_major", FieldType::U8 },
+    { "firmware_minor", FieldType::U8 },
+    { "hardware", FieldType::U8 },
+    // duration of each phase of the last attempt
+    { "stop_us", FieldType::U32 },
+    { "reset_us", FieldType::U32 },
+    { "health_us", FieldType::U32 },
+    { "info_us", FieldType::U32 },
+    { "scan_us", FieldType::U32 },
+};
+
+inline constexpr Field MESSAGE_SCAN_MATCH_FIELDS[] = {
+    { "timestamp", FieldType::I64 },
+    { "dx_mm", FieldType::I16 },
+    { "dy_mm", FieldType::I16 },
+    // 32768 = pi
+    { "dtheta", FieldType::I16 },
+    // 255 = 1.0
+    { "quality", FieldType::U8 },
+    { "iterations", FieldType::U8 },
+    { "matched", FieldType::U16 },
+    { "duration_us", FieldType::U32 },
+};
+
+// followed by the name, PROFILE_HISTOGRAM_FIELDS and `bucket_count` PROFILE_BUCKET_FIELDS
+inline constexpr Field MESSAGE_PROFILE_FIELDS[] = {
+    { "index", FieldType::U8 },
+    { "total", FieldType::U8 },
+    { "ticks_per_us", FieldType::U16 },
+    { "core", FieldType::U8 },
+    { "name_size", FieldType::U8 },
+};
+
+inline constexpr Field PROFILE_HISTOGRAM_FIELDS[] = {
+    { "count", FieldType::U32 },
+    { "total_ticks", FieldType::U64 },
+    { "max_ticks", FieldType::U32 },
+    { "first_bucket", FieldType::U8 },
+    { "bucket_count", FieldType::U8 },
+};
+
+inline constexpr Field PROFILE_BUCKET_FIELDS[] = {
+    { "count", FieldType::U32 },
+};
+
+// followed by `count` LOG_RECORD_FIELDS, each followed by its arguments
+inline constexpr Field MESSAGE_LOG_FIELDS[] = {
+    { "dropped", FieldType::U16 },
+    { "count", FieldType::U8 },
+};
+
+inline constexpr Field LOG_RECORD_FIELDS[] = {
+    { "timestamp_us", FieldType::U32 },
+    { "format_id", FieldType::U32 },
+    { "level", FieldType::U8 },
+    { "args_size", FieldType::U8 },
+};
+
+// followed by `count` samples of two MOTOR_SAMPLE_FIELDS, left motor first
+inline constexpr Field MESSAGE_MOTOR_TRACE_FIELDS[] = {
+    { "reason", FieldType::U8 },
+    { "period_us", FieldType::U16 },
+    { "total", FieldType::U16 },
+    { "trigger", FieldType::U16 },
+    { "offset", FieldType::U16 },
+    { "count", FieldType::U8 },
+};
+
+inline constexpr Field MOTOR_SAMPLE_FIELDS[] = {
+    { "setpoint", FieldType::I16 },
+    { "speed", FieldType::I16 },
+    { "position", FieldType::I32 },
+};
+
+inline constexpr Field MESSAGE_GUARD_EVENT_FIELDS[] = {
+    { "timestamp", FieldType::I64 },
+    { "blocked", FieldType::I8 },
+    { "points", FieldType::U8 },
+    { "nearest_x_mm", FieldType::I16 },
+    { "nearest_y_mm", FieldType::I16 },
+    { "left_speed_mm_s", FieldType::I16 },
+    { "right_speed_mm_s", FieldType::I16 },
+    { "reaction_us", FieldType::U32 },
+};
+
+// followed by `count` LIDAR_RAW_PACKET_FIELDS, each followed by the LIDAR_RAW_PACKET_SIZE packet bytes
+inline constexpr Field MESSAGE_LIDAR_RAW_FIELDS[] = {
+    { "timestamp", FieldType::I64 },
+    { "dropped", FieldType::U16 },
+    { "checksum_errors", FieldType::U16 },
+    { "count", FieldType::U8 },
+};
+
+inline constexpr Field LIDAR_RAW_PACKET_FIELDS[] = {
+    // before `timestamp`
+    { "age_us", FieldType::U32 },
+    { "sequence", FieldType::U8 },
+};
+
+// followed by the STREAM_*_FIELDS of the streams set in `mask`, lowest bit first
+inline constexpr Field MESSAGE_STREAMS_FIELDS[] = {
+    { "timestamp", FieldType::I64 },
+    { "mask", FieldType::U8 },
+};
+
+inline constexpr Field STREAM_ENCODERS_FIELDS[] = {
+    { "left_ticks", FieldType::I32 },
+    { "right_ticks", FieldType::I32 },
+};
+
+inline constexpr Field STREAM_LIDAR_MOTOR_FIELDS[] = {
+    { "rpm", FieldType::U16 },
+    { "target_rpm", FieldType::U16 },
+};
+
+inline constexpr Field STREAM_COLLISION_GUARD_FIELDS[] = {
+    { "blocked", FieldType::I8 },
+    { "left_speed_mm_s", FieldType::I16 },
+    { "right_speed_mm_s", FieldType::I16 },
+};
+
+inline constexpr Field STREAM_LINK_FIELDS[] = {
+    { "tx_free", FieldType::U16 },
+    { "tx_dropped", FieldType::U32 },
+};
+
+// followed by `count` LOCAL_GRID_TILE_FIELDS, each followed by `runs` LOCAL_GRID_RUN_FIELDS
+inline constexpr Field MESSAGE_LOCAL_GRID_FIELDS[] = {
+    { "timestamp", FieldType::I64 },
+    { "x_mm", FieldType::I32 },
+    { "y_mm", FieldType::I32 },
+    // 32768 = pi
+    { "theta", FieldType::I16 },
+    { "origin_tile_x", FieldType::I16 },
+    { "origin_tile_y", FieldType::I16 },
+    { "count", FieldType::U8 },
+};
+
+inline constexpr Field LOCAL_GRID_TILE_FIELDS[] = {
+    { "tile_x", FieldType::I16 },
+    { "tile_y", FieldType::I16 },
+    { "runs", FieldType::U8 },
+};
+
+// cells in row order, x fastest
+inline constexpr Field LOCAL_GRID_RUN_FIELDS[] = {
+    { "length", FieldType::U8 },
+    { "value", FieldType::I8 },
+};
+
+inline constexpr Field MESSAGE_GRASP_FIELDS[] = {
+    { "timestamp", FieldType::I64 },
+    { "action", FieldType::U8 },
+    { "result", FieldType::U8 },
+    { "duration_ms", FieldType::U16 },
+    // 0xFFFF = did not stall
+    { "left_stall_ms", FieldType::U16 },
+    { "right_stall_ms", FieldType::U16 },
+    { "left_peak_ma", FieldType::U16 },
+    { "right_peak_ma", FieldType::U16 },
+};
+
+
+template <FieldType>
+struct FieldTraits;
+
+template <> struct FieldTraits<FieldType::U8> { using Type = uint8_t; };
+template <> struct FieldTraits<FieldType::I8> { using Type = int8_t; };
+template <> struct FieldTraits<FieldType::U16> { using Type = uint16_t; };
+template <> struct FieldTraits<FieldType::I16> { using Type = int16_t; };
+template <> struct FieldTraits<FieldType::U32> { using Type = uint32_t; };
+template <> struct FieldTraits<FieldType::I32> { using Type = int32_t; };
+template <> struct FieldTraits<FieldType::U64> { using Type = uint64_t; };
+template <> struct FieldTraits<FieldType::I64> { using Type = int64_t; };
+
+template <FieldType TYPE>
+using FieldValue = typename FieldTraits<TYPE>::Type;
+
+
+constexpr size_t fieldSize(FieldType type) {
+    switch (type) {
+        case FieldType::U8:
+        case FieldType::I8:
+            return 1;
+        case FieldType::U16:
+        case FieldType::I16:
+            return 2;
+        case FieldType::U32:
+        case FieldType::I32:
+            return 4;
+        case FieldType::U64:
+        case FieldType::I64:
+            return 8;
+    }
+    return 0;
+}
+
+
+// bytes of one run of the fields of `layout`
+template <size_t N>
+constexpr size_t layoutSize(const Field (&layout)[N]) {
+    size_t size = 0;
+    for (const Field& field : layout) {
+        size += fieldSize(field.type);
+    }
+    return size;
+}
+
+
+namespace detail {
+
+template <const auto& LAYOUT, size_t... I, typename... Values>
+void appendFields(std::vector<uint8_t>& out, std::index_sequence<I...>, const Values&... values) {
+    (appendLe<FieldValue<LAYOUT[I].type>>(out, static_cast<FieldValue<LAYOUT[I].type>>(values)), ...);
+}
+
+template <FieldType TYPE, typename Value>
+void readField(std::span<const uint8_t> data, size_t& offset, Value& value) {
+    FieldValue<TYPE> raw {};
+    readLe(data, offset, raw);
+    value = static_cast<Value>(raw);
+}
+
+template <const auto& LAYOUT, size_t... I, typename... Values>
+void readFields(std::span<const uint8_t> data, size_t& offset, std::index_sequence<I...>, Values&... values) {
+    (readField<LAYOUT[I].type>(data, offset, values), ...);
+}
+
+} // namespace detail
+
+
+/**
+ * Appends one run of `LAYOUT` to `out`, each value converted to the type
+ * of its field.
+ */
+template <const auto& LAYOUT, typename... Values>
+void append(std::vector<uint8_t>& out, const Values&... values) {
+    static_assert(sizeof...(Values) == std::size(LAYOUT), "one value per field of the layout");
+    detail::appendFields<LAYOUT>(out, std::index_sequence_for<Values...>(), values...);
+}
+
+
+/**
+ * Reads one run of `LAYOUT` at `offset` into `values`. Returns false,
+ * leaving everything alone, if `data` ends before the run does.
+ */
+template <const auto& LAYOUT, typename... Values>
+bool read(std::span<const uint8_t> data, size_t& offset, Values&... values) {
+    static_assert(sizeof...(Values) == std::size(LAYOUT), "one value per field of the layout");
+    if (offset > data.size() || data.size() - offset < layoutSize(LAYOUT)) {
+        return false;
+    }
+    detail::readFields<LAYOUT>(data, offset, std::index_sequence_for<Values...>(), values...);
+    return true;
+}
+
+
+/**
+ * Everything of a measurements payload except the lidar points, which sit
+ * between the timestamp and the encoders as (angle Q6, distance Q2) pairs.
+ * The Cartesian variant carries robot-frame (x, y) points in int16 mm
+ * instead, followed by a flags byte.
+ */
+struct MeasurementsFields {
+    int64_t timestamp = 0;
+    bool cartesian = false;
+    // Cartesian only: the motion during the batch was compensated on the robot
+    bool motionCompensated = false;
+    int32_t leftTicks = 0;
+    int32_t rightTicks = 0;
+    uint16_t filteredInvalid = 0;
+    uint16_t filteredOutOfRange = 0;
+    uint16_t filteredLowQuality = 0;
+    uint16_t lidarRpm = 0;
+    uint16_t batchBacklog = 0;
+    uint16_t batchSourceBacklog = 0;
+    uint32_t batchAgeUs = 0;
+    uint16_t batchDropped = 0;
+    uint16_t commandsCoalesced = 0;
+    uint16_t commandsPreempted = 0;
+    uint16_t commandsDropped = 0;
+};
+
+
+inline constexpr size_t LIDAR_POINT_SIZE = layoutSize(LIDAR_POINT_FIELDS);
+inline constexpr size_t MEASUREMENTS_FIXED_SIZE = 1 + layoutSize(MESSAGE_MEASUREMENTS_FIELDS) +
+    layoutSize(MEASUREMENTS_ENCODERS_FIELDS) + layoutSize(MEASUREMENTS_FILTERED_FIELDS) + layoutSize(MEASUREMENTS_RPM_FIELDS) +
+    layoutSize(MEASUREMENTS_BATCH_FIELDS) + layoutSize(MEASUREMENTS_COMMAND_LANES_FIELDS);
+
+
+// the part of a measurements payload after the points, shared by both variants
+inline void appendMeasurementsTail(const MeasurementsFields& fields, std::vector<uint8_t>& out) {
+    append<MEASUREMENTS_ENCODERS_FIELDS>(out, fields.leftTicks, fields.rightTicks);
+    append<MEASUREMENTS_FILTERED_FIELDS>(out, fields.filteredInvalid, fields.filteredOutOfRange, fields.filteredLowQuality);
+    append<MEASUREMENTS_RPM_FIELDS>(out, fields.lidarRpm);
+    append<MEASUREMENTS_BATCH_FIELDS>(out, fields.batchBacklog, fields.batchSourceBacklog, fields.batchAgeUs, fields.batchDropped);
+    append<MEASUREMENTS_COMMAND_LANES_FIELDS>(out, fields.commandsCoalesced, fields.commandsPreempted, fields.commandsDropped);
+}
+
+
+/**
+ * Appends a measurements payload to `out`. `points` is a range of anything
+ * with `angleQ6` and `distanceQ2` members.
+ */
+template <typename Points>
+void encodeMeasurements(const MeasurementsFields& fields, const Points& points, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + MEASUREMENTS_FIXED_SIZE + points.size() * LIDAR_POINT_SIZE);
+
+    appendLe<uint8_t>(out, MESSAGE_MEASUREMENTS);
+    append<MESSAGE_MEASUREMENTS_FIELDS>(out, fields.timestamp, points.size());
+    for (const auto& point : points) {
+        append<LIDAR_POINT_FIELDS>(out, point.angleQ6, point.distanceQ2);
+    }
+    appendMeasurementsTail(fields, out);
+}
+
+
+/**
+ * Appends a Cartesian measurements payload to `out`. `points` is a range
+ * of anything with int16 `x` and `y` members, robot frame in mm.
+ */
+template <typename Points>
+void encodeMeasurementsXY(const MeasurementsFields& fields, const Points& points, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + MEASUREMENTS_FIXED_SIZE + layoutSize(MEASUREMENTS_XY_FIELDS) + points.size() * LIDAR_POINT_SIZE);
+
+    appendLe<uint8_t>(out, MESSAGE_MEASUREMENTS_XY);
+    append<MESSAGE_MEASUREMENTS_FIELDS>(out, fields.timestamp, points.size());
+    for (const auto& point : points) {
+        append<LIDAR_POINT_XY_FIELDS>(out, point.x, point.y);
+    }
+    append<MEASUREMENTS_XY_FIELDS>(out, fields.motionCompensated ? MEASUREMENTS_XY_MOTION_COMPENSATED : 0);
+    appendMeasurementsTail(fields, out);
+}
+
+
+/**
+ * Decodes either measurements payload, calling `onPoint(angleQ6, distanceQ2)`
+ * for every polar lidar point or `onPointXY(xMm, yMm)` for every Cartesian
+ * one. Payloads of older firmware, which end earlier, leave the missing
+ * fields at zero. Returns false if `data` is not a measurements payload.
+ */
+template <typename OnPoint, typename OnPointXY>
+bool decodeMeasurements(std::span<const uint8_t> data, MeasurementsFields& fields, OnPoint&& onPoint, OnPointXY&& onPointXY) {
+    fields = {};
+    size_t offset = 0;
+    uint8_t type = 0;
+    uint16_t count = 0;
+    if (!readLe(data, offset, type) || (type != MESSAGE_MEASUREMENTS && type != MESSAGE_MEASUREMENTS_XY) ||
+        !read<MESSAGE_MEASUREMENTS_FIELDS>(data, offset, fields.timestamp, count)) {
+        return false;
+    }
+    fields.cartesian = type == MESSAGE_MEASUREMENTS_XY;
+    const size_t flagsSize = fields.cartesian ? layoutSize(MEASUREMENTS_XY_FIELDS) : 0;
+    if (data.size() - offset < count * LIDAR_POINT_SIZE + flagsSize + layoutSize(MEASUREMENTS_ENCODERS_FIELDS)) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < count; ++i) {
+        if (fields.cartesian) {
+            int16_t x = 0;
+            int16_t y = 0;
+            read<LIDAR_POINT_XY_FIELDS>(data, offset, x, y);
+            onPointXY(x, y);
+        }
+        else {
+            uint16_t angleQ6 = 0;
+            uint16_t distanceQ2 = 0;
+            read<LIDAR_POINT_FIELDS>(data, offset, angleQ6, distanceQ2);
+            onPoint(angleQ6, distanceQ2);
+        }
+    }
+
+    if (fields.cartesian) {
+        uint8_t flags = 0;
+        read<MEASUREMENTS_XY_FIELDS>(data, offset, flags);
+        fields.motionCompensated = (flags & MEASUREMENTS_XY_MOTION_COMPENSATED) != 0;
+    }
+
+    read<MEASUREMENTS_ENCODERS_FIELDS>(data, offset, fields.leftTicks, fields.rightTicks);
+    // firmware before the lidar filter ended after the encoders, each group leaves the offset alone if it is missing
+    read<MEASUREMENTS_FILTERED_FIELDS>(data, offset, fields.filteredInvalid, fields.filteredOutOfRange, fields.filteredLowQuality);
+    read<MEASUREMENTS_RPM_FIELDS>(data, offset, fields.lidarRpm);
+    read<MEASUREMENTS_BATCH_FIELDS>(data, offset, fields.batchBacklog, fields.batchSourceBacklog, fields.batchAgeUs, fields.batchDropped);
+    read<MEASUREMENTS_COMMAND_LANES_FIELDS>(data, offset, fields.commandsCoalesced, fields.commandsPreempted, fields.commandsDropped);
+    return true;
+}
+
+
+} // namespace comm::wire
@@ -0,0 +1,102 @@
+#include "protocol/host_api.h"
+
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "protocol/profiler.h"
+#include "protocol/wire.h"
+
+
+namespace {
+
+
+// the lidar turns clockwise, the host counts angles counter-clockwise
+constexpr float RAD_PER_ANGLE_Q6 = -1.0f / (64 * 57.295779513f);
+constexpr float M_PER_DISTANCE_Q2 = 1.0f / (4 * 1000.0f);
+constexpr float M_PER_MM = 1.0f / 1000.0f;
+
+
+} // namespace
+
+
+extern "C" {
+
+
+uint32_t lily_protocol_abi_version(void) {
+    return LILY_PROTOCOL_ABI_VERSION;
+}
+
+
+size_t lily_measurements_struct_size(void) {
+    return sizeof(lily_measurements);
+}
+
+
+int32_t lily_decode_measurements(
+    const uint8_t* data, size_t size, lily_measurements* fields, float* angles, float* distances, size_t capacity) {
+    PROFILE_SCOPE("decode_measurements");
+    comm::wire::MeasurementsFields decoded;
+    size_t count = 0;
+
+    const bool ok = comm::wire::decodeMeasurements(std::span<const uint8_t>(data, size), decoded,
+        [&](uint16_t angleQ6, uint16_t distanceQ2) {
+            if (count < capacity) {
+                angles[count] = static_cast<int16_t>(angleQ6) * RAD_PER_ANGLE_Q6;
+                distances[count] = distanceQ2 * M_PER_DISTANCE_Q2;
+            }
+            count++;
+        },
+        [&](int16_t xMm, int16_t yMm) {
+            if (count < capacity) {
+                angles[count] = xMm * M_PER_MM;
+                distances[count] = yMm * M_PER_MM;
+            }
+            count++;
+        });
+    if (!ok) {
+        return -1;
+    }
+
+    *fields = {
+        .timestamp = decoded.timestamp,
+        .left_ticks = decoded.leftTicks,
+        .right_ticks = decoded.rightTicks,
+        .filtered_invalid = decoded.filteredInvalid,
+        .filtered_out_of_range = decoded.filteredOutOfRange,
+        .filtered_low_quality = decoded.filteredLowQuality,
+        .lidar_rpm = decoded.lidarRpm,
+        .batch_backlog = decoded.batchBacklog,
+        .batch_source_backlog = decoded.batchSourceBacklog,
+        .batch_age_us = decoded.batchAgeUs,
+        .batch_dropped = decoded.batchDropped,
+        .commands_coalesced = decoded.commandsCoalesced,
+        .commands_preempted = decoded.commandsPreempted,
+        .commands_dropped = decoded.commandsDropped,
+        .cartesian = decoded.cartesian,
+        .motion_compensated = decoded.motionCompensated,
+    };
+    return static_cast<int32_t>(count);
+}
+
+
+size_t lily_profile_dump(uint8_t* out, size_t capacity, int reset) {
+    std::vector<uint8_t> dump;
+    profiling::Profiler::instance().serialize([&](std::span<const uint8_t> payload) {
+        comm::appendLe<uint16_t>(dump, payload.size());
+        dump.insert(dump.end(), payload.begin(), payload.end());
+    });
+
+    if (dump.size() <= capacity) {
+        if (!dump.empty()) {
+            std::memcpy(out, dump.data(), dump.size());
+        }
+        if (reset) {
+            profiling::Profiler::instance().reset();
+        }
+    }
+    return dump.size();
+}
+
+
+} // extern "C"
@@ -0,0 +1,60 @@
+"""Generates the format string table of the deferred log (protocol/binlog.h).
+
+The robot only sends the ID of a format string, the host looks it up in
+this table. The firmware build runs this script, writing
+build/log_formats.json; sw/logic/comm/log_format.py reads it.
+
+Usage: python log_table.py -o log_formats.json <sources...>
+Only the standard library is used, so it runs in the ESP-IDF Python environment.
+"""
+
+from __future__ import annotations
+
+import argparse
+import codecs
+import json
+import re
+from pathlib import Path
+from typing import Iterable
+
+_CALL = re.compile(r'BINLOG_([EWID])\(\s*"((?:[^"\\]|\\.)*)"')
+
+
+def format_id(fmt: str) -> int:
+    """FNV-1a of the format string, the same as binlog::formatId."""
+    value = 2166136261
+    for byte in fmt.encode("latin-1"):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def scan_sources(paths: Iterable[Path]) -> dict[int, dict]:
+    """Maps format IDs to the format strings and locations of all BINLOG calls in `paths`."""
+    table: dict[int, dict] = {}
+    for path in paths:
+        text = Path(path).read_text(encoding="utf-8", errors="replace")
+        for match in _CALL.finditer(text):
+            fmt = codecs.decode(match.group(2), "unicode_escape")
+            line = text.count("\n", 0, match.start()) + 1
+            table[format_id(fmt)] = {"format": fmt, "file": Path(path).name, "line": line}
+    return table
+
+
+def source_files(dirs: Iterable[Path]) -> list[Path]:
+    return sorted(path for directory in dirs for pattern in ("*.h", "*.cpp") for path in Path(directory).rglob(pattern))
+
+
+def main() -> None:
+    sw_dir = Path(__file__).resolve().parents[2]
+    parser = argparse.ArgumentParser(description="Generate the deferred log format table")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("sources", nargs="*", type=Path, help="default: the firmware and protocol sources")
+    args = parser.parse_args()
+
+    sources = args.sources or source_files([sw_dir / "firmware" / "main", sw_dir / "protocol" / "include"])
+    table = scan_sources(sources)
+    Path(args.output).write_text(json.dumps({str(key): value for key, value in sorted(table.items())}, indent=1), encoding="utf-8")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,63 @@
+"""Extracts the wire format from protocol/wire.h: the integer constants and the field tables.
+
+The firmware writes and reads every payload through the `Field` tables of wire.h, the host
+builds its decoders from the output of this script (sw/logic/comm/wire.py), so the two cannot
+disagree on a layout.
+
+Usage: python wire_layout.py [-o wire_layout.json] [wire.h]
+Only the standard library is used, so it runs in the ESP-IDF Python environment.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import re
+from pathlib import Path
+
+DEFAULT_HEADER = Path(__file__).resolve().parents[1] / "include" / "protocol" / "wire.h"
+
+# struct codes of the FieldType values, little-endian
+TYPE_CODES = {"U8": "B", "I8": "b", "U16": "H", "I16": "h", "U32": "I", "I32": "i", "U64": "Q", "I64": "q"}
+
+_CONSTANT = re.compile(r"^inline constexpr (?:u?int\d+_t|size_t) (\w+) = (0x[0-9A-Fa-f]+|\d+);", re.MULTILINE)
+_TABLE = re.compile(r"^inline constexpr Field (\w+)\[\] = \{(.*?)^\};", re.MULTILINE | re.DOTALL)
+_FIELD = re.compile(r'\{\s*"(\w+)",\s*FieldType::(\w+)\s*\}')
+
+
+def parse(text: str) -> dict:
+    """{"constants": {name: value}, "layouts": {name: [[field, type], ...]}} of a wire.h."""
+    constants = {name: int(value, 0) for name, value in _CONSTANT.findall(text)}
+    layouts = {}
+    for name, body in _TABLE.findall(text):
+        # comments between the fields are allowed
+        body = re.sub(r"//[^\n]*", "", body)
+        fields = _FIELD.findall(body)
+        for field, kind in fields:
+            if kind not in TYPE_CODES:
+                raise ValueError(f"{name}.{field}: unknown field type {kind}")
+        if not fields or len(fields) != body.count("{"):
+            raise ValueError(f"{name}: expected one {{ \"name\", FieldType::X }} entry per line")
+        layouts[name] = [list(field) for field in fields]
+    return {"constants": constants, "layouts": layouts}
+
+
+def load(path: Path = DEFAULT_HEADER) -> dict:
+    return parse(Path(path).read_text(encoding="utf-8"))
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Extract the wire format from protocol/wire.h")
+    parser.add_argument("-o", "--output", help="default: standard output")
+    parser.add_argument("header", nargs="?", type=Path, default=DEFAULT_HEADER)
+    args = parser.parse_args()
+
+    text = json.dumps(load(args.header), indent=1)
+    if args.output:
+        Path(args.output).write_text(text, encoding="utf-8")
+    else:
+        print(text)
+
+
+if __name__ == "__main__":
+    main()